@@ -0,0 +1,313 @@
+///////////////////////////////////////////////////////////////////////////////
+// animationsystem.cpp
+// ============
+// keyframed float channels, sampled a batch of channels at a time
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AnimationSystem.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define ANIM_USE_SSE2 1
+#endif
+
+namespace
+{
+	// channels sampled together; a frame is padded to a multiple of this
+	const int CHANNEL_BATCH = 8;
+	const float SAMPLE_LEVELS = 65535.0f;
+
+	// the keys' value at a time, linear between them and held past the ends
+	float EvaluateKeys(const std::vector<ANIMATION_KEY>& keys, float time)
+	{
+		if (time <= keys.front().time)
+		{
+			return keys.front().value;
+		}
+		for (size_t i = 1; i < keys.size(); i++)
+		{
+			if (time <= keys[i].time)
+			{
+				const ANIMATION_KEY& a = keys[i - 1];
+				const ANIMATION_KEY& b = keys[i];
+				float span = b.time - a.time;
+				float t = (span > 0.0f) ? (time - a.time) / span : 1.0f;
+				return a.value + (b.value - a.value) * t;
+			}
+		}
+		return keys.back().value;
+	}
+}
+
+/***********************************************************
+ *  AnimationSystem()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+AnimationSystem::AnimationSystem()
+{
+}
+
+/***********************************************************
+ *  AddClip()
+ *
+ *  This method is used for adding an empty clip. The rate is
+ *  nudged so the clip is a whole number of frames long, so
+ *  the last frame falls on its end.
+ ***********************************************************/
+int AnimationSystem::AddClip(float duration, float sampleRate, bool bLoop)
+{
+	CLIP clip;
+	clip.duration = std::max(duration, 0.001f);
+	clip.frameCount = std::max(1, (int)std::lround(clip.duration * std::max(sampleRate, 0.0f))) + 1;
+	clip.sampleRate = (float)(clip.frameCount - 1) / clip.duration;
+	clip.bLoop = bLoop;
+	clip.bPlaying = false;
+	clip.startTime = 0.0;
+	clip.speed = 1.0f;
+	clip.channelCount = 0;
+	clip.stride = 0;
+	clip.bWritten = false;
+	m_clips.push_back(clip);
+	return (int)m_clips.size() - 1;
+}
+
+/***********************************************************
+ *  Repack()
+ *
+ *  This method is used for widening the frames of a clip to
+ *  make room for another batch of channels.
+ ***********************************************************/
+void AnimationSystem::Repack(CLIP& clip, int newStride)
+{
+	std::vector<uint16_t> samples((size_t)clip.frameCount * newStride, 0);
+	for (int frame = 0; frame < clip.frameCount; frame++)
+	{
+		std::copy(
+			clip.samples.begin() + (size_t)frame * clip.stride,
+			clip.samples.begin() + (size_t)(frame + 1) * clip.stride,
+			samples.begin() + (size_t)frame * newStride);
+	}
+	clip.samples.swap(samples);
+	clip.offsets.resize(newStride, 0.0f);
+	clip.scales.resize(newStride, 0.0f);
+	clip.values.resize(newStride, 0.0f);
+	clip.written.resize(newStride, 0.0f);
+	clip.stride = newStride;
+}
+
+/***********************************************************
+ *  AddChannel()
+ *
+ *  This method is used for resampling a channel's keys at
+ *  its clip's rate and quantizing them into the clip, to 16
+ *  bits across the range the channel covers.
+ ***********************************************************/
+int AnimationSystem::AddChannel(int clip, const std::vector<ANIMATION_KEY>& keys, float* target, uint8_t* pDirty)
+{
+	if ((clip < 0) || (clip >= (int)m_clips.size()) || keys.empty() || (NULL == target))
+	{
+		return -1;
+	}
+	CLIP& c = m_clips[clip];
+
+	std::vector<ANIMATION_KEY> sorted = keys;
+	std::stable_sort(sorted.begin(), sorted.end(),
+		[](const ANIMATION_KEY& a, const ANIMATION_KEY& b) { return a.time < b.time; });
+
+	std::vector<float> resampled(c.frameCount);
+	for (int frame = 0; frame < c.frameCount; frame++)
+	{
+		resampled[frame] = EvaluateKeys(sorted, (float)frame / c.sampleRate);
+	}
+	float minimum = *std::min_element(resampled.begin(), resampled.end());
+	float maximum = *std::max_element(resampled.begin(), resampled.end());
+	float scale = (maximum - minimum) / SAMPLE_LEVELS;
+
+	int channel = c.channelCount;
+	if (channel >= c.stride)
+	{
+		Repack(c, c.stride + CHANNEL_BATCH);
+	}
+	for (int frame = 0; frame < c.frameCount; frame++)
+	{
+		float level = (scale > 0.0f) ? (resampled[frame] - minimum) / scale : 0.0f;
+		c.samples[(size_t)frame * c.stride + channel] = (uint16_t)std::lround(std::min(std::max(level, 0.0f), SAMPLE_LEVELS));
+	}
+	c.offsets[channel] = minimum;
+	c.scales[channel] = scale;
+	c.targets.push_back(target);
+	c.dirtyFlags.push_back(pDirty);
+	c.channelCount++;
+	c.bWritten = false;
+	return channel;
+}
+
+/***********************************************************
+ *  Play()
+ *
+ *  This method is used for starting a clip, with its first
+ *  frame at startTime.
+ ***********************************************************/
+void AnimationSystem::Play(int clip, double startTime, float speed)
+{
+	if ((clip >= 0) && (clip < (int)m_clips.size()))
+	{
+		m_clips[clip].bPlaying = true;
+		m_clips[clip].startTime = startTime;
+		m_clips[clip].speed = speed;
+	}
+}
+
+void AnimationSystem::Stop(int clip)
+{
+	if ((clip >= 0) && (clip < (int)m_clips.size()))
+	{
+		m_clips[clip].bPlaying = false;
+	}
+}
+
+/***********************************************************
+ *  SampleFrame()
+ *
+ *  This method is used for sampling every channel of a clip
+ *  between a frame and the next, a batch of channels at a
+ *  time, into its values.
+ ***********************************************************/
+void AnimationSystem::SampleFrame(CLIP& clip, int frame, float blend)
+{
+	const uint16_t* a = &clip.samples[(size_t)frame * clip.stride];
+	const uint16_t* b = (frame + 1 < clip.frameCount) ? a + clip.stride : a;
+
+#if defined(ANIM_USE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 t = _mm_set1_ps(blend);
+	for (int c = 0; c < clip.stride; c += CHANNEL_BATCH)
+	{
+		__m128i qa = _mm_loadu_si128((const __m128i*)(a + c));
+		__m128i qb = _mm_loadu_si128((const __m128i*)(b + c));
+		__m128 a0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(qa, zero));
+		__m128 a1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(qa, zero));
+		__m128 b0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(qb, zero));
+		__m128 b1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(qb, zero));
+		__m128 level0 = _mm_add_ps(a0, _mm_mul_ps(_mm_sub_ps(b0, a0), t));
+		__m128 level1 = _mm_add_ps(a1, _mm_mul_ps(_mm_sub_ps(b1, a1), t));
+		_mm_storeu_ps(&clip.values[c], _mm_add_ps(_mm_loadu_ps(&clip.offsets[c]),
+			_mm_mul_ps(_mm_loadu_ps(&clip.scales[c]), level0)));
+		_mm_storeu_ps(&clip.values[c + 4], _mm_add_ps(_mm_loadu_ps(&clip.offsets[c + 4]),
+			_mm_mul_ps(_mm_loadu_ps(&clip.scales[c + 4]), level1)));
+	}
+#else
+	for (int c = 0; c < clip.stride; c++)
+	{
+		float level = (float)a[c] + ((float)b[c] - (float)a[c]) * blend;
+		clip.values[c] = clip.offsets[c] + clip.scales[c] * level;
+	}
+#endif
+}
+
+/***********************************************************
+ *  WriteChanged()
+ *
+ *  This method is used for writing the channels whose value
+ *  differs from the one last written, four compared at a
+ *  time, and raising their dirty flags.
+ ***********************************************************/
+int AnimationSystem::WriteChanged(CLIP& clip)
+{
+	int writes = 0;
+	for (int c = 0; c < clip.channelCount; c += 4)
+	{
+		int changed = 0xF;
+		if (clip.bWritten)
+		{
+#if defined(ANIM_USE_SSE2)
+			changed = _mm_movemask_ps(_mm_cmpneq_ps(_mm_loadu_ps(&clip.values[c]), _mm_loadu_ps(&clip.written[c])));
+#else
+			changed = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				changed |= (clip.values[c + i] != clip.written[c + i]) ? (1 << i) : 0;
+			}
+#endif
+		}
+		for (int i = 0; (changed != 0) && (i < 4) && (c + i < clip.channelCount); i++, changed >>= 1)
+		{
+			if (changed & 1)
+			{
+				clip.written[c + i] = clip.values[c + i];
+				*clip.targets[c + i] = clip.values[c + i];
+				if (NULL != clip.dirtyFlags[c + i])
+				{
+					*clip.dirtyFlags[c + i] = 1;
+				}
+				writes++;
+			}
+		}
+	}
+	clip.bWritten = true;
+	return writes;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for advancing every playing clip to
+ *  the time and writing its changed channels.
+ ***********************************************************/
+int AnimationSystem::Update(double time)
+{
+	int writes = 0;
+	for (CLIP& clip : m_clips)
+	{
+		if (!clip.bPlaying || (0 == clip.channelCount))
+		{
+			continue;
+		}
+
+		double t = (time - clip.startTime) * clip.speed;
+		if (clip.bLoop)
+		{
+			t = std::fmod(t, (double)clip.duration);
+			if (t < 0.0)
+			{
+				t += clip.duration;
+			}
+		}
+		else
+		{
+			t = std::min(std::max(t, 0.0), (double)clip.duration);
+		}
+
+		double position = t * clip.sampleRate;
+		int frame = std::min((int)position, std::max(clip.frameCount - 2, 0));
+		float blend = (float)std::min(std::max(position - frame, 0.0), 1.0);
+		SampleFrame(clip, frame, blend);
+		writes += WriteChanged(clip);
+	}
+	return writes;
+}
+
+int AnimationSystem::GetChannelCount() const
+{
+	int count = 0;
+	for (const CLIP& clip : m_clips)
+	{
+		count += clip.channelCount;
+	}
+	return count;
+}
+
+size_t AnimationSystem::GetSampleBytes() const
+{
+	size_t bytes = 0;
+	for (const CLIP& clip : m_clips)
+	{
+		bytes += clip.samples.size() * sizeof(uint16_t);
+	}
+	return bytes;
+}
@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+// animationsystem.h
+// ============
+// keyframed float channels, sampled a batch of channels at a time
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  ANIMATION_KEY
+ *
+ *  A value a channel passes through at a time, in seconds
+ *  from the start of its clip.
+ ***********************************************************/
+struct ANIMATION_KEY
+{
+	float time;
+	float value;
+};
+
+/***********************************************************
+ *  AnimationSystem
+ *
+ *  This class plays keyframed animation on plain floats - a
+ *  light's intensity, a coordinate of a transform, a channel
+ *  of a material colour. The keys of each channel are
+ *  resampled at its clip's rate and stored as 16 bit values
+ *  within the channel's range, two bytes a sample, frame by
+ *  frame across the clip's channels. A frame is sampled for
+ *  eight channels at once: both neighbouring samples, widened
+ *  to floats, blended and scaled into range with SSE2. Only
+ *  the channels whose value changed are written to their
+ *  targets, each setting the dirty flag it was bound with,
+ *  so the owner of the data re-uploads or invalidates only
+ *  what moved.
+ ***********************************************************/
+class AnimationSystem
+{
+public:
+	// constructor
+	AnimationSystem();
+
+	// add a clip of the given length, sampled at the rate; looping clips
+	// repeat from the start, others hold their last frame. The index
+	int AddClip(float duration, float sampleRate, bool bLoop);
+	// add a channel to a clip, driving target and setting *pDirty to 1
+	// whenever it changes; pDirty may be NULL. The targets must stay put
+	// for as long as the clip plays. The index within the clip, or -1
+	int AddChannel(int clip, const std::vector<ANIMATION_KEY>& keys, float* target, uint8_t* pDirty);
+	// start a clip playing from the given time
+	void Play(int clip, double startTime, float speed = 1.0f);
+	void Stop(int clip);
+
+	// sample every playing clip at the time and write what changed;
+	// the number of targets written
+	int Update(double time);
+
+	int GetChannelCount() const;
+	// storage for every clip's samples, in bytes
+	size_t GetSampleBytes() const;
+
+private:
+	struct CLIP
+	{
+		float duration;
+		float sampleRate;
+		bool bLoop;
+		bool bPlaying;
+		double startTime;
+		float speed;
+		// frames of the resampled channels, each stride values long
+		int frameCount;
+		int channelCount;
+		int stride;
+		std::vector<uint16_t> samples;
+		// per channel, padded to the stride: value = offset + scale * sample
+		std::vector<float> offsets;
+		std::vector<float> scales;
+		// the values sampled this update and those last written
+		std::vector<float> values;
+		std::vector<float> written;
+		std::vector<float*> targets;
+		std::vector<uint8_t*> dirtyFlags;
+		// set until the first write, so every target gets a value
+		bool bWritten;
+	};
+
+	std::vector<CLIP> m_clips;
+
+	static void Repack(CLIP& clip, int newStride);
+	static void SampleFrame(CLIP& clip, int frame, float blend);
+	static int WriteChanged(CLIP& clip);
+};
@@ -0,0 +1,578 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetio.cpp
+// ============
+// batched asset file reads - io_uring on Linux, a pool of reads elsewhere
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AssetIO.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// reads in flight at once, and registered buffers to read them into
+	const unsigned int READ_QUEUE_DEPTH = 32;
+	// the largest piece of a file read by one request
+	const size_t READ_BLOCK_SIZE = 256 * 1024;
+}
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+
+/***********************************************************
+ *  RING
+ *
+ *  The submission and completion queues shared with the
+ *  kernel, the registered read buffers, and the pieces of
+ *  files that are currently being read into them.
+ ***********************************************************/
+struct AssetIO::RING
+{
+	// one read in flight, identified by its slot in the ring
+	struct PIECE
+	{
+		READ_REQUEST* pRequest;
+		size_t offset;
+		size_t length;
+	};
+
+	int fd = -1;
+	void* pSqMemory = MAP_FAILED;
+	size_t sqMemorySize = 0;
+	void* pCqMemory = MAP_FAILED;
+	size_t cqMemorySize = 0;
+	io_uring_sqe* pSqes = (io_uring_sqe*)MAP_FAILED;
+	size_t sqesSize = 0;
+
+	unsigned* pSqTail = NULL;
+	unsigned* pSqMask = NULL;
+	unsigned* pSqArray = NULL;
+	unsigned* pCqHead = NULL;
+	unsigned* pCqTail = NULL;
+	unsigned* pCqMask = NULL;
+	io_uring_cqe* pCqes = NULL;
+
+	// READ_QUEUE_DEPTH blocks of READ_BLOCK_SIZE, registered with the kernel
+	std::vector<unsigned char> blocks;
+	bool bRegistered = false;
+
+	PIECE pieces[READ_QUEUE_DEPTH];
+	std::vector<unsigned int> freeSlots;
+
+	unsigned char* Block(unsigned int slot) { return blocks.data() + slot * READ_BLOCK_SIZE; }
+
+	// queue a read of pieces[slot]; the submission queue holds
+	// READ_QUEUE_DEPTH entries, so there is always room for every slot
+	void PushRead(unsigned int slot)
+	{
+		const PIECE& piece = pieces[slot];
+		unsigned tail = *pSqTail;
+		unsigned index = tail & *pSqMask;
+		io_uring_sqe* pSqe = &pSqes[index];
+		std::memset(pSqe, 0, sizeof(io_uring_sqe));
+		pSqe->fd = piece.pRequest->fd;
+		pSqe->off = piece.offset;
+		pSqe->len = (unsigned)piece.length;
+		pSqe->user_data = slot;
+		if (bRegistered)
+		{
+			pSqe->opcode = IORING_OP_READ_FIXED;
+			pSqe->addr = (unsigned long long)(uintptr_t)Block(slot);
+			pSqe->buf_index = (unsigned short)slot;
+		}
+		else
+		{
+			// without registered buffers, read straight into the file
+			pSqe->opcode = IORING_OP_READ;
+			pSqe->addr = (unsigned long long)(uintptr_t)(piece.pRequest->bytes.data() + piece.offset);
+		}
+		pSqArray[index] = index;
+		__atomic_store_n(pSqTail, tail + 1, __ATOMIC_RELEASE);
+	}
+
+	// submit the queued reads and wait for at least minComplete to finish
+	bool Enter(unsigned toSubmit, unsigned minComplete)
+	{
+		for (;;)
+		{
+			long result = syscall(__NR_io_uring_enter, fd, toSubmit, minComplete,
+				(minComplete > 0) ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+			if (result >= 0)
+			{
+				return true;
+			}
+			if (errno != EINTR)
+			{
+				return false;
+			}
+			// an interrupted call may have submitted some entries already
+			toSubmit = 0;
+		}
+	}
+};
+
+/***********************************************************
+ *  CreateRing()
+ *
+ *  This method is used for setting up the io_uring, mapping
+ *  its queues and registering the read buffers. A kernel that
+ *  refuses the buffers still gets plain batched reads.
+ ***********************************************************/
+bool AssetIO::CreateRing()
+{
+	io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+	int fd = (int)syscall(__NR_io_uring_setup, READ_QUEUE_DEPTH, &params);
+	if (fd < 0)
+	{
+		std::cout << "[AssetIO] io_uring unavailable (" << std::strerror(errno) << "), reading on the worker threads" << std::endl;
+		return false;
+	}
+
+	RING* pRing = new RING();
+	pRing->fd = fd;
+	pRing->sqMemorySize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	pRing->cqMemorySize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		pRing->sqMemorySize = std::max(pRing->sqMemorySize, pRing->cqMemorySize);
+		pRing->cqMemorySize = pRing->sqMemorySize;
+	}
+	pRing->pSqMemory = mmap(NULL, pRing->sqMemorySize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		pRing->pCqMemory = pRing->pSqMemory;
+	}
+	else
+	{
+		pRing->pCqMemory = mmap(NULL, pRing->cqMemorySize, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	}
+	pRing->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	pRing->pSqes = (io_uring_sqe*)mmap(NULL, pRing->sqesSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	m_pRing = pRing;
+
+	if ((pRing->pSqMemory == MAP_FAILED) || (pRing->pCqMemory == MAP_FAILED) || (pRing->pSqes == MAP_FAILED))
+	{
+		std::cout << "[AssetIO] Could not map the io_uring queues, reading on the worker threads" << std::endl;
+		DestroyRing();
+		return false;
+	}
+
+	unsigned char* pSq = (unsigned char*)pRing->pSqMemory;
+	unsigned char* pCq = (unsigned char*)pRing->pCqMemory;
+	pRing->pSqTail = (unsigned*)(pSq + params.sq_off.tail);
+	pRing->pSqMask = (unsigned*)(pSq + params.sq_off.ring_mask);
+	pRing->pSqArray = (unsigned*)(pSq + params.sq_off.array);
+	pRing->pCqHead = (unsigned*)(pCq + params.cq_off.head);
+	pRing->pCqTail = (unsigned*)(pCq + params.cq_off.tail);
+	pRing->pCqMask = (unsigned*)(pCq + params.cq_off.ring_mask);
+	pRing->pCqes = (io_uring_cqe*)(pCq + params.cq_off.cqes);
+
+	// registered buffers are pinned once, instead of on every read
+	pRing->blocks.resize(READ_QUEUE_DEPTH * READ_BLOCK_SIZE);
+	struct iovec iovecs[READ_QUEUE_DEPTH];
+	for (unsigned int i = 0; i < READ_QUEUE_DEPTH; i++)
+	{
+		iovecs[i].iov_base = pRing->Block(i);
+		iovecs[i].iov_len = READ_BLOCK_SIZE;
+	}
+	pRing->bRegistered = (syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iovecs, READ_QUEUE_DEPTH) == 0);
+	if (!pRing->bRegistered)
+	{
+		std::cout << "[AssetIO] Could not register read buffers (" << std::strerror(errno) << "), reading without them" << std::endl;
+		pRing->blocks.clear();
+		pRing->blocks.shrink_to_fit();
+	}
+
+	for (unsigned int slot = READ_QUEUE_DEPTH; slot > 0; slot--)
+	{
+		pRing->freeSlots.push_back(slot - 1);
+	}
+
+	std::cout << "[AssetIO] Reading through io_uring, " << READ_QUEUE_DEPTH << " reads of up to "
+		<< (READ_BLOCK_SIZE / 1024) << " KB in flight" << std::endl;
+	return true;
+}
+
+/***********************************************************
+ *  DestroyRing()
+ *
+ *  This method is used for unmapping and closing the ring.
+ ***********************************************************/
+void AssetIO::DestroyRing()
+{
+	if (NULL == m_pRing)
+	{
+		return;
+	}
+	if (m_pRing->pSqes != MAP_FAILED)
+	{
+		munmap(m_pRing->pSqes, m_pRing->sqesSize);
+	}
+	if ((m_pRing->pCqMemory != MAP_FAILED) && (m_pRing->pCqMemory != m_pRing->pSqMemory))
+	{
+		munmap(m_pRing->pCqMemory, m_pRing->cqMemorySize);
+	}
+	if (m_pRing->pSqMemory != MAP_FAILED)
+	{
+		munmap(m_pRing->pSqMemory, m_pRing->sqMemorySize);
+	}
+	close(m_pRing->fd);
+	delete m_pRing;
+	m_pRing = NULL;
+}
+
+/***********************************************************
+ *  RingLoop()
+ *
+ *  This method is used for running the ring. Each pass opens
+ *  the newly queued files, hands every free slot the next
+ *  block of a file still being read, submits the whole batch
+ *  with one system call, and collects what has completed.
+ ***********************************************************/
+void AssetIO::RingLoop()
+{
+	RING* pRing = m_pRing;
+	std::deque<READ_REQUEST*> active;
+	unsigned int inFlight = 0;
+	unsigned int toSubmit = 0;
+
+	for (;;)
+	{
+		std::deque<READ_REQUEST*> arrived;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (active.empty())
+			{
+				m_requestReady.wait(lock, [this]() { return m_bStopping || !m_queue.empty(); });
+			}
+			if (active.empty() && m_queue.empty())
+			{
+				break;
+			}
+			arrived.swap(m_queue);
+		}
+
+		for (READ_REQUEST* pRequest : arrived)
+		{
+			struct stat info;
+			pRequest->fd = open(pRequest->filename.c_str(), O_RDONLY | O_CLOEXEC);
+			if ((pRequest->fd < 0) || (fstat(pRequest->fd, &info) != 0) || (info.st_size <= 0))
+			{
+				pRequest->bFailed = true;
+				FinishRequest(pRequest);
+				continue;
+			}
+			pRequest->size = (size_t)info.st_size;
+			pRequest->bytes.resize(pRequest->size);
+			active.push_back(pRequest);
+		}
+
+		// give each free slot the next block, going round the files so
+		// small ones are not stuck behind large ones
+		bool bProgress = true;
+		while (!pRing->freeSlots.empty() && bProgress)
+		{
+			bProgress = false;
+			for (READ_REQUEST* pRequest : active)
+			{
+				if (pRing->freeSlots.empty())
+				{
+					break;
+				}
+				if (pRequest->bFailed || (pRequest->nextOffset >= pRequest->size))
+				{
+					continue;
+				}
+				unsigned int slot = pRing->freeSlots.back();
+				pRing->freeSlots.pop_back();
+
+				RING::PIECE& piece = pRing->pieces[slot];
+				piece.pRequest = pRequest;
+				piece.offset = pRequest->nextOffset;
+				piece.length = std::min(READ_BLOCK_SIZE, pRequest->size - pRequest->nextOffset);
+				pRequest->nextOffset += piece.length;
+				pRequest->inFlight++;
+
+				pRing->PushRead(slot);
+				toSubmit++;
+				inFlight++;
+				bProgress = true;
+			}
+		}
+
+		if (inFlight == 0)
+		{
+			continue;
+		}
+		if (!pRing->Enter(toSubmit, 1))
+		{
+			std::cout << "[AssetIO] io_uring_enter failed: " << std::strerror(errno) << std::endl;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		toSubmit = 0;
+
+		unsigned head = *pRing->pCqHead;
+		unsigned tail = __atomic_load_n(pRing->pCqTail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++)
+		{
+			const io_uring_cqe& cqe = pRing->pCqes[head & *pRing->pCqMask];
+			unsigned int slot = (unsigned int)cqe.user_data;
+			RING::PIECE& piece = pRing->pieces[slot];
+			READ_REQUEST* pRequest = piece.pRequest;
+
+			if ((cqe.res > 0) && !pRequest->bFailed)
+			{
+				size_t count = (size_t)cqe.res;
+				if (pRing->bRegistered)
+				{
+					std::memcpy(pRequest->bytes.data() + piece.offset, pRing->Block(slot), count);
+				}
+				pRequest->bytesRead += count;
+
+				// a short read keeps its slot and asks for the rest
+				// with the next batch
+				if (count < piece.length)
+				{
+					piece.offset += count;
+					piece.length -= count;
+					pRing->PushRead(slot);
+					toSubmit++;
+					continue;
+				}
+			}
+			else if ((cqe.res == -EAGAIN) || (cqe.res == -EINTR))
+			{
+				pRing->PushRead(slot);
+				toSubmit++;
+				continue;
+			}
+			else
+			{
+				// an error, or the end of a file that shrank since fstat()
+				pRequest->bFailed = true;
+			}
+
+			pRing->freeSlots.push_back(slot);
+			inFlight--;
+			pRequest->inFlight--;
+		}
+		__atomic_store_n(pRing->pCqHead, head, __ATOMIC_RELEASE);
+
+		// hand over the files that have finished
+		for (auto it = active.begin(); it != active.end();)
+		{
+			READ_REQUEST* pRequest = *it;
+			bool bDone = (pRequest->inFlight == 0) &&
+				(pRequest->bFailed || (pRequest->nextOffset >= pRequest->size));
+			if (bDone)
+			{
+				pRequest->bFailed = pRequest->bFailed || (pRequest->bytesRead != pRequest->size);
+				FinishRequest(pRequest);
+				it = active.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+}
+
+#else
+
+// io_uring is Linux only; everywhere else the pool does the reads
+struct AssetIO::RING
+{
+};
+
+bool AssetIO::CreateRing()
+{
+	return false;
+}
+
+void AssetIO::DestroyRing()
+{
+}
+
+void AssetIO::RingLoop()
+{
+}
+
+#endif
+
+/***********************************************************
+ *  AssetIO()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+AssetIO::AssetIO(ThreadPool* pFallbackPool)
+{
+	m_pFallbackPool = pFallbackPool;
+	m_pRing = NULL;
+	m_bStopping = false;
+	m_pending = 0;
+
+	if (CreateRing())
+	{
+		m_ringThread = std::thread(&AssetIO::RingLoop, this);
+	}
+}
+
+/***********************************************************
+ *  ~AssetIO()
+ *
+ *  The destructor for the class. The ring thread empties its
+ *  queue before it stops; reads on the pool are waited for.
+ ***********************************************************/
+AssetIO::~AssetIO()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_requestReady.notify_all();
+	if (m_ringThread.joinable())
+	{
+		m_ringThread.join();
+	}
+	DestroyRing();
+
+	while (m_pending.load() > 0)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+/***********************************************************
+ *  Read()
+ *
+ *  This method is used for queueing a file to be read.
+ ***********************************************************/
+void AssetIO::Read(std::string filename, READ_CALLBACK onComplete)
+{
+	m_pending++;
+
+	if (NULL == m_pRing)
+	{
+		m_pFallbackPool->Submit([this, filename, onComplete]()
+		{
+			onComplete(ReadWholeFile(filename));
+			m_pending--;
+		});
+		return;
+	}
+
+	READ_REQUEST* pRequest = new READ_REQUEST();
+	pRequest->filename = filename;
+	pRequest->onComplete = std::move(onComplete);
+	pRequest->fd = -1;
+	pRequest->size = 0;
+	pRequest->nextOffset = 0;
+	pRequest->bytesRead = 0;
+	pRequest->inFlight = 0;
+	pRequest->bFailed = false;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.push_back(pRequest);
+	}
+	m_requestReady.notify_one();
+}
+
+/***********************************************************
+ *  FinishRequest()
+ *
+ *  This method is used for closing a ring read and passing
+ *  its bytes, or nothing if it failed, to the callback.
+ ***********************************************************/
+void AssetIO::FinishRequest(READ_REQUEST* pRequest)
+{
+#if defined(__unix__) || defined(__APPLE__)
+	if (pRequest->fd >= 0)
+	{
+		close(pRequest->fd);
+	}
+#endif
+	if (pRequest->bFailed)
+	{
+		pRequest->bytes.clear();
+	}
+	pRequest->onComplete(std::move(pRequest->bytes));
+	delete pRequest;
+	m_pending--;
+}
+
+/***********************************************************
+ *  ReadWholeFile()
+ *
+ *  This method is used for reading a file without the ring,
+ *  with pread() where it is available.
+ ***********************************************************/
+std::vector<unsigned char> AssetIO::ReadWholeFile(const std::string& filename)
+{
+	std::vector<unsigned char> bytes;
+
+#if defined(__unix__) || defined(__APPLE__)
+	int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return bytes;
+	}
+	struct stat info;
+	if ((fstat(fd, &info) == 0) && (info.st_size > 0))
+	{
+		bytes.resize((size_t)info.st_size);
+		size_t offset = 0;
+		while (offset < bytes.size())
+		{
+			ssize_t count = pread(fd, bytes.data() + offset, bytes.size() - offset, (off_t)offset);
+			if ((count < 0) && (errno == EINTR))
+			{
+				continue;
+			}
+			if (count <= 0)
+			{
+				bytes.clear();
+				break;
+			}
+			offset += (size_t)count;
+		}
+	}
+	close(fd);
+#else
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (file.is_open())
+	{
+		std::streamsize size = file.tellg();
+		file.seekg(0, std::ios::beg);
+		bytes.resize((size_t)std::max<std::streamsize>(size, 0));
+		if (!file.read((char*)bytes.data(), size))
+		{
+			bytes.clear();
+		}
+	}
+#endif
+
+	return bytes;
+}
@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetio.h
+// ============
+// batched asset file reads - io_uring on Linux, a pool of reads elsewhere
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  AssetIO
+ *
+ *  This class reads whole files for the asset loader. On
+ *  Linux one thread owns an io_uring: it opens the queued
+ *  files, splits them into block sized reads into a set of
+ *  registered buffers, and submits everything that fits in
+ *  one system call, so many files are in flight at once and
+ *  the drive queue stays full. Each file's callback runs as
+ *  soon as its last block lands. Where io_uring is missing
+ *  or refused, every file is read with pread() (or a stream
+ *  on other systems) as a task on the fallback pool.
+ ***********************************************************/
+class AssetIO
+{
+public:
+	// called with the file contents, empty when it could not be read
+	typedef std::function<void(std::vector<unsigned char>)> READ_CALLBACK;
+
+	// constructor - pFallbackPool runs the reads when there is no ring
+	explicit AssetIO(ThreadPool* pFallbackPool);
+	// destructor - finishes every read still in flight
+	~AssetIO();
+
+	// true when reads go through io_uring
+	bool IsUsingRing() const { return NULL != m_pRing; }
+	// reads queued or in flight
+	int GetPendingCount() const { return m_pending.load(); }
+
+	// queue a whole file read; onComplete runs on the I/O thread or a
+	// pool worker, so it should hand real work off rather than do it
+	void Read(std::string filename, READ_CALLBACK onComplete);
+
+	// read a whole file with blocking calls on the calling thread
+	static std::vector<unsigned char> ReadWholeFile(const std::string& filename);
+
+private:
+	// the io_uring state, only defined where it is supported
+	struct RING;
+	// a file being read through the ring
+	struct READ_REQUEST
+	{
+		std::string filename;
+		READ_CALLBACK onComplete;
+		int fd;
+		size_t size;
+		size_t nextOffset;
+		size_t bytesRead;
+		int inFlight;
+		bool bFailed;
+		std::vector<unsigned char> bytes;
+	};
+
+	ThreadPool* m_pFallbackPool;
+	RING* m_pRing;
+	std::thread m_ringThread;
+	std::mutex m_mutex;
+	std::condition_variable m_requestReady;
+	std::deque<READ_REQUEST*> m_queue;
+	bool m_bStopping;
+	std::atomic<int> m_pending;
+
+	bool CreateRing();
+	void DestroyRing();
+	void RingLoop();
+	void FinishRequest(READ_REQUEST* pRequest);
+};
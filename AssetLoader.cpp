@@ -0,0 +1,542 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetloader.cpp
+// ============
+// coroutine based asset loading - file reads and decodes on worker
+// threads, OpenGL uploads resumed on the GL thread
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AssetLoader.h"
+#include "JpegDecoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+/***********************************************************
+ *  AssetLoader()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+AssetLoader::AssetLoader(int workerThreads)
+{
+	// the pool counts the calling thread, which never runs loads
+	m_pWorkers = new ThreadPool(std::max(workerThreads, 1) + 1);
+	m_pIO = new AssetIO(m_pWorkers);
+	m_pUploadThread = NULL;
+	m_pendingUploads = 0;
+	m_bCompressTextures = TextureCompressor::IsSupported();
+	m_compressQuality = COMPRESS_FAST;
+
+	// most of the textures are JPEGs, which the SIMD decoder can also
+	// decode at reduced size; stb_image handles everything else
+	m_decoders.push_back(new JpegDecoder());
+	m_decoders.push_back(new StbImageDecoder());
+}
+
+/***********************************************************
+ *  ~AssetLoader()
+ *
+ *  The destructor for the class. Loads still in flight are
+ *  run to the end, so no coroutine is left suspended.
+ ***********************************************************/
+AssetLoader::~AssetLoader()
+{
+	for (;;)
+	{
+		m_pWorkers->WaitIdle();
+		if ((PumpGLThread(1.0) == 0) && !HasPendingWork())
+		{
+			break;
+		}
+		WaitForGLWork();
+	}
+
+	delete m_pUploadThread;
+	m_pUploadThread = NULL;
+	delete m_pIO;
+	m_pIO = NULL;
+	delete m_pWorkers;
+	m_pWorkers = NULL;
+
+	for (ImageDecoder* pDecoder : m_decoders)
+	{
+		delete pDecoder;
+	}
+	m_decoders.clear();
+}
+
+/***********************************************************
+ *  AddDecoder()
+ *
+ *  This method is used for adding an image decoder ahead of
+ *  the existing ones.
+ ***********************************************************/
+void AssetLoader::AddDecoder(ImageDecoder* pDecoder)
+{
+	if (NULL != pDecoder)
+	{
+		m_decoders.insert(m_decoders.begin(), pDecoder);
+	}
+}
+
+/***********************************************************
+ *  StartUploadThread()
+ *
+ *  This method is used for starting the upload thread. When
+ *  it cannot start, uploads keep running on the GL thread.
+ ***********************************************************/
+bool AssetLoader::StartUploadThread(GLFWwindow* pSharedWith)
+{
+	if (NULL != m_pUploadThread)
+	{
+		return true;
+	}
+
+	GLUploadThread* pUploadThread = new GLUploadThread();
+	if (pUploadThread->Start(pSharedWith) == false)
+	{
+		delete pUploadThread;
+		return false;
+	}
+	m_pUploadThread = pUploadThread;
+	return true;
+}
+
+/***********************************************************
+ *  SetTextureCompression()
+ *
+ *  This method is used for choosing whether loaded textures
+ *  are block compressed, and how carefully.
+ ***********************************************************/
+void AssetLoader::SetTextureCompression(bool bEnable, COMPRESS_QUALITY quality)
+{
+	m_bCompressTextures = bEnable && TextureCompressor::IsSupported();
+	m_compressQuality = quality;
+}
+
+/***********************************************************
+ *  HasPendingWork()
+ *
+ *  This method is used for checking whether any coroutine is
+ *  still waiting on a read, an upload or for the GL thread.
+ ***********************************************************/
+bool AssetLoader::HasPendingWork()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return (m_pIO->GetPendingCount() > 0) || (m_pendingUploads.load() > 0) ||
+		!m_glQueue.empty() || !m_fenceQueue.empty();
+}
+
+/***********************************************************
+ *  WORKER_AWAITER::await_suspend()
+ *
+ *  Hand the suspended coroutine to the worker threads.
+ ***********************************************************/
+void AssetLoader::WORKER_AWAITER::await_suspend(std::coroutine_handle<> handle)
+{
+	pLoader->m_pWorkers->Submit([handle]() { handle.resume(); });
+}
+
+/***********************************************************
+ *  READ_AWAITER::await_suspend()
+ *
+ *  Queue the read; when it completes the bytes are stored in
+ *  the awaiter and the coroutine is handed to the workers to
+ *  decode, leaving the I/O thread free for the next reads.
+ ***********************************************************/
+void AssetLoader::READ_AWAITER::await_suspend(std::coroutine_handle<> handle)
+{
+	// the coroutine, and this awaiter with it, may be resumed and
+	// freed on another thread before Read() returns
+	AssetLoader* pQueueOwner = pLoader;
+	READ_AWAITER* pAwaiter = this;
+	pQueueOwner->m_pIO->Read(filename, [pQueueOwner, pAwaiter, handle](std::vector<unsigned char> bytes)
+	{
+		pAwaiter->bytes = std::move(bytes);
+		pQueueOwner->m_pWorkers->Submit([handle]() { handle.resume(); });
+	});
+}
+
+/***********************************************************
+ *  GL_THREAD_AWAITER::await_suspend()
+ *
+ *  Queue the suspended coroutine for the next pump on the
+ *  GL thread.
+ ***********************************************************/
+void AssetLoader::GL_THREAD_AWAITER::await_suspend(std::coroutine_handle<> handle)
+{
+	// this awaiter lives in the coroutine frame, which the GL thread
+	// may resume and free as soon as the handle is queued
+	AssetLoader* pQueueOwner = pLoader;
+	{
+		std::lock_guard<std::mutex> lock(pQueueOwner->m_mutex);
+		pQueueOwner->m_glQueue.push_back(handle);
+	}
+	pQueueOwner->m_glWorkReady.notify_one();
+}
+
+/***********************************************************
+ *  UPLOAD_AWAITER::await_suspend()
+ *
+ *  Hand the suspended coroutine to the upload thread, or to
+ *  the GL thread when there is no upload thread.
+ ***********************************************************/
+void AssetLoader::UPLOAD_AWAITER::await_suspend(std::coroutine_handle<> handle)
+{
+	AssetLoader* pQueueOwner = pLoader;
+	if (NULL == pQueueOwner->m_pUploadThread)
+	{
+		GL_THREAD_AWAITER{ pQueueOwner }.await_suspend(handle);
+		return;
+	}
+
+	pQueueOwner->m_pendingUploads++;
+	pQueueOwner->m_pUploadThread->Submit([pQueueOwner, handle]()
+	{
+		handle.resume();
+		pQueueOwner->m_pendingUploads--;
+	});
+}
+
+/***********************************************************
+ *  FENCE_AWAITER::await_suspend()
+ *
+ *  Fence the GL commands issued so far and queue the
+ *  suspended coroutine to resume on the GL thread once the
+ *  fence is signalled. Without an upload thread everything
+ *  ran on the GL context already, so no fence is needed.
+ ***********************************************************/
+void AssetLoader::FENCE_AWAITER::await_suspend(std::coroutine_handle<> handle)
+{
+	AssetLoader* pQueueOwner = pLoader;
+
+	FENCED_RESUME pending;
+	pending.fence = (NULL != pQueueOwner->m_pUploadThread) ? GLUploadThread::InsertFence() : NULL;
+	pending.handle = handle;
+	{
+		std::lock_guard<std::mutex> lock(pQueueOwner->m_mutex);
+		pQueueOwner->m_fenceQueue.push_back(pending);
+	}
+	pQueueOwner->m_glWorkReady.notify_one();
+}
+
+/***********************************************************
+ *  PumpGLThread()
+ *
+ *  This method is used for resuming the coroutines that are
+ *  waiting to make OpenGL calls. Fences are only polled, never
+ *  waited on; coroutines whose fences have signalled join the
+ *  queue. Work is taken one coroutine at a time until the
+ *  queue is empty or the time budget is spent, so uploads can
+ *  be spread across frames.
+ ***********************************************************/
+int AssetLoader::PumpGLThread(double budgetSeconds)
+{
+	auto start = std::chrono::steady_clock::now();
+	int resumed = 0;
+
+	std::vector<FENCED_RESUME> fenced;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		fenced.swap(m_fenceQueue);
+	}
+	std::vector<FENCED_RESUME> stillPending;
+	for (const FENCED_RESUME& pending : fenced)
+	{
+		if (NULL != pending.fence)
+		{
+			GLenum status = glClientWaitSync(pending.fence, 0, 0);
+			if ((status != GL_ALREADY_SIGNALED) && (status != GL_CONDITION_SATISFIED))
+			{
+				stillPending.push_back(pending);
+				continue;
+			}
+			glDeleteSync(pending.fence);
+		}
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_glQueue.push_back(pending.handle);
+	}
+	if (!stillPending.empty())
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_fenceQueue.insert(m_fenceQueue.end(), stillPending.begin(), stillPending.end());
+	}
+
+	for (;;)
+	{
+		std::coroutine_handle<> handle;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_glQueue.empty())
+			{
+				break;
+			}
+			handle = m_glQueue.front();
+			m_glQueue.pop_front();
+		}
+
+		handle.resume();
+		resumed++;
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		if (elapsed.count() >= budgetSeconds)
+		{
+			break;
+		}
+	}
+	return resumed;
+}
+
+/***********************************************************
+ *  WaitForGLWork()
+ *
+ *  This method is used for sleeping until a coroutine has
+ *  been queued for the GL thread, or briefly while fences
+ *  are outstanding.
+ ***********************************************************/
+void AssetLoader::WaitForGLWork()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_glWorkReady.wait_for(lock, std::chrono::milliseconds(1), [this]() { return !m_glQueue.empty(); });
+}
+
+/***********************************************************
+ *  ReadFile()
+ *
+ *  This method is used for reading a whole file into memory.
+ *  Every load started in the same frame is read in the same
+ *  batches, and each continues on a worker the moment its
+ *  own bytes are in.
+ ***********************************************************/
+AssetTask<std::vector<unsigned char>> AssetLoader::ReadFile(std::string filename)
+{
+	// kept in a named variable, since GCC destroys temporary awaiters
+	// with members of their own twice
+	READ_AWAITER read{ this, filename, {} };
+	std::vector<unsigned char> bytes = co_await read;
+	co_return bytes;
+}
+
+/***********************************************************
+ *  DecodeImage()
+ *
+ *  This method is used for decoding an image file. ReadFile()
+ *  finishes on a worker, so the decode continues there too.
+ ***********************************************************/
+AssetTask<IMAGE_DATA> AssetLoader::DecodeImage(std::string filename, int scale)
+{
+	std::vector<unsigned char> bytes = co_await ReadFile(filename);
+
+	IMAGE_DATA image;
+	if (bytes.empty())
+	{
+		std::cout << "[AssetLoader] Could not read file: " << filename << std::endl;
+		co_return image;
+	}
+
+	if (!DecodeImageBytes(bytes, scale, image))
+	{
+		std::cout << "[AssetLoader] Could not decode image: " << filename << std::endl;
+	}
+	co_return image;
+}
+
+/***********************************************************
+ *  DecodeImageBytes()
+ *
+ *  This method is used for decoding an image in memory. The
+ *  first decoder that recognises the file and decodes it
+ *  wins; one that fails on a file it recognised, such as a
+ *  progressive JPEG, falls through to the next.
+ ***********************************************************/
+bool AssetLoader::DecodeImageBytes(const std::vector<unsigned char>& bytes, int scale, IMAGE_DATA& image) const
+{
+	for (ImageDecoder* pDecoder : m_decoders)
+	{
+		if (pDecoder->CanDecode(bytes.data(), bytes.size()) &&
+			pDecoder->Decode(bytes.data(), bytes.size(), scale, image))
+		{
+			return true;
+		}
+	}
+	image = IMAGE_DATA();
+	return false;
+}
+
+/***********************************************************
+ *  LoadTexture()
+ *
+ *  This method is used for loading a texture: the file is
+ *  read, then loaded by LoadTextureBytes(). A scale above 1
+ *  gives a cheap reduced size texture, used as a preview.
+ ***********************************************************/
+AssetTask<GLuint> AssetLoader::LoadTexture(std::string filename, int scale)
+{
+	std::vector<unsigned char> bytes = co_await ReadFile(filename);
+	if (bytes.empty())
+	{
+		std::cout << "[AssetLoader] Could not read file: " << filename << std::endl;
+	}
+
+	GLuint textureID = co_await LoadTextureBytes(
+		std::make_shared<const std::vector<unsigned char>>(std::move(bytes)), filename, scale);
+	co_return textureID;
+}
+
+/***********************************************************
+ *  LoadTextureBytes()
+ *
+ *  This method is used for loading a texture from a file in
+ *  memory: the image is decoded on a worker, its mips are
+ *  built and compressed across the workers, every level is
+ *  uploaded on the upload thread, and the ID is handed to
+ *  the GL thread once the upload has completed on the GPU.
+ *  Each call moves to a worker of its own first, so loads
+ *  started together decode at the same time.
+ ***********************************************************/
+AssetTask<GLuint> AssetLoader::LoadTextureBytes(std::shared_ptr<const std::vector<unsigned char>> bytes,
+	std::string filename, int scale)
+{
+	co_await ResumeOnWorker();
+
+	IMAGE_DATA image;
+	if (!bytes->empty() && !DecodeImageBytes(*bytes, scale, image))
+	{
+		std::cout << "[AssetLoader] Could not decode image: " << filename << std::endl;
+	}
+	if (image.pixels)
+	{
+		// still on the worker that decoded it
+		image.mipLevels = std::make_shared<const std::vector<MIP_LEVEL>>(MipGenerator::Generate(
+			image.pixels.get(), image.width, image.height, image.channels, m_pWorkers));
+		if (m_bCompressTextures)
+		{
+			image.compressed = std::make_shared<const COMPRESSED_TEXTURE>(TextureCompressor::Compress(
+				image.pixels.get(), image.width, image.height, image.channels,
+				*image.mipLevels, m_compressQuality, m_pWorkers));
+		}
+	}
+	co_await ResumeOnUploadThread();
+
+	GLuint textureID = CreateTexture(image);
+	co_await ResumeOnGLThreadWhenComplete();
+
+	if (textureID != 0)
+	{
+		std::cout << "[AssetLoader] Loaded texture: " << filename
+			<< ", width: " << image.width
+			<< ", height: " << image.height
+			<< ", channels: " << image.channels
+			<< (image.compressed ? ((image.compressed->format == GL_COMPRESSED_RGBA_BPTC_UNORM) ? ", BC7" : ", BC1") : "")
+			<< std::endl;
+	}
+	co_return textureID;
+}
+
+/***********************************************************
+ *  CreateBuffer()
+ *
+ *  This method is used for creating a buffer object on the
+ *  upload thread. It is bound to the copy target there, so it
+ *  can later be used as any kind of buffer.
+ ***********************************************************/
+AssetTask<GLuint> AssetLoader::CreateBuffer(std::vector<unsigned char> bytes)
+{
+	co_await ResumeOnUploadThread();
+
+	GLuint bufferID = 0;
+	glGenBuffers(1, &bufferID);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+	glBufferData(GL_COPY_WRITE_BUFFER, bytes.size(), bytes.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	co_await ResumeOnGLThreadWhenComplete();
+
+	co_return bufferID;
+}
+
+/***********************************************************
+ *  CreateTexture()
+ *
+ *  This method is used for uploading a decoded image with the
+ *  same settings as SceneManager::CreateGLTexture() - repeat
+ *  wrapping, trilinear filtering and a full mip chain, built
+ *  on the CPU rather than by glGenerateMipmap(). Compressed
+ *  levels are uploaded as they are.
+ ***********************************************************/
+GLuint AssetLoader::CreateTexture(const IMAGE_DATA& image)
+{
+	GLenum internalFormat = 0;
+	GLenum format = 0;
+	if (image.channels == 3)
+	{
+		internalFormat = GL_RGB8;
+		format = GL_RGB;
+	}
+	else if (image.channels == 4)
+	{
+		internalFormat = GL_RGBA8;
+		format = GL_RGBA;
+	}
+	if ((!image.pixels) || (format == 0))
+	{
+		return 0;
+	}
+
+	GLuint textureID = 0;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (image.compressed && !image.compressed->levels.empty())
+	{
+		const COMPRESSED_TEXTURE& compressed = *image.compressed;
+		for (size_t i = 0; i < compressed.levels.size(); i++)
+		{
+			const COMPRESSED_TEXTURE::LEVEL& level = compressed.levels[i];
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, compressed.format, level.width, level.height, 0,
+				(GLsizei)level.blocks.size(), level.blocks.data());
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)compressed.levels.size() - 1);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return textureID;
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels.get());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (image.mipLevels)
+	{
+		UploadMipLevels(*image.mipLevels, internalFormat, format);
+	}
+	else
+	{
+		UploadMipLevels(MipGenerator::Generate(image.pixels.get(), image.width, image.height, image.channels, NULL),
+			internalFormat, format);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return textureID;
+}
+
+/***********************************************************
+ *  UploadMipLevels()
+ *
+ *  This method is used for uploading the levels below the
+ *  base image one at a time, and limiting sampling to the
+ *  levels that exist.
+ ***********************************************************/
+void AssetLoader::UploadMipLevels(const std::vector<MIP_LEVEL>& levels, GLenum internalFormat, GLenum format)
+{
+	// reduced levels have odd widths, so rows are byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		glTexImage2D(GL_TEXTURE_2D, (GLint)(i + 1), internalFormat, levels[i].width, levels[i].height, 0,
+			format, GL_UNSIGNED_BYTE, levels[i].pixels.data());
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size());
+}
@@ -0,0 +1,339 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetloader.h
+// ============
+// coroutine based asset loading - file reads and decodes on worker
+// threads, OpenGL uploads resumed on the GL thread
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ThreadPool.h"
+#include "GLUploadThread.h"
+#include "AssetIO.h"
+#include "ImageDecoder.h"
+
+#include <GL/glew.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  AssetTask
+ *
+ *  The handle returned by a loading coroutine. The coroutine
+ *  starts running as soon as it is called; the handle can be
+ *  co_awaited by any number of other coroutines, which are
+ *  resumed with the result when it is ready. That is how one
+ *  asset waits on others without callbacks or blocking.
+ ***********************************************************/
+template <typename T>
+class AssetTask
+{
+private:
+	// result shared by the coroutine and every copy of the handle
+	struct TASK_STATE
+	{
+		std::mutex mutex;
+		bool bDone = false;
+		std::optional<T> value;
+		std::exception_ptr error;
+		std::vector<std::coroutine_handle<>> waiting;
+
+		void Complete()
+		{
+			std::vector<std::coroutine_handle<>> resume;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				bDone = true;
+				resume.swap(waiting);
+			}
+			for (std::coroutine_handle<> handle : resume)
+			{
+				handle.resume();
+			}
+		}
+	};
+
+public:
+	struct promise_type
+	{
+		std::shared_ptr<TASK_STATE> state = std::make_shared<TASK_STATE>();
+
+		AssetTask get_return_object() { return AssetTask(state); }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_value(T value)
+		{
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->value = std::move(value);
+			}
+			state->Complete();
+		}
+		void unhandled_exception()
+		{
+			state->error = std::current_exception();
+			state->Complete();
+		}
+	};
+
+	AssetTask() {}
+
+	// true once the coroutine has produced its result
+	bool IsReady() const
+	{
+		if (!m_state)
+		{
+			return false;
+		}
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		return m_state->bDone;
+	}
+
+	// the result; only valid once IsReady()
+	T Get() const
+	{
+		if (m_state->error)
+		{
+			std::rethrow_exception(m_state->error);
+		}
+		return *m_state->value;
+	}
+
+	// awaiting a task suspends until its result is ready
+	bool await_ready() const { return IsReady(); }
+	bool await_suspend(std::coroutine_handle<> handle)
+	{
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		if (m_state->bDone)
+		{
+			return false;
+		}
+		m_state->waiting.push_back(handle);
+		return true;
+	}
+	T await_resume() const { return Get(); }
+
+private:
+	explicit AssetTask(std::shared_ptr<TASK_STATE> state) : m_state(state) {}
+
+	std::shared_ptr<TASK_STATE> m_state;
+};
+
+/***********************************************************
+ *  AssetTrigger
+ *
+ *  A one-shot event that coroutines can co_await, used to
+ *  hold a load back until something asks for the asset.
+ *  Set() resumes the waiting coroutines on the calling thread.
+ ***********************************************************/
+class AssetTrigger
+{
+public:
+	bool IsSet() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_bSet;
+	}
+	void Set()
+	{
+		std::vector<std::coroutine_handle<>> resume;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_bSet)
+			{
+				return;
+			}
+			m_bSet = true;
+			resume.swap(m_waiting);
+		}
+		for (std::coroutine_handle<> handle : resume)
+		{
+			handle.resume();
+		}
+	}
+
+	// awaiting the trigger suspends until it has been set
+	struct TRIGGER_AWAITER
+	{
+		AssetTrigger* pTrigger;
+		bool await_ready() const { return pTrigger->IsSet(); }
+		bool await_suspend(std::coroutine_handle<> handle)
+		{
+			std::lock_guard<std::mutex> lock(pTrigger->m_mutex);
+			if (pTrigger->m_bSet)
+			{
+				return false;
+			}
+			pTrigger->m_waiting.push_back(handle);
+			return true;
+		}
+		void await_resume() const {}
+	};
+	TRIGGER_AWAITER operator co_await() { return TRIGGER_AWAITER{ this }; }
+
+private:
+	mutable std::mutex m_mutex;
+	bool m_bSet = false;
+	std::vector<std::coroutine_handle<>> m_waiting;
+};
+
+/***********************************************************
+ *  AssetLoader
+ *
+ *  This class schedules loading coroutines. ResumeOnWorker()
+ *  moves the coroutine onto a worker thread for file access
+ *  and decoding; ResumeOnGLThread() queues it to continue in
+ *  PumpGLThread(), which the render loop calls every frame,
+ *  since OpenGL calls have to be made on the GL thread.
+ *  With an upload thread running, ResumeOnUploadThread()
+ *  moves uploads onto its shared context instead, and
+ *  ResumeOnGLThreadWhenComplete() hands the coroutine back
+ *  to the render thread only once a fence shows the GPU has
+ *  finished with them - the render thread never waits.
+ ***********************************************************/
+class AssetLoader
+{
+public:
+	// constructor
+	explicit AssetLoader(int workerThreads);
+	// destructor - finishes every load still in flight
+	~AssetLoader();
+
+	// awaitable that continues the coroutine on a worker thread
+	struct WORKER_AWAITER
+	{
+		AssetLoader* pLoader;
+		bool await_ready() const { return false; }
+		void await_suspend(std::coroutine_handle<> handle);
+		void await_resume() const {}
+	};
+	// awaitable that continues the coroutine on the GL thread
+	struct GL_THREAD_AWAITER
+	{
+		AssetLoader* pLoader;
+		bool await_ready() const { return false; }
+		void await_suspend(std::coroutine_handle<> handle);
+		void await_resume() const {}
+	};
+
+	// awaitable that continues the coroutine on the upload context, or
+	// on the GL thread when there is no upload thread
+	struct UPLOAD_AWAITER
+	{
+		AssetLoader* pLoader;
+		bool await_ready() const { return false; }
+		void await_suspend(std::coroutine_handle<> handle);
+		void await_resume() const {}
+	};
+	// awaitable, from the upload or GL thread, that continues the
+	// coroutine on the GL thread once its GL commands have completed
+	struct FENCE_AWAITER
+	{
+		AssetLoader* pLoader;
+		bool await_ready() const { return false; }
+		void await_suspend(std::coroutine_handle<> handle);
+		void await_resume() const {}
+	};
+
+	// awaitable that queues a whole file read with the batched reads
+	// and continues the coroutine on a worker with the bytes
+	struct READ_AWAITER
+	{
+		AssetLoader* pLoader;
+		std::string filename;
+		std::vector<unsigned char> bytes;
+		bool await_ready() const { return false; }
+		void await_suspend(std::coroutine_handle<> handle);
+		std::vector<unsigned char> await_resume() { return std::move(bytes); }
+	};
+
+	WORKER_AWAITER ResumeOnWorker() { return WORKER_AWAITER{ this }; }
+	GL_THREAD_AWAITER ResumeOnGLThread() { return GL_THREAD_AWAITER{ this }; }
+	UPLOAD_AWAITER ResumeOnUploadThread() { return UPLOAD_AWAITER{ this }; }
+	FENCE_AWAITER ResumeOnGLThreadWhenComplete() { return FENCE_AWAITER{ this }; }
+
+	// move uploads to a thread with a context shared with the window;
+	// must be called on the main thread
+	bool StartUploadThread(GLFWwindow* pSharedWith);
+	// compress loaded textures to BC1/BC7 before upload; on by default
+	// when the driver supports both, and set before starting any loads
+	void SetTextureCompression(bool bEnable, COMPRESS_QUALITY quality);
+	// add an image decoder, tried before the existing ones; the loader
+	// takes ownership, and it must be added before starting any loads
+	void AddDecoder(ImageDecoder* pDecoder);
+	// decode an image file already in memory, with the first decoder
+	// that manages it; safe from any thread
+	bool DecodeImageBytes(const std::vector<unsigned char>& bytes, int scale, IMAGE_DATA& image) const;
+
+	// resume the coroutines waiting for the GL thread, for up to
+	// budgetSeconds; returns how many were resumed
+	int PumpGLThread(double budgetSeconds);
+	// pump the GL thread until the task has its result
+	template <typename T>
+	T Wait(const AssetTask<T>& task)
+	{
+		while (!task.IsReady())
+		{
+			if (PumpGLThread(1.0) == 0)
+			{
+				WaitForGLWork();
+			}
+		}
+		return task.Get();
+	}
+
+	// read a whole file through the batched reads, finishing on a
+	// worker; empty when it cannot be read
+	AssetTask<std::vector<unsigned char>> ReadFile(std::string filename);
+	// read and decode an image on a worker, flipped for OpenGL, reduced
+	// by scale (1, 2, 4 or 8) where the decoder can do that cheaply
+	AssetTask<IMAGE_DATA> DecodeImage(std::string filename, int scale = 1);
+	// decode and build the mips on the workers, then upload every level
+	// on the upload thread; the texture ID is 0 when it could not load
+	AssetTask<GLuint> LoadTexture(std::string filename, int scale = 1);
+	// load a texture from an image file already read, as LoadTexture()
+	// does; several loads can share the bytes and run side by side
+	AssetTask<GLuint> LoadTextureBytes(std::shared_ptr<const std::vector<unsigned char>> bytes,
+		std::string filename, int scale = 1);
+	// create a static buffer object holding the given bytes
+	AssetTask<GLuint> CreateBuffer(std::vector<unsigned char> bytes);
+
+	// create a mipmapped, repeating 2D texture from a decoded image,
+	// building the mips on the calling thread if the image has none
+	static GLuint CreateTexture(const IMAGE_DATA& image);
+	// upload a mip chain below level 0 of the bound 2D texture
+	static void UploadMipLevels(const std::vector<MIP_LEVEL>& levels, GLenum internalFormat, GLenum format);
+
+private:
+	// a coroutine waiting for its uploads to complete on the GPU
+	struct FENCED_RESUME
+	{
+		GLsync fence;
+		std::coroutine_handle<> handle;
+	};
+
+	ThreadPool* m_pWorkers;
+	AssetIO* m_pIO;
+	std::vector<ImageDecoder*> m_decoders;
+	bool m_bCompressTextures;
+	COMPRESS_QUALITY m_compressQuality;
+	GLUploadThread* m_pUploadThread;
+	std::atomic<int> m_pendingUploads;
+	std::mutex m_mutex;
+	std::condition_variable m_glWorkReady;
+	std::deque<std::coroutine_handle<>> m_glQueue;
+	std::vector<FENCED_RESUME> m_fenceQueue;
+
+	void WaitForGLWork();
+	bool HasPendingWork();
+};
@@ -0,0 +1,183 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.cpp
+// ============
+// scripted camera flythrough, smoothly through timed keys
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CameraPath.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	const float PI = 3.14159265f;
+
+	// the point a fraction t of the way from b to c on the spline through
+	// a, b, c and d
+	glm::vec3 CatmullRom(glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d, float t)
+	{
+		float t2 = t * t;
+		float t3 = t2 * t;
+		return 0.5f * ((2.0f * b) + (c - a) * t +
+			(2.0f * a - 5.0f * b + 4.0f * c - d) * t2 +
+			(3.0f * b - a - 3.0f * c + d) * t3);
+	}
+}
+
+/***********************************************************
+ *  CameraPath()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CameraPath::CameraPath()
+{
+	m_nearPlane = 0.1f;
+	m_farPlane = 2000.0f;
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for reading a path file. Blank lines
+ *  and lines starting with # are skipped; the keys may be in
+ *  any order.
+ ***********************************************************/
+bool CameraPath::Load(const std::string& filename)
+{
+	std::ifstream file(filename);
+	if (!file)
+	{
+		std::cout << "[CameraPath] Could not open " << filename << std::endl;
+		return false;
+	}
+
+	std::vector<CAMERA_KEY> keys;
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		size_t start = line.find_first_not_of(" \t\r");
+		if ((start == std::string::npos) || (line[start] == '#'))
+		{
+			continue;
+		}
+
+		std::istringstream fields(line);
+		CAMERA_KEY key;
+		if (!(fields >> key.time
+			>> key.position.x >> key.position.y >> key.position.z
+			>> key.target.x >> key.target.y >> key.target.z))
+		{
+			std::cout << "[CameraPath] " << filename << ":" << lineNumber
+				<< " is not 'time x y z targetX targetY targetZ'" << std::endl;
+			return false;
+		}
+		keys.push_back(key);
+	}
+	if (keys.empty())
+	{
+		std::cout << "[CameraPath] " << filename << " has no keys" << std::endl;
+		return false;
+	}
+
+	m_keys.clear();
+	for (const CAMERA_KEY& key : keys)
+	{
+		AddKey(key);
+	}
+	std::cout << "[CameraPath] " << m_keys.size() << " keys, " << GetDuration() << " s" << std::endl;
+	return true;
+}
+
+/***********************************************************
+ *  MakeOrbit()
+ *
+ *  This method is used for replacing the keys with one lap
+ *  around a point at a steady speed, looking at it.
+ ***********************************************************/
+void CameraPath::MakeOrbit(glm::vec3 center, float radius, float height, float duration, int keyCount)
+{
+	m_keys.clear();
+	keyCount = std::max(keyCount, 4);
+	for (int i = 0; i <= keyCount; i++)
+	{
+		float angle = (float)i * (2.0f * PI / (float)keyCount);
+		CAMERA_KEY key;
+		key.time = duration * (float)i / (float)keyCount;
+		key.position = center + glm::vec3(std::sin(angle) * radius, height, std::cos(angle) * radius);
+		key.target = center;
+		m_keys.push_back(key);
+	}
+}
+
+/***********************************************************
+ *  AddKey()
+ *
+ *  This method is used for adding a key in time order.
+ ***********************************************************/
+void CameraPath::AddKey(const CAMERA_KEY& key)
+{
+	auto position = std::upper_bound(m_keys.begin(), m_keys.end(), key,
+		[](const CAMERA_KEY& a, const CAMERA_KEY& b) { return a.time < b.time; });
+	m_keys.insert(position, key);
+}
+
+/***********************************************************
+ *  Evaluate()
+ *
+ *  This method is used for the camera between the keys on
+ *  either side of a time, on the spline through them and
+ *  their outer neighbours; the first and last keys stand in
+ *  for the neighbours they do not have.
+ ***********************************************************/
+VIEW_INFO CameraPath::Evaluate(double time, float fovY, float width, float height) const
+{
+	glm::vec3 position(0.0f, 5.0f, 12.0f);
+	glm::vec3 target(0.0f);
+	if (!m_keys.empty())
+	{
+		size_t next = 0;
+		while ((next < m_keys.size()) && (m_keys[next].time <= (float)time))
+		{
+			next++;
+		}
+		if (next == 0)
+		{
+			position = m_keys.front().position;
+			target = m_keys.front().target;
+		}
+		else if (next == m_keys.size())
+		{
+			position = m_keys.back().position;
+			target = m_keys.back().target;
+		}
+		else
+		{
+			const CAMERA_KEY& a = m_keys[(next >= 2) ? next - 2 : 0];
+			const CAMERA_KEY& b = m_keys[next - 1];
+			const CAMERA_KEY& c = m_keys[next];
+			const CAMERA_KEY& d = m_keys[std::min(next + 1, m_keys.size() - 1)];
+			float span = c.time - b.time;
+			float t = (span > 0.0f) ? ((float)time - b.time) / span : 1.0f;
+			position = CatmullRom(a.position, b.position, c.position, d.position, t);
+			target = CatmullRom(a.target, b.target, c.target, d.target, t);
+		}
+	}
+
+	VIEW_INFO viewInfo;
+	viewInfo.position = position;
+	viewInfo.fovY = fovY;
+	viewInfo.viewportWidth = width;
+	viewInfo.viewportHeight = height;
+	viewInfo.view = glm::lookAt(position, target, glm::vec3(0.0f, 1.0f, 0.0f));
+	viewInfo.projection = glm::perspective(fovY, width / std::max(height, 1.0f), m_nearPlane, m_farPlane);
+	return viewInfo;
+}
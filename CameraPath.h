@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.h
+// ============
+// scripted camera flythrough, smoothly through timed keys
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ViewManager.h"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  CAMERA_KEY
+ *
+ *  Where the camera is and what it looks at, a time in
+ *  seconds into the path.
+ ***********************************************************/
+struct CAMERA_KEY
+{
+	float time;
+	glm::vec3 position;
+	glm::vec3 target;
+};
+
+/***********************************************************
+ *  CameraPath
+ *
+ *  This class moves a camera through a list of keys, along
+ *  Catmull-Rom splines so it passes through each key without
+ *  turning sharply at it. The view at a time depends on the
+ *  time alone, so a path can be rendered at any frame rate
+ *  and gives the same frames every run. Paths are read from
+ *  a text file of keys, one per line:
+ *
+ *    # time  x y z  targetX targetY targetZ
+ *    0.0     0 5 12  0 1 -3
+ ***********************************************************/
+class CameraPath
+{
+public:
+	// constructor
+	CameraPath();
+
+	// read the keys from a file, replacing any there were
+	bool Load(const std::string& filename);
+	// a circle of keys around a point, ending where it started
+	void MakeOrbit(glm::vec3 center, float radius, float height, float duration, int keyCount = 12);
+	void AddKey(const CAMERA_KEY& key);
+
+	// the camera at a time, held at the ends, for a viewport
+	VIEW_INFO Evaluate(double time, float fovY, float width, float height) const;
+
+	bool IsEmpty() const { return m_keys.empty(); }
+	// time of the last key
+	float GetDuration() const { return m_keys.empty() ? 0.0f : m_keys.back().time; }
+
+private:
+	std::vector<CAMERA_KEY> m_keys;
+	float m_nearPlane;
+	float m_farPlane;
+};
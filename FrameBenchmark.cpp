@@ -0,0 +1,159 @@
+///////////////////////////////////////////////////////////////////////////////
+// framebenchmark.cpp
+// ============
+// records frame times over a fixed run and summarises them to CSV
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameBenchmark.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+	// value at a fraction of the way through sorted samples
+	double Percentile(const std::vector<double>& sorted, double fraction)
+	{
+		if (sorted.empty())
+		{
+			return 0.0;
+		}
+		size_t index = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+}
+
+/***********************************************************
+ *  FrameBenchmark()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameBenchmark::FrameBenchmark()
+{
+	m_warmupFrames = 0;
+	m_measuredFrames = 0;
+	m_frame = 0;
+	m_bRunning = false;
+}
+
+/***********************************************************
+ *  Begin()
+ *
+ *  This method is used for starting a new benchmark run.
+ ***********************************************************/
+void FrameBenchmark::Begin(const BENCHMARK_RESULT& description, int warmupFrames, int measuredFrames)
+{
+	m_description = description;
+	m_warmupFrames = std::max(warmupFrames, 0);
+	m_measuredFrames = std::max(measuredFrames, 1);
+	m_frame = 0;
+	m_bRunning = true;
+	m_frameTimes.clear();
+	m_cpuTimes.clear();
+	m_frameTimes.reserve(m_measuredFrames);
+	m_cpuTimes.reserve(m_measuredFrames);
+}
+
+/***********************************************************
+ *  RecordFrame()
+ *
+ *  This method is used for recording the times of one frame,
+ *  ignoring them while the run is still warming up.
+ ***********************************************************/
+bool FrameBenchmark::RecordFrame(double frameSeconds, double cpuUpdateSeconds)
+{
+	if (!m_bRunning)
+	{
+		return false;
+	}
+
+	if (m_frame++ >= m_warmupFrames)
+	{
+		m_frameTimes.push_back(frameSeconds * 1000.0);
+		m_cpuTimes.push_back(cpuUpdateSeconds * 1000.0);
+	}
+
+	if ((int)m_frameTimes.size() >= m_measuredFrames)
+	{
+		m_bRunning = false;
+		return true;
+	}
+	return false;
+}
+
+/***********************************************************
+ *  GetResult()
+ *
+ *  This method is used for summarising the recorded frames.
+ ***********************************************************/
+BENCHMARK_RESULT FrameBenchmark::GetResult() const
+{
+	BENCHMARK_RESULT result = m_description;
+	result.frames = (int)m_frameTimes.size();
+	if (m_frameTimes.empty())
+	{
+		return result;
+	}
+
+	std::vector<double> sorted = m_frameTimes;
+	std::sort(sorted.begin(), sorted.end());
+
+	double total = 0.0;
+	for (double time : sorted)
+	{
+		total += time;
+	}
+	double cpuTotal = 0.0;
+	for (double time : m_cpuTimes)
+	{
+		cpuTotal += time;
+	}
+
+	result.meanMs = total / sorted.size();
+	result.medianMs = Percentile(sorted, 0.5);
+	result.p95Ms = Percentile(sorted, 0.95);
+	result.p99Ms = Percentile(sorted, 0.99);
+	result.minMs = sorted.front();
+	result.maxMs = sorted.back();
+	result.cpuUpdateMs = cpuTotal / m_cpuTimes.size();
+	return result;
+}
+
+/***********************************************************
+ *  WriteCSV()
+ *
+ *  This method is used for saving benchmark results so they
+ *  can be plotted as scaling curves.
+ ***********************************************************/
+bool FrameBenchmark::WriteCSV(const char* filename, const std::vector<BENCHMARK_RESULT>& results)
+{
+	std::ofstream file(filename);
+	if (!file.is_open())
+	{
+		std::cout << "[FrameBenchmark] Could not write: " << filename << std::endl;
+		return false;
+	}
+
+	file << "label,objects,lights,textures,threads,frames,mean_ms,median_ms,p95_ms,p99_ms,min_ms,max_ms,cpu_update_ms\n";
+	for (const BENCHMARK_RESULT& result : results)
+	{
+		file << result.label << ','
+			<< result.objects << ','
+			<< result.lights << ','
+			<< result.textures << ','
+			<< result.threads << ','
+			<< result.frames << ','
+			<< result.meanMs << ','
+			<< result.medianMs << ','
+			<< result.p95Ms << ','
+			<< result.p99Ms << ','
+			<< result.minMs << ','
+			<< result.maxMs << ','
+			<< result.cpuUpdateMs << '\n';
+	}
+
+	std::cout << "[FrameBenchmark] Wrote " << results.size() << " results to " << filename << std::endl;
+	return true;
+}
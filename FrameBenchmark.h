@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+// framebenchmark.h
+// ============
+// records frame times over a fixed run and summarises them to CSV
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  BENCHMARK_RESULT
+ *
+ *  Summary of one benchmark run, all times in milliseconds.
+ ***********************************************************/
+struct BENCHMARK_RESULT
+{
+	std::string label;
+	int objects = 0;
+	int lights = 0;
+	int textures = 0;
+	int threads = 0;
+	int frames = 0;
+	double meanMs = 0.0;
+	double medianMs = 0.0;
+	double p95Ms = 0.0;
+	double p99Ms = 0.0;
+	double minMs = 0.0;
+	double maxMs = 0.0;
+	// mean CPU time spent in the scene update, inside the frame time
+	double cpuUpdateMs = 0.0;
+};
+
+/***********************************************************
+ *  FrameBenchmark
+ *
+ *  This class skips a number of warm-up frames and then
+ *  records the frame and CPU update times of a fixed number
+ *  of frames, so runs with different settings are compared
+ *  over the same amount of work.
+ ***********************************************************/
+class FrameBenchmark
+{
+public:
+	// constructor
+	FrameBenchmark();
+
+	// start a run; the result keeps the label and scene counts given here
+	void Begin(const BENCHMARK_RESULT& description, int warmupFrames, int measuredFrames);
+	// record one frame; returns true when the run is complete
+	bool RecordFrame(double frameSeconds, double cpuUpdateSeconds);
+	// true between Begin() and the last measured frame
+	bool IsRunning() const { return m_bRunning; }
+
+	// summary of the last completed run
+	BENCHMARK_RESULT GetResult() const;
+
+	// write results as CSV, one row per run, with a header line
+	static bool WriteCSV(const char* filename, const std::vector<BENCHMARK_RESULT>& results);
+
+private:
+	BENCHMARK_RESULT m_description;
+	int m_warmupFrames;
+	int m_measuredFrames;
+	int m_frame;
+	bool m_bRunning;
+	std::vector<double> m_frameTimes;
+	std::vector<double> m_cpuTimes;
+};
@@ -0,0 +1,135 @@
+///////////////////////////////////////////////////////////////////////////////
+// gluploadthread.cpp
+// ============
+// dedicated thread with a shared OpenGL context for resource uploads
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLUploadThread.h"
+
+#include <iostream>
+
+/***********************************************************
+ *  GLUploadThread()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GLUploadThread::GLUploadThread()
+{
+	m_pContextWindow = NULL;
+	m_bStopping = false;
+	m_bRunning = false;
+}
+
+/***********************************************************
+ *  ~GLUploadThread()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GLUploadThread::~GLUploadThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_jobReady.notify_all();
+
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+	if (NULL != m_pContextWindow)
+	{
+		glfwDestroyWindow(m_pContextWindow);
+		m_pContextWindow = NULL;
+	}
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for creating a hidden 1x1 window that
+ *  shares textures, buffers and sync objects with the main
+ *  window, and starting the thread that makes it current.
+ ***********************************************************/
+bool GLUploadThread::Start(GLFWwindow* pSharedWith)
+{
+	if ((NULL == pSharedWith) || m_thread.joinable())
+	{
+		return false;
+	}
+
+	// the version hints from InitializeGLFW() still apply
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	m_pContextWindow = glfwCreateWindow(1, 1, "upload", NULL, pSharedWith);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+	if (NULL == m_pContextWindow)
+	{
+		std::cout << "[GLUploadThread] Could not create a shared context, uploading on the render thread" << std::endl;
+		return false;
+	}
+
+	m_bRunning = true;
+	m_thread = std::thread(&GLUploadThread::ThreadLoop, this);
+	return true;
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method is used for queueing an upload job.
+ ***********************************************************/
+void GLUploadThread::Submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_jobReady.notify_one();
+}
+
+/***********************************************************
+ *  InsertFence()
+ *
+ *  This method is used for creating a fence after the upload
+ *  commands. The flush is what makes the fence reach the GPU,
+ *  since the upload context never swaps buffers.
+ ***********************************************************/
+GLsync GLUploadThread::InsertFence()
+{
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+	return fence;
+}
+
+/***********************************************************
+ *  ThreadLoop()
+ *
+ *  This method is used for running the upload jobs with the
+ *  shared context current.
+ ***********************************************************/
+void GLUploadThread::ThreadLoop()
+{
+	glfwMakeContextCurrent(m_pContextWindow);
+
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobReady.wait(lock, [this]() { return m_bStopping || !m_jobs.empty(); });
+			if (m_jobs.empty())
+			{
+				break;
+			}
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+
+		job();
+	}
+
+	glfwMakeContextCurrent(NULL);
+	m_bRunning = false;
+}
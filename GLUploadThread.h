@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////
+// gluploadthread.h
+// ============
+// dedicated thread with a shared OpenGL context for resource uploads
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include "GLFW/glfw3.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/***********************************************************
+ *  GLUploadThread
+ *
+ *  This class runs a thread that owns a hidden window whose
+ *  context shares objects with the main window. Upload jobs
+ *  (texture images, mipmaps, buffer data) run on it, so the
+ *  render thread never stalls on a transfer. A job that
+ *  publishes a resource ends with InsertFence(), and the
+ *  render thread polls that fence to find out when the
+ *  resource is safe to use.
+ ***********************************************************/
+class GLUploadThread
+{
+public:
+	// constructor
+	GLUploadThread();
+	// destructor - finishes the queued jobs and closes the context
+	~GLUploadThread();
+
+	// create the shared context and start the thread; must be called on
+	// the main thread, since GLFW only creates windows there
+	bool Start(GLFWwindow* pSharedWith);
+	// true once the thread is running with its context current
+	bool IsRunning() const { return m_bRunning; }
+
+	// queue a job to run with the upload context current
+	void Submit(std::function<void()> job);
+
+	// fence the GL commands issued so far on the calling context and
+	// flush them, so another context can wait for them to complete
+	static GLsync InsertFence();
+
+private:
+	GLFWwindow* m_pContextWindow;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_jobReady;
+	std::deque<std::function<void()>> m_jobs;
+	bool m_bStopping;
+	std::atomic<bool> m_bRunning;
+
+	void ThreadLoop();
+};
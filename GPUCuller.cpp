@@ -0,0 +1,1119 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuculler.cpp
+// ============
+// GPU-driven instance culling, LOD selection and indirect draw compaction
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GPUCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	// shader storage binding points shared with the GLSL code
+	const GLuint INSTANCE_BINDING = 0;
+	const GLuint MESH_BINDING = 1;
+	const GLuint COMMAND_BINDING = 2;
+	const GLuint VISIBLE_BINDING = 3;
+	const GLuint COMPACTED_BINDING = 4;
+	const GLuint DRAW_COUNT_BINDING = 5;
+	const GLuint HIDDEN_GROUP_BINDING = 6;
+	const GLuint RETEST_BINDING = 7;
+
+	// group of an instance that belongs to none
+	const uint32_t NO_GROUP = 0xFFFFFFFFu;
+
+	// work group size of the culling and compaction passes
+	const GLuint CULL_GROUP_SIZE = 64;
+
+	// texture unit for the depth pyramid, above the 16 scene texture slots
+	const GLint PYRAMID_TEXTURE_UNIT = 16;
+
+	const char* const CULL_SHADER_FILE = "shaders/cullInstancesComputeShader.glsl";
+	const char* const COMPACT_SHADER_FILE = "shaders/compactDrawsComputeShader.glsl";
+	const char* const PYRAMID_SHADER_FILE = "shaders/depthPyramidComputeShader.glsl";
+
+	// a linked program in a snapshot, its binary in the program data
+	struct PROGRAM_BINARY
+	{
+		char filename[112];
+		uint32_t format;
+		uint32_t pad;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	/***********************************************************
+	 *  LoadComputeShader()
+	 *
+	 *  Compile and link a compute program from a GLSL file.
+	 *  Returns 0 if the file is missing or does not compile.
+	 ***********************************************************/
+	GLuint LoadComputeShader(const char* filename)
+	{
+		std::ifstream file(filename);
+		if (!file.is_open())
+		{
+			std::cout << "[GPUCuller] Could not open shader: " << filename << std::endl;
+			return 0;
+		}
+		std::stringstream stream;
+		stream << file.rdbuf();
+		std::string source = stream.str();
+		const char* sourceText = source.c_str();
+
+		GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+		glShaderSource(shader, 1, &sourceText, NULL);
+		glCompileShader(shader);
+
+		GLint result = GL_FALSE;
+		char log[1024];
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
+		if (result != GL_TRUE)
+		{
+			glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+			std::cout << "[GPUCuller] ERROR: " << filename << "\n" << log << std::endl;
+			glDeleteShader(shader);
+			return 0;
+		}
+
+		GLuint program = glCreateProgram();
+		glAttachShader(program, shader);
+		// keep the binary available for the scene snapshot
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(program);
+		glDeleteShader(shader);
+
+		glGetProgramiv(program, GL_LINK_STATUS, &result);
+		if (result != GL_TRUE)
+		{
+			glGetProgramInfoLog(program, sizeof(log), NULL, log);
+			std::cout << "[GPUCuller] ERROR: " << filename << "\n" << log << std::endl;
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+
+	/***********************************************************
+	 *  LoadCachedComputeShader()
+	 *
+	 *  Create a compute program from its binary in a snapshot,
+	 *  which skips compiling and linking altogether. A driver
+	 *  update can make it refuse the binary, and then the
+	 *  program is built from the GLSL file as usual.
+	 ***********************************************************/
+	GLuint LoadCachedComputeShader(const char* filename, const SceneSnapshot* pSnapshot)
+	{
+		size_t programCount = 0;
+		size_t dataSize = 0;
+		const PROGRAM_BINARY* programs = (NULL != pSnapshot) ?
+			pSnapshot->GetArray<PROGRAM_BINARY>(SNAPSHOT_PROGRAMS, programCount) : NULL;
+		const unsigned char* data = (NULL != pSnapshot) ?
+			pSnapshot->GetSection(SNAPSHOT_PROGRAM_DATA, dataSize) : NULL;
+
+		for (size_t i = 0; (NULL != data) && (i < programCount); i++)
+		{
+			if ((strncmp(programs[i].filename, filename, sizeof(programs[i].filename)) != 0) ||
+				(programs[i].size > dataSize) || (programs[i].offset > dataSize - programs[i].size))
+			{
+				continue;
+			}
+
+			GLuint program = glCreateProgram();
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			glProgramBinary(program, programs[i].format, data + programs[i].offset, (GLsizei)programs[i].size);
+			GLint result = GL_FALSE;
+			glGetProgramiv(program, GL_LINK_STATUS, &result);
+			if (result == GL_TRUE)
+			{
+				return program;
+			}
+			std::cout << "[GPUCuller] Driver refused the cached binary of " << filename << std::endl;
+			glDeleteProgram(program);
+			break;
+		}
+		return LoadComputeShader(filename);
+	}
+
+	void ResizeBuffer(GLuint buffer, GLsizeiptr size, const void* data, GLenum usage)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<GLsizeiptr>(size, 16), data, usage);
+	}
+}
+
+/***********************************************************
+ *  GPUCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GPUCuller::GPUCuller()
+{
+	m_pixelThreshold = 1.0f;
+	m_bOcclusionCulling = true;
+
+	m_pDrawShader = NULL;
+	m_cullProgram = 0;
+	m_compactProgram = 0;
+	m_pyramidProgram = 0;
+	m_vao = 0;
+	m_vbo = 0;
+	m_ebo = 0;
+	m_instanceBuffer = 0;
+	m_meshBuffer = 0;
+	m_commandBuffer = 0;
+	m_commandTemplateBuffer = 0;
+	m_visibleBuffer = 0;
+	m_compactedBuffer = 0;
+	m_drawCountBuffer = 0;
+	m_hiddenGroupBuffer = 0;
+	m_retestBuffer = 0;
+	m_depthFramebuffer = 0;
+	m_depthTexture = 0;
+	m_depthPyramid = 0;
+	m_depthWidth = 0;
+	m_depthHeight = 0;
+	m_pyramidLevels = 0;
+	m_depthViewProjection = glm::mat4(1.0f);
+	m_bDepthValid = false;
+	m_bGeometryDirty = false;
+	m_bInstancesDirty = false;
+	m_bGroupsDirty = false;
+	m_readbackBuffer = 0;
+	m_readbackSize = 0;
+	m_readbackFence = NULL;
+	m_visibleTextureMask = 0;
+}
+
+/***********************************************************
+ *  ~GPUCuller()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GPUCuller::~GPUCuller()
+{
+	if (NULL != m_readbackFence)
+	{
+		glDeleteSync(m_readbackFence);
+	}
+	GLuint buffers[12] = {
+		m_vbo, m_ebo, m_instanceBuffer, m_meshBuffer, m_commandBuffer,
+		m_commandTemplateBuffer, m_visibleBuffer, m_compactedBuffer, m_drawCountBuffer,
+		m_hiddenGroupBuffer, m_retestBuffer, m_readbackBuffer };
+	for (GLuint buffer : buffers)
+	{
+		if (buffer != 0)
+		{
+			glDeleteBuffers(1, &buffer);
+		}
+	}
+	if (m_vao != 0)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+	}
+	if (m_depthFramebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_depthFramebuffer);
+	}
+	if (m_depthTexture != 0)
+	{
+		glDeleteTextures(1, &m_depthTexture);
+	}
+	if (m_depthPyramid != 0)
+	{
+		glDeleteTextures(1, &m_depthPyramid);
+	}
+	if (m_cullProgram != 0)
+	{
+		glDeleteProgram(m_cullProgram);
+	}
+	if (m_compactProgram != 0)
+	{
+		glDeleteProgram(m_compactProgram);
+	}
+	if (m_pyramidProgram != 0)
+	{
+		glDeleteProgram(m_pyramidProgram);
+	}
+
+	delete m_pDrawShader;
+	m_pDrawShader = NULL;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for loading the shaders and creating
+ *  the buffers of the GPU-driven path.
+ ***********************************************************/
+bool GPUCuller::Initialize(const SceneSnapshot* pSnapshot)
+{
+	m_cullProgram = LoadCachedComputeShader(CULL_SHADER_FILE, pSnapshot);
+	m_compactProgram = LoadCachedComputeShader(COMPACT_SHADER_FILE, pSnapshot);
+	m_pyramidProgram = LoadCachedComputeShader(PYRAMID_SHADER_FILE, pSnapshot);
+
+	m_pDrawShader = new ShaderManager();
+	m_pDrawShader->LoadShaders(
+		"shaders/gpuDrivenVertexShader.glsl",
+		"shaders/gpuDrivenFragmentShader.glsl");
+
+	glGenVertexArrays(1, &m_vao);
+	glGenBuffers(1, &m_vbo);
+	glGenBuffers(1, &m_ebo);
+	glGenBuffers(1, &m_instanceBuffer);
+	glGenBuffers(1, &m_meshBuffer);
+	glGenBuffers(1, &m_commandBuffer);
+	glGenBuffers(1, &m_commandTemplateBuffer);
+	glGenBuffers(1, &m_visibleBuffer);
+	glGenBuffers(1, &m_compactedBuffer);
+	glGenBuffers(1, &m_drawCountBuffer);
+	glGenBuffers(1, &m_hiddenGroupBuffer);
+	glGenBuffers(1, &m_retestBuffer);
+
+	ResizeBuffer(m_drawCountBuffer, sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+	ResizeBuffer(m_hiddenGroupBuffer, sizeof(uint32_t), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	return (m_cullProgram != 0) && (m_compactProgram != 0) && (m_pyramidProgram != 0);
+}
+
+/***********************************************************
+ *  SaveSnapshot()
+ *
+ *  This method is used for adding everything the culler was
+ *  given - shared geometry, mesh records, draw buckets,
+ *  instances and the transforms of their groups - to a
+ *  snapshot, with the binaries of the linked
+ *  compute programs. The shader files are recorded as sources
+ *  so an edited shader is rebuilt rather than restored.
+ ***********************************************************/
+void GPUCuller::SaveSnapshot(SceneSnapshot& snapshot) const
+{
+	snapshot.AddArray(SNAPSHOT_CULLER_VERTICES, m_vertices);
+	snapshot.AddArray(SNAPSHOT_CULLER_INDICES, m_indices);
+	snapshot.AddArray(SNAPSHOT_CULLER_MESHES, m_meshes);
+	snapshot.AddArray(SNAPSHOT_CULLER_BOUNDS, m_meshBounds);
+	snapshot.AddArray(SNAPSHOT_CULLER_BUCKETS, m_bucketTemplate);
+	snapshot.AddArray(SNAPSHOT_CULLER_INSTANCES, m_instances);
+
+	// the group bounds are rebuilt from the instances
+	std::vector<glm::mat4> groupTransforms;
+	for (const INSTANCE_GROUP& group : m_groups)
+	{
+		groupTransforms.push_back(group.transform);
+	}
+	snapshot.AddArray(SNAPSHOT_CULLER_GROUPS, groupTransforms);
+
+	const char* const filenames[3] = { CULL_SHADER_FILE, COMPACT_SHADER_FILE, PYRAMID_SHADER_FILE };
+	const GLuint programs[3] = { m_cullProgram, m_compactProgram, m_pyramidProgram };
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+
+	std::vector<PROGRAM_BINARY> binaries;
+	std::vector<unsigned char> data;
+	for (int i = 0; i < 3; i++)
+	{
+		snapshot.AddSource(filenames[i]);
+
+		GLint length = 0;
+		if ((formatCount > 0) && (programs[i] != 0))
+		{
+			glGetProgramiv(programs[i], GL_PROGRAM_BINARY_LENGTH, &length);
+		}
+		if (length <= 0)
+		{
+			continue;
+		}
+
+		PROGRAM_BINARY binary;
+		memset(&binary, 0, sizeof(binary));
+		strncpy(binary.filename, filenames[i], sizeof(binary.filename) - 1);
+		binary.offset = data.size();
+		data.resize(data.size() + length);
+
+		GLenum format = 0;
+		GLsizei written = 0;
+		glGetProgramBinary(programs[i], length, &written, &format, data.data() + binary.offset);
+		binary.format = format;
+		binary.size = (uint64_t)written;
+		data.resize(binary.offset + written);
+		if (written > 0)
+		{
+			binaries.push_back(binary);
+		}
+	}
+	snapshot.AddArray(SNAPSHOT_PROGRAMS, binaries);
+	snapshot.AddArray(SNAPSHOT_PROGRAM_DATA, data);
+}
+
+/***********************************************************
+ *  RestoreSnapshot()
+ *
+ *  This method is used for taking the meshes and instances
+ *  from a snapshot instead of building them. The records are
+ *  checked against each other before anything is replaced,
+ *  as a bad index here would send the GPU out of bounds.
+ ***********************************************************/
+bool GPUCuller::RestoreSnapshot(const SceneSnapshot& snapshot)
+{
+	std::vector<MESH_VERTEX> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<MESH_RECORD> meshes;
+	std::vector<glm::vec4> meshBounds;
+	std::vector<DRAW_COMMAND> buckets;
+	std::vector<INSTANCE_RECORD> instances;
+	std::vector<glm::mat4> groupTransforms;
+	if (!snapshot.CopyArray(SNAPSHOT_CULLER_VERTICES, vertices) ||
+		!snapshot.CopyArray(SNAPSHOT_CULLER_INDICES, indices) ||
+		!snapshot.CopyArray(SNAPSHOT_CULLER_MESHES, meshes) ||
+		!snapshot.CopyArray(SNAPSHOT_CULLER_BOUNDS, meshBounds) ||
+		!snapshot.CopyArray(SNAPSHOT_CULLER_BUCKETS, buckets) ||
+		!snapshot.CopyArray(SNAPSHOT_CULLER_INSTANCES, instances) ||
+		!snapshot.CopyArray(SNAPSHOT_CULLER_GROUPS, groupTransforms) ||
+		(meshBounds.size() != meshes.size()))
+	{
+		return false;
+	}
+
+	for (const MESH_RECORD& mesh : meshes)
+	{
+		if ((mesh.lodCount > MAX_GPU_LODS) || (mesh.firstBucket + mesh.lodCount > buckets.size()))
+		{
+			return false;
+		}
+	}
+	for (const DRAW_COMMAND& bucket : buckets)
+	{
+		if (((uint64_t)bucket.firstIndex + bucket.count > indices.size()) ||
+			(bucket.baseVertex < 0) || ((size_t)bucket.baseVertex > vertices.size()))
+		{
+			return false;
+		}
+	}
+	for (const INSTANCE_RECORD& instance : instances)
+	{
+		if ((instance.meshIndex >= meshes.size()) ||
+			((instance.group != NO_GROUP) && (instance.group >= groupTransforms.size())))
+		{
+			return false;
+		}
+	}
+
+	m_vertices.swap(vertices);
+	m_indices.swap(indices);
+	m_meshes.swap(meshes);
+	m_meshBounds.swap(meshBounds);
+	m_bucketTemplate.swap(buckets);
+	m_instances.swap(instances);
+	m_groups.assign(groupTransforms.size(), INSTANCE_GROUP());
+	for (size_t g = 0; g < groupTransforms.size(); g++)
+	{
+		m_groups[g].transform = groupTransforms[g];
+	}
+	m_bGeometryDirty = true;
+	m_bInstancesDirty = true;
+	m_bGroupsDirty = true;
+	return true;
+}
+
+/***********************************************************
+ *  AddMesh()
+ *
+ *  This method is used for appending a LOD chain to the
+ *  shared geometry buffers. Each level becomes one draw
+ *  bucket that visible instances are appended to.
+ ***********************************************************/
+int GPUCuller::AddMesh(const std::vector<MESH_LOD>& chain, int textureSlot)
+{
+	if (chain.empty())
+	{
+		return -1;
+	}
+
+	MESH_RECORD record;
+	memset(&record, 0, sizeof(record));
+	record.firstBucket = (uint32_t)m_bucketTemplate.size();
+	record.lodCount = (uint32_t)std::min<size_t>(chain.size(), MAX_GPU_LODS);
+	record.textureSlot = (uint32_t)std::max(textureSlot, 0);
+
+	for (uint32_t level = 0; level < record.lodCount; level++)
+	{
+		const MESH_DATA& mesh = chain[level].mesh;
+		record.lodErrors[level] = chain[level].geometricError;
+
+		DRAW_COMMAND command;
+		command.count = (uint32_t)mesh.indices.size();
+		command.instanceCount = 0;
+		command.firstIndex = (uint32_t)m_indices.size();
+		command.baseVertex = (int32_t)m_vertices.size();
+		command.baseInstance = 0;
+		m_bucketTemplate.push_back(command);
+
+		m_vertices.insert(m_vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+		m_indices.insert(m_indices.end(), mesh.indices.begin(), mesh.indices.end());
+	}
+
+	m_meshes.push_back(record);
+	m_meshBounds.push_back(glm::vec4(chain[0].mesh.boundsCenter, chain[0].mesh.boundsRadius));
+	m_bGeometryDirty = true;
+	m_bInstancesDirty = true;
+
+	return (int)m_meshes.size() - 1;
+}
+
+/***********************************************************
+ *  MakeInstance()
+ *
+ *  This method is used for filling in an instance record
+ *  with its world space bounding sphere.
+ ***********************************************************/
+GPUCuller::INSTANCE_RECORD GPUCuller::MakeInstance(int meshIndex, const glm::mat4& model, uint32_t group) const
+{
+	INSTANCE_RECORD instance;
+	const glm::vec4& bounds = m_meshBounds[meshIndex];
+
+	float scale = std::max(
+		glm::length(glm::vec3(model[0])),
+		std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+	instance.model = model;
+	instance.boundingSphere = glm::vec4(glm::vec3(model * glm::vec4(glm::vec3(bounds), 1.0f)), bounds.w * scale);
+	instance.meshIndex = (uint32_t)meshIndex;
+	instance.scale = scale;
+	instance.group = group;
+	instance.pad = 0;
+	return instance;
+}
+
+/***********************************************************
+ *  AddGroup()
+ *
+ *  This method is used for adding a group that instances can
+ *  be placed in, such as the parts of one prefab instance.
+ ***********************************************************/
+int GPUCuller::AddGroup(const glm::mat4& transform)
+{
+	INSTANCE_GROUP group;
+	group.transform = transform;
+	group.boundingSphere = glm::vec4(glm::vec3(transform[3]), 0.0f);
+	group.coarsestError = 0.0f;
+	m_groups.push_back(group);
+	return (int)m_groups.size() - 1;
+}
+
+/***********************************************************
+ *  SetGroupTransform()
+ *
+ *  This method is used for recording the transform a moved
+ *  group was placed with; its instances move on their own.
+ ***********************************************************/
+void GPUCuller::SetGroupTransform(int groupIndex, const glm::mat4& transform)
+{
+	if ((groupIndex >= 0) && (groupIndex < (int)m_groups.size()))
+	{
+		m_groups[groupIndex].transform = transform;
+	}
+}
+
+/***********************************************************
+ *  AddInstance()
+ *
+ *  This method is used for adding an instance of a mesh.
+ ***********************************************************/
+int GPUCuller::AddInstance(int meshIndex, const glm::mat4& model, int groupIndex)
+{
+	if ((meshIndex < 0) || (meshIndex >= (int)m_meshes.size()) || (groupIndex >= (int)m_groups.size()))
+	{
+		return -1;
+	}
+
+	m_instances.push_back(MakeInstance(meshIndex, model, (groupIndex < 0) ? NO_GROUP : (uint32_t)groupIndex));
+	m_bInstancesDirty = true;
+	m_bGroupsDirty = true;
+	return (int)m_instances.size() - 1;
+}
+
+/***********************************************************
+ *  SetInstanceTransform()
+ *
+ *  This method is used for moving an existing instance.
+ ***********************************************************/
+void GPUCuller::SetInstanceTransform(int instanceIndex, const glm::mat4& model)
+{
+	if ((instanceIndex < 0) || (instanceIndex >= (int)m_instances.size()))
+	{
+		return;
+	}
+
+	m_instances[instanceIndex] = MakeInstance(
+		m_instances[instanceIndex].meshIndex, model, m_instances[instanceIndex].group);
+	m_bGroupsDirty = true;
+
+	// a moved instance only needs its own record updated
+	if (!m_bInstancesDirty)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer);
+		glBufferSubData(
+			GL_SHADER_STORAGE_BUFFER,
+			instanceIndex * sizeof(INSTANCE_RECORD),
+			sizeof(INSTANCE_RECORD),
+			&m_instances[instanceIndex]);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+}
+
+/***********************************************************
+ *  ClearInstances()
+ *
+ *  This method is used for removing all the instances and
+ *  the groups they were placed in.
+ ***********************************************************/
+void GPUCuller::ClearInstances()
+{
+	m_instances.clear();
+	m_groups.clear();
+	m_hiddenGroups.clear();
+	m_bInstancesDirty = true;
+	m_bGroupsDirty = false;
+}
+
+/***********************************************************
+ *  GetGroups()
+ *
+ *  This method is used for getting the groups, with bounds
+ *  that cover their instances as they are now.
+ ***********************************************************/
+const std::vector<GPUCuller::INSTANCE_GROUP>& GPUCuller::GetGroups()
+{
+	if (m_bGroupsDirty)
+	{
+		UpdateGroupBounds();
+	}
+	return m_groups;
+}
+
+/***********************************************************
+ *  UpdateGroupBounds()
+ *
+ *  This method is used for fitting a sphere around the
+ *  instance spheres of each group - centered on the box that
+ *  encloses them - and finding the largest error any of its
+ *  instances shows at its coarsest LOD.
+ ***********************************************************/
+void GPUCuller::UpdateGroupBounds()
+{
+	std::vector<glm::vec3> minimums(m_groups.size(), glm::vec3(FLT_MAX));
+	std::vector<glm::vec3> maximums(m_groups.size(), glm::vec3(-FLT_MAX));
+	for (INSTANCE_GROUP& group : m_groups)
+	{
+		group.boundingSphere = glm::vec4(glm::vec3(group.transform[3]), 0.0f);
+		group.coarsestError = 0.0f;
+	}
+
+	for (const INSTANCE_RECORD& instance : m_instances)
+	{
+		if (instance.group == NO_GROUP)
+		{
+			continue;
+		}
+		glm::vec3 center = glm::vec3(instance.boundingSphere);
+		float radius = instance.boundingSphere.w;
+		minimums[instance.group] = glm::min(minimums[instance.group], center - glm::vec3(radius));
+		maximums[instance.group] = glm::max(maximums[instance.group], center + glm::vec3(radius));
+
+		const MESH_RECORD& mesh = m_meshes[instance.meshIndex];
+		if (mesh.lodCount > 0)
+		{
+			INSTANCE_GROUP& group = m_groups[instance.group];
+			group.coarsestError = std::max(group.coarsestError, mesh.lodErrors[mesh.lodCount - 1] * instance.scale);
+		}
+	}
+	for (size_t g = 0; g < m_groups.size(); g++)
+	{
+		if (minimums[g].x <= maximums[g].x)
+		{
+			m_groups[g].boundingSphere = glm::vec4((minimums[g] + maximums[g]) * 0.5f, 0.0f);
+		}
+	}
+
+	for (const INSTANCE_RECORD& instance : m_instances)
+	{
+		if (instance.group == NO_GROUP)
+		{
+			continue;
+		}
+		glm::vec4& sphere = m_groups[instance.group].boundingSphere;
+		float reach = glm::length(glm::vec3(instance.boundingSphere) - glm::vec3(sphere)) + instance.boundingSphere.w;
+		sphere.w = std::max(sphere.w, reach);
+	}
+
+	m_bGroupsDirty = false;
+}
+
+/***********************************************************
+ *  SetHiddenGroups()
+ *
+ *  This method is used for leaving groups out of the cull
+ *  passes that follow, for instance while something else
+ *  draws them. Bit g of the words is set for group g.
+ ***********************************************************/
+void GPUCuller::SetHiddenGroups(const std::vector<uint32_t>& hiddenGroups)
+{
+	m_hiddenGroups = hiddenGroups;
+}
+
+/***********************************************************
+ *  BuildRayQuery()
+ *
+ *  This method is used for giving a ray query the scene the
+ *  culler draws, for picking and line of sight on the CPU.
+ *  Rays test the full detail level, whatever the GPU draws.
+ ***********************************************************/
+void GPUCuller::BuildRayQuery(RayQuery& rayQuery) const
+{
+	rayQuery.Clear();
+	std::vector<int> rayMeshes(m_meshes.size(), -1);
+	for (size_t m = 0; m < m_meshes.size(); m++)
+	{
+		const DRAW_COMMAND& command = m_bucketTemplate[m_meshes[m].firstBucket];
+		MESH_DATA mesh;
+		mesh.indices.assign(
+			m_indices.begin() + command.firstIndex,
+			m_indices.begin() + command.firstIndex + command.count);
+		uint32_t vertexCount = 0;
+		for (uint32_t index : mesh.indices)
+		{
+			vertexCount = std::max(vertexCount, index + 1);
+		}
+		mesh.vertices.assign(
+			m_vertices.begin() + command.baseVertex,
+			m_vertices.begin() + command.baseVertex + vertexCount);
+		rayMeshes[m] = rayQuery.AddMesh(mesh);
+	}
+
+	for (const INSTANCE_RECORD& instance : m_instances)
+	{
+		if (rayQuery.AddInstance(rayMeshes[instance.meshIndex], instance.model) < 0)
+		{
+			std::cout << "[GPUCuller] WARNING: Mesh " << instance.meshIndex
+				<< " has no triangles; ray query instances no longer match" << std::endl;
+			break;
+		}
+	}
+	rayQuery.Build();
+}
+
+/***********************************************************
+ *  UploadGeometry()
+ *
+ *  This method is used for uploading the shared vertex and
+ *  index buffers used by every indirect draw.
+ ***********************************************************/
+void GPUCuller::UploadGeometry()
+{
+	glBindVertexArray(m_vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(MESH_VERTEX), m_vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(uint32_t), m_indices.data(), GL_STATIC_DRAW);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MESH_VERTEX), (void*)offsetof(MESH_VERTEX, position));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MESH_VERTEX), (void*)offsetof(MESH_VERTEX, normal));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(MESH_VERTEX), (void*)offsetof(MESH_VERTEX, texCoord));
+
+	glBindVertexArray(0);
+
+	ResizeBuffer(m_meshBuffer, m_meshes.size() * sizeof(MESH_RECORD), m_meshes.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	m_bGeometryDirty = false;
+}
+
+/***********************************************************
+ *  UploadInstances()
+ *
+ *  This method is used for uploading the instance records
+ *  and laying out the visible list - every mesh/LOD bucket
+ *  reserves room for all the instances of its mesh, so the
+ *  cull pass can append without any CPU involvement.
+ ***********************************************************/
+void GPUCuller::UploadInstances()
+{
+	std::vector<uint32_t> meshInstanceCounts(m_meshes.size(), 0);
+	for (const INSTANCE_RECORD& instance : m_instances)
+	{
+		meshInstanceCounts[instance.meshIndex]++;
+	}
+
+	uint32_t slot = 0;
+	for (size_t m = 0; m < m_meshes.size(); m++)
+	{
+		for (uint32_t level = 0; level < m_meshes[m].lodCount; level++)
+		{
+			m_bucketTemplate[m_meshes[m].firstBucket + level].baseInstance = slot;
+			slot += meshInstanceCounts[m];
+		}
+	}
+
+	GLsizeiptr commandBytes = m_bucketTemplate.size() * sizeof(DRAW_COMMAND);
+	ResizeBuffer(m_instanceBuffer, m_instances.size() * sizeof(INSTANCE_RECORD), m_instances.data(), GL_DYNAMIC_DRAW);
+	ResizeBuffer(m_visibleBuffer, slot * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+	ResizeBuffer(m_commandTemplateBuffer, commandBytes, m_bucketTemplate.data(), GL_STATIC_DRAW);
+	ResizeBuffer(m_commandBuffer, commandBytes, NULL, GL_DYNAMIC_COPY);
+	ResizeBuffer(m_compactedBuffer, commandBytes, NULL, GL_DYNAMIC_COPY);
+	// a count, then the instances the first cull pass hid
+	ResizeBuffer(m_retestBuffer, (m_instances.size() + 1) * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	m_bInstancesDirty = false;
+}
+
+/***********************************************************
+ *  CaptureDepth()
+ *
+ *  This method is used for copying the depth buffer drawn so
+ *  far and reducing it to a pyramid that cull passes test
+ *  bounding spheres against, remembering the camera it was
+ *  drawn from so later frames project into it correctly.
+ ***********************************************************/
+void GPUCuller::CaptureDepth(int width, int height, const glm::mat4& viewProjection)
+{
+	if (!m_bOcclusionCulling || (m_pyramidProgram == 0) || (width <= 0) || (height <= 0))
+	{
+		return;
+	}
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+	if ((width != m_depthWidth) || (height != m_depthHeight))
+	{
+		if (m_depthTexture != 0)
+		{
+			glDeleteTextures(1, &m_depthTexture);
+			glDeleteTextures(1, &m_depthPyramid);
+			glDeleteFramebuffers(1, &m_depthFramebuffer);
+		}
+		m_depthWidth = width;
+		m_depthHeight = height;
+		m_pyramidLevels = 1 + (int)std::floor(std::log2((float)std::max(width, height)));
+
+		// matches the default framebuffer format so it can be blitted
+		glGenTextures(1, &m_depthTexture);
+		glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH24_STENCIL8, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		glGenTextures(1, &m_depthPyramid);
+		glBindTexture(GL_TEXTURE_2D, m_depthPyramid);
+		glTexStorage2D(GL_TEXTURE_2D, m_pyramidLevels, GL_R32F, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenFramebuffers(1, &m_depthFramebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_depthFramebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_depthTexture, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, previousFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_depthFramebuffer);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+	BuildDepthPyramid();
+	m_depthViewProjection = viewProjection;
+	m_bDepthValid = true;
+}
+
+/***********************************************************
+ *  BuildDepthPyramid()
+ *
+ *  This method is used for reducing the captured depth to a
+ *  mip chain where every texel holds the farthest depth of
+ *  the area it covers. Levels halve rounding down, so the
+ *  shader widens the last texel of a level to 3 where the
+ *  level above is odd, leaving no source texel unread.
+ ***********************************************************/
+void GPUCuller::BuildDepthPyramid()
+{
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+	glUseProgram(m_pyramidProgram);
+	glUniform1i(glGetUniformLocation(m_pyramidProgram, "sourceDepth"), PYRAMID_TEXTURE_UNIT);
+	glActiveTexture(GL_TEXTURE0 + PYRAMID_TEXTURE_UNIT);
+
+	int levelWidth = m_depthWidth;
+	int levelHeight = m_depthHeight;
+	for (int level = 0; level < m_pyramidLevels; level++)
+	{
+		// level 0 reads the depth copy, the others read the level above
+		glBindTexture(GL_TEXTURE_2D, (level == 0) ? m_depthTexture : m_depthPyramid);
+		glUniform1i(glGetUniformLocation(m_pyramidProgram, "sourceLevel"), level - 1);
+		glUniform2i(glGetUniformLocation(m_pyramidProgram, "destinationSize"), levelWidth, levelHeight);
+		glBindImageTexture(0, m_depthPyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+		glDispatchCompute((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		levelWidth = std::max(levelWidth / 2, 1);
+		levelHeight = std::max(levelHeight / 2, 1);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glUseProgram(previousProgram);
+}
+
+/***********************************************************
+ *  ReadBackVisibility()
+ *
+ *  This method is used for finding out which textures are in
+ *  use by visible instances without stalling. The per-bucket
+ *  counts are copied to a read buffer behind a fence, and the
+ *  copy is only read once a later frame sees the fence done.
+ ***********************************************************/
+void GPUCuller::ReadBackVisibility(GLsizeiptr commandBytes)
+{
+	if (NULL != m_readbackFence)
+	{
+		GLenum status = glClientWaitSync(m_readbackFence, 0, 0);
+		if ((status != GL_ALREADY_SIGNALED) && (status != GL_CONDITION_SATISFIED))
+		{
+			return;
+		}
+		glDeleteSync(m_readbackFence);
+		m_readbackFence = NULL;
+
+		std::vector<DRAW_COMMAND> commands(m_readbackSize / sizeof(DRAW_COMMAND));
+		glBindBuffer(GL_COPY_READ_BUFFER, m_readbackBuffer);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, m_readbackSize, commands.data());
+		for (const MESH_RECORD& mesh : m_meshes)
+		{
+			for (uint32_t level = 0; level < mesh.lodCount; level++)
+			{
+				uint32_t bucket = mesh.firstBucket + level;
+				if ((bucket < commands.size()) && (commands[bucket].instanceCount > 0) && (mesh.textureSlot < 32))
+				{
+					m_visibleTextureMask |= 1u << mesh.textureSlot;
+				}
+			}
+		}
+	}
+
+	if (m_readbackBuffer == 0)
+	{
+		glGenBuffers(1, &m_readbackBuffer);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_readbackBuffer);
+	if (m_readbackSize != commandBytes)
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, commandBytes, NULL, GL_STREAM_READ);
+		m_readbackSize = commandBytes;
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, m_commandBuffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, commandBytes);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	m_readbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/***********************************************************
+ *  CullAndDraw()
+ *
+ *  This method is used for running the GPU culling passes
+ *  and drawing the compacted result. With occlusion culling
+ *  the first pass tests every instance against the pyramid
+ *  of the last captured depth, projected with the camera it
+ *  was captured from. What it draws is then captured as the
+ *  new pyramid, and the instances the first pass hid are
+ *  tested again against it and drawn if they show, so an
+ *  instance that just came into view never misses a frame.
+ *  The CPU cost is fixed - at most four dispatches and two
+ *  multi-draws - however many instances there are.
+ ***********************************************************/
+void GPUCuller::CullAndDraw(
+	const VIEW_INFO& viewInfo,
+	glm::vec3 lightDirection,
+	glm::vec3 lightColor,
+	glm::vec3 ambientColor)
+{
+	if (m_instances.empty() || (m_cullProgram == 0) || (NULL == m_pDrawShader))
+	{
+		return;
+	}
+	if (m_bGeometryDirty)
+	{
+		UploadGeometry();
+	}
+	if (m_bInstancesDirty)
+	{
+		UploadInstances();
+	}
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+	// frustum planes from the rows of the view-projection matrix
+	glm::mat4 viewProjection = viewInfo.projection * viewInfo.view;
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; r++)
+	{
+		rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+	}
+	glm::vec4 planes[6] = {
+		rows[3] + rows[0], rows[3] - rows[0],
+		rows[3] + rows[1], rows[3] - rows[1],
+		rows[3] + rows[2], rows[3] - rows[2] };
+	for (glm::vec4& plane : planes)
+	{
+		plane = plane / glm::length(glm::vec3(plane));
+	}
+
+	// the hidden groups can change from one view to the next
+	ResizeBuffer(m_hiddenGroupBuffer, m_hiddenGroups.size() * sizeof(uint32_t), NULL, GL_STREAM_DRAW);
+	if (!m_hiddenGroups.empty())
+	{
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_hiddenGroups.size() * sizeof(uint32_t), m_hiddenGroups.data());
+	}
+	GLuint zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_retestBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+
+	// pass 1 - every instance, against the last captured depth
+	bool bOcclusion = m_bOcclusionCulling && m_bDepthValid;
+	CullPass(viewInfo, viewProjection, planes, bOcclusion, false);
+	ReadBackVisibility((GLsizeiptr)(m_bucketTemplate.size() * sizeof(DRAW_COMMAND)));
+	DrawVisible(viewInfo, lightDirection, lightColor, ambientColor);
+
+	// pass 2 - what pass 1 drew is the new depth; the instances it hid
+	// behind the old depth are tested again behind the new one
+	if (m_bOcclusionCulling)
+	{
+		CaptureDepth((int)viewInfo.viewportWidth, (int)viewInfo.viewportHeight, viewProjection);
+		if (bOcclusion && m_bDepthValid)
+		{
+			CullPass(viewInfo, viewProjection, planes, true, true);
+			DrawVisible(viewInfo, lightDirection, lightColor, ambientColor);
+		}
+	}
+
+	glUseProgram(previousProgram);
+}
+
+/***********************************************************
+ *  CullPass()
+ *
+ *  This method is used for culling and selecting LODs on the
+ *  GPU and compacting the non-empty buckets into the
+ *  indirect buffer. A first pass tests every instance and
+ *  records the ones the depth hid; a retest pass tests only
+ *  those, against the depth captured from this camera.
+ ***********************************************************/
+void GPUCuller::CullPass(
+	const VIEW_INFO& viewInfo,
+	const glm::mat4& viewProjection,
+	const glm::vec4 planes[6],
+	bool bOcclusion,
+	bool bRetest)
+{
+	GLuint bucketCount = (GLuint)m_bucketTemplate.size();
+	GLsizeiptr commandBytes = bucketCount * sizeof(DRAW_COMMAND);
+
+	// reset the per-bucket instance counts and the draw count
+	glBindBuffer(GL_COPY_READ_BUFFER, m_commandTemplateBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_commandBuffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, commandBytes);
+	GLuint zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawCountBuffer);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, m_instanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_BINDING, m_meshBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, m_commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_BINDING, m_visibleBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMPACTED_BINDING, m_compactedBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_COUNT_BINDING, m_drawCountBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HIDDEN_GROUP_BINDING, m_hiddenGroupBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RETEST_BINDING, m_retestBuffer);
+
+	// cull and select LODs
+	glUseProgram(m_cullProgram);
+	glUniformMatrix4fv(glGetUniformLocation(m_cullProgram, "viewProjection"), 1, GL_FALSE, &viewProjection[0][0]);
+	glUniformMatrix4fv(glGetUniformLocation(m_cullProgram, "depthViewProjection"), 1, GL_FALSE, &m_depthViewProjection[0][0]);
+	glUniform4fv(glGetUniformLocation(m_cullProgram, "frustumPlanes"), 6, &planes[0].x);
+	glUniform3f(glGetUniformLocation(m_cullProgram, "cameraPosition"), viewInfo.position.x, viewInfo.position.y, viewInfo.position.z);
+	glUniform1f(glGetUniformLocation(m_cullProgram, "pixelsPerUnit"), viewInfo.viewportHeight / (2.0f * std::tan(viewInfo.fovY * 0.5f)));
+	glUniform1f(glGetUniformLocation(m_cullProgram, "pixelThreshold"), m_pixelThreshold);
+	glUniform1ui(glGetUniformLocation(m_cullProgram, "instanceCount"), (GLuint)m_instances.size());
+	glUniform1ui(glGetUniformLocation(m_cullProgram, "hiddenGroupCount"), (GLuint)(m_hiddenGroups.size() * 32));
+	glUniform1i(glGetUniformLocation(m_cullProgram, "bOcclusion"), bOcclusion ? 1 : 0);
+	glUniform1i(glGetUniformLocation(m_cullProgram, "bRetest"), bRetest ? 1 : 0);
+	glUniform1i(glGetUniformLocation(m_cullProgram, "depthPyramid"), PYRAMID_TEXTURE_UNIT);
+	glUniform2f(glGetUniformLocation(m_cullProgram, "pyramidSize"), (float)m_depthWidth, (float)m_depthHeight);
+	glActiveTexture(GL_TEXTURE0 + PYRAMID_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, m_depthPyramid);
+	glActiveTexture(GL_TEXTURE0);
+
+	glDispatchCompute(((GLuint)m_instances.size() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	// pack the non-empty buckets into the indirect buffer
+	glUseProgram(m_compactProgram);
+	glUniform1ui(glGetUniformLocation(m_compactProgram, "bucketCount"), bucketCount);
+	glDispatchCompute((bucketCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+/***********************************************************
+ *  DrawVisible()
+ *
+ *  This method is used for drawing what the last cull pass
+ *  left in the indirect buffer, in a single call covering
+ *  every mesh and LOD.
+ ***********************************************************/
+void GPUCuller::DrawVisible(
+	const VIEW_INFO& viewInfo,
+	glm::vec3 lightDirection,
+	glm::vec3 lightColor,
+	glm::vec3 ambientColor)
+{
+	m_pDrawShader->use();
+	m_pDrawShader->setMat4Value("view", viewInfo.view);
+	m_pDrawShader->setMat4Value("projection", viewInfo.projection);
+	m_pDrawShader->setVec3Value("lightDirection", lightDirection);
+	m_pDrawShader->setVec3Value("lightColor", lightColor);
+	m_pDrawShader->setVec3Value("ambientColor", ambientColor);
+	GLint samplerUnits[16];
+	for (int i = 0; i < 16; i++)
+	{
+		samplerUnits[i] = i;
+	}
+	glUniform1iv(glGetUniformLocation(m_pDrawShader->m_programID, "objectTextures"), 16, samplerUnits);
+
+	glBindVertexArray(m_vao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_compactedBuffer);
+	glBindBuffer(GL_PARAMETER_BUFFER, m_drawCountBuffer);
+	glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, 0, (GLsizei)m_bucketTemplate.size(), 0);
+	glBindBuffer(GL_PARAMETER_BUFFER, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+}
@@ -0,0 +1,198 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuculler.h
+// ============
+// GPU-driven instance culling, LOD selection and indirect draw compaction
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "ViewManager.h"
+#include "MeshSimplifier.h"
+#include "SceneSnapshot.h"
+#include "RayQuery.h"
+
+#include <vector>
+
+/***********************************************************
+ *  GPUCuller
+ *
+ *  This class keeps every instance (transform, bounds and
+ *  mesh) in a shader storage buffer. Each frame a compute
+ *  pass performs frustum, occlusion and LOD selection on the
+ *  GPU, appends the survivors to per mesh/LOD lists, and a
+ *  second pass compacts the non-empty draws, so the CPU only
+ *  issues one glMultiDrawElementsIndirectCount call - and,
+ *  with occlusion culling, one more for the instances the
+ *  depth just drawn shows the old depth hid wrongly.
+ ***********************************************************/
+class GPUCuller
+{
+public:
+	// constructor
+	GPUCuller();
+	// destructor
+	~GPUCuller();
+
+	// most LOD levels a mesh can use on the GPU path
+	static const int MAX_GPU_LODS = 8;
+
+	// instances placed together, such as the parts of one prefab
+	// instance, that can be hidden from the cull pass as a whole
+	struct INSTANCE_GROUP
+	{
+		// world transform the group was placed with
+		glm::mat4 transform;
+		// sphere enclosing the bounding spheres of its instances
+		glm::vec4 boundingSphere;
+		// largest world space error of its instances' coarsest LODs
+		float coarsestError;
+	};
+
+	// load the compute and draw shaders, taking the compute programs
+	// from the snapshot's binaries when it has ones the driver accepts
+	bool Initialize(const SceneSnapshot* pSnapshot = NULL);
+
+	// add the meshes, instances and compute program binaries to a snapshot
+	void SaveSnapshot(SceneSnapshot& snapshot) const;
+	// replace the meshes and instances with those of a snapshot
+	bool RestoreSnapshot(const SceneSnapshot& snapshot);
+
+	// add a mesh LOD chain, drawn with the texture bound to textureSlot
+	int AddMesh(const std::vector<MESH_LOD>& chain, int textureSlot);
+	// add a group placed with the given transform; returns the group index
+	int AddGroup(const glm::mat4& transform);
+	// replace the transform a group was placed with
+	void SetGroupTransform(int groupIndex, const glm::mat4& transform);
+	// add an instance of a mesh, in a group or in none; returns the instance index
+	int AddInstance(int meshIndex, const glm::mat4& model, int groupIndex = -1);
+	// replace the transform of an existing instance
+	void SetInstanceTransform(int instanceIndex, const glm::mat4& model);
+	// remove all the instances and groups, keeping the meshes
+	void ClearInstances();
+	// the groups with their bounds, refreshed after instances change
+	const std::vector<INSTANCE_GROUP>& GetGroups();
+	// groups the next cull passes skip, one bit per group
+	void SetHiddenGroups(const std::vector<uint32_t>& hiddenGroups);
+	// add the full detail level of each mesh and every instance to a ray
+	// query, and build it; its instance indices are the culler's
+	void BuildRayQuery(RayQuery& rayQuery) const;
+
+	// cull on the GPU and draw everything visible; with occlusion culling
+	// the depth it leaves is captured as the occluders for the next call
+	void CullAndDraw(
+		const VIEW_INFO& viewInfo,
+		glm::vec3 lightDirection,
+		glm::vec3 lightColor,
+		glm::vec3 ambientColor);
+
+	int GetInstanceCount() const { return (int)m_instances.size(); }
+	// texture slots of meshes that had visible instances, one bit per
+	// slot, read back from the GPU a frame or more behind
+	uint32_t GetVisibleTextureMask() const { return m_visibleTextureMask; }
+
+	// largest allowed projected LOD error in pixels
+	float m_pixelThreshold;
+	// test instances against the depth of the last call, then retest
+	// those it hid against the depth of this one
+	bool m_bOcclusionCulling;
+
+private:
+	// std430 layouts shared with the compute and vertex shaders
+	struct INSTANCE_RECORD
+	{
+		glm::mat4 model;
+		glm::vec4 boundingSphere;
+		uint32_t meshIndex;
+		float scale;
+		uint32_t group;
+		uint32_t pad;
+	};
+	struct MESH_RECORD
+	{
+		uint32_t firstBucket;
+		uint32_t lodCount;
+		uint32_t textureSlot;
+		uint32_t pad;
+		float lodErrors[MAX_GPU_LODS];
+	};
+	struct DRAW_COMMAND
+	{
+		uint32_t count;
+		uint32_t instanceCount;
+		uint32_t firstIndex;
+		int32_t baseVertex;
+		uint32_t baseInstance;
+	};
+
+	ShaderManager* m_pDrawShader;
+	GLuint m_cullProgram;
+	GLuint m_compactProgram;
+	GLuint m_pyramidProgram;
+
+	// shared geometry of every mesh and LOD
+	std::vector<MESH_VERTEX> m_vertices;
+	std::vector<uint32_t> m_indices;
+	GLuint m_vao;
+	GLuint m_vbo;
+	GLuint m_ebo;
+
+	std::vector<MESH_RECORD> m_meshes;
+	std::vector<glm::vec4> m_meshBounds;
+	std::vector<DRAW_COMMAND> m_bucketTemplate;
+	std::vector<INSTANCE_RECORD> m_instances;
+	std::vector<INSTANCE_GROUP> m_groups;
+	std::vector<uint32_t> m_hiddenGroups;
+
+	GLuint m_instanceBuffer;
+	GLuint m_meshBuffer;
+	GLuint m_commandBuffer;
+	GLuint m_commandTemplateBuffer;
+	GLuint m_visibleBuffer;
+	GLuint m_compactedBuffer;
+	GLuint m_drawCountBuffer;
+	GLuint m_hiddenGroupBuffer;
+	GLuint m_retestBuffer;
+
+	// captured depth and its farthest-depth pyramid
+	GLuint m_depthFramebuffer;
+	GLuint m_depthTexture;
+	GLuint m_depthPyramid;
+	int m_depthWidth;
+	int m_depthHeight;
+	int m_pyramidLevels;
+	// the camera the captured depth was drawn from
+	glm::mat4 m_depthViewProjection;
+	bool m_bDepthValid;
+
+	bool m_bGeometryDirty;
+	bool m_bInstancesDirty;
+	bool m_bGroupsDirty;
+
+	// asynchronous copy of the per-bucket counts, for texture streaming
+	GLuint m_readbackBuffer;
+	GLsizeiptr m_readbackSize;
+	GLsync m_readbackFence;
+	uint32_t m_visibleTextureMask;
+
+	void ReadBackVisibility(GLsizeiptr commandBytes);
+
+	void UploadGeometry();
+	void UploadInstances();
+	void CaptureDepth(int width, int height, const glm::mat4& viewProjection);
+	void BuildDepthPyramid();
+	void CullPass(
+		const VIEW_INFO& viewInfo,
+		const glm::mat4& viewProjection,
+		const glm::vec4 planes[6],
+		bool bOcclusion,
+		bool bRetest);
+	void DrawVisible(
+		const VIEW_INFO& viewInfo,
+		glm::vec3 lightDirection,
+		glm::vec3 lightColor,
+		glm::vec3 ambientColor);
+	void UpdateGroupBounds();
+	INSTANCE_RECORD MakeInstance(int meshIndex, const glm::mat4& model, uint32_t group) const;
+};
@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+// imagedecoder.cpp
+// ============
+// interface for the image file decoders used by the asset loader
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ImageDecoder.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+
+/***********************************************************
+ *  CanDecode()
+ *
+ *  This method is used for checking stb_image recognises the
+ *  file, from its header alone.
+ ***********************************************************/
+bool StbImageDecoder::CanDecode(const unsigned char* bytes, size_t size) const
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	return stbi_info_from_memory(bytes, (int)size, &width, &height, &channels) != 0;
+}
+
+/***********************************************************
+ *  Decode()
+ *
+ *  This method is used for decoding with stb_image. The flip
+ *  setting is per thread, so decodes running on other threads
+ *  cannot change it part way through. stb_image can only
+ *  decode at full size, so a reduced image is averaged down
+ *  from it afterwards, each pixel from its scale by scale
+ *  block, the blocks on the right and top edges from the
+ *  pixels they have.
+ ***********************************************************/
+bool StbImageDecoder::Decode(const unsigned char* bytes, size_t size, int scale, IMAGE_DATA& image)
+{
+	stbi_set_flip_vertically_on_load_thread(1);
+	unsigned char* pixels = stbi_load_from_memory(
+		bytes,
+		(int)size,
+		&image.width,
+		&image.height,
+		&image.channels,
+		0);
+	if (NULL == pixels)
+	{
+		image = IMAGE_DATA();
+		return false;
+	}
+
+	if (scale <= 1)
+	{
+		image.pixels = std::shared_ptr<unsigned char>(pixels, stbi_image_free);
+		return true;
+	}
+
+	int width = (image.width + scale - 1) / scale;
+	int height = (image.height + scale - 1) / scale;
+	int channels = image.channels;
+	unsigned char* reduced = new unsigned char[(size_t)width * height * channels];
+	for (int y = 0; y < height; y++)
+	{
+		int y0 = y * scale;
+		int y1 = std::min(y0 + scale, image.height);
+		for (int x = 0; x < width; x++)
+		{
+			int x0 = x * scale;
+			int x1 = std::min(x0 + scale, image.width);
+			int count = (y1 - y0) * (x1 - x0);
+			for (int c = 0; c < channels; c++)
+			{
+				int sum = 0;
+				for (int sy = y0; sy < y1; sy++)
+				{
+					const unsigned char* row = pixels + ((size_t)sy * image.width + x0) * channels + c;
+					for (int sx = x0; sx < x1; sx++, row += channels)
+					{
+						sum += *row;
+					}
+				}
+				reduced[((size_t)y * width + x) * channels + c] = (unsigned char)((sum + count / 2) / count);
+			}
+		}
+	}
+	stbi_image_free(pixels);
+
+	image.width = width;
+	image.height = height;
+	image.pixels = std::shared_ptr<unsigned char>(reduced, std::default_delete<unsigned char[]>());
+	return true;
+}
@@ -0,0 +1,72 @@
+///////////////////////////////////////////////////////////////////////////////
+// imagedecoder.h
+// ============
+// interface for the image file decoders used by the asset loader
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MipGenerator.h"
+#include "TextureCompressor.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/***********************************************************
+ *  IMAGE_DATA
+ *
+ *  A decoded image in CPU memory, bottom row first, freed
+ *  when the last copy is released, with its mip chain once
+ *  that has been built, and its block compressed levels when
+ *  the loader compresses textures.
+ ***********************************************************/
+struct IMAGE_DATA
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	std::shared_ptr<unsigned char> pixels;
+	std::shared_ptr<const std::vector<MIP_LEVEL>> mipLevels;
+	std::shared_ptr<const COMPRESSED_TEXTURE> compressed;
+};
+
+/***********************************************************
+ *  ImageDecoder
+ *
+ *  The interface an image format decoder implements to be
+ *  used by the asset loader. Decoders are tried in order and
+ *  the first that recognises the file decodes it. They are
+ *  called from several worker threads at once, so Decode()
+ *  must not keep state between calls.
+ ***********************************************************/
+class ImageDecoder
+{
+public:
+	virtual ~ImageDecoder() {}
+
+	// short name, for logs and benchmarks
+	virtual const char* GetName() const = 0;
+	// true when the file header is one this decoder handles
+	virtual bool CanDecode(const unsigned char* bytes, size_t size) const = 0;
+	// decode with the bottom row first, reduced by scale (1, 2, 4 or 8)
+	// in each direction, rounding the size up
+	virtual bool Decode(const unsigned char* bytes, size_t size, int scale, IMAGE_DATA& image) = 0;
+};
+
+/***********************************************************
+ *  StbImageDecoder
+ *
+ *  Every format stb_image reads. It decodes at full size and
+ *  averages that down for a reduced scale, so a preview
+ *  costs it more than the full image. It is the fallback
+ *  after the specialised decoders.
+ ***********************************************************/
+class StbImageDecoder : public ImageDecoder
+{
+public:
+	const char* GetName() const override { return "stb_image"; }
+	bool CanDecode(const unsigned char* bytes, size_t size) const override;
+	bool Decode(const unsigned char* bytes, size_t size, int scale, IMAGE_DATA& image) override;
+};
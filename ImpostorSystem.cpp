@@ -0,0 +1,468 @@
+///////////////////////////////////////////////////////////////////////////////
+// impostorsystem.cpp
+// ============
+// octahedral impostor baking and instanced rendering for distant props
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ImpostorSystem.h"
+
+#include <glm/gtx/transform.hpp>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+	// attribute locations used for the per-instance data
+	const GLuint INSTANCE_ATTRIBUTE = 3;
+	const GLuint YAW_ATTRIBUTE = 4;
+
+	/***********************************************************
+	 *  OctDecode()
+	 *
+	 *  Map a point of the [-1,1] square onto the unit sphere,
+	 *  the upper hemisphere in the center diamond and the lower
+	 *  hemisphere folded into the corners. The impostor vertex
+	 *  shader performs the inverse mapping.
+	 ***********************************************************/
+	glm::vec3 OctDecode(glm::vec2 p)
+	{
+		glm::vec3 n(p.x, 1.0f - std::fabs(p.x) - std::fabs(p.y), p.y);
+		if (n.y < 0.0f)
+		{
+			float x = (1.0f - std::fabs(n.z)) * ((n.x >= 0.0f) ? 1.0f : -1.0f);
+			float z = (1.0f - std::fabs(n.x)) * ((n.z >= 0.0f) ? 1.0f : -1.0f);
+			n.x = x;
+			n.z = z;
+		}
+		return glm::normalize(n);
+	}
+
+	GLuint CreateAtlasTexture(GLenum internalFormat, GLenum format, GLenum type, int size)
+	{
+		GLuint texture = 0;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size, size, 0, format, type, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return texture;
+	}
+}
+
+/***********************************************************
+ *  ImpostorSystem()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ImpostorSystem::ImpostorSystem()
+{
+	m_pBakeShader = NULL;
+	m_pImpostorShader = NULL;
+	m_quadVAO = 0;
+	m_quadVBO = 0;
+	m_instanceVBO = 0;
+}
+
+/***********************************************************
+ *  ~ImpostorSystem()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ImpostorSystem::~ImpostorSystem()
+{
+	DestroyImpostors();
+
+	if (m_instanceVBO != 0)
+	{
+		glDeleteBuffers(1, &m_instanceVBO);
+	}
+	if (m_quadVBO != 0)
+	{
+		glDeleteBuffers(1, &m_quadVBO);
+	}
+	if (m_quadVAO != 0)
+	{
+		glDeleteVertexArrays(1, &m_quadVAO);
+	}
+
+	delete m_pBakeShader;
+	m_pBakeShader = NULL;
+	delete m_pImpostorShader;
+	m_pImpostorShader = NULL;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for loading the bake and draw shaders
+ *  and creating the quad that every impostor instance uses.
+ ***********************************************************/
+bool ImpostorSystem::Initialize()
+{
+	m_pBakeShader = new ShaderManager();
+	m_pBakeShader->LoadShaders(
+		"shaders/impostorBakeVertexShader.glsl",
+		"shaders/impostorBakeFragmentShader.glsl");
+
+	m_pImpostorShader = new ShaderManager();
+	m_pImpostorShader->LoadShaders(
+		"shaders/impostorVertexShader.glsl",
+		"shaders/impostorFragmentShader.glsl");
+
+	// the four corners of the camera facing quad
+	const float corners[8] = {
+		-1.0f, -1.0f,
+		 1.0f, -1.0f,
+		-1.0f,  1.0f,
+		 1.0f,  1.0f };
+
+	glGenVertexArrays(1, &m_quadVAO);
+	glBindVertexArray(m_quadVAO);
+
+	glGenBuffers(1, &m_quadVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_quadVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+
+	glGenBuffers(1, &m_instanceVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, 0, NULL, GL_STREAM_DRAW);
+	glEnableVertexAttribArray(INSTANCE_ATTRIBUTE);
+	glVertexAttribPointer(INSTANCE_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(IMPOSTOR_INSTANCE),
+		(void*)offsetof(IMPOSTOR_INSTANCE, placement));
+	glVertexAttribDivisor(INSTANCE_ATTRIBUTE, 1);
+	glEnableVertexAttribArray(YAW_ATTRIBUTE);
+	glVertexAttribPointer(YAW_ATTRIBUTE, 1, GL_FLOAT, GL_FALSE, sizeof(IMPOSTOR_INSTANCE),
+		(void*)offsetof(IMPOSTOR_INSTANCE, yaw));
+	glVertexAttribDivisor(YAW_ATTRIBUTE, 1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return true;
+}
+
+/***********************************************************
+ *  BakeImpostor()
+ *
+ *  This method is used for rendering the prop from one view
+ *  direction per atlas frame. Frame (x, y) looks at the prop
+ *  from the octahedral direction at the frame center, with
+ *  an orthographic camera that just encloses the bounds.
+ *  The blend and depth test state it changes is put back.
+ ***********************************************************/
+bool ImpostorSystem::BakeImpostor(
+	std::string tag,
+	DRAW_CALLBACK drawProp,
+	glm::vec3 boundsCenter,
+	float boundsRadius,
+	GLuint albedoTexture,
+	int framesPerSide,
+	int frameSize)
+{
+	if ((NULL == m_pBakeShader) || (boundsRadius <= 0.0f))
+	{
+		return false;
+	}
+
+	IMPOSTOR_INFO impostor;
+	impostor.tag = tag;
+	impostor.framesPerSide = framesPerSide;
+	impostor.frameSize = frameSize;
+	impostor.boundsCenter = boundsCenter;
+	impostor.boundsRadius = boundsRadius;
+
+	int atlasSize = framesPerSide * frameSize;
+	impostor.albedoAtlas = CreateAtlasTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, atlasSize);
+	impostor.normalAtlas = CreateAtlasTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, atlasSize);
+	impostor.depthAtlas = CreateAtlasTexture(GL_R16F, GL_RED, GL_FLOAT, atlasSize);
+
+	GLuint depthBuffer = 0;
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, atlasSize, atlasSize);
+
+	// remember the state the main renderer relies on
+	GLint previousFramebuffer = 0;
+	GLint previousProgram = 0;
+	GLint previousViewport[4];
+	GLboolean bBlend = glIsEnabled(GL_BLEND);
+	GLboolean bDepthTest = glIsEnabled(GL_DEPTH_TEST);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+	GLuint framebuffer = 0;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, impostor.albedoAtlas, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, impostor.normalAtlas, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, impostor.depthAtlas, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+	const GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	glDrawBuffers(3, drawBuffers);
+
+	bool bComplete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	if (bComplete)
+	{
+		glViewport(0, 0, atlasSize, atlasSize);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClearDepth(1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glDisable(GL_BLEND);
+		glEnable(GL_DEPTH_TEST);
+
+		m_pBakeShader->use();
+		m_pBakeShader->setMat4Value("model", glm::mat4(1.0f));
+		m_pBakeShader->setFloatValue("centerDepth", 2.0f * boundsRadius);
+		m_pBakeShader->setFloatValue("boundsRadius", boundsRadius);
+		m_pBakeShader->setVec2Value("UVscale", glm::vec2(1.0f, 1.0f));
+		m_pBakeShader->setVec4Value("objectColor", glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
+		m_pBakeShader->setIntValue("bUseTexture", (albedoTexture != 0) ? 1 : 0);
+		m_pBakeShader->setSampler2DValue("objectTexture", 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, albedoTexture);
+
+		glm::mat4 projection = glm::ortho(
+			-boundsRadius, boundsRadius,
+			-boundsRadius, boundsRadius,
+			boundsRadius, 3.0f * boundsRadius);
+		m_pBakeShader->setMat4Value("projection", projection);
+
+		for (int y = 0; y < framesPerSide; y++)
+		{
+			for (int x = 0; x < framesPerSide; x++)
+			{
+				glm::vec2 grid(
+					((x + 0.5f) / framesPerSide) * 2.0f - 1.0f,
+					((y + 0.5f) / framesPerSide) * 2.0f - 1.0f);
+				glm::vec3 direction = OctDecode(grid);
+				glm::vec3 worldUp = (std::fabs(direction.y) > 0.99f) ?
+					glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+				glm::mat4 view = glm::lookAt(
+					boundsCenter + direction * (2.0f * boundsRadius),
+					boundsCenter,
+					worldUp);
+
+				glViewport(x * frameSize, y * frameSize, frameSize, frameSize);
+				m_pBakeShader->setMat4Value("view", view);
+				drawProp(m_pBakeShader);
+			}
+		}
+
+		glBindTexture(GL_TEXTURE_2D, impostor.albedoAtlas);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, impostor.normalAtlas);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	else
+	{
+		std::cout << "[ImpostorSystem] ERROR: Bake framebuffer incomplete for '" << tag << "'" << std::endl;
+	}
+
+	// restore the main renderer state
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+	glUseProgram(previousProgram);
+	if (bBlend)
+	{
+		glEnable(GL_BLEND);
+	}
+	if (!bDepthTest)
+	{
+		glDisable(GL_DEPTH_TEST);
+	}
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &depthBuffer);
+
+	if (!bComplete)
+	{
+		glDeleteTextures(1, &impostor.albedoAtlas);
+		glDeleteTextures(1, &impostor.normalAtlas);
+		glDeleteTextures(1, &impostor.depthAtlas);
+		return false;
+	}
+
+	std::cout << "[ImpostorSystem] Baked impostor: " << tag
+		<< ", frames: " << framesPerSide << "x" << framesPerSide
+		<< ", atlas: " << atlasSize << "x" << atlasSize
+		<< std::endl;
+
+	m_impostors.push_back(impostor);
+	return true;
+}
+
+/***********************************************************
+ *  ShouldUseImpostor()
+ *
+ *  This method is used for deciding when an instance covers
+ *  fewer pixels than one atlas frame, at which point the
+ *  impostor is indistinguishable from the full mesh.
+ ***********************************************************/
+bool ImpostorSystem::ShouldUseImpostor(
+	std::string tag,
+	float distance,
+	float scale,
+	const VIEW_INFO& viewInfo) const
+{
+	const IMPOSTOR_INFO* impostor = FindImpostor(tag);
+	if ((NULL == impostor) || (distance <= 0.0f))
+	{
+		return false;
+	}
+
+	float pixelsPerUnit = viewInfo.viewportHeight / (2.0f * std::tan(viewInfo.fovY * 0.5f));
+	float screenDiameter = 2.0f * impostor->boundsRadius * scale * pixelsPerUnit / distance;
+	return (screenDiameter < (float)impostor->frameSize);
+}
+
+/***********************************************************
+ *  AddInstance()
+ *
+ *  This method is used for queuing one distant instance.
+ ***********************************************************/
+bool ImpostorSystem::AddInstance(std::string tag, glm::vec3 position, float scale, float yaw)
+{
+	IMPOSTOR_INFO* impostor = FindImpostor(tag);
+	if (NULL == impostor)
+	{
+		return false;
+	}
+
+	IMPOSTOR_INSTANCE instance;
+	instance.placement = glm::vec4(position, scale);
+	instance.yaw = yaw;
+	impostor->instances.push_back(instance);
+	return true;
+}
+
+/***********************************************************
+ *  ClearInstances()
+ *
+ *  This method is used for emptying the per-frame queues.
+ ***********************************************************/
+void ImpostorSystem::ClearInstances()
+{
+	for (IMPOSTOR_INFO& impostor : m_impostors)
+	{
+		impostor.instances.clear();
+	}
+}
+
+/***********************************************************
+ *  Render()
+ *
+ *  This method is used for drawing all queued instances of
+ *  each baked prop with a single instanced draw call.
+ ***********************************************************/
+void ImpostorSystem::Render(
+	const VIEW_INFO& viewInfo,
+	glm::vec3 lightDirection,
+	glm::vec3 lightColor,
+	glm::vec3 ambientColor)
+{
+	if (NULL == m_pImpostorShader)
+	{
+		return;
+	}
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+	m_pImpostorShader->use();
+	m_pImpostorShader->setMat4Value("view", viewInfo.view);
+	m_pImpostorShader->setMat4Value("projection", viewInfo.projection);
+	m_pImpostorShader->setVec3Value("viewPosition", viewInfo.position);
+	m_pImpostorShader->setVec3Value("lightDirection", lightDirection);
+	m_pImpostorShader->setVec3Value("lightColor", lightColor);
+	m_pImpostorShader->setVec3Value("ambientColor", ambientColor);
+	m_pImpostorShader->setSampler2DValue("albedoAtlas", 0);
+	m_pImpostorShader->setSampler2DValue("normalAtlas", 1);
+	m_pImpostorShader->setSampler2DValue("depthAtlas", 2);
+
+	glBindVertexArray(m_quadVAO);
+	for (const IMPOSTOR_INFO& impostor : m_impostors)
+	{
+		if (impostor.instances.empty())
+		{
+			continue;
+		}
+
+		m_pImpostorShader->setVec3Value("boundsCenter", impostor.boundsCenter);
+		m_pImpostorShader->setFloatValue("boundsRadius", impostor.boundsRadius);
+		m_pImpostorShader->setIntValue("framesPerSide", impostor.framesPerSide);
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, impostor.albedoAtlas);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, impostor.normalAtlas);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, impostor.depthAtlas);
+
+		// orphan the buffer so the upload never waits on earlier draws
+		glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, impostor.instances.size() * sizeof(IMPOSTOR_INSTANCE), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, impostor.instances.size() * sizeof(IMPOSTOR_INSTANCE), impostor.instances.data());
+
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)impostor.instances.size());
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	glUseProgram(previousProgram);
+}
+
+/***********************************************************
+ *  FindImpostor()
+ *
+ *  This method is used for finding a baked prop by tag.
+ ***********************************************************/
+ImpostorSystem::IMPOSTOR_INFO* ImpostorSystem::FindImpostor(std::string tag)
+{
+	for (IMPOSTOR_INFO& impostor : m_impostors)
+	{
+		if (impostor.tag.compare(tag) == 0)
+		{
+			return &impostor;
+		}
+	}
+	return NULL;
+}
+
+const ImpostorSystem::IMPOSTOR_INFO* ImpostorSystem::FindImpostor(std::string tag) const
+{
+	for (const IMPOSTOR_INFO& impostor : m_impostors)
+	{
+		if (impostor.tag.compare(tag) == 0)
+		{
+			return &impostor;
+		}
+	}
+	return NULL;
+}
+
+/***********************************************************
+ *  DestroyImpostors()
+ *
+ *  This method is used for freeing all the baked atlases.
+ ***********************************************************/
+void ImpostorSystem::DestroyImpostors()
+{
+	for (IMPOSTOR_INFO& impostor : m_impostors)
+	{
+		glDeleteTextures(1, &impostor.albedoAtlas);
+		glDeleteTextures(1, &impostor.normalAtlas);
+		glDeleteTextures(1, &impostor.depthAtlas);
+	}
+	m_impostors.clear();
+}
@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////
+// impostorsystem.h
+// ============
+// octahedral impostor baking and instanced rendering for distant props
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "ViewManager.h"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  ImpostorSystem
+ *
+ *  This class bakes a prop into octahedral atlases of albedo,
+ *  normal and depth seen from many directions, then draws
+ *  far away instances of the prop as camera facing quads -
+ *  four vertices each, all instances in a single draw.
+ ***********************************************************/
+class ImpostorSystem
+{
+public:
+	// constructor
+	ImpostorSystem();
+	// destructor
+	~ImpostorSystem();
+
+	// one queued instance - xyz position, w uniform scale, and the
+	// turn about the vertical, in radians, it was placed with
+	struct IMPOSTOR_INSTANCE
+	{
+		glm::vec4 placement;
+		float yaw;
+	};
+
+	struct IMPOSTOR_INFO
+	{
+		std::string tag;
+		GLuint albedoAtlas;
+		GLuint normalAtlas;
+		GLuint depthAtlas;
+		int framesPerSide;
+		int frameSize;
+		glm::vec3 boundsCenter;
+		float boundsRadius;
+		// instances queued for the current view
+		std::vector<IMPOSTOR_INSTANCE> instances;
+	};
+
+	// callback that issues the draw calls for the prop being baked; a prop
+	// of several parts sets each part's model matrix and texture on the
+	// bake shader it is given
+	typedef std::function<void(ShaderManager* pBakeShader)> DRAW_CALLBACK;
+
+	// load the shaders and create the shared quad
+	bool Initialize();
+
+	// bake a prop into a new set of atlases associated with the tag
+	bool BakeImpostor(
+		std::string tag,
+		DRAW_CALLBACK drawProp,
+		glm::vec3 boundsCenter,
+		float boundsRadius,
+		GLuint albedoTexture,
+		int framesPerSide = 8,
+		int frameSize = 128);
+
+	// true when an instance is small enough on screen to use its impostor
+	bool ShouldUseImpostor(
+		std::string tag,
+		float distance,
+		float scale,
+		const VIEW_INFO& viewInfo) const;
+
+	// queue an instance of a baked prop for this view; false when the
+	// prop has no impostor
+	bool AddInstance(std::string tag, glm::vec3 position, float scale, float yaw = 0.0f);
+	// forget all the queued instances
+	void ClearInstances();
+
+	// draw every queued instance, one instanced draw per prop
+	void Render(
+		const VIEW_INFO& viewInfo,
+		glm::vec3 lightDirection,
+		glm::vec3 lightColor,
+		glm::vec3 ambientColor);
+
+private:
+	// shader that writes the atlases
+	ShaderManager* m_pBakeShader;
+	// shader that draws the instanced quads
+	ShaderManager* m_pImpostorShader;
+	// quad corners and per-instance data
+	GLuint m_quadVAO;
+	GLuint m_quadVBO;
+	GLuint m_instanceVBO;
+	// baked props
+	std::vector<IMPOSTOR_INFO> m_impostors;
+
+	IMPOSTOR_INFO* FindImpostor(std::string tag);
+	const IMPOSTOR_INFO* FindImpostor(std::string tag) const;
+	void DestroyImpostors();
+};
@@ -0,0 +1,1195 @@
+///////////////////////////////////////////////////////////////////////////////
+// jpegdecoder.cpp
+// ============
+// baseline JPEG decoder with SSE2 transforms and reduced size decoding
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "JpegDecoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define JPEG_USE_SSE2 1
+#endif
+
+namespace
+{
+	// position in the 8x8 block of each coefficient, in file order
+	const unsigned char ZIGZAG[64] = {
+		 0,  1,  8, 16,  9,  2,  3, 10,
+		17, 24, 32, 25, 18, 11,  4,  5,
+		12, 19, 26, 33, 40, 48, 41, 34,
+		27, 20, 13,  6,  7, 14, 21, 28,
+		35, 42, 49, 56, 57, 50, 43, 36,
+		29, 22, 15, 23, 30, 37, 44, 51,
+		58, 59, 52, 45, 38, 31, 39, 46,
+		53, 60, 61, 54, 47, 55, 62, 63 };
+
+	// Huffman codes up to this length are decoded with one lookup
+	const int FAST_BITS = 9;
+
+	/***********************************************************
+	 *  HUFFMAN_TABLE
+	 ***********************************************************/
+	struct HUFFMAN_TABLE
+	{
+		bool bDefined = false;
+		// symbol and code length for every FAST_BITS prefix, 0 if longer
+		uint16_t fast[1 << FAST_BITS];
+		// for AC codes whose magnitude bits also fit in the prefix, the
+		// value * 256 + run * 16 + total bits, 0 otherwise
+		int16_t fastAC[1 << FAST_BITS];
+		// canonical decoding of the longer codes
+		int maxCode[18];
+		int valueOffset[17];
+		unsigned char symbols[256];
+
+		bool Build(const unsigned char counts[16], const unsigned char* values, int valueCount)
+		{
+			std::memset(fast, 0, sizeof(fast));
+			std::memcpy(symbols, values, valueCount);
+
+			int code = 0;
+			int k = 0;
+			for (int length = 1; length <= 16; length++)
+			{
+				valueOffset[length] = k - code;
+				for (int i = 0; i < counts[length - 1]; i++, k++, code++)
+				{
+					// more codes than this length has room for
+					if (code >= (1 << length))
+					{
+						return false;
+					}
+					if (length <= FAST_BITS)
+					{
+						int first = code << (FAST_BITS - length);
+						int count = 1 << (FAST_BITS - length);
+						for (int j = 0; j < count; j++)
+						{
+							fast[first + j] = (uint16_t)(symbols[k] | (length << 8));
+						}
+					}
+				}
+				// largest code of this length, shifted to 16 bits
+				maxCode[length] = code << (16 - length);
+				code <<= 1;
+			}
+			maxCode[17] = 0x7FFFFFFF;
+
+			for (int i = 0; i < (1 << FAST_BITS); i++)
+			{
+				fastAC[i] = 0;
+				int length = fast[i] >> 8;
+				int run = (fast[i] >> 4) & 15;
+				int size = fast[i] & 15;
+				if ((fast[i] == 0) || (size == 0) || (length + size > FAST_BITS))
+				{
+					continue;
+				}
+				int bits = (i >> (FAST_BITS - length - size)) & ((1 << size) - 1);
+				int value = (bits < (1 << (size - 1))) ? bits - (1 << size) + 1 : bits;
+				if ((value >= -128) && (value <= 127))
+				{
+					fastAC[i] = (int16_t)(value * 256 + run * 16 + length + size);
+				}
+			}
+			bDefined = true;
+			return true;
+		}
+	};
+
+	/***********************************************************
+	 *  BIT_READER
+	 *
+	 *  Reads the entropy coded data, removing the stuffed zero
+	 *  after each 0xFF. At a marker it stops and feeds zeros.
+	 ***********************************************************/
+	struct BIT_READER
+	{
+		const unsigned char* p;
+		const unsigned char* end;
+		uint64_t buffer;
+		int bitCount;
+		bool bMarker;
+
+		void Reset(const unsigned char* pStart, const unsigned char* pEnd)
+		{
+			p = pStart;
+			end = pEnd;
+			buffer = 0;
+			bitCount = 0;
+			bMarker = false;
+		}
+
+		// top up the buffer to at least 57 bits, so a code and its
+		// magnitude can be read without checking again
+		void Fill()
+		{
+			while (bitCount <= 56)
+			{
+				unsigned int byte = 0;
+				if (!bMarker && (p < end))
+				{
+					byte = *p;
+					if (byte == 0xFF)
+					{
+						unsigned int next = (p + 1 < end) ? p[1] : 0xD9;
+						if (next == 0x00)
+						{
+							p += 2;
+						}
+						else
+						{
+							bMarker = true;
+							byte = 0;
+						}
+					}
+					else
+					{
+						p++;
+					}
+				}
+				buffer |= (uint64_t)byte << (56 - bitCount);
+				bitCount += 8;
+			}
+		}
+
+		int GetBits(int count)
+		{
+			if (count == 0)
+			{
+				return 0;
+			}
+			if (bitCount < count)
+			{
+				Fill();
+			}
+			int value = (int)(buffer >> (64 - count));
+			buffer <<= count;
+			bitCount -= count;
+			return value;
+		}
+
+		// the next FAST_BITS bits, without using them
+		int Peek()
+		{
+			if (bitCount < 16)
+			{
+				Fill();
+			}
+			return (int)(buffer >> (64 - FAST_BITS));
+		}
+
+		void Skip(int count)
+		{
+			buffer <<= count;
+			bitCount -= count;
+		}
+
+		// read a count bit magnitude and sign extend it
+		int Receive(int count)
+		{
+			int value = GetBits(count);
+			return (value < (1 << (count - 1))) ? value - (1 << count) + 1 : value;
+		}
+
+		int Decode(const HUFFMAN_TABLE& table)
+		{
+			if (bitCount < 16)
+			{
+				Fill();
+			}
+			uint16_t entry = table.fast[buffer >> (64 - FAST_BITS)];
+			if (entry != 0)
+			{
+				int length = entry >> 8;
+				buffer <<= length;
+				bitCount -= length;
+				return entry & 0xFF;
+			}
+
+			int top = (int)(buffer >> 48);
+			int length = FAST_BITS + 1;
+			while ((length <= 16) && (top >= table.maxCode[length]))
+			{
+				length++;
+			}
+			if (length > 16)
+			{
+				return -1;
+			}
+			int code = (int)(buffer >> (64 - length));
+			buffer <<= length;
+			bitCount -= length;
+			int index = code + table.valueOffset[length];
+			return ((index >= 0) && (index < 256)) ? table.symbols[index] : -1;
+		}
+	};
+
+	/***********************************************************
+	 *  COMPONENT
+	 ***********************************************************/
+	struct COMPONENT
+	{
+		int id = 0;
+		int h = 1;
+		int v = 1;
+		int quantTable = 0;
+		int dcTable = 0;
+		int acTable = 0;
+		int dcPredictor = 0;
+		// blocks across and down, padded out to whole MCUs
+		int blocksX = 0;
+		int blocksY = 0;
+		// decoded samples across and down each block, and the plane
+		// they go in
+		int blockWidth = 8;
+		int blockHeight = 8;
+		int planeWidth = 0;
+		std::vector<unsigned char> plane;
+	};
+
+	/***********************************************************
+	 *  IDCT_TABLES
+	 *
+	 *  Basis for the inverse DCT at each output size. Output n
+	 *  of an N point transform uses the first N coefficients of
+	 *  the 8 point one, so a block reduces by 8/N in one step.
+	 ***********************************************************/
+	struct IDCT_TABLES
+	{
+		// basis[N][u][x] for N = 1, 2, 4, 8
+		alignas(16) float basis[9][8][8];
+
+		IDCT_TABLES()
+		{
+			const double pi = 3.14159265358979323846;
+			std::memset(basis, 0, sizeof(basis));
+			for (int n = 1; n <= 8; n *= 2)
+			{
+				for (int u = 0; u < n; u++)
+				{
+					double c = (u == 0) ? std::sqrt(0.5) : 1.0;
+					for (int x = 0; x < n; x++)
+					{
+						basis[n][u][x] = (float)(0.5 * c * std::cos((2 * x + 1) * u * pi / (2.0 * n)));
+					}
+				}
+			}
+		}
+	};
+
+	const IDCT_TABLES& IdctTables()
+	{
+		static const IDCT_TABLES tables;
+		return tables;
+	}
+
+	// AAN scale for each frequency, cos(k * pi / 16) * sqrt(2) but 1 for
+	// the DC term, folded into the dequantisation for full size blocks
+	const float AAN_SCALE[8] = {
+		1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+		1.0f, 0.785694958f, 0.541196100f, 0.275899379f };
+
+	inline float Add(float a, float b) { return a + b; }
+	inline float Sub(float a, float b) { return a - b; }
+	inline float Mul(float a, float b) { return a * b; }
+#if defined(JPEG_USE_SSE2)
+	inline __m128 Add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+	inline __m128 Sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+	inline __m128 Mul(__m128 a, float b) { return _mm_mul_ps(a, _mm_set1_ps(b)); }
+#endif
+
+	/***********************************************************
+	 *  InverseDCT8()
+	 *
+	 *  One 8 point AAN inverse DCT (the float one from libjpeg)
+	 *  on pre-scaled coefficients, in place. T is a float, or
+	 *  or four lines of a block at once.
+	 ***********************************************************/
+	template <typename T>
+	void InverseDCT8(T v[8])
+	{
+		// even part
+		T tmp10 = Add(v[0], v[4]);
+		T tmp11 = Sub(v[0], v[4]);
+		T tmp13 = Add(v[2], v[6]);
+		T tmp12 = Sub(Mul(Sub(v[2], v[6]), 1.414213562f), tmp13);
+		T tmp0 = Add(tmp10, tmp13);
+		T tmp3 = Sub(tmp10, tmp13);
+		T tmp1 = Add(tmp11, tmp12);
+		T tmp2 = Sub(tmp11, tmp12);
+
+		// odd part
+		T z13 = Add(v[5], v[3]);
+		T z10 = Sub(v[5], v[3]);
+		T z11 = Add(v[1], v[7]);
+		T z12 = Sub(v[1], v[7]);
+		T tmp7 = Add(z11, z13);
+		T tmp11Odd = Mul(Sub(z11, z13), 1.414213562f);
+		T z5 = Mul(Add(z10, z12), 1.847759065f);
+		T tmp10Odd = Sub(Mul(z12, 1.082392200f), z5);
+		T tmp12Odd = Add(Mul(z10, -2.613125930f), z5);
+		T tmp6 = Sub(tmp12Odd, tmp7);
+		T tmp5 = Sub(tmp11Odd, tmp6);
+		T tmp4 = Add(tmp10Odd, tmp5);
+
+		v[0] = Add(tmp0, tmp7);
+		v[7] = Sub(tmp0, tmp7);
+		v[1] = Add(tmp1, tmp6);
+		v[6] = Sub(tmp1, tmp6);
+		v[2] = Add(tmp2, tmp5);
+		v[5] = Sub(tmp2, tmp5);
+		v[4] = Add(tmp3, tmp4);
+		v[3] = Sub(tmp3, tmp4);
+	}
+
+	/***********************************************************
+	 *  InverseDCTFull()
+	 *
+	 *  Transform a full 8x8 block of coefficients, pre-scaled
+	 *  by AAN_SCALE, into samples: columns first, then rows.
+	 *  With SSE2 each pass works on four lines at once, with a
+	 *  transpose between.
+	 ***********************************************************/
+	void InverseDCTFull(const float coefficients[64], unsigned char* pOut, int stride)
+	{
+#if defined(JPEG_USE_SSE2)
+		// lines[half][row], the left and right four columns
+		__m128 lines[2][8];
+		for (int row = 0; row < 8; row++)
+		{
+			lines[0][row] = _mm_load_ps(coefficients + row * 8);
+			lines[1][row] = _mm_load_ps(coefficients + row * 8 + 4);
+		}
+
+		for (int pass = 0; pass < 2; pass++)
+		{
+			InverseDCT8(lines[0]);
+			InverseDCT8(lines[1]);
+
+			// transpose the four 4x4 quarters, swapping the off diagonal ones
+			_MM_TRANSPOSE4_PS(lines[0][0], lines[0][1], lines[0][2], lines[0][3]);
+			_MM_TRANSPOSE4_PS(lines[1][0], lines[1][1], lines[1][2], lines[1][3]);
+			_MM_TRANSPOSE4_PS(lines[0][4], lines[0][5], lines[0][6], lines[0][7]);
+			_MM_TRANSPOSE4_PS(lines[1][4], lines[1][5], lines[1][6], lines[1][7]);
+			for (int i = 0; i < 4; i++)
+			{
+				std::swap(lines[1][i], lines[0][i + 4]);
+			}
+		}
+
+		// descale, centre, round and saturate to bytes
+		const __m128 scale = _mm_set1_ps(0.125f);
+		const __m128 bias = _mm_set1_ps(128.0f);
+		for (int row = 0; row < 8; row++)
+		{
+			__m128i low = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(lines[0][row], scale), bias));
+			__m128i high = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(lines[1][row], scale), bias));
+			__m128i bytes = _mm_packus_epi16(_mm_packs_epi32(low, high), _mm_setzero_si128());
+			_mm_storel_epi64((__m128i*)(pOut + row * stride), bytes);
+		}
+#else
+		float work[64];
+		float line[8];
+		for (int column = 0; column < 8; column++)
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				line[i] = coefficients[i * 8 + column];
+			}
+			InverseDCT8(line);
+			for (int i = 0; i < 8; i++)
+			{
+				work[i * 8 + column] = line[i];
+			}
+		}
+		for (int row = 0; row < 8; row++)
+		{
+			InverseDCT8(work + row * 8);
+			for (int x = 0; x < 8; x++)
+			{
+				int value = (int)std::lround(work[row * 8 + x] * 0.125f + 128.0f);
+				pOut[row * stride + x] = (unsigned char)std::min(std::max(value, 0), 255);
+			}
+		}
+#endif
+	}
+
+	/***********************************************************
+	 *  InverseDCT()
+	 *
+	 *  Transform the top-left width x height coefficients of a
+	 *  block (natural order) into width x height samples.
+	 ***********************************************************/
+	void InverseDCT(const float coefficients[64], int width, int height, unsigned char* pOut, int stride)
+	{
+		if ((width == 1) && (height == 1))
+		{
+			int value = (int)std::lround(coefficients[0] / 8.0f + 128.0f);
+			pOut[0] = (unsigned char)std::min(std::max(value, 0), 255);
+			return;
+		}
+
+		const IDCT_TABLES& tables = IdctTables();
+		const float (*rowBasis)[8] = tables.basis[width];
+		const float (*columnBasis)[8] = tables.basis[height];
+		alignas(16) float rows[8][8];
+
+#if defined(JPEG_USE_SSE2)
+		if (width >= 4)
+		{
+			const int lanes = width / 4;
+			// rows: rows[v][x] = sum over u of F[v][u] * basis[u][x];
+			// most high frequency rows are all zero and are skipped
+			int usedRows[8];
+			int usedCount = 0;
+			for (int v = 0; v < height; v++)
+			{
+				__m128 sum[2] = { _mm_setzero_ps(), _mm_setzero_ps() };
+				bool bUsed = false;
+				for (int u = 0; u < width; u++)
+				{
+					float f = coefficients[v * 8 + u];
+					if (f == 0.0f)
+					{
+						continue;
+					}
+					bUsed = true;
+					__m128 weight = _mm_set1_ps(f);
+					for (int l = 0; l < lanes; l++)
+					{
+						sum[l] = _mm_add_ps(sum[l], _mm_mul_ps(weight, _mm_load_ps(&rowBasis[u][l * 4])));
+					}
+				}
+				if (!bUsed)
+				{
+					continue;
+				}
+				for (int l = 0; l < lanes; l++)
+				{
+					_mm_store_ps(&rows[v][l * 4], sum[l]);
+				}
+				usedRows[usedCount++] = v;
+			}
+			// columns: out[y][x] = sum over v of basis[v][y] * rows[v][x]
+			const __m128 bias = _mm_set1_ps(128.0f);
+			for (int y = 0; y < height; y++)
+			{
+				__m128 sum[2] = { bias, bias };
+				for (int i = 0; i < usedCount; i++)
+				{
+					const int v = usedRows[i];
+					__m128 weight = _mm_set1_ps(columnBasis[v][y]);
+					for (int l = 0; l < lanes; l++)
+					{
+						sum[l] = _mm_add_ps(sum[l], _mm_mul_ps(weight, _mm_load_ps(&rows[v][l * 4])));
+					}
+				}
+				// round, then saturate to bytes on the way down
+				__m128i low = _mm_cvtps_epi32(sum[0]);
+				__m128i high = (lanes == 2) ? _mm_cvtps_epi32(sum[1]) : _mm_setzero_si128();
+				__m128i bytes = _mm_packus_epi16(_mm_packs_epi32(low, high), _mm_setzero_si128());
+				if (lanes == 2)
+				{
+					_mm_storel_epi64((__m128i*)(pOut + y * stride), bytes);
+				}
+				else
+				{
+					int packed = _mm_cvtsi128_si32(bytes);
+					std::memcpy(pOut + y * stride, &packed, 4);
+				}
+			}
+			return;
+		}
+#endif
+
+		for (int v = 0; v < height; v++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				float sum = 0.0f;
+				for (int u = 0; u < width; u++)
+				{
+					sum += coefficients[v * 8 + u] * rowBasis[u][x];
+				}
+				rows[v][x] = sum;
+			}
+		}
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				float sum = 128.0f;
+				for (int v = 0; v < height; v++)
+				{
+					sum += columnBasis[v][y] * rows[v][x];
+				}
+				int value = (int)std::lround(sum);
+				pOut[y * stride + x] = (unsigned char)std::min(std::max(value, 0), 255);
+			}
+		}
+	}
+
+	// YCbCr to RGB factors in 4.12 fixed point
+	const int CR_TO_R = 5743;
+	const int CB_TO_G = -1410;
+	const int CR_TO_G = -2925;
+	const int CB_TO_B = 7258;
+
+	/***********************************************************
+	 *  ConvertRow()
+	 *
+	 *  Convert one row of YCbCr samples to interleaved RGB, in
+	 *  16 bit fixed point, eight pixels at a time with SSE2.
+	 ***********************************************************/
+	void ConvertRow(const unsigned char* pY, const unsigned char* pCb, const unsigned char* pCr, int count, unsigned char* pOut)
+	{
+		int x = 0;
+#if defined(JPEG_USE_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i signFlip = _mm_set1_epi8((char)0x80);
+		const __m128i yBias = _mm_set1_epi8((char)128);
+		for (; x + 8 <= count; x += 8)
+		{
+			// y * 16 + 8, and the centred chroma times 256
+			__m128i y = _mm_srli_epi16(_mm_unpacklo_epi8(yBias, _mm_loadl_epi64((const __m128i*)(pY + x))), 4);
+			__m128i cb = _mm_unpacklo_epi8(zero, _mm_xor_si128(_mm_loadl_epi64((const __m128i*)(pCb + x)), signFlip));
+			__m128i cr = _mm_unpacklo_epi8(zero, _mm_xor_si128(_mm_loadl_epi64((const __m128i*)(pCr + x)), signFlip));
+
+			// products come out times 16, like y
+			__m128i r = _mm_add_epi16(y, _mm_mulhi_epi16(cr, _mm_set1_epi16(CR_TO_R)));
+			__m128i g = _mm_add_epi16(_mm_add_epi16(y, _mm_mulhi_epi16(cb, _mm_set1_epi16(CB_TO_G))),
+				_mm_mulhi_epi16(cr, _mm_set1_epi16(CR_TO_G)));
+			__m128i b = _mm_add_epi16(y, _mm_mulhi_epi16(cb, _mm_set1_epi16(CB_TO_B)));
+
+			// saturate each to bytes, then interleave
+			alignas(16) unsigned char rgb[2][16];
+			_mm_store_si128((__m128i*)rgb[0], _mm_packus_epi16(_mm_srai_epi16(r, 4), _mm_srai_epi16(b, 4)));
+			_mm_store_si128((__m128i*)rgb[1], _mm_packus_epi16(_mm_srai_epi16(g, 4), zero));
+			for (int i = 0; i < 8; i++)
+			{
+				pOut[(x + i) * 3 + 0] = rgb[0][i];
+				pOut[(x + i) * 3 + 1] = rgb[1][i];
+				pOut[(x + i) * 3 + 2] = rgb[0][i + 8];
+			}
+		}
+#endif
+		// the same arithmetic, one pixel at a time
+		for (; x < count; x++)
+		{
+			int y = (pY[x] << 4) + 8;
+			int cb = (pCb[x] - 128) << 8;
+			int cr = (pCr[x] - 128) << 8;
+			int r = (y + ((cr * CR_TO_R) >> 16)) >> 4;
+			int g = (y + ((cb * CB_TO_G) >> 16) + ((cr * CR_TO_G) >> 16)) >> 4;
+			int b = (y + ((cb * CB_TO_B) >> 16)) >> 4;
+			pOut[x * 3 + 0] = (unsigned char)std::min(std::max(r, 0), 255);
+			pOut[x * 3 + 1] = (unsigned char)std::min(std::max(g, 0), 255);
+			pOut[x * 3 + 2] = (unsigned char)std::min(std::max(b, 0), 255);
+		}
+	}
+
+	/***********************************************************
+	 *  SAMPLE_TAP
+	 *
+	 *  Where an output sample falls between two samples of a
+	 *  subsampled component: the first and the weight, out of
+	 *  256, of the one after it.
+	 ***********************************************************/
+	struct SAMPLE_TAP
+	{
+		int first;
+		int weight;
+	};
+
+	SAMPLE_TAP MakeTap(int position, int outCount, int factor, int maxFactor)
+	{
+		// centre of output sample, in component samples, times 256
+		int centre = ((2 * position + 1) * factor * 256) / (2 * maxFactor) - 128;
+		int sourceCount = (outCount * factor + maxFactor - 1) / maxFactor;
+		SAMPLE_TAP tap;
+		tap.first = (centre < 0) ? 0 : (centre >> 8);
+		tap.weight = (centre < 0) ? 0 : (centre & 255);
+		if (tap.first >= sourceCount - 1)
+		{
+			tap.first = sourceCount - 1;
+			tap.weight = 0;
+		}
+		return tap;
+	}
+
+	std::vector<SAMPLE_TAP> MakeTaps(int outCount, int factor, int maxFactor)
+	{
+		std::vector<SAMPLE_TAP> taps(outCount);
+		for (int i = 0; i < outCount; i++)
+		{
+			taps[i] = MakeTap(i, outCount, factor, maxFactor);
+		}
+		return taps;
+	}
+
+	/***********************************************************
+	 *  UpsampleRow()
+	 *
+	 *  Interpolate a row of a subsampled component across to
+	 *  the output width. The row has already been blended
+	 *  between two source rows and is scaled by 4, with its
+	 *  edge samples repeated one before and after. Halving, by
+	 *  far the most common case, runs eight samples at a time;
+	 *  its 3/4, 1/4 weights are the ones the taps give.
+	 ***********************************************************/
+	void UpsampleRow(const uint16_t* pBlended, int sourceWidth, const std::vector<SAMPLE_TAP>& taps, bool bHalf,
+		int outWidth, unsigned char* pOut)
+	{
+		if (bHalf)
+		{
+			int i = 0;
+#if defined(JPEG_USE_SSE2)
+			const __m128i round = _mm_set1_epi16(8);
+			for (; (i + 8 <= sourceWidth) && (2 * i + 16 <= outWidth); i += 8)
+			{
+				__m128i centre = _mm_loadu_si128((const __m128i*)(pBlended + i));
+				__m128i previous = _mm_loadu_si128((const __m128i*)(pBlended + i - 1));
+				__m128i next = _mm_loadu_si128((const __m128i*)(pBlended + i + 1));
+				__m128i triple = _mm_add_epi16(_mm_add_epi16(centre, centre), centre);
+				__m128i even = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(triple, previous), round), 4);
+				__m128i odd = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(triple, next), round), 4);
+				_mm_storeu_si128((__m128i*)(pOut + 2 * i),
+					_mm_packus_epi16(_mm_unpacklo_epi16(even, odd), _mm_unpackhi_epi16(even, odd)));
+			}
+#endif
+			for (int x = 2 * i; x < outWidth; x++)
+			{
+				int source = x >> 1;
+				int neighbour = pBlended[(x & 1) ? (source + 1) : (source - 1)];
+				pOut[x] = (unsigned char)((3 * pBlended[source] + neighbour + 8) >> 4);
+			}
+			return;
+		}
+
+		for (int x = 0; x < outWidth; x++)
+		{
+			const SAMPLE_TAP& tap = taps[x];
+			int value = pBlended[tap.first] * (256 - tap.weight) + pBlended[tap.first + 1] * tap.weight;
+			pOut[x] = (unsigned char)((value + 512) >> 10);
+		}
+	}
+
+	/***********************************************************
+	 *  JPEG_STATE
+	 *
+	 *  Everything read from one file while it is decoded.
+	 ***********************************************************/
+	struct JPEG_STATE
+	{
+		// dequantisation factors in file order, and the same with the
+		// AAN scale folded in for full size blocks
+		float quant[4][64] = {};
+		float scaledQuant[4][64] = {};
+		HUFFMAN_TABLE dc[4];
+		HUFFMAN_TABLE ac[4];
+		COMPONENT components[3];
+		int componentCount = 0;
+		int width = 0;
+		int height = 0;
+		int maxH = 1;
+		int maxV = 1;
+		int mcusX = 0;
+		int mcusY = 0;
+		int restartInterval = 0;
+		bool bFrame = false;
+		bool bScanned = false;
+		int blockSize = 8;
+
+		bool ReadFrame(const unsigned char* p, int length);
+		bool ReadHuffman(const unsigned char* p, int length);
+		bool ReadQuant(const unsigned char* p, int length);
+		const unsigned char* DecodeScan(const unsigned char* p, const unsigned char* end, int length);
+		bool DecodeBlock(BIT_READER& reader, COMPONENT& component, unsigned char* pOut);
+	};
+
+	bool JPEG_STATE::ReadQuant(const unsigned char* p, int length)
+	{
+		while (length > 0)
+		{
+			int precision = p[0] >> 4;
+			int id = p[0] & 15;
+			int size = (precision == 0) ? 64 : 128;
+			if ((id > 3) || (length < 1 + size))
+			{
+				return false;
+			}
+			for (int i = 0; i < 64; i++)
+			{
+				quant[id][i] = (float)((precision == 0) ? p[1 + i] : ((p[1 + i * 2] << 8) | p[2 + i * 2]));
+				scaledQuant[id][i] = quant[id][i] * AAN_SCALE[ZIGZAG[i] >> 3] * AAN_SCALE[ZIGZAG[i] & 7];
+			}
+			p += 1 + size;
+			length -= 1 + size;
+		}
+		return true;
+	}
+
+	bool JPEG_STATE::ReadHuffman(const unsigned char* p, int length)
+	{
+		while (length > 0)
+		{
+			if (length < 17)
+			{
+				return false;
+			}
+			int tableClass = p[0] >> 4;
+			int id = p[0] & 15;
+			int total = 0;
+			for (int i = 0; i < 16; i++)
+			{
+				total += p[1 + i];
+			}
+			if ((tableClass > 1) || (id > 3) || (total > 256) || (length < 17 + total))
+			{
+				return false;
+			}
+			HUFFMAN_TABLE& table = (tableClass == 0) ? dc[id] : ac[id];
+			if (!table.Build(p + 1, p + 17, total))
+			{
+				return false;
+			}
+			p += 17 + total;
+			length -= 17 + total;
+		}
+		return true;
+	}
+
+	bool JPEG_STATE::ReadFrame(const unsigned char* p, int length)
+	{
+		if ((length < 6) || (p[0] != 8))
+		{
+			return false;
+		}
+		height = (p[1] << 8) | p[2];
+		width = (p[3] << 8) | p[4];
+		componentCount = p[5];
+		if ((width == 0) || (height == 0) || ((componentCount != 1) && (componentCount != 3)) ||
+			(length < 6 + componentCount * 3))
+		{
+			return false;
+		}
+
+		for (int i = 0; i < componentCount; i++)
+		{
+			COMPONENT& component = components[i];
+			component.id = p[6 + i * 3];
+			component.h = p[7 + i * 3] >> 4;
+			component.v = p[7 + i * 3] & 15;
+			component.quantTable = p[8 + i * 3];
+			if ((component.h < 1) || (component.h > 4) || (component.v < 1) || (component.v > 4) || (component.quantTable > 3))
+			{
+				return false;
+			}
+			maxH = std::max(maxH, component.h);
+			maxV = std::max(maxV, component.v);
+		}
+
+		mcusX = (width + 8 * maxH - 1) / (8 * maxH);
+		mcusY = (height + 8 * maxV - 1) / (8 * maxV);
+		for (int i = 0; i < componentCount; i++)
+		{
+			COMPONENT& component = components[i];
+			component.blocksX = mcusX * component.h;
+			component.blocksY = mcusY * component.v;
+			// subsampled components keep more of each block when the image
+			// is reduced, up to all of it, so they lose no more detail
+			component.blockWidth = std::min(blockSize * std::max(maxH / component.h, 1), 8);
+			component.blockHeight = std::min(blockSize * std::max(maxV / component.v, 1), 8);
+			component.planeWidth = component.blocksX * component.blockWidth;
+			component.plane.assign((size_t)component.planeWidth * component.blocksY * component.blockHeight, 0);
+		}
+		bFrame = true;
+		return true;
+	}
+
+	/***********************************************************
+	 *  DecodeBlock()
+	 *
+	 *  Huffman decode and dequantize one block, keeping only the
+	 *  coefficients the reduced transform uses, then transform
+	 *  it into the component plane.
+	 ***********************************************************/
+	bool JPEG_STATE::DecodeBlock(BIT_READER& reader, COMPONENT& component, unsigned char* pOut)
+	{
+		alignas(16) float coefficients[64];
+		std::memset(coefficients, 0, sizeof(coefficients));
+		const bool bFull = (component.blockWidth == 8) && (component.blockHeight == 8);
+		const float* q = bFull ? scaledQuant[component.quantTable] : quant[component.quantTable];
+
+		int size = reader.Decode(dc[component.dcTable]);
+		if ((size < 0) || (size > 11))
+		{
+			return false;
+		}
+		component.dcPredictor += (size > 0) ? reader.Receive(size) : 0;
+		coefficients[0] = component.dcPredictor * q[0];
+
+		const HUFFMAN_TABLE& acTable = ac[component.acTable];
+		for (int k = 1; k < 64;)
+		{
+			// short code and magnitude together, in one lookup
+			int fastAC = acTable.fastAC[reader.Peek()];
+			if (fastAC != 0)
+			{
+				reader.Skip(fastAC & 15);
+				k += (fastAC >> 4) & 15;
+				if (k > 63)
+				{
+					return false;
+				}
+				int position = ZIGZAG[k];
+				if (((position & 7) < component.blockWidth) && ((position >> 3) < component.blockHeight))
+				{
+					coefficients[position] = (fastAC >> 8) * q[k];
+				}
+				k++;
+				continue;
+			}
+
+			int symbol = reader.Decode(acTable);
+			if (symbol < 0)
+			{
+				return false;
+			}
+			int run = symbol >> 4;
+			int bits = symbol & 15;
+			if (bits == 0)
+			{
+				if (run != 15)
+				{
+					break;
+				}
+				k += 16;
+				continue;
+			}
+			k += run;
+			if (k > 63)
+			{
+				return false;
+			}
+			int value = reader.Receive(bits);
+			int position = ZIGZAG[k];
+			if (((position & 7) < component.blockWidth) && ((position >> 3) < component.blockHeight))
+			{
+				coefficients[position] = value * q[k];
+			}
+			k++;
+		}
+
+		if (bFull)
+		{
+			InverseDCTFull(coefficients, pOut, component.planeWidth);
+		}
+		else
+		{
+			InverseDCT(coefficients, component.blockWidth, component.blockHeight, pOut, component.planeWidth);
+		}
+		return true;
+	}
+
+	/***********************************************************
+	 *  DecodeScan()
+	 *
+	 *  Read a scan header and decode its entropy coded data.
+	 *  Returns the first byte after the data, or NULL on error.
+	 ***********************************************************/
+	const unsigned char* JPEG_STATE::DecodeScan(const unsigned char* p, const unsigned char* end, int length)
+	{
+		int scanCount = p[0];
+		if ((scanCount < 1) || (scanCount > componentCount) || (length < 4 + scanCount * 2))
+		{
+			return NULL;
+		}
+		COMPONENT* scanComponents[3];
+		for (int i = 0; i < scanCount; i++)
+		{
+			int id = p[1 + i * 2];
+			int tables = p[2 + i * 2];
+			scanComponents[i] = NULL;
+			for (int c = 0; c < componentCount; c++)
+			{
+				if (components[c].id == id)
+				{
+					scanComponents[i] = &components[c];
+				}
+			}
+			if (NULL == scanComponents[i])
+			{
+				return NULL;
+			}
+			scanComponents[i]->dcTable = tables >> 4;
+			scanComponents[i]->acTable = tables & 15;
+			if ((scanComponents[i]->dcTable > 3) || (scanComponents[i]->acTable > 3) ||
+				!dc[scanComponents[i]->dcTable].bDefined || !ac[scanComponents[i]->acTable].bDefined)
+			{
+				return NULL;
+			}
+			scanComponents[i]->dcPredictor = 0;
+		}
+		// baseline only: the full spectrum in one scan, no refinement
+		const unsigned char* pSpectral = p + 1 + scanCount * 2;
+		if ((pSpectral[0] != 0) || (pSpectral[1] != 63) || (pSpectral[2] != 0))
+		{
+			return NULL;
+		}
+
+		BIT_READER reader;
+		reader.Reset(p + length - 2, end);
+
+		// a lone component is coded block by block rather than in MCUs
+		const bool bInterleaved = (scanCount > 1);
+		int unitsX = mcusX;
+		int unitsY = mcusY;
+		if (!bInterleaved)
+		{
+			const COMPONENT& single = *scanComponents[0];
+			unitsX = (((width * single.h + maxH - 1) / maxH) + 7) / 8;
+			unitsY = (((height * single.v + maxV - 1) / maxV) + 7) / 8;
+		}
+
+		int untilRestart = restartInterval;
+		for (int unitY = 0; unitY < unitsY; unitY++)
+		{
+			for (int unitX = 0; unitX < unitsX; unitX++)
+			{
+				if ((restartInterval > 0) && (untilRestart-- == 0))
+				{
+					// skip to just after the RSTn marker and start over
+					const unsigned char* q = reader.p;
+					while ((q + 1 < end) && !((q[0] == 0xFF) && (q[1] >= 0xD0) && (q[1] <= 0xD7)))
+					{
+						q++;
+					}
+					if (q + 1 >= end)
+					{
+						return NULL;
+					}
+					reader.Reset(q + 2, end);
+					for (int i = 0; i < scanCount; i++)
+					{
+						scanComponents[i]->dcPredictor = 0;
+					}
+					untilRestart = restartInterval - 1;
+				}
+
+				for (int i = 0; i < scanCount; i++)
+				{
+					COMPONENT& component = *scanComponents[i];
+					const int blocksH = bInterleaved ? component.h : 1;
+					const int blocksV = bInterleaved ? component.v : 1;
+					for (int by = 0; by < blocksV; by++)
+					{
+						for (int bx = 0; bx < blocksH; bx++)
+						{
+							size_t blockX = (size_t)unitX * blocksH + bx;
+							size_t blockY = (size_t)unitY * blocksV + by;
+							unsigned char* pOut = component.plane.data() +
+								blockY * component.blockHeight * component.planeWidth + blockX * component.blockWidth;
+							if (!DecodeBlock(reader, component, pOut))
+							{
+								return NULL;
+							}
+						}
+					}
+				}
+			}
+		}
+
+		// continue from the marker that ended the data
+		const unsigned char* q = reader.p;
+		while ((q + 1 < end) && !((q[0] == 0xFF) && (q[1] != 0x00) && ((q[1] < 0xD0) || (q[1] > 0xD7))))
+		{
+			q++;
+		}
+		bScanned = true;
+		return q;
+	}
+}
+
+/***********************************************************
+ *  CanDecode()
+ *
+ *  This method is used for recognising a JPEG by its SOI
+ *  marker.
+ ***********************************************************/
+bool JpegDecoder::CanDecode(const unsigned char* bytes, size_t size) const
+{
+	return (size >= 4) && (bytes[0] == 0xFF) && (bytes[1] == 0xD8) && (bytes[2] == 0xFF);
+}
+
+/***********************************************************
+ *  Decode()
+ *
+ *  This method is used for decoding a JPEG: the markers are
+ *  read in order, each block is decoded straight into its
+ *  component's plane at the reduced size, and the planes
+ *  are upsampled and colour converted into the image, with
+ *  the rows written bottom first.
+ ***********************************************************/
+bool JpegDecoder::Decode(const unsigned char* bytes, size_t size, int scale, IMAGE_DATA& image)
+{
+	image = IMAGE_DATA();
+	if (!CanDecode(bytes, size))
+	{
+		return false;
+	}
+
+	std::unique_ptr<JPEG_STATE> state(new JPEG_STATE());
+	state->blockSize = (scale >= 8) ? 1 : ((scale >= 4) ? 2 : ((scale >= 2) ? 4 : 8));
+	const int reduction = 8 / state->blockSize;
+
+	const unsigned char* p = bytes + 2;
+	const unsigned char* end = bytes + size;
+	while (p + 4 <= end)
+	{
+		if (p[0] != 0xFF)
+		{
+			p++;
+			continue;
+		}
+		int marker = p[1];
+		if ((marker == 0xFF) || (marker == 0x01) || ((marker >= 0xD0) && (marker <= 0xD7)))
+		{
+			p += (marker == 0xFF) ? 1 : 2;
+			continue;
+		}
+		if (marker == 0xD9)
+		{
+			break;
+		}
+
+		int length = (p[2] << 8) | p[3];
+		const unsigned char* pData = p + 4;
+		if ((length < 2) || (pData + length - 2 > end))
+		{
+			return false;
+		}
+
+		bool bOk = true;
+		switch (marker)
+		{
+		case 0xC0:
+		case 0xC1:
+			bOk = state->ReadFrame(pData, length - 2);
+			break;
+		case 0xC4:
+			bOk = state->ReadHuffman(pData, length - 2);
+			break;
+		case 0xDB:
+			bOk = state->ReadQuant(pData, length - 2);
+			break;
+		case 0xDD:
+			bOk = (length >= 4);
+			if (bOk)
+			{
+				state->restartInterval = (pData[0] << 8) | pData[1];
+			}
+			break;
+		case 0xDA:
+			if (!state->bFrame)
+			{
+				return false;
+			}
+			p = state->DecodeScan(pData, end, length);
+			if (NULL == p)
+			{
+				return false;
+			}
+			continue;
+		default:
+			// progressive, lossless and arithmetic frames go to another decoder
+			if ((marker >= 0xC2) && (marker <= 0xCF) && (marker != 0xC4) && (marker != 0xC8) && (marker != 0xCC))
+			{
+				return false;
+			}
+			break;
+		}
+		if (!bOk)
+		{
+			return false;
+		}
+		p = pData + length - 2;
+	}
+
+	if (!state->bScanned)
+	{
+		return false;
+	}
+
+	const int outWidth = (state->width + reduction - 1) / reduction;
+	const int outHeight = (state->height + reduction - 1) / reduction;
+	const int channels = state->componentCount;
+	unsigned char* pixels = new unsigned char[(size_t)outWidth * outHeight * channels];
+
+	// subsampled components are interpolated between sample centres, as
+	// libjpeg and stb_image do, so colour edges do not come out blocky
+	std::vector<SAMPLE_TAP> columnTaps[3];
+	std::vector<unsigned char> upsampled[3];
+	std::vector<uint16_t> blended(outWidth + 2);
+	for (int c = 0; c < channels; c++)
+	{
+		const COMPONENT& component = state->components[c];
+		columnTaps[c] = MakeTaps(outWidth, component.h * component.blockWidth, state->maxH * state->blockSize);
+		upsampled[c].resize(outWidth);
+	}
+	for (int y = 0; y < outHeight; y++)
+	{
+		for (int c = 0; c < channels; c++)
+		{
+			const COMPONENT& component = state->components[c];
+			// component samples per output sample, as across / outAcross
+			// and down / outDown
+			const int across = component.h * component.blockWidth;
+			const int down = component.v * component.blockHeight;
+			const int outAcross = state->maxH * state->blockSize;
+			const int outDown = state->maxV * state->blockSize;
+			if ((across == outAcross) && (down == outDown))
+			{
+				std::memcpy(upsampled[c].data(), component.plane.data() + (size_t)y * component.planeWidth, outWidth);
+				continue;
+			}
+
+			SAMPLE_TAP row = MakeTap(y, outHeight, down, outDown);
+			const unsigned char* pRow0 = component.plane.data() + (size_t)row.first * component.planeWidth;
+			const unsigned char* pRow1 = pRow0 + ((row.weight > 0) ? component.planeWidth : 0);
+			int sourceWidth = (outWidth * across + outAcross - 1) / outAcross;
+			uint16_t* pBlended = blended.data() + 1;
+			for (int x = 0; x < sourceWidth; x++)
+			{
+				pBlended[x] = (uint16_t)((pRow0[x] * (256 - row.weight) + pRow1[x] * row.weight + 32) >> 6);
+			}
+			pBlended[-1] = pBlended[0];
+			pBlended[sourceWidth] = pBlended[sourceWidth - 1];
+			UpsampleRow(pBlended, sourceWidth, columnTaps[c], across * 2 == outAcross, outWidth, upsampled[c].data());
+		}
+
+		unsigned char* pOut = pixels + (size_t)(outHeight - 1 - y) * outWidth * channels;
+		if (channels == 3)
+		{
+			ConvertRow(upsampled[0].data(), upsampled[1].data(), upsampled[2].data(), outWidth, pOut);
+		}
+		else
+		{
+			std::memcpy(pOut, upsampled[0].data(), outWidth);
+		}
+	}
+
+	image.width = outWidth;
+	image.height = outHeight;
+	image.channels = channels;
+	image.pixels = std::shared_ptr<unsigned char>(pixels, std::default_delete<unsigned char[]>());
+	return true;
+}
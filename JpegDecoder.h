@@ -0,0 +1,32 @@
+///////////////////////////////////////////////////////////////////////////////
+// jpegdecoder.h
+// ============
+// baseline JPEG decoder with SSE2 transforms and reduced size decoding
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ImageDecoder.h"
+
+/***********************************************************
+ *  JpegDecoder
+ *
+ *  This class decodes baseline (sequential Huffman) JPEGs,
+ *  greyscale or YCbCr with any chroma subsampling, which is
+ *  what every texture in this project is. The inverse DCT
+ *  and the colour conversion run four or eight values at a
+ *  time with SSE2. A reduced decode keeps only the low
+ *  frequency corner of each 8x8 block and runs a smaller
+ *  inverse DCT on it - 4x4, 2x2 or just the DC value - so a
+ *  1/8 size image costs little more than the Huffman decode.
+ *  Progressive and arithmetic coded files are left to the
+ *  next decoder.
+ ***********************************************************/
+class JpegDecoder : public ImageDecoder
+{
+public:
+	const char* GetName() const override { return "jpeg-simd"; }
+	bool CanDecode(const unsigned char* bytes, size_t size) const override;
+	bool Decode(const unsigned char* bytes, size_t size, int scale, IMAGE_DATA& image) override;
+};
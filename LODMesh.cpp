@@ -0,0 +1,167 @@
+///////////////////////////////////////////////////////////////////////////////
+// lodmesh.cpp
+// ============
+// GPU storage and screen-space selection for a mesh LOD chain
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LODMesh.h"
+
+#include <cstddef>
+#include <iostream>
+
+/***********************************************************
+ *  LODMesh()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LODMesh::LODMesh()
+{
+	m_vao = 0;
+	m_vbo = 0;
+	m_ebo = 0;
+	m_boundsCenter = glm::vec3(0.0f);
+	m_boundsRadius = 0.0f;
+	// one pixel of error is below what can be seen when levels switch
+	m_pixelThreshold = 1.0f;
+}
+
+/***********************************************************
+ *  ~LODMesh()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LODMesh::~LODMesh()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for concatenating all the levels of
+ *  a LOD chain into a single VAO, remembering where each
+ *  level starts so any of them can be drawn directly.
+ ***********************************************************/
+bool LODMesh::Create(const std::vector<MESH_LOD>& chain)
+{
+	Destroy();
+	if (chain.empty())
+	{
+		return false;
+	}
+
+	std::vector<MESH_VERTEX> vertices;
+	std::vector<uint32_t> indices;
+	for (const MESH_LOD& level : chain)
+	{
+		LOD_RANGE range;
+		range.firstIndex = (GLuint)indices.size();
+		range.indexCount = (GLsizei)level.mesh.indices.size();
+		range.baseVertex = (GLint)vertices.size();
+		range.geometricError = level.geometricError;
+		m_levels.push_back(range);
+		m_levelErrors.push_back(level.geometricError);
+
+		vertices.insert(vertices.end(), level.mesh.vertices.begin(), level.mesh.vertices.end());
+		indices.insert(indices.end(), level.mesh.indices.begin(), level.mesh.indices.end());
+	}
+	m_boundsCenter = chain[0].mesh.boundsCenter;
+	m_boundsRadius = chain[0].mesh.boundsRadius;
+
+	glGenVertexArrays(1, &m_vao);
+	glBindVertexArray(m_vao);
+
+	glGenBuffers(1, &m_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MESH_VERTEX), vertices.data(), GL_STATIC_DRAW);
+
+	glGenBuffers(1, &m_ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+
+	// same attribute locations as the basic shape meshes
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MESH_VERTEX), (void*)offsetof(MESH_VERTEX, position));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MESH_VERTEX), (void*)offsetof(MESH_VERTEX, normal));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(MESH_VERTEX), (void*)offsetof(MESH_VERTEX, texCoord));
+
+	glBindVertexArray(0);
+
+	return true;
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the GPU buffers.
+ ***********************************************************/
+void LODMesh::Destroy()
+{
+	if (m_ebo != 0)
+	{
+		glDeleteBuffers(1, &m_ebo);
+		m_ebo = 0;
+	}
+	if (m_vbo != 0)
+	{
+		glDeleteBuffers(1, &m_vbo);
+		m_vbo = 0;
+	}
+	if (m_vao != 0)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+		m_vao = 0;
+	}
+	m_levels.clear();
+	m_levelErrors.clear();
+}
+
+/***********************************************************
+ *  SelectLevel()
+ *
+ *  This method is used for choosing the level to draw for an
+ *  object at the given distance. The scale converts the mesh
+ *  space error into world units for scaled instances.
+ ***********************************************************/
+int LODMesh::SelectLevel(float distance, float scale, float fovYRadians, float viewportHeight) const
+{
+	if (m_levels.size() <= 1)
+	{
+		return 0;
+	}
+
+	// measure from the nearest point of the bounding sphere
+	float surfaceDistance = distance - m_boundsRadius * scale;
+	return MeshSimplifier::SelectLOD(
+		m_levelErrors,
+		surfaceDistance / scale,
+		fovYRadians,
+		viewportHeight,
+		m_pixelThreshold);
+}
+
+/***********************************************************
+ *  DrawLevel()
+ *
+ *  This method is used for drawing one level of the chain.
+ ***********************************************************/
+void LODMesh::DrawLevel(int level) const
+{
+	if ((level < 0) || (level >= (int)m_levels.size()))
+	{
+		return;
+	}
+
+	const LOD_RANGE& range = m_levels[level];
+	glBindVertexArray(m_vao);
+	glDrawElementsBaseVertex(
+		GL_TRIANGLES,
+		range.indexCount,
+		GL_UNSIGNED_INT,
+		(void*)(range.firstIndex * sizeof(uint32_t)),
+		range.baseVertex);
+	glBindVertexArray(0);
+}
@@ -0,0 +1,65 @@
+///////////////////////////////////////////////////////////////////////////////
+// lodmesh.h
+// ============
+// GPU storage and screen-space selection for a mesh LOD chain
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshSimplifier.h"
+
+#include <GL/glew.h>
+
+#include <vector>
+
+/***********************************************************
+ *  LODMesh
+ *
+ *  This class uploads every level of a LOD chain into one
+ *  vertex/index buffer pair and draws the level chosen from
+ *  the projected screen-space error.
+ ***********************************************************/
+class LODMesh
+{
+public:
+	// constructor
+	LODMesh();
+	// destructor
+	~LODMesh();
+
+	struct LOD_RANGE
+	{
+		GLuint firstIndex;
+		GLsizei indexCount;
+		GLint baseVertex;
+		float geometricError;
+	};
+
+	// upload all the levels of the chain into GPU buffers
+	bool Create(const std::vector<MESH_LOD>& chain);
+	// free the GPU buffers
+	void Destroy();
+
+	// choose a level for an object at the given distance from the camera
+	int SelectLevel(float distance, float scale, float fovYRadians, float viewportHeight) const;
+	// draw one level with the currently bound shader and model matrix
+	void DrawLevel(int level) const;
+
+	int GetLevelCount() const { return (int)m_levels.size(); }
+	const LOD_RANGE& GetLevel(int level) const { return m_levels[level]; }
+	float GetBoundsRadius() const { return m_boundsRadius; }
+	glm::vec3 GetBoundsCenter() const { return m_boundsCenter; }
+
+	// largest allowed projected error, in pixels, before switching to a finer level
+	float m_pixelThreshold;
+
+private:
+	GLuint m_vao;
+	GLuint m_vbo;
+	GLuint m_ebo;
+	std::vector<LOD_RANGE> m_levels;
+	std::vector<float> m_levelErrors;
+	glm::vec3 m_boundsCenter;
+	float m_boundsRadius;
+};
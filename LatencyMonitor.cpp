@@ -0,0 +1,274 @@
+///////////////////////////////////////////////////////////////////////////////
+// latencymonitor.cpp
+// ============
+// measures the time from input events to the frames showing them
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LatencyMonitor.h"
+
+#include "GLFW/glfw3.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+	// a frame the GPU has not finished after this long is given up on
+	const GLuint64 FLUSH_TIMEOUT_NS = 1000000000;
+
+	// value at a fraction of the way through sorted samples
+	double Percentile(const std::vector<double>& sorted, double fraction)
+	{
+		if (sorted.empty())
+		{
+			return 0.0;
+		}
+		size_t index = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+
+	LATENCY_SUMMARY SummariseSamples(const std::string& label, const char* metric, const std::vector<double>& samples)
+	{
+		LATENCY_SUMMARY summary;
+		summary.label = label;
+		summary.metric = metric;
+		summary.events = (int)samples.size();
+		if (samples.empty())
+		{
+			return summary;
+		}
+
+		std::vector<double> sorted = samples;
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0.0;
+		for (double sample : sorted)
+		{
+			total += sample;
+		}
+		summary.meanMs = total / sorted.size();
+		summary.medianMs = Percentile(sorted, 0.5);
+		summary.p90Ms = Percentile(sorted, 0.9);
+		summary.p95Ms = Percentile(sorted, 0.95);
+		summary.p99Ms = Percentile(sorted, 0.99);
+		summary.minMs = sorted.front();
+		summary.maxMs = sorted.back();
+		return summary;
+	}
+}
+
+/***********************************************************
+ *  LatencyMonitor()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LatencyMonitor::LatencyMonitor()
+{
+	m_gpuClockOffset = 0.0;
+	Calibrate();
+}
+
+/***********************************************************
+ *  ~LatencyMonitor()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LatencyMonitor::~LatencyMonitor()
+{
+	for (FENCED_FRAME& frame : m_frames)
+	{
+		glDeleteSync(frame.fence);
+		m_freeQueries.push_back(frame.query);
+	}
+	m_frames.clear();
+	if (!m_freeQueries.empty())
+	{
+		glDeleteQueries((GLsizei)m_freeQueries.size(), m_freeQueries.data());
+	}
+}
+
+/***********************************************************
+ *  Calibrate()
+ *
+ *  This method is used for finding the offset between the
+ *  GPU timestamp clock and glfwGetTime(). The GPU time is
+ *  read once the commands before it have reached the GPU,
+ *  so it is taken between two CPU readings.
+ ***********************************************************/
+void LatencyMonitor::Calibrate()
+{
+	double before = glfwGetTime();
+	GLint64 gpuTime = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+	double after = glfwGetTime();
+	m_gpuClockOffset = 0.5 * (before + after) - gpuTime * 1.0e-9;
+}
+
+/***********************************************************
+ *  RecordFrame()
+ *
+ *  This method is used for fencing a frame just after its
+ *  swap, with a timestamp query at the same point, and then
+ *  taking the samples of any earlier frames that are done.
+ *  Frames that applied no input are not fenced.
+ ***********************************************************/
+void LatencyMonitor::RecordFrame(const std::vector<double>& inputTimes, double latchTime, double swapTime)
+{
+	if (!inputTimes.empty())
+	{
+		FENCED_FRAME frame;
+		if (m_freeQueries.empty())
+		{
+			frame.query = 0;
+			glGenQueries(1, &frame.query);
+		}
+		else
+		{
+			frame.query = m_freeQueries.back();
+			m_freeQueries.pop_back();
+		}
+		glQueryCounter(frame.query, GL_TIMESTAMP);
+		frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		frame.inputTimes = inputTimes;
+		frame.latchTime = latchTime;
+		frame.swapTime = swapTime;
+		m_frames.push_back(frame);
+	}
+	CollectFrames(false);
+}
+
+/***********************************************************
+ *  CollectFrames()
+ *
+ *  This method is used for adding the samples of each fenced
+ *  frame the GPU has finished, oldest first. Without bWait
+ *  it stops at the first frame still in flight.
+ ***********************************************************/
+void LatencyMonitor::CollectFrames(bool bWait)
+{
+	while (!m_frames.empty())
+	{
+		FENCED_FRAME& frame = m_frames.front();
+		GLenum status = bWait ?
+			glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT, FLUSH_TIMEOUT_NS) :
+			glClientWaitSync(frame.fence, 0, 0);
+		if ((status != GL_ALREADY_SIGNALED) && (status != GL_CONDITION_SATISFIED))
+		{
+			if (!bWait || (status != GL_TIMEOUT_EXPIRED))
+			{
+				return;
+			}
+			std::cout << "[LatencyMonitor] WARNING: Gave up waiting for a frame" << std::endl;
+		}
+		else
+		{
+			GLuint64 gpuTime = 0;
+			glGetQueryObjectui64v(frame.query, GL_QUERY_RESULT, &gpuTime);
+			double gpuDone = gpuTime * 1.0e-9 + m_gpuClockOffset;
+			for (double inputTime : frame.inputTimes)
+			{
+				m_inputToLatch.push_back((frame.latchTime - inputTime) * 1000.0);
+				m_inputToSwap.push_back((frame.swapTime - inputTime) * 1000.0);
+				m_inputToGPU.push_back((gpuDone - inputTime) * 1000.0);
+			}
+		}
+		glDeleteSync(frame.fence);
+		m_freeQueries.push_back(frame.query);
+		m_frames.pop_front();
+	}
+}
+
+/***********************************************************
+ *  Flush()
+ *
+ *  This method is used for waiting on every fenced frame,
+ *  at the end of a run.
+ ***********************************************************/
+void LatencyMonitor::Flush()
+{
+	CollectFrames(true);
+}
+
+/***********************************************************
+ *  Reset()
+ *
+ *  This method is used for dropping the samples taken so
+ *  far, and matching the clocks again, since they drift.
+ *  Frames still in flight count towards the new samples.
+ ***********************************************************/
+void LatencyMonitor::Reset()
+{
+	m_inputToLatch.clear();
+	m_inputToSwap.clear();
+	m_inputToGPU.clear();
+	Calibrate();
+}
+
+/***********************************************************
+ *  Summarise()
+ *
+ *  This method is used for summarising each latency over the
+ *  input events measured: to the camera latching it, to the
+ *  swap returning, and to the GPU finishing the frame.
+ ***********************************************************/
+std::vector<LATENCY_SUMMARY> LatencyMonitor::Summarise(const std::string& label) const
+{
+	std::vector<LATENCY_SUMMARY> summaries;
+	summaries.push_back(SummariseSamples(label, "input_to_latch", m_inputToLatch));
+	summaries.push_back(SummariseSamples(label, "input_to_swap", m_inputToSwap));
+	summaries.push_back(SummariseSamples(label, "input_to_gpu_done", m_inputToGPU));
+	return summaries;
+}
+
+/***********************************************************
+ *  Print()
+ *
+ *  This method is used for showing latency summaries on the
+ *  console.
+ ***********************************************************/
+void LatencyMonitor::Print(const std::vector<LATENCY_SUMMARY>& summaries)
+{
+	for (const LATENCY_SUMMARY& summary : summaries)
+	{
+		std::cout << "[LatencyMonitor] " << summary.label << " " << summary.metric
+			<< ": median " << summary.medianMs
+			<< " ms, p95 " << summary.p95Ms
+			<< " ms, max " << summary.maxMs
+			<< " ms over " << summary.events << " events" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  WriteCSV()
+ *
+ *  This method is used for saving latency summaries next to
+ *  the frame time results.
+ ***********************************************************/
+bool LatencyMonitor::WriteCSV(const char* filename, const std::vector<LATENCY_SUMMARY>& summaries)
+{
+	std::ofstream file(filename);
+	if (!file.is_open())
+	{
+		std::cout << "[LatencyMonitor] Could not write: " << filename << std::endl;
+		return false;
+	}
+
+	file << "label,metric,events,mean_ms,median_ms,p90_ms,p95_ms,p99_ms,min_ms,max_ms\n";
+	for (const LATENCY_SUMMARY& summary : summaries)
+	{
+		file << summary.label << ','
+			<< summary.metric << ','
+			<< summary.events << ','
+			<< summary.meanMs << ','
+			<< summary.medianMs << ','
+			<< summary.p90Ms << ','
+			<< summary.p95Ms << ','
+			<< summary.p99Ms << ','
+			<< summary.minMs << ','
+			<< summary.maxMs << '\n';
+	}
+
+	std::cout << "[LatencyMonitor] Wrote " << summaries.size() << " rows to " << filename << std::endl;
+	return true;
+}
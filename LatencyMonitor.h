@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+// latencymonitor.h
+// ============
+// measures the time from input events to the frames showing them
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  LATENCY_SUMMARY
+ *
+ *  The distribution of one latency over the input events of
+ *  a run, all times in milliseconds.
+ ***********************************************************/
+struct LATENCY_SUMMARY
+{
+	std::string label;
+	std::string metric;
+	int events = 0;
+	double meanMs = 0.0;
+	double medianMs = 0.0;
+	double p90Ms = 0.0;
+	double p95Ms = 0.0;
+	double p99Ms = 0.0;
+	double minMs = 0.0;
+	double maxMs = 0.0;
+};
+
+/***********************************************************
+ *  LatencyMonitor
+ *
+ *  This class follows each input event from the moment the
+ *  event thread timestamped it to the frame that applied it:
+ *  when the camera latched it, when glfwSwapBuffers() for
+ *  that frame returned, and when the GPU finished the frame.
+ *  The last comes from a timestamp query behind the swap,
+ *  read once a fence after it has signalled, so the render
+ *  thread never waits for it. All times are glfwGetTime()
+ *  seconds; GPU timestamps are moved onto that clock.
+ ***********************************************************/
+class LatencyMonitor
+{
+public:
+	// constructor - needs the current context
+	LatencyMonitor();
+	// destructor - frees the fences and queries
+	~LatencyMonitor();
+
+	// after the swap, record the input events a frame applied, when it
+	// latched them and when the swap returned, and fence the frame
+	void RecordFrame(const std::vector<double>& inputTimes, double latchTime, double swapTime);
+	// wait for every fenced frame, so the samples are complete
+	void Flush();
+	// drop the samples, to start measuring afresh
+	void Reset();
+
+	// input events measured since the last Reset()
+	int GetEventCount() const { return (int)m_inputToLatch.size(); }
+	// the distribution of each latency since the last Reset()
+	std::vector<LATENCY_SUMMARY> Summarise(const std::string& label) const;
+
+	// print summaries to the console
+	static void Print(const std::vector<LATENCY_SUMMARY>& summaries);
+	// write summaries as CSV, one row per run and latency, with a header
+	static bool WriteCSV(const char* filename, const std::vector<LATENCY_SUMMARY>& summaries);
+
+private:
+	// a presented frame the GPU may still be working on
+	struct FENCED_FRAME
+	{
+		GLsync fence;
+		GLuint query;
+		std::vector<double> inputTimes;
+		double latchTime;
+		double swapTime;
+	};
+
+	std::deque<FENCED_FRAME> m_frames;
+	std::vector<GLuint> m_freeQueries;
+	// glfwGetTime() minus the GPU timestamp clock, in seconds
+	double m_gpuClockOffset;
+	// samples, in milliseconds, one per input event
+	std::vector<double> m_inputToLatch;
+	std::vector<double> m_inputToSwap;
+	std::vector<double> m_inputToGPU;
+
+	// match the GPU timestamp clock to glfwGetTime()
+	void Calibrate();
+	// take the samples of the fenced frames the GPU has finished
+	void CollectFrames(bool bWait);
+};
@@ -0,0 +1,838 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmapbaker.cpp
+// ============
+// offline path traced lightmaps for the static geometry
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightmapBaker.h"
+
+#include "SceneSnapshot.h"
+#include "TextureCompressor.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
+
+const float LightmapBaker::LIGHTMAP_RANGE = 2.0f;
+
+namespace
+{
+	// rays start this far off the surface, so they do not hit it
+	const float SURFACE_OFFSET = 0.002f;
+	// shadow rays of directional lights reach this far
+	const float DIRECTIONAL_SHADOW_DISTANCE = 1000.0f;
+	// the charts shrink by this much each time they do not fit
+	const float PACK_SHRINK = 0.85f;
+	const int MAX_PACK_ATTEMPTS = 24;
+
+	/***********************************************************
+	 *  HashRow()
+	 *
+	 *  Mix a row of the lightmap into the starting state of its
+	 *  random sequence, so a bake gives the same result however
+	 *  the rows are spread across threads.
+	 ***********************************************************/
+	uint32_t HashRow(int row)
+	{
+		uint32_t h = 0x9E3779B9u ^ ((uint32_t)row * 0x85EBCA6Bu);
+		h ^= h >> 16;
+		h *= 0x7FEB352Du;
+		h ^= h >> 15;
+		h *= 0x846CA68Bu;
+		h ^= h >> 16;
+		return h | 1u;
+	}
+
+	// xorshift random number in [0, 1)
+	float NextRandom(uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// FNV-1a over raw bytes
+	void HashBytes(uint32_t& hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 16777619u;
+		}
+	}
+
+	// a direction about the normal, more often near it, as diffuse
+	// surfaces scatter light
+	glm::vec3 SampleCosine(glm::vec3 normal, uint32_t& state)
+	{
+		float r1 = NextRandom(state);
+		float r2 = NextRandom(state);
+		float radius = std::sqrt(r1);
+		float angle = 6.2831853f * r2;
+		glm::vec3 tangent = (std::fabs(normal.x) > 0.5f) ?
+			glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+		tangent = glm::normalize(glm::cross(tangent, normal));
+		glm::vec3 bitangent = glm::cross(normal, tangent);
+		return glm::normalize(
+			tangent * (radius * std::cos(angle)) +
+			bitangent * (radius * std::sin(angle)) +
+			normal * std::sqrt(std::max(0.0f, 1.0f - r1)));
+	}
+
+	// union-find over the triangles of an object
+	uint32_t FindRoot(std::vector<uint32_t>& parents, uint32_t item)
+	{
+		while (parents[item] != item)
+		{
+			parents[item] = parents[parents[item]];
+			item = parents[item];
+		}
+		return item;
+	}
+}
+
+/***********************************************************
+ *  LightmapBaker()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightmapBaker::LightmapBaker()
+{
+	m_info.width = 0;
+	m_info.height = 0;
+	m_info.range = LIGHTMAP_RANGE;
+	m_info.pad = 0;
+}
+
+/***********************************************************
+ *  AddObject()
+ *
+ *  This method is used for adding an object that gets a
+ *  lightmap, moved into world space. The texture slot and
+ *  UV scale are kept for drawing it.
+ ***********************************************************/
+void LightmapBaker::AddObject(
+	const MESH_DATA& mesh,
+	const glm::mat4& model,
+	glm::vec3 diffuseColor,
+	int textureSlot,
+	glm::vec2 uvScale)
+{
+	BAKE_OBJECT object;
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+	object.positions.reserve(mesh.vertices.size());
+	object.normals.reserve(mesh.vertices.size());
+	object.texCoords.reserve(mesh.vertices.size());
+	for (const MESH_VERTEX& vertex : mesh.vertices)
+	{
+		object.positions.push_back(glm::vec3(model * glm::vec4(vertex.position, 1.0f)));
+		glm::vec3 normal = normalMatrix * vertex.normal;
+		float length = glm::length(normal);
+		object.normals.push_back((length > 0.0f) ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f));
+		object.texCoords.push_back(vertex.texCoord);
+	}
+	object.indices = mesh.indices;
+	object.diffuseColor = diffuseColor;
+	object.textureSlot = textureSlot;
+	object.uvScale = uvScale;
+	object.bLightmapped = true;
+	m_objects.push_back(std::move(object));
+}
+
+/***********************************************************
+ *  AddOccluder()
+ *
+ *  This method is used for adding an object that is not
+ *  lightmapped itself, but shadows and bounces light onto
+ *  the objects that are.
+ ***********************************************************/
+void LightmapBaker::AddOccluder(const MESH_DATA& mesh, const glm::mat4& model, glm::vec3 diffuseColor)
+{
+	AddObject(mesh, model, diffuseColor, -1, glm::vec2(1.0f));
+	m_objects.back().bLightmapped = false;
+}
+
+/***********************************************************
+ *  AddLight()
+ *
+ *  This method is used for adding a light to bake.
+ ***********************************************************/
+void LightmapBaker::AddLight(const BAKE_LIGHT& light)
+{
+	m_lights.push_back(light);
+}
+
+/***********************************************************
+ *  GetSceneHash()
+ *
+ *  This method is used for hashing everything the baked
+ *  result depends on - the world space geometry, colours,
+ *  texture slots and lights - so a lightmap baked for a
+ *  different scene is never loaded. The bake settings are
+ *  left out: a rougher bake of the same scene still fits.
+ ***********************************************************/
+uint32_t LightmapBaker::GetSceneHash() const
+{
+	uint32_t hash = 2166136261u;
+	for (const BAKE_OBJECT& object : m_objects)
+	{
+		HashBytes(hash, object.positions.data(), object.positions.size() * sizeof(glm::vec3));
+		HashBytes(hash, object.texCoords.data(), object.texCoords.size() * sizeof(glm::vec2));
+		HashBytes(hash, object.indices.data(), object.indices.size() * sizeof(uint32_t));
+		HashBytes(hash, &object.diffuseColor, sizeof(object.diffuseColor));
+		HashBytes(hash, &object.textureSlot, sizeof(object.textureSlot));
+		HashBytes(hash, &object.uvScale, sizeof(object.uvScale));
+		HashBytes(hash, &object.bLightmapped, sizeof(object.bLightmapped));
+	}
+	for (const BAKE_LIGHT& light : m_lights)
+	{
+		HashBytes(hash, &light.bDirectional, sizeof(light.bDirectional));
+		HashBytes(hash, &light.position, sizeof(light.position));
+		HashBytes(hash, &light.direction, sizeof(light.direction));
+		HashBytes(hash, &light.ambient, sizeof(light.ambient));
+		HashBytes(hash, &light.diffuse, sizeof(light.diffuse));
+		HashBytes(hash, &light.constant, sizeof(float) * 3);
+	}
+	return hash;
+}
+
+/***********************************************************
+ *  Bake()
+ *
+ *  This method is used for baking the lightmap: unwrapping
+ *  and packing the charts, shrinking them until they fit,
+ *  finding what each texel covers, tracing the light there
+ *  across the pool, filling the padding around each chart
+ *  and compressing the result.
+ ***********************************************************/
+bool LightmapBaker::Bake(const LIGHTMAP_SETTINGS& settings, ThreadPool* pPool)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<CHART> charts;
+	BuildCharts(charts);
+	if (charts.empty())
+	{
+		std::cout << "[LightmapBaker] Nothing to bake" << std::endl;
+		return false;
+	}
+
+	float texelsPerUnit = settings.texelsPerUnit;
+	int atlasHeight = 0;
+	int attempt = 0;
+	while (!PackCharts(charts, texelsPerUnit, settings.chartPadding, settings.atlasSize, atlasHeight))
+	{
+		if (++attempt >= MAX_PACK_ATTEMPTS)
+		{
+			std::cout << "[LightmapBaker] The charts do not fit a "
+				<< settings.atlasSize << " atlas" << std::endl;
+			return false;
+		}
+		texelsPerUnit *= PACK_SHRINK;
+	}
+	if (texelsPerUnit < settings.texelsPerUnit)
+	{
+		std::cout << "[LightmapBaker] Lowered the density to " << texelsPerUnit
+			<< " texels per unit to fit the atlas" << std::endl;
+	}
+
+	m_info.width = settings.atlasSize;
+	m_info.height = atlasHeight;
+	m_info.range = LIGHTMAP_RANGE;
+	BuildGeometry(charts, texelsPerUnit, settings.chartPadding);
+
+	std::vector<TEXEL> texels;
+	std::vector<int> coverage;
+	RasterizeTexels(texels, coverage);
+
+	// every object goes into the query as world space geometry with one
+	// instance, so a hit's instance is the object and its triangle is
+	// the object's own
+	RayQuery rayQuery;
+	for (const BAKE_OBJECT& object : m_objects)
+	{
+		MESH_DATA mesh;
+		mesh.vertices.resize(object.positions.size());
+		for (size_t i = 0; i < object.positions.size(); i++)
+		{
+			mesh.vertices[i].position = object.positions[i];
+			mesh.vertices[i].normal = object.normals[i];
+			mesh.vertices[i].texCoord = object.texCoords[i];
+		}
+		mesh.indices = object.indices;
+		rayQuery.AddInstance(rayQuery.AddMesh(mesh), glm::mat4(1.0f));
+	}
+	rayQuery.Build();
+
+	const int width = m_info.width;
+	const int height = m_info.height;
+	std::vector<glm::vec3> light(texels.size(), glm::vec3(0.0f));
+	auto traceRows = [&](size_t begin, size_t end)
+	{
+		for (size_t row = begin; row < end; row++)
+		{
+			uint32_t state = HashRow((int)row);
+			for (int x = 0; x < width; x++)
+			{
+				size_t index = row * width + x;
+				if (coverage[index])
+				{
+					const TEXEL& texel = texels[index];
+					light[index] = TraceTexel(rayQuery, texel, settings, state);
+				}
+			}
+		}
+	};
+	if (NULL != pPool)
+	{
+		pPool->ParallelFor((size_t)height, 1, traceRows);
+	}
+	else
+	{
+		traceRows(0, (size_t)height);
+	}
+
+	DilateTexels(light, coverage, width, height, settings.chartPadding);
+
+	std::vector<unsigned char> pixels(texels.size() * 3);
+	for (size_t i = 0; i < light.size(); i++)
+	{
+		glm::vec3 value = glm::clamp(light[i] / LIGHTMAP_RANGE, 0.0f, 1.0f);
+		pixels[i * 3 + 0] = (unsigned char)(value.r * 255.0f + 0.5f);
+		pixels[i * 3 + 1] = (unsigned char)(value.g * 255.0f + 0.5f);
+		pixels[i * 3 + 2] = (unsigned char)(value.b * 255.0f + 0.5f);
+	}
+	m_blocks = TextureCompressor::CompressLevel(pixels.data(), width, height, 3, false, COMPRESS_REFINED, pPool);
+
+	size_t covered = std::count(coverage.begin(), coverage.end(), 1);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "[LightmapBaker] Baked a " << width << "x" << height << " lightmap, "
+		<< charts.size() << " charts, " << covered << " texels traced with "
+		<< settings.samples << " paths each, in " << seconds << " s" << std::endl;
+	return true;
+}
+
+/***********************************************************
+ *  Write()
+ *
+ *  This method is used for writing the baked lightmap, its
+ *  geometry and its objects in a snapshot file, versioned
+ *  with the hash of the scene.
+ ***********************************************************/
+bool LightmapBaker::Write(const std::string& filename) const
+{
+	if (m_blocks.empty())
+	{
+		return false;
+	}
+
+	std::vector<LIGHTMAP_INFO> info(1, m_info);
+	SceneSnapshot snapshot;
+	snapshot.AddArray(SNAPSHOT_LIGHTMAP_INFO, info);
+	snapshot.AddArray(SNAPSHOT_LIGHTMAP_VERTICES, m_vertices);
+	snapshot.AddArray(SNAPSHOT_LIGHTMAP_INDICES, m_indices);
+	snapshot.AddArray(SNAPSHOT_LIGHTMAP_OBJECTS, m_drawObjects);
+	snapshot.AddArray(SNAPSHOT_LIGHTMAP_BLOCKS, m_blocks);
+	if (!snapshot.Write(filename, GetSceneHash()))
+	{
+		std::cout << "[LightmapBaker] Could not write: " << filename << std::endl;
+		return false;
+	}
+	std::cout << "[LightmapBaker] Wrote " << filename << std::endl;
+	return true;
+}
+
+/***********************************************************
+ *  BuildCharts()
+ *
+ *  This method is used for splitting each lightmapped object
+ *  into charts. Triangles are grouped by the axis, and side,
+ *  their face normal points along most; within a group,
+ *  triangles sharing an edge - found by welding positions,
+ *  since meshes split vertices at seams - join one chart.
+ *  Projected onto the plane of its axis, no chart of a convex
+ *  surface overlaps itself.
+ ***********************************************************/
+void LightmapBaker::BuildCharts(std::vector<CHART>& charts) const
+{
+	for (size_t objectIndex = 0; objectIndex < m_objects.size(); objectIndex++)
+	{
+		const BAKE_OBJECT& object = m_objects[objectIndex];
+		if (!object.bLightmapped)
+		{
+			continue;
+		}
+
+		// weld vertices at the same position
+		std::map<std::tuple<float, float, float>, uint32_t> weldMap;
+		std::vector<uint32_t> weld(object.positions.size());
+		for (size_t i = 0; i < object.positions.size(); i++)
+		{
+			const glm::vec3& p = object.positions[i];
+			auto inserted = weldMap.insert(std::make_pair(std::make_tuple(p.x, p.y, p.z), (uint32_t)weldMap.size()));
+			weld[i] = inserted.first->second;
+		}
+
+		// classify the triangles, dropping any without area
+		uint32_t triangleCount = (uint32_t)(object.indices.size() / 3);
+		std::vector<int> classes(triangleCount, -1);
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			glm::vec3 a = object.positions[object.indices[t * 3 + 0]];
+			glm::vec3 b = object.positions[object.indices[t * 3 + 1]];
+			glm::vec3 c = object.positions[object.indices[t * 3 + 2]];
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			if (glm::dot(normal, normal) <= 1e-12f)
+			{
+				continue;
+			}
+			// the mesh normals say which side is out, whatever the winding
+			glm::vec3 shading = object.normals[object.indices[t * 3 + 0]] +
+				object.normals[object.indices[t * 3 + 1]] +
+				object.normals[object.indices[t * 3 + 2]];
+			if (glm::dot(normal, shading) < 0.0f)
+			{
+				normal = -normal;
+			}
+			glm::vec3 magnitude = glm::abs(normal);
+			int axis = (magnitude.x >= magnitude.y) ?
+				((magnitude.x >= magnitude.z) ? 0 : 2) :
+				((magnitude.y >= magnitude.z) ? 1 : 2);
+			classes[t] = axis * 2 + ((normal[axis] < 0.0f) ? 1 : 0);
+		}
+
+		// join triangles of the same class across shared edges
+		std::vector<uint32_t> parents(triangleCount);
+		std::iota(parents.begin(), parents.end(), 0u);
+		std::unordered_map<uint64_t, uint32_t> edgeOwners[6];
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			if (classes[t] < 0)
+			{
+				continue;
+			}
+			for (int edge = 0; edge < 3; edge++)
+			{
+				uint64_t a = weld[object.indices[t * 3 + edge]];
+				uint64_t b = weld[object.indices[t * 3 + (edge + 1) % 3]];
+				uint64_t key = (std::min(a, b) << 32) | std::max(a, b);
+				auto inserted = edgeOwners[classes[t]].insert(std::make_pair(key, t));
+				if (!inserted.second)
+				{
+					parents[FindRoot(parents, t)] = FindRoot(parents, inserted.first->second);
+				}
+			}
+		}
+
+		std::unordered_map<uint32_t, size_t> chartOfRoot;
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			if (classes[t] < 0)
+			{
+				continue;
+			}
+			uint32_t root = FindRoot(parents, t);
+			auto inserted = chartOfRoot.insert(std::make_pair(root, charts.size()));
+			if (inserted.second)
+			{
+				CHART chart;
+				chart.object = (int)objectIndex;
+				chart.axis = classes[t] / 2;
+				chart.projectedMin = glm::vec2(FLT_MAX);
+				chart.projectedMax = glm::vec2(-FLT_MAX);
+				chart.width = 0;
+				chart.height = 0;
+				chart.x = 0;
+				chart.y = 0;
+				charts.push_back(chart);
+			}
+			CHART& chart = charts[inserted.first->second];
+			chart.triangles.push_back(t);
+			int u = (chart.axis + 1) % 3;
+			int v = (chart.axis + 2) % 3;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				const glm::vec3& p = object.positions[object.indices[t * 3 + corner]];
+				chart.projectedMin = glm::min(chart.projectedMin, glm::vec2(p[u], p[v]));
+				chart.projectedMax = glm::max(chart.projectedMax, glm::vec2(p[u], p[v]));
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  PackCharts()
+ *
+ *  This method is used for sizing the charts at a density
+ *  and placing them on shelves, tallest first, across the
+ *  width of the atlas. The height used is rounded up to
+ *  whole compressed blocks; false if it is too tall.
+ ***********************************************************/
+bool LightmapBaker::PackCharts(
+	std::vector<CHART>& charts,
+	float texelsPerUnit,
+	int padding,
+	int atlasSize,
+	int& atlasHeight) const
+{
+	std::vector<size_t> order(charts.size());
+	for (size_t i = 0; i < charts.size(); i++)
+	{
+		glm::vec2 extent = (charts[i].projectedMax - charts[i].projectedMin) * texelsPerUnit;
+		charts[i].width = (int)std::ceil(extent.x) + 1 + padding * 2;
+		charts[i].height = (int)std::ceil(extent.y) + 1 + padding * 2;
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&charts](size_t a, size_t b)
+	{
+		return charts[a].height > charts[b].height;
+	});
+
+	int shelfX = 0;
+	int shelfY = 0;
+	int shelfHeight = 0;
+	for (size_t index : order)
+	{
+		CHART& chart = charts[index];
+		if (chart.width > atlasSize)
+		{
+			return false;
+		}
+		if (shelfX + chart.width > atlasSize)
+		{
+			shelfY += shelfHeight;
+			shelfX = 0;
+			shelfHeight = 0;
+		}
+		chart.x = shelfX;
+		chart.y = shelfY;
+		shelfX += chart.width;
+		shelfHeight = std::max(shelfHeight, chart.height);
+	}
+
+	atlasHeight = (shelfY + shelfHeight + 3) & ~3;
+	return atlasHeight <= atlasSize;
+}
+
+/***********************************************************
+ *  ProjectToChart()
+ *
+ *  This method is used for finding where a position on a
+ *  chart lands in the atlas, in texels.
+ ***********************************************************/
+glm::vec2 LightmapBaker::ProjectToChart(const CHART& chart, glm::vec3 position, float texelsPerUnit, int padding) const
+{
+	int u = (chart.axis + 1) % 3;
+	int v = (chart.axis + 2) % 3;
+	glm::vec2 projected(position[u], position[v]);
+	return glm::vec2((float)(chart.x + padding), (float)(chart.y + padding)) +
+		(projected - chart.projectedMin) * texelsPerUnit + glm::vec2(0.5f);
+}
+
+/***********************************************************
+ *  BuildGeometry()
+ *
+ *  This method is used for writing out the lightmapped
+ *  objects, one range of indices each, with the vertices of
+ *  every chart separate so each has its own place in the
+ *  atlas.
+ ***********************************************************/
+void LightmapBaker::BuildGeometry(const std::vector<CHART>& charts, float texelsPerUnit, int padding)
+{
+	m_vertices.clear();
+	m_indices.clear();
+	m_drawObjects.clear();
+	glm::vec2 atlasScale(1.0f / m_info.width, 1.0f / m_info.height);
+
+	for (size_t objectIndex = 0; objectIndex < m_objects.size(); objectIndex++)
+	{
+		const BAKE_OBJECT& object = m_objects[objectIndex];
+		if (!object.bLightmapped)
+		{
+			continue;
+		}
+
+		LIGHTMAP_OBJECT drawObject;
+		drawObject.firstIndex = (uint32_t)m_indices.size();
+		drawObject.textureSlot = object.textureSlot;
+		drawObject.uvScaleU = object.uvScale.x;
+		drawObject.uvScaleV = object.uvScale.y;
+
+		for (const CHART& chart : charts)
+		{
+			if (chart.object != (int)objectIndex)
+			{
+				continue;
+			}
+			std::unordered_map<uint32_t, uint32_t> remap;
+			for (uint32_t t : chart.triangles)
+			{
+				for (int corner = 0; corner < 3; corner++)
+				{
+					uint32_t source = object.indices[t * 3 + corner];
+					auto inserted = remap.insert(std::make_pair(source, (uint32_t)m_vertices.size()));
+					if (inserted.second)
+					{
+						LIGHTMAP_VERTEX vertex;
+						vertex.position = object.positions[source];
+						vertex.normal = object.normals[source];
+						vertex.texCoord = object.texCoords[source];
+						vertex.lightmapCoord =
+							ProjectToChart(chart, object.positions[source], texelsPerUnit, padding) * atlasScale;
+						m_vertices.push_back(vertex);
+					}
+					m_indices.push_back(inserted.first->second);
+				}
+			}
+		}
+
+		drawObject.indexCount = (uint32_t)m_indices.size() - drawObject.firstIndex;
+		m_drawObjects.push_back(drawObject);
+	}
+}
+
+/***********************************************************
+ *  RasterizeTexels()
+ *
+ *  This method is used for finding, for every texel whose
+ *  centre a lightmapped triangle covers, the world position
+ *  and normal there and the object it belongs to.
+ ***********************************************************/
+void LightmapBaker::RasterizeTexels(std::vector<TEXEL>& texels, std::vector<int>& coverage) const
+{
+	const int width = m_info.width;
+	const int height = m_info.height;
+	texels.assign((size_t)width * height, TEXEL());
+	coverage.assign((size_t)width * height, 0);
+	glm::vec2 atlasSize((float)width, (float)height);
+
+	// draw objects follow the lightmapped objects in order
+	size_t drawIndex = 0;
+	for (size_t objectIndex = 0; objectIndex < m_objects.size(); objectIndex++)
+	{
+		if (!m_objects[objectIndex].bLightmapped)
+		{
+			continue;
+		}
+		const LIGHTMAP_OBJECT& drawObject = m_drawObjects[drawIndex++];
+		for (uint32_t i = 0; i < drawObject.indexCount; i += 3)
+		{
+			const LIGHTMAP_VERTEX& a = m_vertices[m_indices[drawObject.firstIndex + i + 0]];
+			const LIGHTMAP_VERTEX& b = m_vertices[m_indices[drawObject.firstIndex + i + 1]];
+			const LIGHTMAP_VERTEX& c = m_vertices[m_indices[drawObject.firstIndex + i + 2]];
+			glm::vec2 pa = a.lightmapCoord * atlasSize;
+			glm::vec2 pb = b.lightmapCoord * atlasSize;
+			glm::vec2 pc = c.lightmapCoord * atlasSize;
+			float area = (pb.x - pa.x) * (pc.y - pa.y) - (pb.y - pa.y) * (pc.x - pa.x);
+			if (std::fabs(area) < 1e-8f)
+			{
+				continue;
+			}
+			float invArea = 1.0f / area;
+
+			int minX = std::max(0, (int)std::floor(std::min(pa.x, std::min(pb.x, pc.x))));
+			int minY = std::max(0, (int)std::floor(std::min(pa.y, std::min(pb.y, pc.y))));
+			int maxX = std::min(width - 1, (int)std::ceil(std::max(pa.x, std::max(pb.x, pc.x))));
+			int maxY = std::min(height - 1, (int)std::ceil(std::max(pa.y, std::max(pb.y, pc.y))));
+			for (int y = minY; y <= maxY; y++)
+			{
+				for (int x = minX; x <= maxX; x++)
+				{
+					glm::vec2 p(x + 0.5f, y + 0.5f);
+					float wa = ((pb.x - p.x) * (pc.y - p.y) - (pb.y - p.y) * (pc.x - p.x)) * invArea;
+					float wb = ((pc.x - p.x) * (pa.y - p.y) - (pc.y - p.y) * (pa.x - p.x)) * invArea;
+					float wc = 1.0f - wa - wb;
+					if ((wa < -1e-4f) || (wb < -1e-4f) || (wc < -1e-4f))
+					{
+						continue;
+					}
+					size_t index = (size_t)y * width + x;
+					TEXEL& texel = texels[index];
+					texel.position = a.position * wa + b.position * wb + c.position * wc;
+					glm::vec3 normal = a.normal * wa + b.normal * wb + c.normal * wc;
+					float length = glm::length(normal);
+					texel.normal = (length > 0.0f) ? normal / length : a.normal;
+					texel.object = (int)objectIndex;
+					coverage[index] = 1;
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  DirectLight()
+ *
+ *  This method is used for adding up the light reaching a
+ *  point straight from each light that it can see, as the
+ *  scene shader's diffuse term, before the surface colour.
+ ***********************************************************/
+glm::vec3 LightmapBaker::DirectLight(const RayQuery& rayQuery, glm::vec3 position, glm::vec3 normal) const
+{
+	glm::vec3 total(0.0f);
+	glm::vec3 origin = position + normal * SURFACE_OFFSET;
+	for (const BAKE_LIGHT& light : m_lights)
+	{
+		RAY ray;
+		ray.origin = origin;
+		float attenuation = 1.0f;
+		if (light.bDirectional)
+		{
+			ray.direction = -glm::normalize(light.direction);
+			ray.maxDistance = DIRECTIONAL_SHADOW_DISTANCE;
+		}
+		else
+		{
+			glm::vec3 toLight = light.position - origin;
+			float distance = glm::length(toLight);
+			attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+			// in lengths of the ray, stopping just short of the light
+			ray.direction = toLight;
+			ray.maxDistance = 0.999f;
+		}
+		float cosine = glm::dot(normal, glm::normalize(ray.direction));
+		if ((cosine <= 0.0f) || rayQuery.AnyHit(ray))
+		{
+			continue;
+		}
+		total += light.diffuse * (cosine * attenuation);
+	}
+	return total;
+}
+
+/***********************************************************
+ *  TraceTexel()
+ *
+ *  This method is used for finding the light leaving a
+ *  texel: the lights' ambient, plus its colour times the
+ *  direct light and the light bounced off everything else.
+ *  The bounced light follows paths sampled about the normal
+ *  in proportion to the cosine, so each step just takes on
+ *  the colour of the surface it reflects from.
+ ***********************************************************/
+glm::vec3 LightmapBaker::TraceTexel(
+	const RayQuery& rayQuery,
+	const TEXEL& texel,
+	const LIGHTMAP_SETTINGS& settings,
+	uint32_t& state) const
+{
+	glm::vec3 ambient(0.0f);
+	for (const BAKE_LIGHT& light : m_lights)
+	{
+		float attenuation = 1.0f;
+		if (!light.bDirectional)
+		{
+			float distance = glm::length(light.position - texel.position);
+			attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+		}
+		ambient += light.ambient * attenuation;
+	}
+
+	glm::vec3 direct = DirectLight(rayQuery, texel.position, texel.normal);
+
+	glm::vec3 indirect(0.0f);
+	for (int sample = 0; sample < settings.samples; sample++)
+	{
+		glm::vec3 origin = texel.position + texel.normal * SURFACE_OFFSET;
+		glm::vec3 direction = SampleCosine(texel.normal, state);
+		glm::vec3 throughput(1.0f);
+		for (int bounce = 0; bounce < settings.bounces; bounce++)
+		{
+			RAY ray;
+			ray.origin = origin;
+			ray.direction = direction;
+			RAY_HIT hit;
+			if (!rayQuery.ClosestHit(ray, hit))
+			{
+				indirect += throughput * settings.skyColor;
+				break;
+			}
+
+			const BAKE_OBJECT& object = m_objects[hit.instance];
+			glm::vec3 a = object.positions[object.indices[hit.triangle * 3 + 0]];
+			glm::vec3 b = object.positions[object.indices[hit.triangle * 3 + 1]];
+			glm::vec3 c = object.positions[object.indices[hit.triangle * 3 + 2]];
+			glm::vec3 normal = glm::normalize(glm::cross(b - a, c - a));
+			if (glm::dot(normal, direction) > 0.0f)
+			{
+				normal = -normal;
+			}
+			glm::vec3 position = origin + direction * hit.distance;
+
+			throughput *= object.diffuseColor;
+			indirect += throughput * DirectLight(rayQuery, position, normal);
+
+			origin = position + normal * SURFACE_OFFSET;
+			direction = SampleCosine(normal, state);
+		}
+	}
+	if (settings.samples > 0)
+	{
+		indirect /= (float)settings.samples;
+	}
+
+	return ambient + m_objects[texel.object].diffuseColor * (direct + indirect);
+}
+
+/***********************************************************
+ *  DilateTexels()
+ *
+ *  This method is used for growing each chart into its
+ *  padding, one texel a pass, so filtering at the chart's
+ *  edge never blends in the empty space around it.
+ ***********************************************************/
+void LightmapBaker::DilateTexels(std::vector<glm::vec3>& light, std::vector<int>& coverage, int width, int height, int passes)
+{
+	std::vector<int> next;
+	for (int pass = 0; pass < passes; pass++)
+	{
+		next = coverage;
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				size_t index = (size_t)y * width + x;
+				if (coverage[index])
+				{
+					continue;
+				}
+				glm::vec3 sum(0.0f);
+				int count = 0;
+				for (int dy = -1; dy <= 1; dy++)
+				{
+					for (int dx = -1; dx <= 1; dx++)
+					{
+						int nx = x + dx;
+						int ny = y + dy;
+						if ((nx < 0) || (ny < 0) || (nx >= width) || (ny >= height))
+						{
+							continue;
+						}
+						size_t neighbour = (size_t)ny * width + nx;
+						if (coverage[neighbour])
+						{
+							sum += light[neighbour];
+							count++;
+						}
+					}
+				}
+				if (count > 0)
+				{
+					light[index] = sum / (float)count;
+					next[index] = 1;
+				}
+			}
+		}
+		coverage.swap(next);
+	}
+}
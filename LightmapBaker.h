@@ -0,0 +1,205 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmapbaker.h
+// ============
+// offline path traced lightmaps for the static geometry
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshData.h"
+#include "RayQuery.h"
+#include "ThreadPool.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  LIGHTMAP_SETTINGS
+ *
+ *  How finely and how carefully the lightmap is baked.
+ ***********************************************************/
+struct LIGHTMAP_SETTINGS
+{
+	// lightmap texels per world unit, lowered if the charts do not fit
+	float texelsPerUnit = 8.0f;
+	// width of the atlas, and the most its height may grow to
+	int atlasSize = 1024;
+	// empty texels around each chart, filled by dilation
+	int chartPadding = 2;
+	// paths traced from each texel for the indirect light
+	int samples = 64;
+	// bounces along each path
+	int bounces = 2;
+	// light arriving along rays that leave the scene
+	glm::vec3 skyColor = glm::vec3(0.0f);
+};
+
+/***********************************************************
+ *  BAKE_LIGHT
+ *
+ *  A light as the scene shader applies it: a directional
+ *  light, or a point light with its attenuation. ambient is
+ *  added unshadowed, attenuated like the rest of the light.
+ ***********************************************************/
+struct BAKE_LIGHT
+{
+	bool bDirectional = false;
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+	glm::vec3 ambient = glm::vec3(0.0f);
+	glm::vec3 diffuse = glm::vec3(1.0f);
+	float constant = 1.0f;
+	float linear = 0.0f;
+	float quadratic = 0.0f;
+};
+
+/***********************************************************
+ *  LIGHTMAP_VERTEX
+ *
+ *  A lightmapped vertex, already in world space, with its
+ *  texture coordinate and its place in the lightmap.
+ ***********************************************************/
+struct LIGHTMAP_VERTEX
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texCoord;
+	glm::vec2 lightmapCoord;
+};
+
+/***********************************************************
+ *  LIGHTMAP_OBJECT
+ *
+ *  The index range of one lightmapped object, and the
+ *  texture slot and UV scale it is drawn with.
+ ***********************************************************/
+struct LIGHTMAP_OBJECT
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	int32_t textureSlot;
+	float uvScaleU;
+	float uvScaleV;
+};
+
+/***********************************************************
+ *  LIGHTMAP_INFO
+ *
+ *  Size of the lightmap, and the value its brightest texel
+ *  stands for.
+ ***********************************************************/
+struct LIGHTMAP_INFO
+{
+	int32_t width;
+	int32_t height;
+	float range;
+	uint32_t pad;
+};
+
+/***********************************************************
+ *  LightmapBaker
+ *
+ *  This class bakes the light falling on static objects into
+ *  one atlas. Each object is unwrapped into charts - groups
+ *  of connected triangles facing the same axis, projected
+ *  onto that axis's plane - which are shelf packed. Every
+ *  covered texel then traces shadow rays to each light and
+ *  paths for the light bouncing off the rest of the scene,
+ *  through a RayQuery, rows spread across the pool. The
+ *  result is the object's diffuse colour times the light,
+ *  so drawing is one fetch times the texture. It is written
+ *  BC1 compressed, with the unwrapped geometry, in a snapshot
+ *  file tagged with a hash of the scene that made it.
+ ***********************************************************/
+class LightmapBaker
+{
+public:
+	// constructor
+	LightmapBaker();
+
+	// add an object that gets a lightmap, drawn with the texture slot
+	void AddObject(
+		const MESH_DATA& mesh,
+		const glm::mat4& model,
+		glm::vec3 diffuseColor,
+		int textureSlot,
+		glm::vec2 uvScale);
+	// add an object that only casts shadows and bounces light
+	void AddOccluder(const MESH_DATA& mesh, const glm::mat4& model, glm::vec3 diffuseColor);
+	void AddLight(const BAKE_LIGHT& light);
+
+	// hash of the objects and lights, which a baked file must match
+	uint32_t GetSceneHash() const;
+
+	// unwrap, trace and compress; false if there is nothing to bake
+	bool Bake(const LIGHTMAP_SETTINGS& settings, ThreadPool* pPool);
+	// write the baked lightmap and geometry
+	bool Write(const std::string& filename) const;
+
+	// the value of a full texel; the shader scales the fetch by this
+	static const float LIGHTMAP_RANGE;
+
+private:
+	// an object in world space
+	struct BAKE_OBJECT
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> texCoords;
+		std::vector<uint32_t> indices;
+		glm::vec3 diffuseColor;
+		int textureSlot;
+		glm::vec2 uvScale;
+		bool bLightmapped;
+	};
+	// connected triangles of one object unwrapped together
+	struct CHART
+	{
+		int object;
+		std::vector<uint32_t> triangles;
+		// the axis the chart faces, and its two projected axes
+		int axis;
+		glm::vec2 projectedMin;
+		glm::vec2 projectedMax;
+		// size and place in the atlas, in texels, padding included
+		int width;
+		int height;
+		int x;
+		int y;
+	};
+	// what a texel covers: a world position and normal
+	struct TEXEL
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		int object;
+	};
+
+	std::vector<BAKE_OBJECT> m_objects;
+	std::vector<BAKE_LIGHT> m_lights;
+
+	// results of Bake()
+	LIGHTMAP_INFO m_info;
+	std::vector<LIGHTMAP_VERTEX> m_vertices;
+	std::vector<uint32_t> m_indices;
+	std::vector<LIGHTMAP_OBJECT> m_drawObjects;
+	std::vector<unsigned char> m_blocks;
+
+	void BuildCharts(std::vector<CHART>& charts) const;
+	bool PackCharts(std::vector<CHART>& charts, float texelsPerUnit, int padding, int atlasSize, int& atlasHeight) const;
+	glm::vec2 ProjectToChart(const CHART& chart, glm::vec3 position, float texelsPerUnit, int padding) const;
+	void BuildGeometry(const std::vector<CHART>& charts, float texelsPerUnit, int padding);
+	void RasterizeTexels(std::vector<TEXEL>& texels, std::vector<int>& coverage) const;
+
+	glm::vec3 DirectLight(const RayQuery& rayQuery, glm::vec3 position, glm::vec3 normal) const;
+	glm::vec3 TraceTexel(
+		const RayQuery& rayQuery,
+		const TEXEL& texel,
+		const LIGHTMAP_SETTINGS& settings,
+		uint32_t& state) const;
+	static void DilateTexels(std::vector<glm::vec3>& light, std::vector<int>& coverage, int width, int height, int passes);
+};
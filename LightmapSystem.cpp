@@ -0,0 +1,188 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmapsystem.cpp
+// ============
+// draws the static objects with the light baked by LightmapBaker
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightmapSystem.h"
+
+#include "SceneSnapshot.h"
+#include "TextureCompressor.h"
+
+#include <cstddef>
+#include <iostream>
+
+namespace
+{
+	// after the 16 scene texture units
+	const GLint LIGHTMAP_TEXTURE_UNIT = 16;
+}
+
+/***********************************************************
+ *  LightmapSystem()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightmapSystem::LightmapSystem()
+{
+	m_pShader = NULL;
+	m_texture = 0;
+	m_vao = 0;
+	m_vbo = 0;
+	m_ebo = 0;
+	m_range = 1.0f;
+	m_bLoaded = false;
+}
+
+/***********************************************************
+ *  ~LightmapSystem()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LightmapSystem::~LightmapSystem()
+{
+	if (m_ebo != 0)
+	{
+		glDeleteBuffers(1, &m_ebo);
+	}
+	if (m_vbo != 0)
+	{
+		glDeleteBuffers(1, &m_vbo);
+	}
+	if (m_vao != 0)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+	}
+	if (m_texture != 0)
+	{
+		glDeleteTextures(1, &m_texture);
+	}
+	delete m_pShader;
+	m_pShader = NULL;
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for reading a baked lightmap file,
+ *  checking it was baked for this scene and is complete,
+ *  then uploading the lightmap and the geometry and loading
+ *  the shaders. The blocks go to the driver as they are.
+ ***********************************************************/
+bool LightmapSystem::Load(const std::string& filename, uint32_t sceneHash)
+{
+	if (!TextureCompressor::IsSupported())
+	{
+		std::cout << "[LightmapSystem] BC1 textures are not supported; lighting per pixel" << std::endl;
+		return false;
+	}
+
+	SceneSnapshot file;
+	if (!file.Open(filename, sceneHash))
+	{
+		std::cout << "[LightmapSystem] No lightmap baked for this scene in " << filename
+			<< "; run with --bake-lightmaps to bake one" << std::endl;
+		return false;
+	}
+
+	size_t infoCount = 0;
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+	size_t blockBytes = 0;
+	const LIGHTMAP_INFO* info = file.GetArray<LIGHTMAP_INFO>(SNAPSHOT_LIGHTMAP_INFO, infoCount);
+	const LIGHTMAP_VERTEX* vertices = file.GetArray<LIGHTMAP_VERTEX>(SNAPSHOT_LIGHTMAP_VERTICES, vertexCount);
+	const uint32_t* indices = file.GetArray<uint32_t>(SNAPSHOT_LIGHTMAP_INDICES, indexCount);
+	const unsigned char* blocks = file.GetArray<unsigned char>(SNAPSHOT_LIGHTMAP_BLOCKS, blockBytes);
+	if ((NULL == info) || (infoCount != 1) || (NULL == vertices) || (NULL == indices) || (NULL == blocks) ||
+		!file.CopyArray(SNAPSHOT_LIGHTMAP_OBJECTS, m_objects) ||
+		(blockBytes != (size_t)((info->width + 3) / 4) * ((info->height + 3) / 4) * 8))
+	{
+		std::cout << "[LightmapSystem] " << filename << " is incomplete" << std::endl;
+		m_objects.clear();
+		return false;
+	}
+	m_range = info->range;
+
+	glGenTextures(1, &m_texture);
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+	glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+		info->width, info->height, 0, (GLsizei)blockBytes, blocks);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenVertexArrays(1, &m_vao);
+	glBindVertexArray(m_vao);
+
+	glGenBuffers(1, &m_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(LIGHTMAP_VERTEX), vertices, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LIGHTMAP_VERTEX), (void*)offsetof(LIGHTMAP_VERTEX, position));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(LIGHTMAP_VERTEX), (void*)offsetof(LIGHTMAP_VERTEX, texCoord));
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(LIGHTMAP_VERTEX), (void*)offsetof(LIGHTMAP_VERTEX, lightmapCoord));
+
+	glGenBuffers(1, &m_ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(uint32_t), indices, GL_STATIC_DRAW);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	m_pShader = new ShaderManager();
+	m_pShader->LoadShaders(
+		"shaders/lightmapVertexShader.glsl",
+		"shaders/lightmapFragmentShader.glsl");
+
+	std::cout << "[LightmapSystem] Loaded a " << info->width << "x" << info->height
+		<< " lightmap for " << m_objects.size() << " objects" << std::endl;
+	m_bLoaded = true;
+	return true;
+}
+
+/***********************************************************
+ *  Render()
+ *
+ *  This method is used for drawing the lightmapped objects,
+ *  one indexed draw each, with the texture slot and UV scale
+ *  each was baked with.
+ ***********************************************************/
+void LightmapSystem::Render(const VIEW_INFO& viewInfo)
+{
+	if (!m_bLoaded || m_objects.empty())
+	{
+		return;
+	}
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+	m_pShader->use();
+	m_pShader->setMat4Value("view", viewInfo.view);
+	m_pShader->setMat4Value("projection", viewInfo.projection);
+	m_pShader->setSampler2DValue("lightmapTexture", LIGHTMAP_TEXTURE_UNIT);
+	m_pShader->setFloatValue("lightmapRange", m_range);
+
+	glActiveTexture(GL_TEXTURE0 + LIGHTMAP_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+
+	glBindVertexArray(m_vao);
+	for (const LIGHTMAP_OBJECT& object : m_objects)
+	{
+		m_pShader->setSampler2DValue("objectTexture", object.textureSlot);
+		m_pShader->setVec2Value("UVscale", glm::vec2(object.uvScaleU, object.uvScaleV));
+		glDrawElements(GL_TRIANGLES, (GLsizei)object.indexCount, GL_UNSIGNED_INT,
+			(void*)(object.firstIndex * sizeof(uint32_t)));
+	}
+	glBindVertexArray(0);
+
+	glActiveTexture(GL_TEXTURE0);
+	glUseProgram(previousProgram);
+}
@@ -0,0 +1,54 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmapsystem.h
+// ============
+// draws the static objects with the light baked by LightmapBaker
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "LightmapBaker.h"
+#include "ShaderManager.h"
+#include "ViewManager.h"
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  LightmapSystem
+ *
+ *  This class loads a baked lightmap file and draws the
+ *  objects in it. Their geometry is already in world space
+ *  and their light is already in the lightmap, so each pixel
+ *  is its texture times one lightmap fetch, with no lights
+ *  evaluated at all. The scene textures stay bound to units
+ *  0-15 and the lightmap goes on a unit after them.
+ ***********************************************************/
+class LightmapSystem
+{
+public:
+	// constructor
+	LightmapSystem();
+	// destructor
+	~LightmapSystem();
+
+	// load a lightmap baked for the scene with this hash; false if it is
+	// missing, stale or cannot be sampled here
+	bool Load(const std::string& filename, uint32_t sceneHash);
+	bool IsLoaded() const { return m_bLoaded; }
+
+	// draw every lightmapped object, with the scene textures bound
+	void Render(const VIEW_INFO& viewInfo);
+
+	int GetObjectCount() const { return (int)m_objects.size(); }
+
+private:
+	ShaderManager* m_pShader;
+	GLuint m_texture;
+	GLuint m_vao;
+	GLuint m_vbo;
+	GLuint m_ebo;
+	float m_range;
+	std::vector<LIGHTMAP_OBJECT> m_objects;
+	bool m_bLoaded;
+};
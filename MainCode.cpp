@@ -9,6 +9,14 @@
 
 #include <iostream>         // error handling and output
 #include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // strcmp
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -22,6 +30,16 @@
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "MeshSimplifier.h"
+#include "StressScene.h"
+#include "StereoTarget.h"
+#include "CameraPath.h"
+#include "VideoExporter.h"
+#include "FrameBenchmark.h"
+#include "AssetIO.h"
+#include "JpegDecoder.h"
+#include "StartupProfiler.h"
+#include "LatencyMonitor.h"
 
 // Namespace for declaring global variables
 namespace
@@ -38,12 +56,75 @@ namespace
 	ShaderManager* g_ShaderManager = nullptr;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
+	// generated stress scene, used instead of the campsite with --stress
+	StressScene* g_StressScene = nullptr;
+
+	// command line options
+	bool g_bStressScene = false;
+	STRESS_SETTINGS g_StressSettings;
+	bool g_bBenchmark = false;
+	int g_BenchmarkFrames = 300;
+	int g_BenchmarkWarmup = 60;
+	std::string g_BenchmarkOutput = "benchmark.csv";
+	std::vector<int> g_SweepObjects;
+	std::vector<int> g_SweepThreads;
+	// prepared scene saved on the first run and mapped on later ones
+	std::string g_SnapshotFile = "scene.snapshot";
+	// baked light for the static objects, and how to bake it
+	std::string g_LightmapFile = "scene.lightmap";
+	bool g_bBakeLightmaps = false;
+	LIGHTMAP_SETTINGS g_LightmapSettings;
+	// views shown from the start; both can be toggled while running
+	bool g_bSplitScreen = false;
+	bool g_bMinimap = false;
+	// both eyes of the first camera drawn in one pass, side by side, and
+	// the target they are drawn to, created by the render thread
+	bool g_bStereo = false;
+	float g_EyeSeparation = 0.065f;
+	StereoTarget* g_StereoTarget = nullptr;
+
+	// flythrough export: where it goes, how long it is (0 for the whole
+	// camera path) and the path, read from a file or circling the scene
+	bool g_bExport = false;
+	VIDEO_EXPORT_SETTINGS g_ExportSettings;
+	float g_ExportSeconds = 0.0f;
+	std::string g_CameraPathFile;
+	CameraPath g_CameraPath;
+	const float EXPORT_FOV_DEGREES = 60.0f;
+
+	// startup phases, timed from when the globals are constructed
+	StartupProfiler g_StartupProfiler;
+	std::string g_ProfileOutput;
+	std::string g_StartupBenchmarkOutput;
+	int g_StartupRuns = 5;
+	// a profiled run that has not loaded by then gives up
+	const double PROFILE_TIMEOUT_MS = 60000.0;
+
+	// runs of the stress benchmark, drawn by the render thread, which
+	// clears the flag when it is done
+	std::vector<STRESS_SETTINGS> g_BenchmarkRuns;
+	std::atomic<bool> g_bRendering(false);
+
+	// input latency is printed this often, and written per run when
+	// benchmarking; a benchmark times a probe event this often, as no
+	// one is using the controls
+	const double LATENCY_REPORT_SECONDS = 5.0;
+	const double LATENCY_PROBE_SECONDS = 0.005;
+	std::string g_LatencyOutput = "latency.csv";
 }
 
 // Function declarations - all functions that are called manually
 // need to be pre-declared at the beginning of the source code.
 bool InitializeGLFW();
 bool InitializeGLEW();
+void RenderLoop();
+bool BakeLODChain(const char* meshFile, const char* lodFile);
+bool BakeLightmaps();
+bool BenchmarkDecoders(const char* outputFile, int fileCount, char* files[]);
+bool BenchmarkStartup(int argc, char* argv[]);
+bool ParseCommandLine(int argc, char* argv[]);
+std::vector<STRESS_SETTINGS> MakeBenchmarkRuns();
+BENCHMARK_RESULT DescribeRun(const STRESS_SETTINGS& settings);
 
 
 /***********************************************************
@@ -54,81 +135,482 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
-	// if GLFW fails initialization, then terminate the application
-	if (InitializeGLFW() == false)
+	// offline LOD baking - simplify a mesh into a LOD chain file and exit
+	if ((argc >= 4) && (strcmp(argv[1], "--bake-lods") == 0))
+	{
+		return(BakeLODChain(argv[2], argv[3]) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// offline decoder comparison - time every image decoder on the files
+	if ((argc >= 4) && (strcmp(argv[1], "--bench-decoders") == 0))
+	{
+		return(BenchmarkDecoders(argv[2], argc - 3, argv + 3) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// stress scene and benchmark options
+	if (ParseCommandLine(argc, argv) == false)
 	{
 		return(EXIT_FAILURE);
 	}
 
+	// the campsite's scene shader has no stereo variant
+	if (g_bStereo && !g_bStressScene)
+	{
+		std::cout << "[Stereo] Single pass stereo draws the stress scene; run with --stress" << std::endl;
+		g_bStereo = false;
+	}
+
+	// offline lightmap baking - trace the static objects' light and exit
+	if (g_bBakeLightmaps)
+	{
+		return(BakeLightmaps() ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// startup benchmark - run this program repeatedly, profiling startup
+	if (!g_StartupBenchmarkOutput.empty())
+	{
+		return(BenchmarkStartup(argc, argv) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
 	// try to create a new shader manager object
 	g_ShaderManager = new ShaderManager();
+
+	// start reading the snapshot or building the campground on the loader
+	// workers now, so it overlaps creating the window and compiling the
+	// shaders; PrepareScene() joins it once there is a context
+	if (!g_bStressScene)
+	{
+		g_StartupProfiler.BeginPhase("begin_prepare_scene");
+		g_SceneManager = new SceneManager(g_ShaderManager);
+		g_SceneManager->SetSnapshotFile(g_SnapshotFile);
+		g_SceneManager->SetLightmapFile(g_LightmapFile);
+		g_SceneManager->SetStartupProfiler(&g_StartupProfiler);
+		g_SceneManager->BeginPrepareScene();
+		g_StartupProfiler.EndPhase();
+	}
+
+	// if GLFW fails initialization, then terminate the application
+	g_StartupProfiler.BeginPhase("glfw_init");
+	if (InitializeGLFW() == false)
+	{
+		return(EXIT_FAILURE);
+	}
+	g_StartupProfiler.EndPhase();
+
+	// a headless export never shows its window
+	if (g_ExportSettings.bHeadless)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
+
 	// try to create a new view manager object
 	g_ViewManager = new ViewManager(
 		g_ShaderManager);
+	ViewManager::SetSplitScreen(g_bSplitScreen);
+	ViewManager::SetMinimap(g_bMinimap);
 
 	// try to create the main display window
+	g_StartupProfiler.BeginPhase("create_window");
 	g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
+	g_StartupProfiler.EndPhase();
 
 	// if GLEW fails initialization, then terminate the application
+	g_StartupProfiler.BeginPhase("glew_init");
 	if (InitializeGLEW() == false)
 	{
 		return(EXIT_FAILURE);
 	}
+	g_StartupProfiler.EndPhase();
 
 	// load the shader code from the external GLSL files
+	g_StartupProfiler.BeginPhase("load_shaders");
 	g_ShaderManager->LoadShaders(
 		"shaders/vertexShader.glsl",
 		"shaders/fragmentShader.glsl");
 	g_ShaderManager->use();
+	g_StartupProfiler.EndPhase();
+
+	// the stress scene replaces the campsite, otherwise prepare the 3D scene
+	g_BenchmarkRuns = MakeBenchmarkRuns();
+	g_StartupProfiler.BeginPhase("prepare_scene");
+	if (g_bStressScene)
+	{
+		g_StressScene = new StressScene();
+		g_StressScene->Generate(g_BenchmarkRuns[0]);
+	}
+	else
+	{
+		g_SceneManager->PrepareScene();
+	}
+	g_StartupProfiler.EndPhase();
+
+	// the export follows the camera path given, or circles the scene
+	if (g_bExport)
+	{
+		if (!g_CameraPathFile.empty())
+		{
+			if (!g_CameraPath.Load(g_CameraPathFile))
+			{
+				return(EXIT_FAILURE);
+			}
+		}
+		else if (NULL != g_StressScene)
+		{
+			g_CameraPath.MakeOrbit(glm::vec3(0.0f, 2.0f, 0.0f), g_StressScene->GetWorldRadius() * 0.6f, 12.0f, 30.0f);
+		}
+		else
+		{
+			g_CameraPath.MakeOrbit(glm::vec3(0.0f, 1.0f, -3.0f), 16.0f, 5.0f, 20.0f);
+		}
+		g_ExportSettings.duration = (g_ExportSeconds > 0.0f) ? g_ExportSeconds : g_CameraPath.GetDuration();
+	}
+
+	// frames are drawn on a thread of their own, leaving this one - the
+	// only thread GLFW takes window events on - waiting for input, so
+	// every event is timestamped and gathered the moment it arrives
+	glfwMakeContextCurrent(NULL);
+	g_bRendering = true;
+	std::thread renderThread(RenderLoop);
+	while (g_bRendering)
+	{
+		if (g_bBenchmark)
+		{
+			glfwWaitEventsTimeout(LATENCY_PROBE_SECONDS);
+			ViewManager::AddProbeEvent();
+		}
+		else
+		{
+			glfwWaitEvents();
+		}
+	}
+	renderThread.join();
+	glfwMakeContextCurrent(g_Window);
+
+	// clear the allocated manager objects from memory
+	if (NULL != g_StressScene)
+	{
+		delete g_StressScene;
+		g_StressScene = NULL;
+	}
+	if (NULL != g_SceneManager)
+	{
+		delete g_SceneManager;
+		g_SceneManager = NULL;
+	}
+	if (NULL != g_ViewManager)
+	{
+		delete g_ViewManager;
+		g_ViewManager = NULL;
+	}
+	if (NULL != g_ShaderManager)
+	{
+		delete g_ShaderManager;
+		g_ShaderManager = NULL;
+	}
+
+	// Terminates the program successfully
+	exit(EXIT_SUCCESS); 
+}
 
-	// try to create a new scene manager object and prepare the 3D scene
-	g_SceneManager = new SceneManager(g_ShaderManager);
-	g_SceneManager->PrepareScene();
+/***********************************************************
+ *	RenderLoop()
+ *
+ *  This function is used to draw frames on the render thread
+ *  until the window is closed, or a benchmark or profiled
+ *  run is done. The work that does not need the camera comes
+ *  first in each frame, so the input is latched as late as
+ *  it can be before the frame is submitted.
+ ***********************************************************/
+void RenderLoop()
+{
+	glfwMakeContextCurrent(g_Window);
+
+	// benchmark runs measure unthrottled frames over a fixed camera path
+	FrameBenchmark benchmark;
+	std::vector<BENCHMARK_RESULT> benchmarkResults;
+	size_t benchmarkRun = 0;
+	int benchmarkFrame = 0;
+	if (g_bBenchmark)
+	{
+		glfwSwapInterval(0);
+		benchmark.Begin(DescribeRun(g_BenchmarkRuns[0]), g_BenchmarkWarmup, g_BenchmarkFrames);
+	}
+	double lastFrameTime = glfwGetTime();
+
+	// time from each input event to the frame applying it being shown
+	LatencyMonitor* pLatency = new LatencyMonitor();
+	std::vector<LATENCY_SUMMARY> latencyResults;
+	double latencyReportTime = lastFrameTime;
+
+	// an export draws the camera path a fixed step a frame, as fast as
+	// the frames can be drawn and read back
+	VideoExporter* pExporter = NULL;
+	int exportFrame = 0;
+	if (g_bExport)
+	{
+		glfwSwapInterval(0);
+		pExporter = new VideoExporter();
+		// the frames are the size of the framebuffer the views fill
+		int framebufferWidth = 0;
+		int framebufferHeight = 0;
+		glfwGetFramebufferSize(g_Window, &framebufferWidth, &framebufferHeight);
+		if (!pExporter->Open(g_ExportSettings, framebufferWidth, framebufferHeight))
+		{
+			delete pExporter;
+			pExporter = NULL;
+			glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+		}
+	}
 
 	// loop will keep running until the application is closed 
 	// or until an error has occurred
 	while (!glfwWindowShouldClose(g_Window))
 	{
+		// an exported frame shows its own time, not the clock's
+		double exportTime = (NULL != pExporter) ? pExporter->GetFrameTime(exportFrame) : 0.0;
+		if ((NULL != pExporter) && (NULL != g_SceneManager))
+		{
+			g_SceneManager->SetSceneTime(exportTime);
+		}
+
+		// everything that does not need the camera - asset loads, lights,
+		// textures and reflections - is done before the input is latched
+		if (NULL != g_SceneManager)
+		{
+			g_SceneManager->UpdateAssets();
+		}
+
+		// headless, the frame is drawn offscreen
+		if (NULL != pExporter)
+		{
+			pExporter->BeginFrame();
+		}
+
 		// Enable z-depth
 		glEnable(GL_DEPTH_TEST);
+		glEnable(GL_MULTISAMPLE);
 
 		// Clear the frame and z buffers
 		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// convert from 3D object space to 2D view
+		// convert from 3D object space to 2D view, with the latest input
 		g_ViewManager->PrepareSceneView();
 
 		// refresh the 3D scene
-		g_SceneManager->RenderScene();
+		double cpuUpdateTime = 0.0;
+		if (NULL != g_StressScene)
+		{
+			// every view is culled in one pass, then drawn into its viewport
+			std::vector<SCENE_VIEW> views = g_ViewManager->GetViews();
+			double sceneTime = glfwGetTime();
+			if (g_bBenchmark)
+			{
+				views[0].viewInfo = g_StressScene->GetBenchmarkView(
+					benchmarkFrame, views[0].viewInfo.viewportWidth, views[0].viewInfo.viewportHeight);
+				sceneTime = benchmarkFrame / 60.0;
+			}
+			else if (NULL != pExporter)
+			{
+				views[0].viewInfo = g_CameraPath.Evaluate(exportTime, glm::radians(EXPORT_FOV_DEGREES),
+					views[0].viewInfo.viewportWidth, views[0].viewInfo.viewportHeight);
+				sceneTime = exportTime;
+			}
+
+			// stereo draws the first camera's eyes, each half its viewport
+			if (g_bStereo && (NULL == g_StereoTarget))
+			{
+				g_StereoTarget = new StereoTarget();
+				if (!g_StereoTarget->Initialize(views[0].width / 2, views[0].height))
+				{
+					delete g_StereoTarget;
+					g_StereoTarget = NULL;
+					g_bStereo = false;
+				}
+			}
+
+			if (NULL != g_StereoTarget)
+			{
+				// culled once, for a view enclosing both eyes, and drawn once
+				VIEW_INFO eyes[2];
+				VIEW_INFO cullView;
+				g_StereoTarget->MakeEyes(views[0].viewInfo, g_EyeSeparation, eyes, cullView);
+
+				double updateStart = glfwGetTime();
+				g_StressScene->Update(sceneTime, cullView);
+				cpuUpdateTime = glfwGetTime() - updateStart;
 
+				g_StereoTarget->Begin(eyes);
+				g_StressScene->RenderStereo(
+					g_StereoTarget->GetMode(),
+					glm::vec3(-0.5f, -0.5f, -1.0f),
+					glm::vec3(0.9f, 0.9f, 0.9f),
+					glm::vec3(0.4f, 0.4f, 0.4f));
+				g_StereoTarget->End();
+				g_StereoTarget->Present(views[0].x, views[0].y, views[0].width, views[0].height);
+			}
+			else
+			{
+				std::vector<VIEW_INFO> viewInfos;
+				for (const SCENE_VIEW& view : views)
+				{
+					viewInfos.push_back(view.viewInfo);
+				}
+
+				double updateStart = glfwGetTime();
+				g_StressScene->Update(sceneTime, viewInfos);
+				cpuUpdateTime = glfwGetTime() - updateStart;
+
+				for (size_t i = 0; i < views.size(); i++)
+				{
+					ViewManager::BeginView(views[i]);
+					g_StressScene->Render(
+						(int)i,
+						viewInfos[i],
+						glm::vec3(-0.5f, -0.5f, -1.0f),
+						glm::vec3(0.9f, 0.9f, 0.9f),
+						glm::vec3(0.4f, 0.4f, 0.4f));
+				}
+				ViewManager::EndViews();
+			}
+		}
+		else
+		{
+			std::vector<SCENE_VIEW> views = g_ViewManager->GetViews();
+			if (NULL != pExporter)
+			{
+				views[0].viewInfo = g_CameraPath.Evaluate(exportTime, glm::radians(EXPORT_FOV_DEGREES),
+					views[0].viewInfo.viewportWidth, views[0].viewInfo.viewportHeight);
+			}
+			g_SceneManager->RenderViews(views);
+
+			// report what a click picked, under the crosshair
+			if (g_ViewManager->IsPickRequested())
+			{
+				const VIEW_INFO& viewInfo = g_ViewManager->GetViewInfo();
+				RAY_HIT hit;
+				double pickStart = glfwGetTime();
+				bool bHit = g_SceneManager->PickObject(
+					viewInfo, 0.5f * viewInfo.viewportWidth, 0.5f * viewInfo.viewportHeight, hit);
+				double pickTime = glfwGetTime() - pickStart;
+				if (bHit)
+				{
+					std::cout << "[RayQuery] Picked instance " << hit.instance
+						<< " at " << hit.distance << " units in " << pickTime * 1.0e6 << " us" << std::endl;
+				}
+				else
+				{
+					std::cout << "[RayQuery] Nothing under the crosshair (" << pickTime * 1.0e6 << " us)" << std::endl;
+				}
+			}
+		}
+
+
+		// the frame is exported once nothing in it is still loading; until
+		// then the same time is drawn again
+		bool bExportDone = false;
+		if ((NULL != pExporter) && ((NULL == g_SceneManager) || !g_SceneManager->IsLoading()))
+		{
+			pExporter->CaptureFrame();
+			exportFrame++;
+			bExportDone = (exportFrame >= pExporter->GetTotalFrames());
+		}
 
 		// Flips the the back buffer with the front buffer every frame.
-		glfwSwapBuffers(g_Window);
+		if (!g_ExportSettings.bHeadless)
+		{
+			glfwSwapBuffers(g_Window);
+		}
+		pLatency->RecordFrame(g_ViewManager->GetLatchedInputTimes(), g_ViewManager->GetLatchTime(), glfwGetTime());
+		if (bExportDone)
+		{
+			break;
+		}
+		if (!g_StartupProfiler.HasEvent("first_frame"))
+		{
+			// when profiling, wait for the frame to really be finished
+			if (!g_ProfileOutput.empty())
+			{
+				glFinish();
+			}
+			g_StartupProfiler.Mark("first_frame");
+			std::cout << "[Startup] First frame after " << g_StartupProfiler.GetElapsedMs() << " ms" << std::endl;
+		}
+
+		// a profiled run ends once everything it asked for has loaded
+		if (!g_ProfileOutput.empty())
+		{
+			if ((NULL == g_SceneManager) || !g_SceneManager->IsLoading())
+			{
+				g_StartupProfiler.Mark("scene_loaded");
+				break;
+			}
+			if (g_StartupProfiler.GetElapsedMs() > PROFILE_TIMEOUT_MS)
+			{
+				g_StartupProfiler.Mark("timeout");
+				break;
+			}
+		}
 
-		// query the latest GLFW events
-		glfwPollEvents();
+		// record the frame, moving to the next run when one completes
+		double frameEnd = glfwGetTime();
+		if (g_bBenchmark && (benchmarkFrame == g_BenchmarkWarmup))
+		{
+			// latency is measured over the same frames as the frame times
+			pLatency->Reset();
+		}
+		if (g_bBenchmark && benchmark.RecordFrame(frameEnd - lastFrameTime, cpuUpdateTime))
+		{
+			benchmarkResults.push_back(benchmark.GetResult());
+			pLatency->Flush();
+			std::vector<LATENCY_SUMMARY> summaries = pLatency->Summarise(benchmarkResults.back().label);
+			LatencyMonitor::Print(summaries);
+			latencyResults.insert(latencyResults.end(), summaries.begin(), summaries.end());
+			if (++benchmarkRun >= g_BenchmarkRuns.size())
+			{
+				break;
+			}
+			g_StressScene->Generate(g_BenchmarkRuns[benchmarkRun]);
+			benchmark.Begin(DescribeRun(g_BenchmarkRuns[benchmarkRun]), g_BenchmarkWarmup, g_BenchmarkFrames);
+			benchmarkFrame = 0;
+			frameEnd = glfwGetTime();
+		}
+		else if (!g_bBenchmark && (frameEnd - latencyReportTime >= LATENCY_REPORT_SECONDS))
+		{
+			if (pLatency->GetEventCount() > 0)
+			{
+				LatencyMonitor::Print(pLatency->Summarise("interactive"));
+			}
+			pLatency->Reset();
+			latencyReportTime = frameEnd;
+		}
+		benchmarkFrame++;
+		lastFrameTime = frameEnd;
 	}
 
-	// clear the allocated manager objects from memory
-	if (NULL != g_SceneManager)
+	if (g_bBenchmark)
 	{
-		delete g_SceneManager;
-		g_SceneManager = NULL;
+		FrameBenchmark::WriteCSV(g_BenchmarkOutput.c_str(), benchmarkResults);
+		LatencyMonitor::WriteCSV(g_LatencyOutput.c_str(), latencyResults);
 	}
-	if (NULL != g_ViewManager)
+	delete pLatency;
+	pLatency = NULL;
+	if (NULL != pExporter)
 	{
-		delete g_ViewManager;
-		g_ViewManager = NULL;
+		pExporter->Finish();
+		delete pExporter;
+		pExporter = NULL;
 	}
-	if (NULL != g_ShaderManager)
+	delete g_StereoTarget;
+	g_StereoTarget = NULL;
+	if (!g_ProfileOutput.empty())
 	{
-		delete g_ShaderManager;
-		g_ShaderManager = NULL;
+		g_StartupProfiler.WriteJSON(g_ProfileOutput.c_str());
 	}
 
-	// Terminates the program successfully
-	exit(EXIT_SUCCESS); 
+	glfwMakeContextCurrent(NULL);
+	g_bRendering = false;
+	glfwPostEmptyEvent();
 }
 
 /***********************************************************
@@ -153,6 +635,8 @@ bool InitializeGLFW()
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 #endif
+	// multisampling, needed for alpha-to-coverage on the vegetation
+	glfwWindowHint(GLFW_SAMPLES, 4);
 	// GLFW: end -------------------------------
 
 	return(true);
@@ -183,4 +667,340 @@ bool InitializeGLEW()
 	std::cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << "\n" << std::endl;
 
 	return(true);
-}
\ No newline at end of file
+}
+
+/***********************************************************
+ *	BakeLODChain()
+ *
+ *  This function is used to generate the LOD chain for a
+ *  mesh offline and save it for fast loading at runtime.
+ ***********************************************************/
+bool BakeLODChain(const char* meshFile, const char* lodFile)
+{
+	MESH_DATA mesh;
+	if (MeshData::LoadOBJMesh(meshFile, mesh) == false)
+	{
+		return false;
+	}
+
+	MeshSimplifier simplifier;
+	LOD_SETTINGS settings;
+	std::vector<MESH_LOD> chain;
+	if (simplifier.GenerateLODChain(mesh, settings, chain) == false)
+	{
+		std::cerr << "ERROR: Could not simplify " << meshFile << std::endl;
+		return false;
+	}
+
+	for (size_t i = 0; i < chain.size(); i++)
+	{
+		std::cout << "INFO: LOD " << i
+			<< " triangles: " << MeshData::TriangleCount(chain[i].mesh)
+			<< " error: " << chain[i].geometricError << "\n";
+	}
+
+	return MeshSimplifier::SaveLODChain(lodFile, chain);
+}
+
+/***********************************************************
+ *	BakeLightmaps()
+ *
+ *  This function is used to bake the lightmap of the static
+ *  objects offline, for example:
+ *    --bake-lightmaps --lightmap=campsite.lightmap
+ *    --lightmap-samples=256 --lightmap-density=16
+ *  The scene is prepared as it would be for drawing, from
+ *  the snapshot if there is one, but without a window.
+ ***********************************************************/
+bool BakeLightmaps()
+{
+	SceneManager sceneManager(NULL);
+	sceneManager.SetSnapshotFile(g_SnapshotFile);
+	sceneManager.SetLightmapFile(g_LightmapFile);
+	sceneManager.BeginPrepareScene();
+	return sceneManager.BakeLightmaps(g_LightmapSettings);
+}
+
+/***********************************************************
+ *	BenchmarkDecoders()
+ *
+ *  This function is used to time each image decoder on each
+ *  file at every reduction it supports, and write the mean
+ *  decode time and throughput in source megapixels per second
+ *  to a CSV file, for example:
+ *    --bench-decoders decoders.csv textures/tent.jpg textures/sky.jpg
+ *  Files are read into memory first, so only decoding is timed.
+ ***********************************************************/
+bool BenchmarkDecoders(const char* outputFile, int fileCount, char* files[])
+{
+	std::ofstream output(outputFile);
+	if (!output)
+	{
+		std::cerr << "ERROR: Could not write " << outputFile << std::endl;
+		return false;
+	}
+	output << "file,decoder,scale,width,height,runs,mean_ms,min_ms,mpix_per_s\n";
+
+	JpegDecoder jpegDecoder;
+	StbImageDecoder stbDecoder;
+	ImageDecoder* decoders[] = { &jpegDecoder, &stbDecoder };
+	const int scales[] = { 1, 2, 4, 8 };
+
+	for (int f = 0; f < fileCount; f++)
+	{
+		std::vector<unsigned char> bytes = AssetIO::ReadWholeFile(files[f]);
+		if (bytes.empty())
+		{
+			std::cerr << "ERROR: Could not read " << files[f] << std::endl;
+			continue;
+		}
+
+		for (ImageDecoder* pDecoder : decoders)
+		{
+			if (!pDecoder->CanDecode(bytes.data(), bytes.size()))
+			{
+				continue;
+			}
+
+			int fullWidth = 0;
+			int fullHeight = 0;
+			for (int scale : scales)
+			{
+				// run for at least half a second and five decodes
+				IMAGE_DATA image;
+				int runs = 0;
+				double totalMs = 0.0;
+				double minMs = 0.0;
+				bool bOk = true;
+				while (bOk && ((runs < 5) || (totalMs < 500.0)))
+				{
+					auto start = std::chrono::steady_clock::now();
+					bOk = pDecoder->Decode(bytes.data(), bytes.size(), scale, image);
+					double ms = std::chrono::duration<double, std::milli>(
+						std::chrono::steady_clock::now() - start).count();
+					minMs = (runs == 0) ? ms : std::min(minMs, ms);
+					totalMs += ms;
+					runs++;
+				}
+				if (!bOk)
+				{
+					std::cerr << "ERROR: " << pDecoder->GetName() << " could not decode " << files[f] << std::endl;
+					break;
+				}
+				if (scale == 1)
+				{
+					fullWidth = image.width;
+					fullHeight = image.height;
+				}
+
+				double meanMs = totalMs / runs;
+				output << files[f] << "," << pDecoder->GetName() << "," << scale
+					<< "," << image.width << "," << image.height << "," << runs
+					<< "," << meanMs << "," << minMs
+					<< "," << ((double)fullWidth * fullHeight / 1000.0) / meanMs << "\n";
+				std::cout << "INFO: " << files[f] << " " << pDecoder->GetName() << " 1/" << scale
+					<< ": " << meanMs << " ms" << std::endl;
+			}
+		}
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *	BenchmarkStartup()
+ *
+ *  This function is used to launch this program over and
+ *  over with the same options plus --profile-startup, for
+ *  example:
+ *    --bench-startup=startup_bench.json --runs=10 --no-snapshot
+ *  Cold runs have the executable, textures, shaders and the
+ *  snapshot evicted from the page cache first; warm runs
+ *  follow a run that loads them all.
+ ***********************************************************/
+bool BenchmarkStartup(int argc, char* argv[])
+{
+	const std::string profileFile = "startup_run.json";
+	std::string command = std::string("\"") + argv[0] + "\"";
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if ((argument.rfind("--bench-startup", 0) == 0) ||
+			(argument.rfind("--runs", 0) == 0) ||
+			(argument.rfind("--profile-startup", 0) == 0))
+		{
+			continue;
+		}
+		command += " \"" + argument + "\"";
+	}
+	command += " --profile-startup=" + profileFile;
+#ifdef _WIN32
+	// cmd.exe strips the outer quotes of a command that starts with one
+	command = "\"" + command + "\"";
+#endif
+
+	std::vector<std::string> evictPaths = { argv[0], "textures", "shaders" };
+	if (!g_SnapshotFile.empty())
+	{
+		evictPaths.push_back(g_SnapshotFile);
+	}
+
+	return StartupProfiler::RunBenchmark(
+		command, profileFile, g_StartupRuns, evictPaths, g_StartupBenchmarkOutput.c_str());
+}
+
+/***********************************************************
+ *	ParseCommandLine()
+ *
+ *  This function is used to read the stress scene and the
+ *  benchmark options, given as --name or --name=value.
+ *  Lists are comma separated, for example:
+ *    --stress --objects=20000 --lights=64 --textures=32
+ *    --seed=7 --threads=4 --benchmark --frames=600
+ *    --warmup=60 --out=scaling.csv --latency-out=latency.csv
+ *    --sweep-objects=1000,10000,100000 --sweep-threads=1,2,4,8
+ *    --snapshot=campsite.snapshot --no-snapshot
+ *    --lightmap=campsite.lightmap --no-lightmap
+ *    --bake-lightmaps --lightmap-samples=256 --lightmap-density=16
+ *    --profile-startup=startup.json
+ *    --split-screen --minimap --stereo --eye-separation=0.065
+ *    --export=flythrough.y4m --camera-path=path.txt
+ *    --export-fps=30 --export-seconds=20 --headless
+ *    --bench-startup=startup_bench.json --runs=10
+ ***********************************************************/
+bool ParseCommandLine(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		std::string name = argument;
+		std::string value;
+		size_t equals = argument.find('=');
+		if (equals != std::string::npos)
+		{
+			name = argument.substr(0, equals);
+			value = argument.substr(equals + 1);
+		}
+
+		std::vector<int> list;
+		size_t start = 0;
+		while (!value.empty() && (start <= value.size()))
+		{
+			size_t comma = value.find(',', start);
+			list.push_back(atoi(value.substr(start, comma - start).c_str()));
+			if (comma == std::string::npos)
+			{
+				break;
+			}
+			start = comma + 1;
+		}
+
+		if (name == "--stress") { g_bStressScene = true; }
+		else if (name == "--objects") { g_StressSettings.objectCount = atoi(value.c_str()); }
+		else if (name == "--lights") { g_StressSettings.lightCount = atoi(value.c_str()); }
+		else if (name == "--textures") { g_StressSettings.textureCount = atoi(value.c_str()); }
+		else if (name == "--seed") { g_StressSettings.seed = (uint32_t)strtoul(value.c_str(), NULL, 10); }
+		else if (name == "--threads") { g_StressSettings.threadCount = atoi(value.c_str()); }
+		else if (name == "--benchmark") { g_bBenchmark = true; }
+		else if (name == "--frames") { g_BenchmarkFrames = atoi(value.c_str()); }
+		else if (name == "--warmup") { g_BenchmarkWarmup = atoi(value.c_str()); }
+		else if (name == "--out") { g_BenchmarkOutput = value; }
+		else if (name == "--latency-out") { g_LatencyOutput = value; }
+		else if (name == "--sweep-objects") { g_SweepObjects = list; g_bStressScene = true; }
+		else if (name == "--sweep-threads") { g_SweepThreads = list; g_bStressScene = true; }
+		else if (name == "--snapshot") { g_SnapshotFile = value; }
+		else if (name == "--no-snapshot") { g_SnapshotFile.clear(); }
+		else if (name == "--lightmap") { g_LightmapFile = value; }
+		else if (name == "--no-lightmap") { g_LightmapFile.clear(); }
+		else if (name == "--bake-lightmaps") { g_bBakeLightmaps = true; }
+		else if (name == "--lightmap-samples") { g_LightmapSettings.samples = std::max(atoi(value.c_str()), 1); }
+		else if (name == "--lightmap-density") { g_LightmapSettings.texelsPerUnit = std::max((float)atof(value.c_str()), 1.0f); }
+		else if (name == "--profile-startup") { g_ProfileOutput = value.empty() ? "startup.json" : value; }
+		else if (name == "--bench-startup") { g_StartupBenchmarkOutput = value.empty() ? "startup_bench.json" : value; }
+		else if (name == "--runs") { g_StartupRuns = std::max(atoi(value.c_str()), 1); }
+		else if (name == "--split-screen") { g_bSplitScreen = true; }
+		else if (name == "--minimap") { g_bMinimap = true; }
+		else if (name == "--stereo") { g_bStereo = true; }
+		else if (name == "--eye-separation") { g_EyeSeparation = std::max((float)atof(value.c_str()), 0.0f); }
+		else if (name == "--export") { g_bExport = true; if (!value.empty()) { g_ExportSettings.output = value; } }
+		else if (name == "--camera-path") { g_CameraPathFile = value; }
+		else if (name == "--export-fps") { g_ExportSettings.framesPerSecond = std::max(atoi(value.c_str()), 1); }
+		else if (name == "--export-seconds") { g_ExportSeconds = std::max((float)atof(value.c_str()), 0.0f); }
+		else if (name == "--headless") { g_bExport = true; g_ExportSettings.bHeadless = true; }
+		else
+		{
+			std::cerr << "ERROR: Unknown option " << argument << std::endl;
+			return false;
+		}
+	}
+
+	// a sweep only makes sense as a benchmark
+	if (!g_SweepObjects.empty() || !g_SweepThreads.empty())
+	{
+		g_bBenchmark = true;
+	}
+	// an export has a camera path of its own
+	if (g_bExport && g_bBenchmark)
+	{
+		std::cout << "[VideoExporter] Exporting instead of benchmarking" << std::endl;
+		g_bBenchmark = false;
+	}
+	return true;
+}
+
+/***********************************************************
+ *	MakeBenchmarkRuns()
+ *
+ *  This function is used to list the stress scene settings
+ *  to run - every swept object count with every swept thread
+ *  count, or just the single scene from the command line.
+ ***********************************************************/
+std::vector<STRESS_SETTINGS> MakeBenchmarkRuns()
+{
+	std::vector<int> objectCounts = g_SweepObjects;
+	std::vector<int> threadCounts = g_SweepThreads;
+	if (objectCounts.empty())
+	{
+		objectCounts.push_back(g_StressSettings.objectCount);
+	}
+	if (threadCounts.empty())
+	{
+		threadCounts.push_back(g_StressSettings.threadCount);
+	}
+
+	std::vector<STRESS_SETTINGS> runs;
+	for (int objects : objectCounts)
+	{
+		for (int threads : threadCounts)
+		{
+			STRESS_SETTINGS settings = g_StressSettings;
+			settings.objectCount = objects;
+			settings.threadCount = threads;
+			runs.push_back(settings);
+		}
+	}
+	return runs;
+}
+
+/***********************************************************
+ *	DescribeRun()
+ *
+ *  This function is used to label a benchmark result with
+ *  the scene it was measured on.
+ ***********************************************************/
+BENCHMARK_RESULT DescribeRun(const STRESS_SETTINGS& settings)
+{
+	BENCHMARK_RESULT description;
+	if (NULL == g_StressScene)
+	{
+		description.label = "campsite";
+		return description;
+	}
+
+	description.label = "stress";
+	description.objects = settings.objectCount;
+	description.lights = settings.lightCount;
+	description.textures = settings.textureCount;
+	description.threads = (settings.threadCount > 0) ? settings.threadCount : ThreadPool::DefaultThreadCount();
+	return description;
+}
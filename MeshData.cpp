@@ -0,0 +1,411 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshdata.cpp
+// ============
+// CPU-side indexed triangle meshes - vertex layout, loading, bounds
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshData.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+namespace
+{
+	/***********************************************************
+	 *  ResolveOBJIndex()
+	 *
+	 *  OBJ indices are 1-based and may be negative, meaning
+	 *  relative to the end of the list read so far.
+	 ***********************************************************/
+	int ResolveOBJIndex(int index, size_t count)
+	{
+		if (index > 0)
+		{
+			return index - 1;
+		}
+		if (index < 0)
+		{
+			return (int)count + index;
+		}
+		return -1;
+	}
+}
+
+/***********************************************************
+ *  LoadOBJMesh()
+ *
+ *  This method is used for reading a Wavefront OBJ file into
+ *  an indexed triangle list. Polygons are fan triangulated
+ *  and identical position/uv/normal corners are welded.
+ ***********************************************************/
+bool MeshData::LoadOBJMesh(const char* filename, MESH_DATA& mesh)
+{
+	std::ifstream file(filename);
+	if (!file.is_open())
+	{
+		std::cout << "[MeshData] Could not open mesh: " << filename << std::endl;
+		return false;
+	}
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> texCoords;
+	// packed position/texcoord/normal indices used to weld face corners
+	std::unordered_map<uint64_t, uint32_t> cornerMap;
+
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream stream(line);
+		std::string keyword;
+		stream >> keyword;
+
+		if (keyword == "v")
+		{
+			glm::vec3 p;
+			stream >> p.x >> p.y >> p.z;
+			positions.push_back(p);
+		}
+		else if (keyword == "vn")
+		{
+			glm::vec3 n;
+			stream >> n.x >> n.y >> n.z;
+			normals.push_back(n);
+		}
+		else if (keyword == "vt")
+		{
+			glm::vec2 t;
+			stream >> t.x >> t.y;
+			texCoords.push_back(t);
+		}
+		else if (keyword == "f")
+		{
+			std::vector<uint32_t> polygon;
+			std::string corner;
+			while (stream >> corner)
+			{
+				int p = 0, t = 0, n = 0;
+				const char* text = corner.c_str();
+				p = atoi(text);
+				const char* slash = strchr(text, '/');
+				if (slash != NULL)
+				{
+					if (slash[1] != '/')
+					{
+						t = atoi(slash + 1);
+					}
+					const char* slash2 = strchr(slash + 1, '/');
+					if (slash2 != NULL)
+					{
+						n = atoi(slash2 + 1);
+					}
+				}
+
+				int pi = ResolveOBJIndex(p, positions.size());
+				int ti = ResolveOBJIndex(t, texCoords.size());
+				int ni = ResolveOBJIndex(n, normals.size());
+				if ((pi < 0) || (pi >= (int)positions.size()))
+				{
+					std::cout << "[MeshData] ERROR: Bad face index in " << filename << std::endl;
+					return false;
+				}
+
+				uint64_t key = ((uint64_t)(uint32_t)pi << 42) |
+					((uint64_t)(uint32_t)(ti + 1) << 21) |
+					(uint64_t)(uint32_t)(ni + 1);
+				auto found = cornerMap.find(key);
+				if (found != cornerMap.end())
+				{
+					polygon.push_back(found->second);
+					continue;
+				}
+
+				MESH_VERTEX vertex;
+				vertex.position = positions[pi];
+				vertex.normal = (ni >= 0 && ni < (int)normals.size()) ? normals[ni] : glm::vec3(0.0f);
+				vertex.texCoord = (ti >= 0 && ti < (int)texCoords.size()) ? texCoords[ti] : glm::vec2(0.0f);
+
+				uint32_t index = (uint32_t)mesh.vertices.size();
+				mesh.vertices.push_back(vertex);
+				cornerMap[key] = index;
+				polygon.push_back(index);
+			}
+
+			// fan triangulate the polygon
+			for (size_t i = 2; i < polygon.size(); i++)
+			{
+				mesh.indices.push_back(polygon[0]);
+				mesh.indices.push_back(polygon[i - 1]);
+				mesh.indices.push_back(polygon[i]);
+			}
+		}
+	}
+
+	// generate flat-weighted normals when the file did not supply any
+	if (normals.empty())
+	{
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			MESH_VERTEX& a = mesh.vertices[mesh.indices[i]];
+			MESH_VERTEX& b = mesh.vertices[mesh.indices[i + 1]];
+			MESH_VERTEX& c = mesh.vertices[mesh.indices[i + 2]];
+			glm::vec3 faceNormal = glm::cross(b.position - a.position, c.position - a.position);
+			a.normal += faceNormal;
+			b.normal += faceNormal;
+			c.normal += faceNormal;
+		}
+		for (MESH_VERTEX& vertex : mesh.vertices)
+		{
+			float len = glm::length(vertex.normal);
+			vertex.normal = (len > 0.0f) ? vertex.normal / len : glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+	}
+
+	ComputeBounds(mesh);
+
+	std::cout << "[MeshData] Loaded mesh: " << filename
+		<< ", vertices: " << mesh.vertices.size()
+		<< ", triangles: " << TriangleCount(mesh)
+		<< std::endl;
+
+	return !mesh.indices.empty();
+}
+
+/***********************************************************
+ *  ComputeBounds()
+ *
+ *  This method is used for computing a bounding sphere that
+ *  is centered on the axis-aligned box of the vertices.
+ ***********************************************************/
+void MeshData::ComputeBounds(MESH_DATA& mesh)
+{
+	if (mesh.vertices.empty())
+	{
+		mesh.boundsCenter = glm::vec3(0.0f);
+		mesh.boundsRadius = 0.0f;
+		return;
+	}
+
+	glm::vec3 minimum = mesh.vertices[0].position;
+	glm::vec3 maximum = mesh.vertices[0].position;
+	for (const MESH_VERTEX& vertex : mesh.vertices)
+	{
+		minimum = glm::min(minimum, vertex.position);
+		maximum = glm::max(maximum, vertex.position);
+	}
+
+	mesh.boundsCenter = (minimum + maximum) * 0.5f;
+	float radius = 0.0f;
+	for (const MESH_VERTEX& vertex : mesh.vertices)
+	{
+		radius = glm::max(radius, glm::length(vertex.position - mesh.boundsCenter));
+	}
+	mesh.boundsRadius = radius;
+}
+
+/***********************************************************
+ *  CreateBoxMesh()
+ *
+ *  This method is used for building a unit cube centered on
+ *  the origin, the same shape as ShapeMeshes::DrawBoxMesh().
+ ***********************************************************/
+void MeshData::CreateBoxMesh(MESH_DATA& mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	// face normals with the two axes spanning each face
+	const glm::vec3 normals[6] = {
+		glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0),
+		glm::vec3(0, 1, 0), glm::vec3(0, -1, 0),
+		glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) };
+	const glm::vec3 tangents[6] = {
+		glm::vec3(0, 0, -1), glm::vec3(0, 0, 1),
+		glm::vec3(1, 0, 0), glm::vec3(1, 0, 0),
+		glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0) };
+
+	for (int face = 0; face < 6; face++)
+	{
+		glm::vec3 n = normals[face];
+		glm::vec3 t = tangents[face];
+		glm::vec3 b = glm::cross(n, t);
+		uint32_t first = (uint32_t)mesh.vertices.size();
+		for (int corner = 0; corner < 4; corner++)
+		{
+			float u = (corner == 1 || corner == 2) ? 1.0f : 0.0f;
+			float v = (corner >= 2) ? 1.0f : 0.0f;
+			MESH_VERTEX vertex;
+			vertex.position = 0.5f * n + (u - 0.5f) * t + (v - 0.5f) * b;
+			vertex.normal = n;
+			vertex.texCoord = glm::vec2(u, v);
+			mesh.vertices.push_back(vertex);
+		}
+		const uint32_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+		for (uint32_t index : quad)
+		{
+			mesh.indices.push_back(first + index);
+		}
+	}
+	ComputeBounds(mesh);
+}
+
+/***********************************************************
+ *  CreateCylinderMesh()
+ *
+ *  This method is used for building a capped cylinder of
+ *  radius 1 standing from y = 0 to y = 1, the same shape as
+ *  ShapeMeshes::DrawCylinderMesh().
+ ***********************************************************/
+void MeshData::CreateCylinderMesh(int slices, MESH_DATA& mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	slices = std::max(slices, 3);
+
+	// side wall, with a duplicated seam column for the texture wrap
+	for (int i = 0; i <= slices; i++)
+	{
+		float u = (float)i / slices;
+		float angle = u * 6.2831853f;
+		glm::vec3 normal(std::cos(angle), 0.0f, std::sin(angle));
+		for (int ring = 0; ring < 2; ring++)
+		{
+			MESH_VERTEX vertex;
+			vertex.position = glm::vec3(normal.x, (float)ring, normal.z);
+			vertex.normal = normal;
+			vertex.texCoord = glm::vec2(u, (float)ring);
+			mesh.vertices.push_back(vertex);
+		}
+	}
+	for (int i = 0; i < slices; i++)
+	{
+		uint32_t a = (uint32_t)(i * 2);
+		mesh.indices.insert(mesh.indices.end(), { a, a + 1, a + 3, a, a + 3, a + 2 });
+	}
+
+	// top and bottom caps as triangle fans
+	for (int cap = 0; cap < 2; cap++)
+	{
+		float y = (float)cap;
+		glm::vec3 normal(0.0f, cap ? 1.0f : -1.0f, 0.0f);
+		uint32_t center = (uint32_t)mesh.vertices.size();
+		MESH_VERTEX vertex;
+		vertex.position = glm::vec3(0.0f, y, 0.0f);
+		vertex.normal = normal;
+		vertex.texCoord = glm::vec2(0.5f);
+		mesh.vertices.push_back(vertex);
+		for (int i = 0; i < slices; i++)
+		{
+			float angle = (float)i / slices * 6.2831853f;
+			vertex.position = glm::vec3(std::cos(angle), y, std::sin(angle));
+			vertex.texCoord = glm::vec2(0.5f + 0.5f * std::cos(angle), 0.5f + 0.5f * std::sin(angle));
+			mesh.vertices.push_back(vertex);
+		}
+		for (int i = 0; i < slices; i++)
+		{
+			uint32_t a = center + 1 + (uint32_t)i;
+			uint32_t b = center + 1 + (uint32_t)((i + 1) % slices);
+			if (cap)
+			{
+				mesh.indices.insert(mesh.indices.end(), { center, b, a });
+			}
+			else
+			{
+				mesh.indices.insert(mesh.indices.end(), { center, a, b });
+			}
+		}
+	}
+	ComputeBounds(mesh);
+}
+
+/***********************************************************
+ *  CreateSphereMesh()
+ *
+ *  This method is used for building a UV sphere of radius 1
+ *  centered on the origin.
+ ***********************************************************/
+void MeshData::CreateSphereMesh(int stacks, int slices, MESH_DATA& mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	stacks = std::max(stacks, 2);
+	slices = std::max(slices, 3);
+
+	for (int j = 0; j <= stacks; j++)
+	{
+		float v = (float)j / stacks;
+		float phi = v * 3.14159265f;
+		for (int i = 0; i <= slices; i++)
+		{
+			float u = (float)i / slices;
+			float theta = u * 6.2831853f;
+			MESH_VERTEX vertex;
+			vertex.normal = glm::vec3(std::sin(phi) * std::cos(theta), -std::cos(phi), std::sin(phi) * std::sin(theta));
+			vertex.position = vertex.normal;
+			vertex.texCoord = glm::vec2(u, v);
+			mesh.vertices.push_back(vertex);
+		}
+	}
+	const uint32_t row = (uint32_t)slices + 1;
+	for (uint32_t j = 0; j < (uint32_t)stacks; j++)
+	{
+		for (uint32_t i = 0; i < (uint32_t)slices; i++)
+		{
+			uint32_t a = j * row + i;
+			mesh.indices.insert(mesh.indices.end(), { a, a + row, a + row + 1, a, a + row + 1, a + 1 });
+		}
+	}
+	ComputeBounds(mesh);
+}
+
+/***********************************************************
+ *  CreateTorusMesh()
+ *
+ *  This method is used for building a torus around the y
+ *  axis with a main radius of 1 and the given tube radius.
+ ***********************************************************/
+void MeshData::CreateTorusMesh(int mainSegments, int tubeSegments, float tubeRadius, MESH_DATA& mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	mainSegments = std::max(mainSegments, 3);
+	tubeSegments = std::max(tubeSegments, 3);
+
+	for (int j = 0; j <= mainSegments; j++)
+	{
+		float u = (float)j / mainSegments;
+		float theta = u * 6.2831853f;
+		glm::vec3 center(std::cos(theta), 0.0f, std::sin(theta));
+		for (int i = 0; i <= tubeSegments; i++)
+		{
+			float v = (float)i / tubeSegments;
+			float phi = v * 6.2831853f;
+			MESH_VERTEX vertex;
+			vertex.normal = std::cos(phi) * center + glm::vec3(0.0f, std::sin(phi), 0.0f);
+			vertex.position = center + tubeRadius * vertex.normal;
+			vertex.texCoord = glm::vec2(u, v);
+			mesh.vertices.push_back(vertex);
+		}
+	}
+	const uint32_t row = (uint32_t)tubeSegments + 1;
+	for (uint32_t j = 0; j < (uint32_t)mainSegments; j++)
+	{
+		for (uint32_t i = 0; i < (uint32_t)tubeSegments; i++)
+		{
+			uint32_t a = j * row + i;
+			mesh.indices.insert(mesh.indices.end(), { a, a + 1, a + row + 1, a, a + row + 1, a + row });
+		}
+	}
+	ComputeBounds(mesh);
+}
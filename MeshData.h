@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshdata.h
+// ============
+// CPU-side indexed triangle meshes - vertex layout, loading, bounds
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  MESH_VERTEX
+ *
+ *  One interleaved vertex, laid out exactly like the shader
+ *  inputs: position (location 0), normal (location 1) and
+ *  texture coordinate (location 2).
+ ***********************************************************/
+struct MESH_VERTEX
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texCoord;
+};
+
+/***********************************************************
+ *  MESH_DATA
+ *
+ *  An indexed triangle list held in CPU memory, along with
+ *  the bounding sphere used for culling and LOD selection.
+ ***********************************************************/
+struct MESH_DATA
+{
+	std::vector<MESH_VERTEX> vertices;
+	std::vector<uint32_t> indices;
+	glm::vec3 boundsCenter = glm::vec3(0.0f);
+	float boundsRadius = 0.0f;
+};
+
+namespace MeshData
+{
+	// load a triangulated mesh from a Wavefront OBJ file
+	bool LoadOBJMesh(const char* filename, MESH_DATA& mesh);
+	// recompute the bounding sphere of the mesh
+	void ComputeBounds(MESH_DATA& mesh);
+
+	// procedural versions of the basic shapes drawn by ShapeMeshes
+	void CreateBoxMesh(MESH_DATA& mesh);
+	void CreateCylinderMesh(int slices, MESH_DATA& mesh);
+	void CreateSphereMesh(int stacks, int slices, MESH_DATA& mesh);
+	void CreateTorusMesh(int mainSegments, int tubeSegments, float tubeRadius, MESH_DATA& mesh);
+	// number of triangles in the mesh
+	inline size_t TriangleCount(const MESH_DATA& mesh) { return mesh.indices.size() / 3; }
+}
@@ -0,0 +1,711 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshsimplifier.cpp
+// ============
+// quadric error metric mesh simplification and LOD chain generation
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <queue>
+#include <unordered_map>
+
+namespace
+{
+	// identifies LOD chain files written by SaveLODChain()
+	const uint32_t LOD_FILE_MAGIC = 0x43444F4C; // "LODC"
+	const uint32_t LOD_FILE_VERSION = 1;
+
+	// weight applied to the planes that keep open borders in place
+	const double BORDER_WEIGHT = 10.0;
+
+	/***********************************************************
+	 *  QUADRIC
+	 *
+	 *  Symmetric 4x4 error quadric stored as its 10 unique
+	 *  coefficients, plus the accumulated area weight so the
+	 *  error can be reported as a mean distance.
+	 ***********************************************************/
+	struct QUADRIC
+	{
+		double a2, ab, ac, ad;
+		double b2, bc, bd;
+		double c2, cd;
+		double d2;
+		double weight;
+	};
+
+	void QuadricClear(QUADRIC& q)
+	{
+		memset(&q, 0, sizeof(QUADRIC));
+	}
+
+	void QuadricAddPlane(QUADRIC& q, const glm::vec3& n, float d, double w)
+	{
+		double a = n.x, b = n.y, c = n.z, dd = d;
+		q.a2 += w * a * a; q.ab += w * a * b; q.ac += w * a * c; q.ad += w * a * dd;
+		q.b2 += w * b * b; q.bc += w * b * c; q.bd += w * b * dd;
+		q.c2 += w * c * c; q.cd += w * c * dd;
+		q.d2 += w * dd * dd;
+		q.weight += w;
+	}
+
+	void QuadricAdd(QUADRIC& q, const QUADRIC& other)
+	{
+		q.a2 += other.a2; q.ab += other.ab; q.ac += other.ac; q.ad += other.ad;
+		q.b2 += other.b2; q.bc += other.bc; q.bd += other.bd;
+		q.c2 += other.c2; q.cd += other.cd;
+		q.d2 += other.d2;
+		q.weight += other.weight;
+	}
+
+	double QuadricEvaluate(const QUADRIC& q, const glm::vec3& p)
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double e = q.a2 * x * x + 2.0 * q.ab * x * y + 2.0 * q.ac * x * z + 2.0 * q.ad * x
+			+ q.b2 * y * y + 2.0 * q.bc * y * z + 2.0 * q.bd * y
+			+ q.c2 * z * z + 2.0 * q.cd * z
+			+ q.d2;
+		return (e > 0.0) ? e : 0.0;
+	}
+
+	// pending half-edge collapse, from -> to
+	struct COLLAPSE
+	{
+		double cost;
+		double positionError;
+		uint32_t from;
+		uint32_t to;
+		uint32_t stampFrom;
+		uint32_t stampTo;
+
+		bool operator>(const COLLAPSE& other) const { return cost > other.cost; }
+	};
+
+	/***********************************************************
+	 *  SIMPLIFY_STATE
+	 *
+	 *  Working data for one Simplify() call - triangle list,
+	 *  vertex-to-triangle adjacency, quadrics and lock flags.
+	 ***********************************************************/
+	struct SIMPLIFY_STATE
+	{
+		const MESH_DATA* source;
+		std::vector<uint32_t> indices;
+		std::vector<bool> triRemoved;
+		std::vector<std::vector<uint32_t>> vertexTris;
+		std::vector<QUADRIC> quadrics;
+		std::vector<bool> locked;
+		std::vector<bool> border;
+		std::vector<bool> removed;
+		std::vector<uint32_t> stamps;
+		float attributeScale;
+		float attributeWeight;
+	};
+
+	void CollectNeighbours(const SIMPLIFY_STATE& state, uint32_t vertex, std::vector<uint32_t>& neighbours)
+	{
+		neighbours.clear();
+		for (uint32_t tri : state.vertexTris[vertex])
+		{
+			if (state.triRemoved[tri])
+			{
+				continue;
+			}
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t other = state.indices[tri * 3 + k];
+				if ((other != vertex) &&
+					(std::find(neighbours.begin(), neighbours.end(), other) == neighbours.end()))
+				{
+					neighbours.push_back(other);
+				}
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  CollapseFlipsTriangles()
+	 *
+	 *  Moving 'from' onto 'to' must not turn any surviving
+	 *  triangle around or squash it to nothing.
+	 ***********************************************************/
+	bool CollapseFlipsTriangles(const SIMPLIFY_STATE& state, uint32_t from, uint32_t to)
+	{
+		const std::vector<MESH_VERTEX>& vertices = state.source->vertices;
+		const glm::vec3& target = vertices[to].position;
+
+		for (uint32_t tri : state.vertexTris[from])
+		{
+			if (state.triRemoved[tri])
+			{
+				continue;
+			}
+			const uint32_t* corner = &state.indices[tri * 3];
+			if ((corner[0] == to) || (corner[1] == to) || (corner[2] == to))
+			{
+				continue;
+			}
+
+			glm::vec3 p[3];
+			glm::vec3 q[3];
+			for (int k = 0; k < 3; k++)
+			{
+				p[k] = vertices[corner[k]].position;
+				q[k] = (corner[k] == from) ? target : p[k];
+			}
+			glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+			glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+			float beforeLength = glm::length(before);
+			float afterLength = glm::length(after);
+			if ((afterLength <= 1e-12f) || (beforeLength <= 1e-12f))
+			{
+				return true;
+			}
+			if (glm::dot(before, after) < 0.25f * beforeLength * afterLength)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/***********************************************************
+	 *  EvaluateCollapse()
+	 *
+	 *  Cost of collapsing 'from' onto 'to' - the combined
+	 *  quadric at the kept position plus the squared change of
+	 *  normal and uv scaled into position units.
+	 ***********************************************************/
+	bool EvaluateCollapse(const SIMPLIFY_STATE& state, uint32_t from, uint32_t to, COLLAPSE& collapse)
+	{
+		if (state.locked[from])
+		{
+			return false;
+		}
+		// border vertices may only slide along the border
+		if (state.border[from] && !state.border[to])
+		{
+			return false;
+		}
+
+		const MESH_VERTEX& a = state.source->vertices[from];
+		const MESH_VERTEX& b = state.source->vertices[to];
+
+		QUADRIC q = state.quadrics[from];
+		QuadricAdd(q, state.quadrics[to]);
+		double positionError = QuadricEvaluate(q, b.position);
+		if (q.weight > 0.0)
+		{
+			positionError /= q.weight;
+		}
+
+		glm::vec3 dn = a.normal - b.normal;
+		glm::vec2 dt = a.texCoord - b.texCoord;
+		double attributeError = (glm::dot(dn, dn) + glm::dot(dt, dt)) *
+			state.attributeScale * state.attributeScale * state.attributeWeight;
+
+		collapse.cost = positionError + attributeError;
+		collapse.positionError = std::sqrt(positionError);
+		collapse.from = from;
+		collapse.to = to;
+		collapse.stampFrom = state.stamps[from];
+		collapse.stampTo = state.stamps[to];
+		return true;
+	}
+
+	bool FindBestCollapse(const SIMPLIFY_STATE& state, uint32_t vertex, std::vector<uint32_t>& scratch, COLLAPSE& best)
+	{
+		bool bFound = false;
+		CollectNeighbours(state, vertex, scratch);
+		for (uint32_t other : scratch)
+		{
+			COLLAPSE candidate;
+			if (EvaluateCollapse(state, vertex, other, candidate) &&
+				((bFound == false) || (candidate.cost < best.cost)))
+			{
+				best = candidate;
+				bFound = true;
+			}
+		}
+		return bFound;
+	}
+}
+
+/***********************************************************
+ *  MeshSimplifier()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MeshSimplifier::MeshSimplifier()
+{
+}
+
+/***********************************************************
+ *  ~MeshSimplifier()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MeshSimplifier::~MeshSimplifier()
+{
+}
+
+/***********************************************************
+ *  Simplify()
+ *
+ *  This method is used for reducing a mesh by repeatedly
+ *  collapsing the cheapest edge until the index target or
+ *  the error limit is reached. Vertices that share their
+ *  position with another vertex (uv or normal seams) are
+ *  locked so attribute discontinuities are preserved.
+ ***********************************************************/
+float MeshSimplifier::Simplify(
+	const MESH_DATA& source,
+	size_t targetIndexCount,
+	float targetError,
+	float attributeWeight,
+	MESH_DATA& result)
+{
+	const size_t vertexCount = source.vertices.size();
+	const size_t triCount = source.indices.size() / 3;
+
+	SIMPLIFY_STATE state;
+	state.source = &source;
+	state.indices = source.indices;
+	state.triRemoved.assign(triCount, false);
+	state.vertexTris.resize(vertexCount);
+	state.quadrics.resize(vertexCount);
+	state.locked.assign(vertexCount, false);
+	state.border.assign(vertexCount, false);
+	state.removed.assign(vertexCount, false);
+	state.stamps.assign(vertexCount, 0);
+	state.attributeScale = (source.boundsRadius > 0.0f) ? source.boundsRadius : 1.0f;
+	state.attributeWeight = attributeWeight;
+
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		QuadricClear(state.quadrics[v]);
+	}
+
+	// lock vertices on attribute seams - more than one vertex at exactly
+	// one position; sorted by position, they are runs of equal neighbours,
+	// and comparing the floats treats -0.0f and 0.0f as the same
+	{
+		std::vector<uint32_t> order(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			order[v] = (uint32_t)v;
+		}
+		auto positionLess = [&source](uint32_t a, uint32_t b)
+		{
+			const glm::vec3& pa = source.vertices[a].position;
+			const glm::vec3& pb = source.vertices[b].position;
+			if (pa.x != pb.x)
+			{
+				return pa.x < pb.x;
+			}
+			if (pa.y != pb.y)
+			{
+				return pa.y < pb.y;
+			}
+			return pa.z < pb.z;
+		};
+		std::sort(order.begin(), order.end(), positionLess);
+		for (size_t i = 1; i < vertexCount; i++)
+		{
+			if (source.vertices[order[i - 1]].position == source.vertices[order[i]].position)
+			{
+				state.locked[order[i - 1]] = true;
+				state.locked[order[i]] = true;
+			}
+		}
+	}
+
+	// accumulate area-weighted face plane quadrics and adjacency
+	std::unordered_map<uint64_t, uint32_t> edgeUse;
+	for (size_t t = 0; t < triCount; t++)
+	{
+		const uint32_t* corner = &state.indices[t * 3];
+		const glm::vec3& p0 = source.vertices[corner[0]].position;
+		const glm::vec3& p1 = source.vertices[corner[1]].position;
+		const glm::vec3& p2 = source.vertices[corner[2]].position;
+
+		glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+		float area = glm::length(n);
+		if (area > 0.0f)
+		{
+			n /= area;
+			for (int k = 0; k < 3; k++)
+			{
+				QuadricAddPlane(state.quadrics[corner[k]], n, -glm::dot(n, p0), area * 0.5);
+			}
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			state.vertexTris[corner[k]].push_back((uint32_t)t);
+			uint32_t a = corner[k];
+			uint32_t b = corner[(k + 1) % 3];
+			uint64_t key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+			edgeUse[key]++;
+		}
+	}
+
+	// edges used by a single triangle are open borders - add a
+	// perpendicular plane so collapses cannot pull the border inwards
+	for (size_t t = 0; t < triCount; t++)
+	{
+		const uint32_t* corner = &state.indices[t * 3];
+		const glm::vec3& p0 = source.vertices[corner[0]].position;
+		const glm::vec3& p1 = source.vertices[corner[1]].position;
+		const glm::vec3& p2 = source.vertices[corner[2]].position;
+		glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+		if (glm::length(faceNormal) <= 0.0f)
+		{
+			continue;
+		}
+		faceNormal = glm::normalize(faceNormal);
+
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t a = corner[k];
+			uint32_t b = corner[(k + 1) % 3];
+			uint64_t key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+			if (edgeUse[key] != 1)
+			{
+				continue;
+			}
+			state.border[a] = true;
+			state.border[b] = true;
+
+			glm::vec3 edge = source.vertices[b].position - source.vertices[a].position;
+			float edgeLength = glm::length(edge);
+			if (edgeLength <= 0.0f)
+			{
+				continue;
+			}
+			glm::vec3 n = glm::normalize(glm::cross(edge, faceNormal));
+			double w = BORDER_WEIGHT * edgeLength * edgeLength;
+			QuadricAddPlane(state.quadrics[a], n, -glm::dot(n, source.vertices[a].position), w);
+			QuadricAddPlane(state.quadrics[b], n, -glm::dot(n, source.vertices[a].position), w);
+		}
+	}
+
+	// seed the queue with each vertex's cheapest outgoing collapse
+	std::priority_queue<COLLAPSE, std::vector<COLLAPSE>, std::greater<COLLAPSE>> queue;
+	std::vector<uint32_t> neighbours;
+	std::vector<uint32_t> scratch;
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		COLLAPSE best;
+		if (FindBestCollapse(state, (uint32_t)v, scratch, best))
+		{
+			queue.push(best);
+		}
+	}
+
+	size_t liveIndexCount = state.indices.size();
+	float resultError = 0.0f;
+	const double targetErrorSq = (double)targetError * (double)targetError;
+
+	while ((liveIndexCount > targetIndexCount) && !queue.empty())
+	{
+		COLLAPSE collapse = queue.top();
+		queue.pop();
+
+		if (state.removed[collapse.from] || state.removed[collapse.to] ||
+			(collapse.stampFrom != state.stamps[collapse.from]) ||
+			(collapse.stampTo != state.stamps[collapse.to]))
+		{
+			continue;
+		}
+		if (collapse.cost > targetErrorSq)
+		{
+			break;
+		}
+		if (CollapseFlipsTriangles(state, collapse.from, collapse.to))
+		{
+			// the vertex is queued again once its neighbourhood changes
+			continue;
+		}
+
+		// perform the collapse - triangles using both vertices vanish,
+		// the rest are rewired from 'from' to 'to'
+		uint32_t from = collapse.from;
+		uint32_t to = collapse.to;
+		for (uint32_t tri : state.vertexTris[from])
+		{
+			if (state.triRemoved[tri])
+			{
+				continue;
+			}
+			uint32_t* corner = &state.indices[tri * 3];
+			if ((corner[0] == to) || (corner[1] == to) || (corner[2] == to))
+			{
+				state.triRemoved[tri] = true;
+				liveIndexCount -= 3;
+				continue;
+			}
+			for (int k = 0; k < 3; k++)
+			{
+				if (corner[k] == from)
+				{
+					corner[k] = to;
+				}
+			}
+			state.vertexTris[to].push_back(tri);
+		}
+		state.vertexTris[from].clear();
+		state.removed[from] = true;
+		QuadricAdd(state.quadrics[to], state.quadrics[from]);
+		resultError = std::max(resultError, (float)collapse.positionError);
+
+		// refresh the candidates around the surviving vertex
+		CollectNeighbours(state, to, neighbours);
+		neighbours.push_back(to);
+		for (uint32_t v : neighbours)
+		{
+			state.stamps[v]++;
+		}
+		for (uint32_t v : neighbours)
+		{
+			COLLAPSE best;
+			if (FindBestCollapse(state, v, scratch, best))
+			{
+				queue.push(best);
+			}
+		}
+	}
+
+	// compact the surviving triangles and vertices
+	std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+	result.vertices.clear();
+	result.indices.clear();
+	result.indices.reserve(liveIndexCount);
+	for (size_t t = 0; t < triCount; t++)
+	{
+		if (state.triRemoved[t])
+		{
+			continue;
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = state.indices[t * 3 + k];
+			if (remap[v] == UINT32_MAX)
+			{
+				remap[v] = (uint32_t)result.vertices.size();
+				result.vertices.push_back(source.vertices[v]);
+			}
+			result.indices.push_back(remap[v]);
+		}
+	}
+	result.boundsCenter = source.boundsCenter;
+	result.boundsRadius = source.boundsRadius;
+
+	return resultError;
+}
+
+/***********************************************************
+ *  GenerateLODChain()
+ *
+ *  This method is used for building successively coarser
+ *  levels, each simplified from the previous one. The error
+ *  of each level is accumulated so it stays a conservative
+ *  bound on the deviation from the full detail mesh.
+ ***********************************************************/
+bool MeshSimplifier::GenerateLODChain(
+	const MESH_DATA& source,
+	const LOD_SETTINGS& settings,
+	std::vector<MESH_LOD>& chain)
+{
+	chain.clear();
+	if (source.indices.empty())
+	{
+		return false;
+	}
+
+	MESH_LOD base;
+	base.mesh = source;
+	if (base.mesh.boundsRadius <= 0.0f)
+	{
+		MeshData::ComputeBounds(base.mesh);
+	}
+	base.geometricError = 0.0f;
+	chain.push_back(base);
+
+	const float maxError = settings.maxRelativeError * base.mesh.boundsRadius;
+
+	while ((int)chain.size() < settings.maxLevels)
+	{
+		const MESH_LOD& previous = chain.back();
+		size_t previousTris = MeshData::TriangleCount(previous.mesh);
+		size_t targetTris = (size_t)(previousTris * settings.reductionPerLevel);
+		if (targetTris < settings.minTriangles)
+		{
+			break;
+		}
+
+		// the levels so far have used up the whole error budget
+		float remainingError = maxError - previous.geometricError;
+		if (remainingError <= 0.0f)
+		{
+			break;
+		}
+
+		MESH_LOD level;
+		float levelError = Simplify(
+			previous.mesh,
+			targetTris * 3,
+			remainingError,
+			settings.attributeWeight,
+			level.mesh);
+
+		// stop once a level no longer saves a meaningful amount
+		size_t levelTris = MeshData::TriangleCount(level.mesh);
+		if ((levelTris == 0) || (levelTris > previousTris * 0.9f))
+		{
+			break;
+		}
+
+		level.geometricError = previous.geometricError + levelError;
+		chain.push_back(level);
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  SaveLODChain()
+ *
+ *  This method is used for writing a LOD chain to a binary
+ *  file so it can be generated offline and loaded quickly.
+ ***********************************************************/
+bool MeshSimplifier::SaveLODChain(const char* filename, const std::vector<MESH_LOD>& chain)
+{
+	FILE* file = fopen(filename, "wb");
+	if (file == NULL)
+	{
+		std::cout << "[MeshSimplifier] Could not write LOD file: " << filename << std::endl;
+		return false;
+	}
+
+	uint32_t header[3] = { LOD_FILE_MAGIC, LOD_FILE_VERSION, (uint32_t)chain.size() };
+	fwrite(header, sizeof(header), 1, file);
+	for (const MESH_LOD& level : chain)
+	{
+		uint32_t counts[2] = { (uint32_t)level.mesh.vertices.size(), (uint32_t)level.mesh.indices.size() };
+		float bounds[5] = {
+			level.geometricError,
+			level.mesh.boundsCenter.x,
+			level.mesh.boundsCenter.y,
+			level.mesh.boundsCenter.z,
+			level.mesh.boundsRadius };
+		fwrite(counts, sizeof(counts), 1, file);
+		fwrite(bounds, sizeof(bounds), 1, file);
+		fwrite(level.mesh.vertices.data(), sizeof(MESH_VERTEX), level.mesh.vertices.size(), file);
+		fwrite(level.mesh.indices.data(), sizeof(uint32_t), level.mesh.indices.size(), file);
+	}
+
+	bool bSuccess = (ferror(file) == 0);
+	fclose(file);
+	return bSuccess;
+}
+
+/***********************************************************
+ *  LoadLODChain()
+ *
+ *  This method is used for reading a LOD chain previously
+ *  written by SaveLODChain().
+ ***********************************************************/
+bool MeshSimplifier::LoadLODChain(const char* filename, std::vector<MESH_LOD>& chain)
+{
+	FILE* file = fopen(filename, "rb");
+	if (file == NULL)
+	{
+		std::cout << "[MeshSimplifier] Could not open LOD file: " << filename << std::endl;
+		return false;
+	}
+
+	chain.clear();
+	uint32_t header[3] = { 0, 0, 0 };
+	bool bSuccess = (fread(header, sizeof(header), 1, file) == 1) &&
+		(header[0] == LOD_FILE_MAGIC) &&
+		(header[1] == LOD_FILE_VERSION);
+
+	for (uint32_t i = 0; bSuccess && (i < header[2]); i++)
+	{
+		uint32_t counts[2];
+		float bounds[5];
+		bSuccess = (fread(counts, sizeof(counts), 1, file) == 1) &&
+			(fread(bounds, sizeof(bounds), 1, file) == 1);
+		if (!bSuccess)
+		{
+			break;
+		}
+
+		MESH_LOD level;
+		level.geometricError = bounds[0];
+		level.mesh.boundsCenter = glm::vec3(bounds[1], bounds[2], bounds[3]);
+		level.mesh.boundsRadius = bounds[4];
+		level.mesh.vertices.resize(counts[0]);
+		level.mesh.indices.resize(counts[1]);
+		bSuccess = (fread(level.mesh.vertices.data(), sizeof(MESH_VERTEX), counts[0], file) == counts[0]) &&
+			(fread(level.mesh.indices.data(), sizeof(uint32_t), counts[1], file) == counts[1]);
+		chain.push_back(std::move(level));
+	}
+	fclose(file);
+
+	if (!bSuccess)
+	{
+		std::cout << "[MeshSimplifier] ERROR: Invalid LOD file: " << filename << std::endl;
+		chain.clear();
+	}
+	return bSuccess;
+}
+
+/***********************************************************
+ *  ProjectedError()
+ *
+ *  This method is used for converting an object-space error
+ *  into the number of pixels it covers on screen.
+ ***********************************************************/
+float MeshSimplifier::ProjectedError(
+	float geometricError,
+	float distance,
+	float fovYRadians,
+	float viewportHeight)
+{
+	float pixelsPerUnit = viewportHeight / (2.0f * std::tan(fovYRadians * 0.5f));
+	return geometricError * pixelsPerUnit / std::max(distance, 1e-3f);
+}
+
+/***********************************************************
+ *  SelectLOD()
+ *
+ *  This method is used for choosing the coarsest level whose
+ *  error projects to no more than pixelThreshold pixels. With
+ *  a threshold around one pixel the switch is not visible.
+ ***********************************************************/
+int MeshSimplifier::SelectLOD(
+	const std::vector<float>& levelErrors,
+	float distance,
+	float fovYRadians,
+	float viewportHeight,
+	float pixelThreshold)
+{
+	int selected = 0;
+	for (size_t i = 1; i < levelErrors.size(); i++)
+	{
+		if (ProjectedError(levelErrors[i], distance, fovYRadians, viewportHeight) > pixelThreshold)
+		{
+			break;
+		}
+		selected = (int)i;
+	}
+	return selected;
+}
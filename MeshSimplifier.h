@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshsimplifier.h
+// ============
+// quadric error metric mesh simplification and LOD chain generation
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshData.h"
+
+#include <vector>
+
+/***********************************************************
+ *  MESH_LOD
+ *
+ *  One level of a LOD chain. The geometric error is the
+ *  object-space deviation (in mesh units) from the full
+ *  detail mesh, used for screen-space LOD selection.
+ ***********************************************************/
+struct MESH_LOD
+{
+	MESH_DATA mesh;
+	float geometricError;
+};
+
+/***********************************************************
+ *  LOD_SETTINGS
+ *
+ *  Controls how a LOD chain is generated.
+ ***********************************************************/
+struct LOD_SETTINGS
+{
+	// maximum number of levels, including the full detail mesh
+	int maxLevels = 6;
+	// triangle count of each level relative to the previous one
+	float reductionPerLevel = 0.5f;
+	// stop generating levels below this triangle count
+	size_t minTriangles = 16;
+	// weight of normal/uv deviation relative to position error
+	float attributeWeight = 1.0f;
+	// stop a level early once the error exceeds this fraction of the mesh radius
+	float maxRelativeError = 0.25f;
+};
+
+/***********************************************************
+ *  MeshSimplifier
+ *
+ *  This class reduces indexed triangle meshes with half-edge
+ *  collapses ordered by quadric error (Garland-Heckbert),
+ *  with extra penalties for normal/uv changes so shading and
+ *  texturing are preserved, and builds LOD chains from it.
+ ***********************************************************/
+class MeshSimplifier
+{
+public:
+	// constructor
+	MeshSimplifier();
+	// destructor
+	~MeshSimplifier();
+
+	// reduce the mesh to at most targetIndexCount indices without
+	// exceeding targetError; returns the resulting geometric error
+	float Simplify(
+		const MESH_DATA& source,
+		size_t targetIndexCount,
+		float targetError,
+		float attributeWeight,
+		MESH_DATA& result);
+
+	// build a LOD chain, level 0 being a copy of the source mesh
+	bool GenerateLODChain(
+		const MESH_DATA& source,
+		const LOD_SETTINGS& settings,
+		std::vector<MESH_LOD>& chain);
+
+	// write/read a LOD chain to/from a binary file for offline baking
+	static bool SaveLODChain(const char* filename, const std::vector<MESH_LOD>& chain);
+	static bool LoadLODChain(const char* filename, std::vector<MESH_LOD>& chain);
+
+	// convert an object-space error into pixels at the given distance
+	static float ProjectedError(
+		float geometricError,
+		float distance,
+		float fovYRadians,
+		float viewportHeight);
+
+	// pick the coarsest level whose projected error stays under the threshold
+	static int SelectLOD(
+		const std::vector<float>& levelErrors,
+		float distance,
+		float fovYRadians,
+		float viewportHeight,
+		float pixelThreshold);
+};
@@ -0,0 +1,230 @@
+///////////////////////////////////////////////////////////////////////////////
+// mipgenerator.cpp
+// ============
+// sRGB correct mipmap chains built on the CPU across worker threads
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define MIP_USE_SSE2 1
+#endif
+
+namespace
+{
+	// rows of a level filtered per task
+	const size_t ROW_GRAIN = 16;
+	// steps in the linear to sRGB table, fine enough that the darkest
+	// sRGB values still round to the right byte
+	const int ENCODE_STEPS = 16383;
+
+	/***********************************************************
+	 *  SRGB_TABLES
+	 *
+	 *  Lookup tables for the sRGB transfer function, in both
+	 *  directions, built once on first use.
+	 ***********************************************************/
+	struct SRGB_TABLES
+	{
+		float toLinear[256];
+		float toUnit[256];
+		unsigned char toSrgb[ENCODE_STEPS + 1];
+
+		SRGB_TABLES()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				float c = i / 255.0f;
+				toLinear[i] = (c <= 0.04045f) ? (c / 12.92f) : std::pow((c + 0.055f) / 1.055f, 2.4f);
+				toUnit[i] = c;
+			}
+			for (int i = 0; i <= ENCODE_STEPS; i++)
+			{
+				float l = (float)i / ENCODE_STEPS;
+				float c = (l <= 0.0031308f) ? (l * 12.92f) : (1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f);
+				toSrgb[i] = (unsigned char)std::lround(std::min(std::max(c, 0.0f), 1.0f) * 255.0f);
+			}
+		}
+	};
+
+	const SRGB_TABLES& Tables()
+	{
+		static const SRGB_TABLES tables;
+		return tables;
+	}
+
+	// true for the channel that holds alpha, which stays linear
+	bool IsAlpha(int channel, int channels)
+	{
+		return ((channels == 4) && (channel == 3)) || ((channels == 2) && (channel == 1));
+	}
+
+	/***********************************************************
+	 *  LoadPixel()
+	 *
+	 *  Decode one 8 bit pixel into four linear floats through
+	 *  the per-channel tables, unused channels left at zero.
+	 ***********************************************************/
+	inline void LoadPixel(const unsigned char* pPixel, int channels, const float* const decode[4], float out[4])
+	{
+		out[1] = out[2] = out[3] = 0.0f;
+		for (int c = 0; c < channels; c++)
+		{
+			out[c] = decode[c][pPixel[c]];
+		}
+	}
+
+	/***********************************************************
+	 *  Average4()
+	 *
+	 *  Average four linear pixels into one.
+	 ***********************************************************/
+	inline void Average4(const float* a, const float* b, const float* c, const float* d, float* pOut)
+	{
+#if defined(MIP_USE_SSE2)
+		__m128 sum = _mm_add_ps(
+			_mm_add_ps(_mm_loadu_ps(a), _mm_loadu_ps(b)),
+			_mm_add_ps(_mm_loadu_ps(c), _mm_loadu_ps(d)));
+		_mm_storeu_ps(pOut, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+		for (int i = 0; i < 4; i++)
+		{
+			pOut[i] = (a[i] + b[i] + c[i] + d[i]) * 0.25f;
+		}
+#endif
+	}
+
+	/***********************************************************
+	 *  EncodePixel()
+	 *
+	 *  Encode one linear pixel back to 8 bits: colour through
+	 *  the sRGB table, alpha rounded directly.
+	 ***********************************************************/
+	inline void EncodePixel(const float* pLinear, int channels, const SRGB_TABLES& tables, unsigned char* pOut)
+	{
+		// table index for colour, byte value for alpha, in one step
+		int index[4];
+#if defined(MIP_USE_SSE2)
+		const __m128 scale = (channels == 2)
+			? _mm_setr_ps((float)ENCODE_STEPS, 255.0f, 0.0f, 0.0f)
+			: _mm_setr_ps((float)ENCODE_STEPS, (float)ENCODE_STEPS, (float)ENCODE_STEPS, 255.0f);
+		__m128 clamped = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(pLinear), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+		__m128i rounded = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, scale), _mm_set1_ps(0.5f)));
+		_mm_storeu_si128((__m128i*)index, rounded);
+#else
+		for (int c = 0; c < 4; c++)
+		{
+			float value = std::min(std::max(pLinear[c], 0.0f), 1.0f);
+			index[c] = (int)(value * (IsAlpha(c, channels) ? 255.0f : (float)ENCODE_STEPS) + 0.5f);
+		}
+#endif
+		for (int c = 0; c < channels; c++)
+		{
+			pOut[c] = IsAlpha(c, channels) ? (unsigned char)index[c] : tables.toSrgb[index[c]];
+		}
+	}
+}
+
+/***********************************************************
+ *  Generate()
+ *
+ *  This method is used for building the mip chain. The first
+ *  level is filtered straight from the image bytes, and later
+ *  levels from the linear floats of the one before. Odd sizes
+ *  round down, with the last row or column reused at the edge.
+ ***********************************************************/
+std::vector<MIP_LEVEL> MipGenerator::Generate(
+	const unsigned char* pixels,
+	int width,
+	int height,
+	int channels,
+	ThreadPool* pPool)
+{
+	std::vector<MIP_LEVEL> levels;
+	if ((NULL == pixels) || (width <= 0) || (height <= 0) || (channels < 1) || (channels > 4))
+	{
+		return levels;
+	}
+
+	const SRGB_TABLES& tables = Tables();
+	const float* decode[4];
+	for (int c = 0; c < 4; c++)
+	{
+		decode[c] = IsAlpha(c, channels) ? tables.toUnit : tables.toLinear;
+	}
+	std::vector<float> previous;
+	std::vector<float> current;
+	int srcWidth = width;
+	int srcHeight = height;
+
+	while ((srcWidth > 1) || (srcHeight > 1))
+	{
+		const int dstWidth = std::max(srcWidth / 2, 1);
+		const int dstHeight = std::max(srcHeight / 2, 1);
+		const bool bFromBytes = levels.empty();
+
+		MIP_LEVEL level;
+		level.width = dstWidth;
+		level.height = dstHeight;
+		level.pixels.resize((size_t)dstWidth * dstHeight * channels);
+		current.resize((size_t)dstWidth * dstHeight * 4);
+
+		auto filterRows = [&](size_t begin, size_t end)
+		{
+			for (size_t y = begin; y < end; y++)
+			{
+				const int y0 = std::min((int)y * 2, srcHeight - 1);
+				const int y1 = std::min((int)y * 2 + 1, srcHeight - 1);
+				float* pRow = current.data() + y * dstWidth * 4;
+
+				for (int x = 0; x < dstWidth; x++)
+				{
+					const int x0 = std::min(x * 2, srcWidth - 1);
+					const int x1 = std::min(x * 2 + 1, srcWidth - 1);
+					if (bFromBytes)
+					{
+						float a[4], b[4], c[4], d[4];
+						LoadPixel(pixels + ((size_t)y0 * srcWidth + x0) * channels, channels, decode, a);
+						LoadPixel(pixels + ((size_t)y0 * srcWidth + x1) * channels, channels, decode, b);
+						LoadPixel(pixels + ((size_t)y1 * srcWidth + x0) * channels, channels, decode, c);
+						LoadPixel(pixels + ((size_t)y1 * srcWidth + x1) * channels, channels, decode, d);
+						Average4(a, b, c, d, pRow + x * 4);
+					}
+					else
+					{
+						const float* pSource = previous.data();
+						Average4(
+							pSource + ((size_t)y0 * srcWidth + x0) * 4,
+							pSource + ((size_t)y0 * srcWidth + x1) * 4,
+							pSource + ((size_t)y1 * srcWidth + x0) * 4,
+							pSource + ((size_t)y1 * srcWidth + x1) * 4,
+							pRow + x * 4);
+					}
+					EncodePixel(pRow + x * 4, channels, tables,
+						level.pixels.data() + (y * dstWidth + x) * channels);
+				}
+			}
+		};
+
+		if (NULL != pPool)
+		{
+			pPool->ParallelFor((size_t)dstHeight, ROW_GRAIN, filterRows);
+		}
+		else
+		{
+			filterRows(0, (size_t)dstHeight);
+		}
+
+		levels.push_back(std::move(level));
+		previous.swap(current);
+		srcWidth = dstWidth;
+		srcHeight = dstHeight;
+	}
+
+	return levels;
+}
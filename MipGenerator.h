@@ -0,0 +1,51 @@
+///////////////////////////////////////////////////////////////////////////////
+// mipgenerator.h
+// ============
+// sRGB correct mipmap chains built on the CPU across worker threads
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <vector>
+
+/***********************************************************
+ *  MIP_LEVEL
+ *
+ *  One reduced level of an image, with the same channel
+ *  layout as the image it was built from.
+ ***********************************************************/
+struct MIP_LEVEL
+{
+	int width = 0;
+	int height = 0;
+	std::vector<unsigned char> pixels;
+};
+
+/***********************************************************
+ *  MipGenerator
+ *
+ *  This class builds the mipmap chain of an 8 bit image with
+ *  a 2x2 box filter applied in linear light: colour channels
+ *  are decoded from sRGB before averaging and encoded again
+ *  after, so minified textures keep their brightness instead
+ *  of darkening the way a plain byte average does. Alpha (the
+ *  fourth channel, or the second of two) is averaged as is.
+ *  Each level is filtered from the previous level's linear
+ *  values, not from its rounded bytes, and its rows are split
+ *  across the pool; the filter and the encode use SSE2.
+ ***********************************************************/
+class MipGenerator
+{
+public:
+	// every level below the base image, down to 1x1; pPool may be NULL
+	// to build on the calling thread only
+	static std::vector<MIP_LEVEL> Generate(
+		const unsigned char* pixels,
+		int width,
+		int height,
+		int channels,
+		ThreadPool* pPool);
+};
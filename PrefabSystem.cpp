@@ -0,0 +1,318 @@
+///////////////////////////////////////////////////////////////////////////////
+// prefabsystem.cpp
+// ============
+// reusable object hierarchies, instanced with automatic batching of parts
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PrefabSystem.h"
+
+#include <glm/gtx/transform.hpp>
+#include <iostream>
+
+/***********************************************************
+ *  PrefabSystem()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+PrefabSystem::PrefabSystem()
+{
+	m_pCuller = NULL;
+}
+
+/***********************************************************
+ *  ~PrefabSystem()
+ *
+ *  The destructor for the class - the GPU culler belongs to
+ *  the scene manager.
+ ***********************************************************/
+PrefabSystem::~PrefabSystem()
+{
+	m_pCuller = NULL;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for setting the GPU culler that the
+ *  flattened prefab parts are added to.
+ ***********************************************************/
+bool PrefabSystem::Initialize(GPUCuller* pCuller)
+{
+	m_pCuller = pCuller;
+	return (NULL != m_pCuller);
+}
+
+/***********************************************************
+ *  MakeTransform()
+ *
+ *  This method is used for building a model matrix from the
+ *  same scale, rotation and position values that are passed
+ *  to SceneManager::SetTransformations(), so hand placed
+ *  objects can be copied into a prefab unchanged.
+ ***********************************************************/
+glm::mat4 PrefabSystem::MakeTransform(
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	glm::mat4 scale = glm::scale(scaleXYZ);
+	glm::mat4 rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
+	glm::mat4 rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 translation = glm::translate(positionXYZ);
+
+	return translation * rotationZ * rotationY * rotationX * scale;
+}
+
+/***********************************************************
+ *  CreateShapeMesh()
+ *
+ *  This method is used for building the mesh of a shape at
+ *  the detail the basic shape meshes are drawn with.
+ ***********************************************************/
+void PrefabSystem::CreateShapeMesh(PREFAB_SHAPE shape, MESH_DATA& mesh)
+{
+	switch (shape)
+	{
+	case PREFAB_BOX:
+		MeshData::CreateBoxMesh(mesh);
+		break;
+	case PREFAB_CYLINDER:
+		MeshData::CreateCylinderMesh(32, mesh);
+		break;
+	case PREFAB_SPHERE:
+		MeshData::CreateSphereMesh(24, 48, mesh);
+		break;
+	default:
+		MeshData::CreateTorusMesh(48, 16, 0.1f, mesh);
+		break;
+	}
+}
+
+/***********************************************************
+ *  CreatePrefab()
+ *
+ *  This method is used for adding a new, empty prefab.
+ ***********************************************************/
+int PrefabSystem::CreatePrefab(std::string name)
+{
+	PREFAB prefab;
+	prefab.name = name;
+	prefab.bFlattened = false;
+	m_prefabs.push_back(prefab);
+	return (int)m_prefabs.size() - 1;
+}
+
+/***********************************************************
+ *  FindPrefab()
+ *
+ *  This method is used for looking up a prefab by its name.
+ ***********************************************************/
+int PrefabSystem::FindPrefab(std::string name) const
+{
+	for (size_t i = 0; i < m_prefabs.size(); i++)
+	{
+		if (m_prefabs[i].name == name)
+		{
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+/***********************************************************
+ *  AddPart()
+ *
+ *  This method is used for adding a textured shape to a
+ *  prefab, placed relative to the prefab's root.
+ ***********************************************************/
+void PrefabSystem::AddPart(int prefabIndex, PREFAB_SHAPE shape, int textureSlot, const glm::mat4& localTransform)
+{
+	if ((prefabIndex < 0) || (prefabIndex >= (int)m_prefabs.size()))
+	{
+		std::cout << "[PrefabSystem] Invalid prefab index: " << prefabIndex << std::endl;
+		return;
+	}
+
+	PREFAB_PART part;
+	part.shape = shape;
+	part.textureSlot = textureSlot;
+	part.localTransform = localTransform;
+	m_prefabs[prefabIndex].parts.push_back(part);
+	m_prefabs[prefabIndex].bFlattened = false;
+}
+
+/***********************************************************
+ *  AddChild()
+ *
+ *  This method is used for nesting one prefab inside another.
+ *  A child has to be defined before its parent, which keeps
+ *  the hierarchy free of cycles.
+ ***********************************************************/
+bool PrefabSystem::AddChild(int prefabIndex, int childPrefabIndex, const glm::mat4& localTransform)
+{
+	if ((prefabIndex < 0) || (prefabIndex >= (int)m_prefabs.size()) ||
+		(childPrefabIndex < 0) || (childPrefabIndex >= prefabIndex))
+	{
+		std::cout << "[PrefabSystem] A child prefab must be defined before its parent" << std::endl;
+		return false;
+	}
+
+	PREFAB_CHILD child;
+	child.prefabIndex = childPrefabIndex;
+	child.localTransform = localTransform;
+	m_prefabs[prefabIndex].children.push_back(child);
+	m_prefabs[prefabIndex].bFlattened = false;
+	return true;
+}
+
+/***********************************************************
+ *  GetShapeChain()
+ *
+ *  This method is used for getting the LOD chain of a shape,
+ *  simplifying it the first time. The culler picks a level
+ *  per part, so thousands of far away copies cost a handful
+ *  of triangles each.
+ ***********************************************************/
+const std::vector<MESH_LOD>& PrefabSystem::GetShapeChain(PREFAB_SHAPE shape)
+{
+	std::vector<MESH_LOD>& chain = m_shapeChains[shape];
+	if (chain.empty())
+	{
+		MESH_DATA mesh;
+		CreateShapeMesh(shape, mesh);
+
+		LOD_SETTINGS settings;
+		settings.minTriangles = 12;
+		MeshSimplifier simplifier;
+		simplifier.GenerateLODChain(mesh, settings, chain);
+	}
+	return chain;
+}
+
+/***********************************************************
+ *  FindBatch()
+ *
+ *  This method is used for finding the batch shared by every
+ *  part with this shape and texture, registering a new mesh
+ *  with the GPU culler the first time the pair is used.
+ ***********************************************************/
+int PrefabSystem::FindBatch(PREFAB_SHAPE shape, int textureSlot)
+{
+	for (size_t i = 0; i < m_batches.size(); i++)
+	{
+		if ((m_batches[i].shape == shape) && (m_batches[i].textureSlot == textureSlot))
+		{
+			return (int)i;
+		}
+	}
+
+	BATCH batch;
+	batch.shape = shape;
+	batch.textureSlot = textureSlot;
+	batch.meshIndex = m_pCuller->AddMesh(GetShapeChain(shape), textureSlot);
+	m_batches.push_back(batch);
+	return (int)m_batches.size() - 1;
+}
+
+/***********************************************************
+ *  Flatten()
+ *
+ *  This method is used for collecting the parts of a prefab
+ *  and all of its children, with the child transforms folded
+ *  into each part's transform.
+ ***********************************************************/
+void PrefabSystem::Flatten(int prefabIndex, const glm::mat4& parentTransform, std::vector<FLAT_PART>& output)
+{
+	const PREFAB& prefab = m_prefabs[prefabIndex];
+
+	for (const PREFAB_PART& part : prefab.parts)
+	{
+		FLAT_PART flat;
+		flat.batchIndex = FindBatch(part.shape, part.textureSlot);
+		flat.transform = parentTransform * part.localTransform;
+		output.push_back(flat);
+	}
+	for (const PREFAB_CHILD& child : prefab.children)
+	{
+		Flatten(child.prefabIndex, parentTransform * child.localTransform, output);
+	}
+}
+
+/***********************************************************
+ *  GetFlattened()
+ *
+ *  This method is used for getting the flattened parts of a
+ *  prefab, building them the first time they are needed.
+ ***********************************************************/
+const std::vector<PrefabSystem::FLAT_PART>& PrefabSystem::GetFlattened(int prefabIndex)
+{
+	PREFAB& prefab = m_prefabs[prefabIndex];
+	if (!prefab.bFlattened)
+	{
+		std::vector<FLAT_PART> flattened;
+		Flatten(prefabIndex, glm::mat4(1.0f), flattened);
+		m_prefabs[prefabIndex].flattened.swap(flattened);
+		m_prefabs[prefabIndex].bFlattened = true;
+	}
+	return m_prefabs[prefabIndex].flattened;
+}
+
+/***********************************************************
+ *  Instantiate()
+ *
+ *  This method is used for placing a copy of a prefab in the
+ *  world. Each part becomes one GPU culler instance in the
+ *  batch of its shape and texture; the parts of an instance
+ *  are added consecutively, in one culler group, so they can
+ *  be moved, or hidden from the cull pass, together.
+ ***********************************************************/
+int PrefabSystem::Instantiate(int prefabIndex, const glm::mat4& worldTransform)
+{
+	if ((NULL == m_pCuller) || (prefabIndex < 0) || (prefabIndex >= (int)m_prefabs.size()))
+	{
+		std::cout << "[PrefabSystem] Cannot instantiate prefab: " << prefabIndex << std::endl;
+		return -1;
+	}
+
+	const std::vector<FLAT_PART>& parts = GetFlattened(prefabIndex);
+
+	INSTANCE instance;
+	instance.prefabIndex = prefabIndex;
+	instance.firstCullerInstance = m_pCuller->GetInstanceCount();
+	instance.cullerGroup = m_pCuller->AddGroup(worldTransform);
+	for (const FLAT_PART& part : parts)
+	{
+		m_pCuller->AddInstance(m_batches[part.batchIndex].meshIndex, worldTransform * part.transform, instance.cullerGroup);
+	}
+
+	m_instances.push_back(instance);
+	return (int)m_instances.size() - 1;
+}
+
+/***********************************************************
+ *  SetInstanceTransform()
+ *
+ *  This method is used for moving every part of a prefab
+ *  instance to follow a new world transform.
+ ***********************************************************/
+void PrefabSystem::SetInstanceTransform(int instanceIndex, const glm::mat4& worldTransform)
+{
+	if ((instanceIndex < 0) || (instanceIndex >= (int)m_instances.size()))
+	{
+		return;
+	}
+
+	const INSTANCE& instance = m_instances[instanceIndex];
+	const std::vector<FLAT_PART>& parts = GetFlattened(instance.prefabIndex);
+	m_pCuller->SetGroupTransform(instance.cullerGroup, worldTransform);
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		m_pCuller->SetInstanceTransform(
+			instance.firstCullerInstance + (int)i,
+			worldTransform * parts[i].transform);
+	}
+}
@@ -0,0 +1,131 @@
+///////////////////////////////////////////////////////////////////////////////
+// prefabsystem.h
+// ============
+// reusable object hierarchies, instanced with automatic batching of parts
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GPUCuller.h"
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  PREFAB_SHAPE
+ *
+ *  The basic shapes a prefab part can be made of.
+ ***********************************************************/
+enum PREFAB_SHAPE
+{
+	PREFAB_BOX = 0,
+	PREFAB_CYLINDER,
+	PREFAB_SPHERE,
+	PREFAB_TORUS,
+	PREFAB_SHAPE_COUNT
+};
+
+/***********************************************************
+ *  PrefabSystem
+ *
+ *  This class holds prefabs - named lists of textured parts
+ *  and child prefabs, each with a local transform - that are
+ *  defined once and then instantiated any number of times.
+ *  Every instance is flattened into parts, and all the parts
+ *  with the same shape and texture share one mesh on the GPU
+ *  culler, so identical parts across every instance of every
+ *  prefab are drawn together in the same indirect draw.
+ ***********************************************************/
+class PrefabSystem
+{
+public:
+	// constructor
+	PrefabSystem();
+	// destructor
+	~PrefabSystem();
+
+	// draw the instances through the given GPU culler
+	bool Initialize(GPUCuller* pCuller);
+
+	// create an empty prefab; returns its index
+	int CreatePrefab(std::string name);
+	// find a prefab by name; returns -1 when not found
+	int FindPrefab(std::string name) const;
+	// add a shape drawn with the texture bound to textureSlot
+	void AddPart(int prefabIndex, PREFAB_SHAPE shape, int textureSlot, const glm::mat4& localTransform);
+	// nest an already defined prefab inside another one
+	bool AddChild(int prefabIndex, int childPrefabIndex, const glm::mat4& localTransform);
+
+	// place a copy of a prefab in the world; returns the instance index
+	int Instantiate(int prefabIndex, const glm::mat4& worldTransform);
+	// move an existing instance and all of its parts
+	void SetInstanceTransform(int instanceIndex, const glm::mat4& worldTransform);
+
+	int GetInstanceCount() const { return (int)m_instances.size(); }
+	// number of distinct shape and texture batches in use
+	int GetBatchCount() const { return (int)m_batches.size(); }
+
+	// build a transform the same way as SceneManager::SetTransformations()
+	static glm::mat4 MakeTransform(
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ);
+	// build the full detail mesh of a shape
+	static void CreateShapeMesh(PREFAB_SHAPE shape, MESH_DATA& mesh);
+	// the LOD chain of a shape, built the first time it is asked for
+	const std::vector<MESH_LOD>& GetShapeChain(PREFAB_SHAPE shape);
+
+private:
+	struct PREFAB_PART
+	{
+		PREFAB_SHAPE shape;
+		int textureSlot;
+		glm::mat4 localTransform;
+	};
+	struct PREFAB_CHILD
+	{
+		int prefabIndex;
+		glm::mat4 localTransform;
+	};
+	// a part resolved to its batch, relative to the prefab root
+	struct FLAT_PART
+	{
+		int batchIndex;
+		glm::mat4 transform;
+	};
+	struct PREFAB
+	{
+		std::string name;
+		std::vector<PREFAB_PART> parts;
+		std::vector<PREFAB_CHILD> children;
+		std::vector<FLAT_PART> flattened;
+		bool bFlattened;
+	};
+	// one GPU culler mesh shared by every part with this shape and texture
+	struct BATCH
+	{
+		PREFAB_SHAPE shape;
+		int textureSlot;
+		int meshIndex;
+	};
+	struct INSTANCE
+	{
+		int prefabIndex;
+		int firstCullerInstance;
+		int cullerGroup;
+	};
+
+	GPUCuller* m_pCuller;
+	std::vector<PREFAB> m_prefabs;
+	std::vector<BATCH> m_batches;
+	std::vector<INSTANCE> m_instances;
+	// LOD chains of the shapes, built when first used
+	std::vector<MESH_LOD> m_shapeChains[PREFAB_SHAPE_COUNT];
+
+	int FindBatch(PREFAB_SHAPE shape, int textureSlot);
+	void Flatten(int prefabIndex, const glm::mat4& parentTransform, std::vector<FLAT_PART>& output);
+	const std::vector<FLAT_PART>& GetFlattened(int prefabIndex);
+};
@@ -0,0 +1,1141 @@
+///////////////////////////////////////////////////////////////////////////////
+// rayquery.cpp
+// ============
+// closest and any hit ray queries over a two level BVH, for picking and
+// line of sight
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RayQuery.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define RAY_USE_SSE2 1
+#endif
+
+namespace
+{
+	// centroid bins tried for each SAH split
+	const int SAH_BINS = 12;
+	// nodes deeper than this become leaves, whatever their size, so the
+	// traversal stacks below cannot overflow
+	const int MAX_BVH_DEPTH = 48;
+	const int TRAVERSAL_STACK_SIZE = 64;
+	// triangles seen edge on are missed
+	const float DETERMINANT_EPSILON = 1.0e-12f;
+	// returned by the box tests for a miss
+	const float NO_HIT = std::numeric_limits<float>::infinity();
+
+	// a node still to be visited, and where the ray enters it
+	struct STACK_ENTRY
+	{
+		uint32_t node;
+		float entry;
+	};
+
+	float SurfaceArea(glm::vec3 boundsMin, glm::vec3 boundsMax)
+	{
+		glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+		return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+
+	// reciprocal of a direction component, kept finite so that a zero
+	// component times it gives zero rather than NaN
+	float SafeReciprocal(float value)
+	{
+		const float tiny = 1.0e-20f;
+		return 1.0f / ((std::fabs(value) > tiny) ? value : std::copysign(tiny, value));
+	}
+
+#if !defined(RAY_USE_SSE2)
+	// slab test of one ray; the entry distance, or NO_HIT
+	float IntersectBoxScalar(
+		const glm::vec3& boundsMin,
+		const glm::vec3& boundsMax,
+		const float* origin,
+		const float* invDirection,
+		float maxDistance)
+	{
+		float entry = 0.0f;
+		float exit = maxDistance;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float t0 = (boundsMin[axis] - origin[axis]) * invDirection[axis];
+			float t1 = (boundsMax[axis] - origin[axis]) * invDirection[axis];
+			entry = std::max(entry, std::min(t0, t1));
+			exit = std::min(exit, std::max(t0, t1));
+		}
+		return (entry <= exit) ? entry : NO_HIT;
+	}
+
+	// Moller-Trumbore test of one ray and one triangle, hitting only
+	// closer than maxDistance
+	bool IntersectTriangleScalar(
+		const float* v0,
+		const float* e1,
+		const float* e2,
+		const float* origin,
+		const float* direction,
+		float maxDistance,
+		float& t,
+		float& u,
+		float& v)
+	{
+		glm::vec3 edge1(e1[0], e1[1], e1[2]);
+		glm::vec3 edge2(e2[0], e2[1], e2[2]);
+		glm::vec3 dir(direction[0], direction[1], direction[2]);
+		glm::vec3 pvec = glm::cross(dir, edge2);
+		float det = glm::dot(edge1, pvec);
+		if (std::fabs(det) <= DETERMINANT_EPSILON)
+		{
+			return false;
+		}
+		float invDet = 1.0f / det;
+		glm::vec3 tvec(origin[0] - v0[0], origin[1] - v0[1], origin[2] - v0[2]);
+		u = glm::dot(tvec, pvec) * invDet;
+		glm::vec3 qvec = glm::cross(tvec, edge1);
+		v = glm::dot(dir, qvec) * invDet;
+		t = glm::dot(edge2, qvec) * invDet;
+		return (u >= 0.0f) && (v >= 0.0f) && (u + v <= 1.0f) && (t > 0.0f) && (t < maxDistance);
+	}
+#endif
+}
+
+/***********************************************************
+ *  RayQuery()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RayQuery::RayQuery()
+{
+}
+
+/***********************************************************
+ *  BuildBVH()
+ *
+ *  This method is used for building a BVH over boxes, with
+ *  binned SAH splits along the widest axis of the centroids.
+ *  order receives the box indices so that each leaf's boxes
+ *  are contiguous, from the leaf's first.
+ ***********************************************************/
+void RayQuery::BuildBVH(
+	const std::vector<glm::vec3>& boxMin,
+	const std::vector<glm::vec3>& boxMax,
+	uint32_t leafSize,
+	std::vector<BVH_NODE>& nodes,
+	std::vector<uint32_t>& order)
+{
+	size_t count = boxMin.size();
+	nodes.clear();
+	order.resize(count);
+	if (count == 0)
+	{
+		return;
+	}
+
+	std::vector<glm::vec3> centroids(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		order[i] = (uint32_t)i;
+		centroids[i] = 0.5f * (boxMin[i] + boxMax[i]);
+	}
+
+	struct BUILD_TASK
+	{
+		uint32_t node;
+		uint32_t start;
+		uint32_t end;
+		int depth;
+	};
+	std::vector<BUILD_TASK> tasks;
+	nodes.reserve(2 * count);
+	nodes.push_back(BVH_NODE());
+	tasks.push_back({ 0, 0, (uint32_t)count, 0 });
+
+	while (!tasks.empty())
+	{
+		BUILD_TASK task = tasks.back();
+		tasks.pop_back();
+
+		glm::vec3 boundsMin(FLT_MAX);
+		glm::vec3 boundsMax(-FLT_MAX);
+		glm::vec3 centroidMin(FLT_MAX);
+		glm::vec3 centroidMax(-FLT_MAX);
+		for (uint32_t i = task.start; i < task.end; i++)
+		{
+			uint32_t box = order[i];
+			boundsMin = glm::min(boundsMin, boxMin[box]);
+			boundsMax = glm::max(boundsMax, boxMax[box]);
+			centroidMin = glm::min(centroidMin, centroids[box]);
+			centroidMax = glm::max(centroidMax, centroids[box]);
+		}
+		nodes[task.node].boundsMin = boundsMin;
+		nodes[task.node].boundsMax = boundsMax;
+
+		glm::vec3 extent = centroidMax - centroidMin;
+		int axis = 0;
+		if (extent.y > extent[axis])
+		{
+			axis = 1;
+		}
+		if (extent.z > extent[axis])
+		{
+			axis = 2;
+		}
+
+		uint32_t boxCount = task.end - task.start;
+		uint32_t split = task.start;
+		if ((boxCount > leafSize) && (task.depth < MAX_BVH_DEPTH) && (extent[axis] > 0.0f))
+		{
+			float scale = SAH_BINS / extent[axis];
+			float offset = centroidMin[axis];
+			auto binOf = [&](uint32_t box)
+			{
+				int bin = (int)((centroids[box][axis] - offset) * scale);
+				return std::min(bin, SAH_BINS - 1);
+			};
+
+			int binCount[SAH_BINS] = {};
+			glm::vec3 binMin[SAH_BINS];
+			glm::vec3 binMax[SAH_BINS];
+			for (int bin = 0; bin < SAH_BINS; bin++)
+			{
+				binMin[bin] = glm::vec3(FLT_MAX);
+				binMax[bin] = glm::vec3(-FLT_MAX);
+			}
+			for (uint32_t i = task.start; i < task.end; i++)
+			{
+				uint32_t box = order[i];
+				int bin = binOf(box);
+				binCount[bin]++;
+				binMin[bin] = glm::min(binMin[bin], boxMin[box]);
+				binMax[bin] = glm::max(binMax[bin], boxMax[box]);
+			}
+
+			// sweep from the right for the boxes above each plane, then
+			// from the left to cost each plane
+			float rightArea[SAH_BINS] = {};
+			int rightCount[SAH_BINS] = {};
+			glm::vec3 sideMin(FLT_MAX);
+			glm::vec3 sideMax(-FLT_MAX);
+			int sideCount = 0;
+			for (int bin = SAH_BINS - 1; bin > 0; bin--)
+			{
+				sideMin = glm::min(sideMin, binMin[bin]);
+				sideMax = glm::max(sideMax, binMax[bin]);
+				sideCount += binCount[bin];
+				rightArea[bin] = SurfaceArea(sideMin, sideMax);
+				rightCount[bin] = sideCount;
+			}
+
+			int bestBin = -1;
+			float bestCost = FLT_MAX;
+			sideMin = glm::vec3(FLT_MAX);
+			sideMax = glm::vec3(-FLT_MAX);
+			sideCount = 0;
+			for (int bin = 0; bin < SAH_BINS - 1; bin++)
+			{
+				sideMin = glm::min(sideMin, binMin[bin]);
+				sideMax = glm::max(sideMax, binMax[bin]);
+				sideCount += binCount[bin];
+				if ((sideCount == 0) || (rightCount[bin + 1] == 0))
+				{
+					continue;
+				}
+				float cost = sideCount * SurfaceArea(sideMin, sideMax) + rightCount[bin + 1] * rightArea[bin + 1];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestBin = bin;
+				}
+			}
+
+			if (bestBin >= 0)
+			{
+				uint32_t* middle = std::partition(
+					order.data() + task.start,
+					order.data() + task.end,
+					[&](uint32_t box) { return binOf(box) <= bestBin; });
+				split = (uint32_t)(middle - order.data());
+			}
+		}
+
+		if ((split == task.start) || (split == task.end))
+		{
+			nodes[task.node].first = task.start;
+			nodes[task.node].count = boxCount;
+			continue;
+		}
+
+		uint32_t left = (uint32_t)nodes.size();
+		nodes.push_back(BVH_NODE());
+		nodes.push_back(BVH_NODE());
+		nodes[task.node].first = left;
+		nodes[task.node].count = 0;
+		tasks.push_back({ left, task.start, split, task.depth + 1 });
+		tasks.push_back({ left + 1, split, task.end, task.depth + 1 });
+	}
+}
+
+/***********************************************************
+ *  AddMesh()
+ *
+ *  This method is used for building the BVH of a mesh's
+ *  triangles, four to a leaf, then packing each leaf's
+ *  triangles into blocks for the SIMD tests.
+ ***********************************************************/
+int RayQuery::AddMesh(const MESH_DATA& mesh)
+{
+	size_t triangleCount = MeshData::TriangleCount(mesh);
+	std::vector<glm::vec3> boxMin(triangleCount);
+	std::vector<glm::vec3> boxMax(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const glm::vec3& p0 = mesh.vertices[mesh.indices[3 * t + 0]].position;
+		const glm::vec3& p1 = mesh.vertices[mesh.indices[3 * t + 1]].position;
+		const glm::vec3& p2 = mesh.vertices[mesh.indices[3 * t + 2]].position;
+		boxMin[t] = glm::min(p0, glm::min(p1, p2));
+		boxMax[t] = glm::max(p0, glm::max(p1, p2));
+	}
+
+	MESH_BVH bvh;
+	std::vector<uint32_t> order;
+	BuildBVH(boxMin, boxMax, 4, bvh.nodes, order);
+
+	for (BVH_NODE& node : bvh.nodes)
+	{
+		if (node.count == 0)
+		{
+			continue;
+		}
+		uint32_t firstTriangle = node.first;
+		node.first = (uint32_t)bvh.blocks.size();
+		for (uint32_t i = 0; i < node.count; i += 4)
+		{
+			TRIANGLE_BLOCK block = {};
+			for (int lane = 0; lane < 4; lane++)
+			{
+				block.triangle[lane] = -1;
+				if (i + lane >= node.count)
+				{
+					continue;
+				}
+				uint32_t t = order[firstTriangle + i + lane];
+				const glm::vec3& p0 = mesh.vertices[mesh.indices[3 * t + 0]].position;
+				const glm::vec3& p1 = mesh.vertices[mesh.indices[3 * t + 1]].position;
+				const glm::vec3& p2 = mesh.vertices[mesh.indices[3 * t + 2]].position;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					block.v0[axis][lane] = p0[axis];
+					block.e1[axis][lane] = p1[axis] - p0[axis];
+					block.e2[axis][lane] = p2[axis] - p0[axis];
+				}
+				block.triangle[lane] = (int32_t)t;
+			}
+			bvh.blocks.push_back(block);
+		}
+	}
+
+	m_meshes.push_back(std::move(bvh));
+	return (int)m_meshes.size() - 1;
+}
+
+/***********************************************************
+ *  AddInstance()
+ *
+ *  This method is used for placing a mesh in the world. Its
+ *  world bounds are those of its bounding box's corners.
+ ***********************************************************/
+int RayQuery::AddInstance(int meshIndex, const glm::mat4& model)
+{
+	if ((meshIndex < 0) || (meshIndex >= (int)m_meshes.size()) || m_meshes[meshIndex].nodes.empty())
+	{
+		return -1;
+	}
+
+	const BVH_NODE& root = m_meshes[meshIndex].nodes[0];
+	INSTANCE instance;
+	instance.worldToObject = glm::inverse(model);
+	instance.boundsMin = glm::vec3(FLT_MAX);
+	instance.boundsMax = glm::vec3(-FLT_MAX);
+	instance.mesh = meshIndex;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 local(
+			(corner & 1) ? root.boundsMax.x : root.boundsMin.x,
+			(corner & 2) ? root.boundsMax.y : root.boundsMin.y,
+			(corner & 4) ? root.boundsMax.z : root.boundsMin.z);
+		glm::vec3 world = glm::vec3(model * glm::vec4(local, 1.0f));
+		instance.boundsMin = glm::min(instance.boundsMin, world);
+		instance.boundsMax = glm::max(instance.boundsMax, world);
+	}
+	m_instances.push_back(instance);
+	return (int)m_instances.size() - 1;
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for building the BVH over the
+ *  instances, one to a leaf.
+ ***********************************************************/
+void RayQuery::Build()
+{
+	std::vector<glm::vec3> boxMin(m_instances.size());
+	std::vector<glm::vec3> boxMax(m_instances.size());
+	for (size_t i = 0; i < m_instances.size(); i++)
+	{
+		boxMin[i] = m_instances[i].boundsMin;
+		boxMax[i] = m_instances[i].boundsMax;
+	}
+	BuildBVH(boxMin, boxMax, 1, m_nodes, m_instanceOrder);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing every mesh and instance.
+ ***********************************************************/
+void RayQuery::Clear()
+{
+	m_meshes.clear();
+	m_instances.clear();
+	m_nodes.clear();
+	m_instanceOrder.clear();
+}
+
+/***********************************************************
+ *  MakeTraceRay()
+ *
+ *  This method is used for setting up a ray for the tests.
+ ***********************************************************/
+void RayQuery::MakeTraceRay(glm::vec3 origin, glm::vec3 direction, TRACE_RAY& ray)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		ray.origin[axis] = origin[axis];
+		ray.direction[axis] = direction[axis];
+		ray.invDirection[axis] = SafeReciprocal(direction[axis]);
+	}
+	// with these, a box test's w lane is the ray's own interval
+	ray.origin[3] = 0.0f;
+	ray.direction[3] = 0.0f;
+	ray.invDirection[3] = 1.0f;
+}
+
+/***********************************************************
+ *  IntersectBox()
+ *
+ *  This method is used for the slab test of one ray against
+ *  a node's box, all three axes at once. Returns where the
+ *  ray enters the box, or NO_HIT.
+ ***********************************************************/
+float RayQuery::IntersectBox(const BVH_NODE& node, const TRACE_RAY& ray, float maxDistance)
+{
+#if defined(RAY_USE_SSE2)
+	const __m128 maskXYZ = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	// the w lanes load the node's first and count; replace them with
+	// 0 and maxDistance so they clip the ray's interval
+	__m128 boundsMin = _mm_and_ps(_mm_loadu_ps(&node.boundsMin.x), maskXYZ);
+	__m128 boundsMax = _mm_or_ps(
+		_mm_and_ps(_mm_loadu_ps(&node.boundsMax.x), maskXYZ),
+		_mm_setr_ps(0.0f, 0.0f, 0.0f, maxDistance));
+	__m128 origin = _mm_load_ps(ray.origin);
+	__m128 invDirection = _mm_load_ps(ray.invDirection);
+
+	__m128 t0 = _mm_mul_ps(_mm_sub_ps(boundsMin, origin), invDirection);
+	__m128 t1 = _mm_mul_ps(_mm_sub_ps(boundsMax, origin), invDirection);
+	__m128 near4 = _mm_min_ps(t0, t1);
+	__m128 far4 = _mm_max_ps(t0, t1);
+
+	near4 = _mm_max_ps(near4, _mm_shuffle_ps(near4, near4, _MM_SHUFFLE(1, 0, 3, 2)));
+	near4 = _mm_max_ps(near4, _mm_shuffle_ps(near4, near4, _MM_SHUFFLE(2, 3, 0, 1)));
+	far4 = _mm_min_ps(far4, _mm_shuffle_ps(far4, far4, _MM_SHUFFLE(1, 0, 3, 2)));
+	far4 = _mm_min_ps(far4, _mm_shuffle_ps(far4, far4, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	float entry = _mm_cvtss_f32(near4);
+	float exit = _mm_cvtss_f32(far4);
+	return (entry <= exit) ? entry : NO_HIT;
+#else
+	return IntersectBoxScalar(node.boundsMin, node.boundsMax, ray.origin, ray.invDirection, maxDistance);
+#endif
+}
+
+/***********************************************************
+ *  IntersectBlock()
+ *
+ *  This method is used for testing one ray against the four
+ *  triangles of a block at once. The closest hit nearer
+ *  than hit.distance is recorded in hit, less its instance.
+ ***********************************************************/
+bool RayQuery::IntersectBlock(const TRIANGLE_BLOCK& block, const TRACE_RAY& ray, RAY_HIT& hit)
+{
+	alignas(16) float t[4];
+	alignas(16) float u[4];
+	alignas(16) float v[4];
+	int hitMask = 0;
+
+#if defined(RAY_USE_SSE2)
+	__m128 dx = _mm_set1_ps(ray.direction[0]);
+	__m128 dy = _mm_set1_ps(ray.direction[1]);
+	__m128 dz = _mm_set1_ps(ray.direction[2]);
+	__m128 e1x = _mm_load_ps(block.e1[0]);
+	__m128 e1y = _mm_load_ps(block.e1[1]);
+	__m128 e1z = _mm_load_ps(block.e1[2]);
+	__m128 e2x = _mm_load_ps(block.e2[0]);
+	__m128 e2y = _mm_load_ps(block.e2[1]);
+	__m128 e2z = _mm_load_ps(block.e2[2]);
+
+	// pvec = d x e2
+	__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+	__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	__m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+	__m128 tx = _mm_sub_ps(_mm_set1_ps(ray.origin[0]), _mm_load_ps(block.v0[0]));
+	__m128 ty = _mm_sub_ps(_mm_set1_ps(ray.origin[1]), _mm_load_ps(block.v0[1]));
+	__m128 tz = _mm_sub_ps(_mm_set1_ps(ray.origin[2]), _mm_load_ps(block.v0[2]));
+	__m128 u4 = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), invDet);
+
+	// qvec = tvec x e1
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+	__m128 v4 = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+	__m128 t4 = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+	const __m128 zero = _mm_setzero_ps();
+	__m128 absDet = _mm_and_ps(det, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+	__m128 mask = _mm_cmpgt_ps(absDet, _mm_set1_ps(DETERMINANT_EPSILON));
+	mask = _mm_and_ps(mask, _mm_cmpge_ps(u4, zero));
+	mask = _mm_and_ps(mask, _mm_cmpge_ps(v4, zero));
+	mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u4, v4), _mm_set1_ps(1.0f)));
+	mask = _mm_and_ps(mask, _mm_cmpgt_ps(t4, zero));
+	mask = _mm_and_ps(mask, _mm_cmplt_ps(t4, _mm_set1_ps(hit.distance)));
+	hitMask = _mm_movemask_ps(mask);
+	if (hitMask == 0)
+	{
+		return false;
+	}
+	_mm_store_ps(t, t4);
+	_mm_store_ps(u, u4);
+	_mm_store_ps(v, v4);
+#else
+	for (int lane = 0; lane < 4; lane++)
+	{
+		float v0[3] = { block.v0[0][lane], block.v0[1][lane], block.v0[2][lane] };
+		float e1[3] = { block.e1[0][lane], block.e1[1][lane], block.e1[2][lane] };
+		float e2[3] = { block.e2[0][lane], block.e2[1][lane], block.e2[2][lane] };
+		if (IntersectTriangleScalar(v0, e1, e2, ray.origin, ray.direction, hit.distance, t[lane], u[lane], v[lane]))
+		{
+			hitMask |= 1 << lane;
+		}
+	}
+#endif
+
+	bool bHit = false;
+	for (int lane = 0; lane < 4; lane++)
+	{
+		if ((hitMask & (1 << lane)) && (t[lane] < hit.distance))
+		{
+			hit.distance = t[lane];
+			hit.triangle = block.triangle[lane];
+			hit.u = u[lane];
+			hit.v = v[lane];
+			bHit = true;
+		}
+	}
+	return bHit;
+}
+
+/***********************************************************
+ *  IntersectBoxPacket()
+ *
+ *  This method is used for the slab test of four rays
+ *  against a node's box, one ray to a lane. Returns the
+ *  lanes that hit, and the nearest entry among them.
+ ***********************************************************/
+int RayQuery::IntersectBoxPacket(const BVH_NODE& node, const TRACE_PACKET& packet, const float* tMax, float& nearest)
+{
+	alignas(16) float entries[4];
+	int hitMask = 0;
+
+#if defined(RAY_USE_SSE2)
+	__m128 entry = _mm_setzero_ps();
+	__m128 exit = _mm_loadu_ps(tMax);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		__m128 origin = _mm_load_ps(packet.origin[axis]);
+		__m128 invDirection = _mm_load_ps(packet.invDirection[axis]);
+		__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin[axis]), origin), invDirection);
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax[axis]), origin), invDirection);
+		entry = _mm_max_ps(entry, _mm_min_ps(t0, t1));
+		exit = _mm_min_ps(exit, _mm_max_ps(t0, t1));
+	}
+	hitMask = _mm_movemask_ps(_mm_cmple_ps(entry, exit));
+	_mm_store_ps(entries, entry);
+#else
+	for (int lane = 0; lane < 4; lane++)
+	{
+		float origin[3] = { packet.origin[0][lane], packet.origin[1][lane], packet.origin[2][lane] };
+		float invDirection[3] = { packet.invDirection[0][lane], packet.invDirection[1][lane], packet.invDirection[2][lane] };
+		entries[lane] = IntersectBoxScalar(node.boundsMin, node.boundsMax, origin, invDirection, tMax[lane]);
+		if (entries[lane] != NO_HIT)
+		{
+			hitMask |= 1 << lane;
+		}
+	}
+#endif
+
+	nearest = NO_HIT;
+	for (int lane = 0; lane < 4; lane++)
+	{
+		if (hitMask & (1 << lane))
+		{
+			nearest = std::min(nearest, entries[lane]);
+		}
+	}
+	return hitMask;
+}
+
+/***********************************************************
+ *  IntersectTrianglePacket()
+ *
+ *  This method is used for testing four rays, one to a lane,
+ *  against one triangle of a block. Lanes hitting it nearer
+ *  than their tMax have tMax and their hit updated, less the
+ *  instance, and are returned.
+ ***********************************************************/
+int RayQuery::IntersectTrianglePacket(
+	const TRIANGLE_BLOCK& block,
+	int lane,
+	const TRACE_PACKET& packet,
+	float* tMax,
+	RAY_HIT* hits)
+{
+	alignas(16) float t[4];
+	alignas(16) float u[4];
+	alignas(16) float v[4];
+	int hitMask = 0;
+
+#if defined(RAY_USE_SSE2)
+	__m128 dx = _mm_load_ps(packet.direction[0]);
+	__m128 dy = _mm_load_ps(packet.direction[1]);
+	__m128 dz = _mm_load_ps(packet.direction[2]);
+	__m128 e1x = _mm_set1_ps(block.e1[0][lane]);
+	__m128 e1y = _mm_set1_ps(block.e1[1][lane]);
+	__m128 e1z = _mm_set1_ps(block.e1[2][lane]);
+	__m128 e2x = _mm_set1_ps(block.e2[0][lane]);
+	__m128 e2y = _mm_set1_ps(block.e2[1][lane]);
+	__m128 e2z = _mm_set1_ps(block.e2[2][lane]);
+
+	__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+	__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	__m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+	__m128 tx = _mm_sub_ps(_mm_load_ps(packet.origin[0]), _mm_set1_ps(block.v0[0][lane]));
+	__m128 ty = _mm_sub_ps(_mm_load_ps(packet.origin[1]), _mm_set1_ps(block.v0[1][lane]));
+	__m128 tz = _mm_sub_ps(_mm_load_ps(packet.origin[2]), _mm_set1_ps(block.v0[2][lane]));
+	__m128 u4 = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), invDet);
+
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+	__m128 v4 = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+	__m128 t4 = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+	const __m128 zero = _mm_setzero_ps();
+	__m128 absDet = _mm_and_ps(det, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+	__m128 mask = _mm_cmpgt_ps(absDet, _mm_set1_ps(DETERMINANT_EPSILON));
+	mask = _mm_and_ps(mask, _mm_cmpge_ps(u4, zero));
+	mask = _mm_and_ps(mask, _mm_cmpge_ps(v4, zero));
+	mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u4, v4), _mm_set1_ps(1.0f)));
+	mask = _mm_and_ps(mask, _mm_cmpgt_ps(t4, zero));
+	mask = _mm_and_ps(mask, _mm_cmplt_ps(t4, _mm_loadu_ps(tMax)));
+	hitMask = _mm_movemask_ps(mask);
+	if (hitMask == 0)
+	{
+		return 0;
+	}
+	_mm_store_ps(t, t4);
+	_mm_store_ps(u, u4);
+	_mm_store_ps(v, v4);
+#else
+	float v0[3] = { block.v0[0][lane], block.v0[1][lane], block.v0[2][lane] };
+	float e1[3] = { block.e1[0][lane], block.e1[1][lane], block.e1[2][lane] };
+	float e2[3] = { block.e2[0][lane], block.e2[1][lane], block.e2[2][lane] };
+	for (int ray = 0; ray < 4; ray++)
+	{
+		float origin[3] = { packet.origin[0][ray], packet.origin[1][ray], packet.origin[2][ray] };
+		float direction[3] = { packet.direction[0][ray], packet.direction[1][ray], packet.direction[2][ray] };
+		if (IntersectTriangleScalar(v0, e1, e2, origin, direction, tMax[ray], t[ray], u[ray], v[ray]))
+		{
+			hitMask |= 1 << ray;
+		}
+	}
+#endif
+
+	for (int ray = 0; ray < 4; ray++)
+	{
+		if (hitMask & (1 << ray))
+		{
+			tMax[ray] = t[ray];
+			hits[ray].triangle = block.triangle[lane];
+			hits[ray].u = u[ray];
+			hits[ray].v = v[ray];
+		}
+	}
+	return hitMask;
+}
+
+/***********************************************************
+ *  TraceMesh()
+ *
+ *  This method is used for tracing a ray, already in the
+ *  mesh's space, through the mesh's BVH, nearer child first.
+ *  Returns true if it found a hit closer than hit.distance.
+ ***********************************************************/
+bool RayQuery::TraceMesh(const MESH_BVH& mesh, const TRACE_RAY& ray, RAY_HIT& hit, bool bAnyHit)
+{
+	STACK_ENTRY stack[TRAVERSAL_STACK_SIZE];
+	int top = 0;
+	bool bHit = false;
+
+	if (IntersectBox(mesh.nodes[0], ray, hit.distance) == NO_HIT)
+	{
+		return false;
+	}
+	stack[top++] = { 0, 0.0f };
+
+	while (top > 0)
+	{
+		STACK_ENTRY entry = stack[--top];
+		if (entry.entry >= hit.distance)
+		{
+			continue;
+		}
+		const BVH_NODE& node = mesh.nodes[entry.node];
+		if (node.count > 0)
+		{
+			uint32_t blockCount = (node.count + 3) / 4;
+			for (uint32_t i = 0; i < blockCount; i++)
+			{
+				if (IntersectBlock(mesh.blocks[node.first + i], ray, hit))
+				{
+					bHit = true;
+					if (bAnyHit)
+					{
+						return true;
+					}
+				}
+			}
+			continue;
+		}
+
+		uint32_t nearChild = node.first;
+		uint32_t farChild = node.first + 1;
+		float nearEntry = IntersectBox(mesh.nodes[nearChild], ray, hit.distance);
+		float farEntry = IntersectBox(mesh.nodes[farChild], ray, hit.distance);
+		if (farEntry < nearEntry)
+		{
+			std::swap(nearChild, farChild);
+			std::swap(nearEntry, farEntry);
+		}
+		if (farEntry != NO_HIT)
+		{
+			stack[top++] = { farChild, farEntry };
+		}
+		if (nearEntry != NO_HIT)
+		{
+			stack[top++] = { nearChild, nearEntry };
+		}
+	}
+	return bHit;
+}
+
+/***********************************************************
+ *  TraceRay()
+ *
+ *  This method is used for tracing one ray through the
+ *  instance BVH, moving it into the space of each instance
+ *  whose box it reaches. hit.distance starts as the ray's
+ *  maxDistance; with bAnyHit the first hit ends the trace.
+ ***********************************************************/
+bool RayQuery::TraceRay(const RAY& ray, RAY_HIT& hit, bool bAnyHit) const
+{
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	TRACE_RAY worldRay;
+	MakeTraceRay(ray.origin, ray.direction, worldRay);
+	STACK_ENTRY stack[TRAVERSAL_STACK_SIZE];
+	int top = 0;
+
+	if (IntersectBox(m_nodes[0], worldRay, hit.distance) == NO_HIT)
+	{
+		return false;
+	}
+	stack[top++] = { 0, 0.0f };
+
+	while (top > 0)
+	{
+		STACK_ENTRY entry = stack[--top];
+		if (entry.entry >= hit.distance)
+		{
+			continue;
+		}
+		const BVH_NODE& node = m_nodes[entry.node];
+		if (node.count > 0)
+		{
+			for (uint32_t i = 0; i < node.count; i++)
+			{
+				uint32_t instanceIndex = m_instanceOrder[node.first + i];
+				const INSTANCE& instance = m_instances[instanceIndex];
+				// the transform is affine, so distances along the ray
+				// are the same in both spaces
+				TRACE_RAY localRay;
+				MakeTraceRay(
+					glm::vec3(instance.worldToObject * glm::vec4(ray.origin, 1.0f)),
+					glm::vec3(instance.worldToObject * glm::vec4(ray.direction, 0.0f)),
+					localRay);
+				if (TraceMesh(m_meshes[instance.mesh], localRay, hit, bAnyHit))
+				{
+					hit.instance = (int)instanceIndex;
+					if (bAnyHit)
+					{
+						return true;
+					}
+				}
+			}
+			continue;
+		}
+
+		uint32_t nearChild = node.first;
+		uint32_t farChild = node.first + 1;
+		float nearEntry = IntersectBox(m_nodes[nearChild], worldRay, hit.distance);
+		float farEntry = IntersectBox(m_nodes[farChild], worldRay, hit.distance);
+		if (farEntry < nearEntry)
+		{
+			std::swap(nearChild, farChild);
+			std::swap(nearEntry, farEntry);
+		}
+		if (farEntry != NO_HIT)
+		{
+			stack[top++] = { farChild, farEntry };
+		}
+		if (nearEntry != NO_HIT)
+		{
+			stack[top++] = { nearChild, nearEntry };
+		}
+	}
+	return hit.instance >= 0;
+}
+
+/***********************************************************
+ *  TraceMeshPacket()
+ *
+ *  This method is used for tracing four rays, already in the
+ *  mesh's space, through the mesh's BVH together. Each node
+ *  is visited by the lanes whose rays reach it. Returns the
+ *  lanes that found closer hits.
+ ***********************************************************/
+int RayQuery::TraceMeshPacket(
+	const MESH_BVH& mesh,
+	const TRACE_PACKET& packet,
+	int activeMask,
+	float* tMax,
+	RAY_HIT* hits,
+	bool bAnyHit)
+{
+	uint32_t stack[TRAVERSAL_STACK_SIZE];
+	int top = 0;
+	int hitMask = 0;
+	stack[top++] = 0;
+
+	while ((top > 0) && (activeMask != 0))
+	{
+		const BVH_NODE& node = mesh.nodes[stack[--top]];
+		float nearest = 0.0f;
+		if ((IntersectBoxPacket(node, packet, tMax, nearest) & activeMask) == 0)
+		{
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (uint32_t i = 0; i < node.count; i++)
+			{
+				const TRIANGLE_BLOCK& block = mesh.blocks[node.first + i / 4];
+				int lanes = IntersectTrianglePacket(block, i % 4, packet, tMax, hits) & activeMask;
+				hitMask |= lanes;
+				if (bAnyHit)
+				{
+					// a lane that has hit something is done
+					for (int ray = 0; ray < 4; ray++)
+					{
+						if (lanes & (1 << ray))
+						{
+							tMax[ray] = -1.0f;
+						}
+					}
+					activeMask &= ~lanes;
+				}
+			}
+			continue;
+		}
+
+		// visit the child nearer to the packet first
+		uint32_t nearChild = node.first;
+		uint32_t farChild = node.first + 1;
+		float nearEntry = 0.0f;
+		float farEntry = 0.0f;
+		int nearMask = IntersectBoxPacket(mesh.nodes[nearChild], packet, tMax, nearEntry) & activeMask;
+		int farMask = IntersectBoxPacket(mesh.nodes[farChild], packet, tMax, farEntry) & activeMask;
+		if (farEntry < nearEntry)
+		{
+			std::swap(nearChild, farChild);
+			std::swap(nearMask, farMask);
+		}
+		if (farMask != 0)
+		{
+			stack[top++] = farChild;
+		}
+		if (nearMask != 0)
+		{
+			stack[top++] = nearChild;
+		}
+	}
+	return hitMask;
+}
+
+/***********************************************************
+ *  TracePacket()
+ *
+ *  This method is used for tracing up to four rays together
+ *  through the instance BVH. Lanes past count, and lanes
+ *  whose any hit query is answered, have a negative tMax so
+ *  every box test misses them.
+ ***********************************************************/
+void RayQuery::TracePacket(const RAY* rays, RAY_HIT* hits, int count, bool bAnyHit) const
+{
+	TRACE_PACKET worldPacket;
+	float tMax[4];
+	int activeMask = 0;
+	for (int lane = 0; lane < 4; lane++)
+	{
+		const RAY& ray = rays[std::min(lane, count - 1)];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			worldPacket.origin[axis][lane] = ray.origin[axis];
+			worldPacket.direction[axis][lane] = ray.direction[axis];
+			worldPacket.invDirection[axis][lane] = SafeReciprocal(ray.direction[axis]);
+		}
+		tMax[lane] = -1.0f;
+		if (lane < count)
+		{
+			hits[lane] = RAY_HIT();
+			tMax[lane] = ray.maxDistance;
+			activeMask |= 1 << lane;
+		}
+	}
+	if (m_nodes.empty())
+	{
+		return;
+	}
+
+	uint32_t stack[TRAVERSAL_STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+
+	while ((top > 0) && (activeMask != 0))
+	{
+		const BVH_NODE& node = m_nodes[stack[--top]];
+		float nearest = 0.0f;
+		int nodeMask = IntersectBoxPacket(node, worldPacket, tMax, nearest) & activeMask;
+		if (nodeMask == 0)
+		{
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (uint32_t i = 0; i < node.count; i++)
+			{
+				uint32_t instanceIndex = m_instanceOrder[node.first + i];
+				const INSTANCE& instance = m_instances[instanceIndex];
+				TRACE_PACKET localPacket;
+				for (int lane = 0; lane < 4; lane++)
+				{
+					glm::vec4 origin(worldPacket.origin[0][lane], worldPacket.origin[1][lane], worldPacket.origin[2][lane], 1.0f);
+					glm::vec4 direction(worldPacket.direction[0][lane], worldPacket.direction[1][lane], worldPacket.direction[2][lane], 0.0f);
+					origin = instance.worldToObject * origin;
+					direction = instance.worldToObject * direction;
+					for (int axis = 0; axis < 3; axis++)
+					{
+						localPacket.origin[axis][lane] = origin[axis];
+						localPacket.direction[axis][lane] = direction[axis];
+						localPacket.invDirection[axis][lane] = SafeReciprocal(direction[axis]);
+					}
+				}
+
+				int lanes = TraceMeshPacket(m_meshes[instance.mesh], localPacket, nodeMask, tMax, hits, bAnyHit);
+				for (int lane = 0; lane < 4; lane++)
+				{
+					if (lanes & (1 << lane))
+					{
+						hits[lane].instance = (int)instanceIndex;
+					}
+				}
+				if (bAnyHit)
+				{
+					activeMask &= ~lanes;
+					nodeMask &= ~lanes;
+				}
+			}
+			continue;
+		}
+
+		uint32_t nearChild = node.first;
+		uint32_t farChild = node.first + 1;
+		float nearEntry = 0.0f;
+		float farEntry = 0.0f;
+		int nearMask = IntersectBoxPacket(m_nodes[nearChild], worldPacket, tMax, nearEntry) & activeMask;
+		int farMask = IntersectBoxPacket(m_nodes[farChild], worldPacket, tMax, farEntry) & activeMask;
+		if (farEntry < nearEntry)
+		{
+			std::swap(nearChild, farChild);
+			std::swap(nearMask, farMask);
+		}
+		if (farMask != 0)
+		{
+			stack[top++] = farChild;
+		}
+		if (nearMask != 0)
+		{
+			stack[top++] = nearChild;
+		}
+	}
+
+	for (int lane = 0; lane < count; lane++)
+	{
+		if (hits[lane].instance >= 0)
+		{
+			hits[lane].distance = bAnyHit ? 0.0f : tMax[lane];
+		}
+	}
+}
+
+/***********************************************************
+ *  ClosestHit()
+ *
+ *  This method is used for finding the nearest surface
+ *  along a ray, for picking.
+ ***********************************************************/
+bool RayQuery::ClosestHit(const RAY& ray, RAY_HIT& hit) const
+{
+	hit = RAY_HIT();
+	hit.distance = ray.maxDistance;
+	if (!TraceRay(ray, hit, false))
+	{
+		hit = RAY_HIT();
+		return false;
+	}
+	return true;
+}
+
+/***********************************************************
+ *  AnyHit()
+ *
+ *  This method is used for checking whether anything lies
+ *  along a ray, which can stop at the first hit it finds.
+ ***********************************************************/
+bool RayQuery::AnyHit(const RAY& ray) const
+{
+	RAY_HIT hit;
+	hit.distance = ray.maxDistance;
+	return TraceRay(ray, hit, true);
+}
+
+/***********************************************************
+ *  IsVisible()
+ *
+ *  This method is used for line of sight between two points.
+ *  The ray stops just short of the target, so the surface
+ *  the target sits on does not hide it.
+ ***********************************************************/
+bool RayQuery::IsVisible(glm::vec3 from, glm::vec3 to) const
+{
+	RAY ray;
+	ray.origin = from;
+	ray.direction = to - from;
+	ray.maxDistance = 0.999f;
+	return !AnyHit(ray);
+}
+
+/***********************************************************
+ *  ClosestHitPacket()
+ *
+ *  This method is used for the closest hits of many rays,
+ *  such as a grid of probe rays, four at a time. Rays that
+ *  start together and point alike share most of their
+ *  traversal.
+ ***********************************************************/
+void RayQuery::ClosestHitPacket(const RAY* rays, RAY_HIT* hits, int count) const
+{
+	for (int i = 0; i < count; i += 4)
+	{
+		TracePacket(rays + i, hits + i, std::min(4, count - i), false);
+	}
+}
+
+/***********************************************************
+ *  AnyHitPacket()
+ *
+ *  This method is used for checking many rays for any hit,
+ *  four at a time.
+ ***********************************************************/
+void RayQuery::AnyHitPacket(const RAY* rays, bool* hits, int count) const
+{
+	for (int i = 0; i < count; i += 4)
+	{
+		RAY_HIT packetHits[4];
+		int packetCount = std::min(4, count - i);
+		TracePacket(rays + i, packetHits, packetCount, true);
+		for (int lane = 0; lane < packetCount; lane++)
+		{
+			hits[i + lane] = (packetHits[lane].instance >= 0);
+		}
+	}
+}
+
+/***********************************************************
+ *  MakePickRay()
+ *
+ *  This method is used for the ray from the camera through a
+ *  point in the window, from the near plane to the far.
+ ***********************************************************/
+RAY RayQuery::MakePickRay(const VIEW_INFO& viewInfo, float x, float y)
+{
+	float ndcX = 2.0f * x / viewInfo.viewportWidth - 1.0f;
+	float ndcY = 1.0f - 2.0f * y / viewInfo.viewportHeight;
+	glm::mat4 inverseViewProjection = glm::inverse(viewInfo.projection * viewInfo.view);
+	glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+	glm::vec3 start = glm::vec3(nearPoint) / nearPoint.w;
+	glm::vec3 end = glm::vec3(farPoint) / farPoint.w;
+
+	RAY ray;
+	ray.origin = start;
+	ray.direction = glm::normalize(end - start);
+	ray.maxDistance = glm::length(end - start);
+	return ray;
+}
@@ -0,0 +1,182 @@
+///////////////////////////////////////////////////////////////////////////////
+// rayquery.h
+// ============
+// closest and any hit ray queries over a two level BVH, for picking and
+// line of sight
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshData.h"
+#include "ViewManager.h"
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  RAY
+ *
+ *  A ray from origin along direction. Distances along it are
+ *  in lengths of direction, so a ray from a to b with
+ *  direction b - a reaches b at 1.
+ ***********************************************************/
+struct RAY
+{
+	glm::vec3 origin = glm::vec3(0.0f);
+	glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+	// hits further along than this are ignored
+	float maxDistance = FLT_MAX;
+};
+
+/***********************************************************
+ *  RAY_HIT
+ *
+ *  The closest hit of a ray: the instance and the triangle
+ *  of its mesh, with the barycentric coordinates of the hit
+ *  on that triangle. instance is -1 when nothing was hit.
+ ***********************************************************/
+struct RAY_HIT
+{
+	float distance = FLT_MAX;
+	int instance = -1;
+	int triangle = -1;
+	float u = 0.0f;
+	float v = 0.0f;
+};
+
+/***********************************************************
+ *  RayQuery
+ *
+ *  This class answers ray queries against instanced meshes.
+ *  Each mesh gets a BVH over its triangles, built once, with
+ *  the triangles of each leaf packed four to a block so one
+ *  SSE test covers them all; the instances get a BVH over
+ *  their world bounds, and a ray is moved into each instance
+ *  it reaches. Both are built with binned SAH splits.
+ *  Packets of four rays are traced together, each box and
+ *  triangle test covering all four rays at once. Queries
+ *  change nothing, so any number of threads may run them at
+ *  once; adding or building must not overlap them.
+ ***********************************************************/
+class RayQuery
+{
+public:
+	// constructor
+	RayQuery();
+
+	// add a mesh and build its BVH; returns the mesh index
+	int AddMesh(const MESH_DATA& mesh);
+	// add an instance of a mesh; returns the instance index, or -1 for
+	// a missing or empty mesh
+	int AddInstance(int meshIndex, const glm::mat4& model);
+	// build the BVH over the instances, after adding them
+	void Build();
+	// remove the meshes and instances
+	void Clear();
+
+	// the closest hit along the ray; false if there is none
+	bool ClosestHit(const RAY& ray, RAY_HIT& hit) const;
+	// true if anything is hit along the ray, stopping at the first hit
+	bool AnyHit(const RAY& ray) const;
+	// true if nothing lies between the two points
+	bool IsVisible(glm::vec3 from, glm::vec3 to) const;
+	// closest or any hits of many rays, traced four at a time
+	void ClosestHitPacket(const RAY* rays, RAY_HIT* hits, int count) const;
+	void AnyHitPacket(const RAY* rays, bool* hits, int count) const;
+
+	// the ray through a window position, in pixels from the top left,
+	// with a unit direction
+	static RAY MakePickRay(const VIEW_INFO& viewInfo, float x, float y);
+
+	int GetMeshCount() const { return (int)m_meshes.size(); }
+	int GetInstanceCount() const { return (int)m_instances.size(); }
+
+private:
+	// a BVH node; count is 0 for an inner node, whose children are at
+	// first and first + 1, otherwise the leaf's items start at first
+	struct BVH_NODE
+	{
+		glm::vec3 boundsMin;
+		uint32_t first;
+		glm::vec3 boundsMax;
+		uint32_t count;
+	};
+	// four triangles as a corner and two edges, one lane each; unused
+	// lanes have zero edges and never hit
+	struct alignas(16) TRIANGLE_BLOCK
+	{
+		float v0[3][4];
+		float e1[3][4];
+		float e2[3][4];
+		int32_t triangle[4];
+	};
+	// a mesh BVH; leaves point at blocks, count is their triangles
+	struct MESH_BVH
+	{
+		std::vector<BVH_NODE> nodes;
+		std::vector<TRIANGLE_BLOCK> blocks;
+	};
+	struct INSTANCE
+	{
+		glm::mat4 worldToObject;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		int mesh;
+	};
+	// a ray set up for box and triangle tests; the w lanes let one SSE
+	// box test also clip to the ray's own interval
+	struct alignas(16) TRACE_RAY
+	{
+		float origin[4];
+		float direction[4];
+		float invDirection[4];
+	};
+	// four rays, one lane each
+	struct alignas(16) TRACE_PACKET
+	{
+		float origin[3][4];
+		float direction[3][4];
+		float invDirection[3][4];
+	};
+
+	std::vector<MESH_BVH> m_meshes;
+	std::vector<INSTANCE> m_instances;
+	// instance BVH; its leaves index m_instanceOrder
+	std::vector<BVH_NODE> m_nodes;
+	std::vector<uint32_t> m_instanceOrder;
+
+	static void BuildBVH(
+		const std::vector<glm::vec3>& boxMin,
+		const std::vector<glm::vec3>& boxMax,
+		uint32_t leafSize,
+		std::vector<BVH_NODE>& nodes,
+		std::vector<uint32_t>& order);
+	static void MakeTraceRay(glm::vec3 origin, glm::vec3 direction, TRACE_RAY& ray);
+
+	bool TraceRay(const RAY& ray, RAY_HIT& hit, bool bAnyHit) const;
+	void TracePacket(const RAY* rays, RAY_HIT* hits, int count, bool bAnyHit) const;
+	static bool TraceMesh(const MESH_BVH& mesh, const TRACE_RAY& ray, RAY_HIT& hit, bool bAnyHit);
+	static int TraceMeshPacket(
+		const MESH_BVH& mesh,
+		const TRACE_PACKET& packet,
+		int activeMask,
+		float* tMax,
+		RAY_HIT* hits,
+		bool bAnyHit);
+
+	// SIMD tests: one ray against a box or four triangles, and four
+	// rays against a box or one triangle
+	static float IntersectBox(const BVH_NODE& node, const TRACE_RAY& ray, float maxDistance);
+	static bool IntersectBlock(const TRIANGLE_BLOCK& block, const TRACE_RAY& ray, RAY_HIT& hit);
+	static int IntersectBoxPacket(const BVH_NODE& node, const TRACE_PACKET& packet, const float* tMax, float& nearest);
+	static int IntersectTrianglePacket(
+		const TRIANGLE_BLOCK& block,
+		int lane,
+		const TRACE_PACKET& packet,
+		float* tMax,
+		RAY_HIT* hits);
+};
@@ -0,0 +1,500 @@
+///////////////////////////////////////////////////////////////////////////////
+// reflectionprobes.cpp
+// ============
+// cubemap reflections, re-rendered a face or a mip at a time
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ReflectionProbes.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+	// after the 16 scene texture units
+	const GLint PROBE_TEXTURE_UNIT = 16;
+	// the smallest prefiltered mip; smaller ones add nothing but cost
+	const int MIN_MIP_SIZE = 8;
+	const int FACE_COUNT = 6;
+
+	// looking down each axis in cubemap face order, with the up vectors
+	// that lay the image out the way the faces are sampled
+	const glm::vec3 FACE_DIRECTIONS[FACE_COUNT] = {
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+	const glm::vec3 FACE_UPS[FACE_COUNT] = {
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f) };
+}
+
+/***********************************************************
+ *  ReflectionProbes()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ReflectionProbes::ReflectionProbes()
+{
+	m_pPrefilterShader = NULL;
+	m_pReflectionShader = NULL;
+	m_framebuffer = 0;
+	m_depthBuffer = 0;
+	m_emptyVAO = 0;
+	m_mipCount = 0;
+	m_current = -1;
+	m_frame = 0;
+	m_refreshCount = 0;
+}
+
+/***********************************************************
+ *  ~ReflectionProbes()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ReflectionProbes::~ReflectionProbes()
+{
+	for (PROBE& probe : m_probes)
+	{
+		glDeleteTextures(1, &probe.captureCubemap);
+		glDeleteTextures(1, &probe.prefilteredCubemap);
+	}
+	m_probes.clear();
+	if (m_emptyVAO != 0)
+	{
+		glDeleteVertexArrays(1, &m_emptyVAO);
+	}
+	if (m_depthBuffer != 0)
+	{
+		glDeleteRenderbuffers(1, &m_depthBuffer);
+	}
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+	}
+	delete m_pPrefilterShader;
+	m_pPrefilterShader = NULL;
+	delete m_pReflectionShader;
+	m_pReflectionShader = NULL;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for loading the prefilter and
+ *  reflection shaders and creating the framebuffer and depth
+ *  buffer every probe face is rendered with.
+ ***********************************************************/
+bool ReflectionProbes::Initialize(const REFLECTION_PROBE_SETTINGS& settings)
+{
+	m_settings = settings;
+	m_settings.resolution = std::max(m_settings.resolution, MIN_MIP_SIZE);
+	m_settings.stepsPerFrame = std::max(m_settings.stepsPerFrame, 1);
+
+	m_mipCount = 1;
+	while ((m_settings.resolution >> m_mipCount) >= MIN_MIP_SIZE)
+	{
+		m_mipCount++;
+	}
+
+	glGenRenderbuffers(1, &m_depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_settings.resolution, m_settings.resolution);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glGenVertexArrays(1, &m_emptyVAO);
+	// the blurred mips are sampled across face edges
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+	m_pPrefilterShader = new ShaderManager();
+	m_pPrefilterShader->LoadShaders(
+		"shaders/probePrefilterVertexShader.glsl",
+		"shaders/probePrefilterFragmentShader.glsl");
+	m_pReflectionShader = new ShaderManager();
+	m_pReflectionShader->LoadShaders(
+		"shaders/reflectionVertexShader.glsl",
+		"shaders/reflectionFragmentShader.glsl");
+
+	std::cout << "[ReflectionProbes] " << m_settings.resolution << "x" << m_settings.resolution
+		<< " probes, " << (FACE_COUNT + m_mipCount) << " steps a refresh, "
+		<< m_settings.stepsPerFrame << " a frame" << std::endl;
+	return true;
+}
+
+/***********************************************************
+ *  CreateCubemap()
+ *
+ *  This method is used for creating an empty cubemap at the
+ *  probe resolution, with room for the prefiltered mips.
+ ***********************************************************/
+GLuint ReflectionProbes::CreateCubemap(bool bMipmapped) const
+{
+	GLuint cubemap = 0;
+	glGenTextures(1, &cubemap);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+	glTexStorage2D(GL_TEXTURE_CUBE_MAP, bMipmapped ? m_mipCount : 1, GL_RGBA16F,
+		m_settings.resolution, m_settings.resolution);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, bMipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, bMipmapped ? m_mipCount - 1 : 0);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	return cubemap;
+}
+
+/***********************************************************
+ *  AddProbe()
+ *
+ *  This method is used for adding a probe, which is captured
+ *  ahead of any refresh that is merely due.
+ ***********************************************************/
+int ReflectionProbes::AddProbe(glm::vec3 position, float radius)
+{
+	if ((0 == m_framebuffer) || (radius <= 0.0f))
+	{
+		return -1;
+	}
+
+	PROBE probe;
+	probe.position = position;
+	probe.radius = radius;
+	// the capture is mipmapped too, so the prefilter can read a level
+	// matching the footprint of each sample instead of aliasing
+	probe.captureCubemap = CreateCubemap(true);
+	probe.prefilteredCubemap = CreateCubemap(true);
+	probe.step = -1;
+	probe.bDirty = true;
+	probe.bReady = false;
+	probe.lastRefreshFrame = 0;
+	m_probes.push_back(probe);
+	return (int)m_probes.size() - 1;
+}
+
+/***********************************************************
+ *  Invalidate()
+ *
+ *  This method is used for marking the probes that can see
+ *  a changed part of the scene, so they are refreshed next.
+ *  A refresh already under way carries on; the probe is
+ *  captured again after it.
+ ***********************************************************/
+void ReflectionProbes::Invalidate(glm::vec3 center, float radius)
+{
+	for (PROBE& probe : m_probes)
+	{
+		if (glm::length(probe.position - center) <= probe.radius + radius)
+		{
+			probe.bDirty = true;
+		}
+	}
+}
+
+void ReflectionProbes::InvalidateAll()
+{
+	for (PROBE& probe : m_probes)
+	{
+		probe.bDirty = true;
+	}
+}
+
+/***********************************************************
+ *  ChooseProbe()
+ *
+ *  This method is used for picking the probe to refresh
+ *  next: an invalidated one, else the stalest that is due,
+ *  else none.
+ ***********************************************************/
+int ReflectionProbes::ChooseProbe() const
+{
+	int chosen = -1;
+	for (int i = 0; i < (int)m_probes.size(); i++)
+	{
+		if (m_probes[i].bDirty &&
+			((chosen < 0) || (m_probes[i].lastRefreshFrame < m_probes[chosen].lastRefreshFrame)))
+		{
+			chosen = i;
+		}
+	}
+	if (chosen >= 0)
+	{
+		return chosen;
+	}
+
+	for (int i = 0; i < (int)m_probes.size(); i++)
+	{
+		if ((m_frame - m_probes[i].lastRefreshFrame >= (uint64_t)m_settings.idleRefreshFrames) &&
+			((chosen < 0) || (m_probes[i].lastRefreshFrame < m_probes[chosen].lastRefreshFrame)))
+		{
+			chosen = i;
+		}
+	}
+	return chosen;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for doing this frame's share of the
+ *  refreshing: at most stepsPerFrame faces or mips, however
+ *  many probes are waiting. The framebuffer, viewport,
+ *  program and clear colour are put back afterwards, and
+ *  the depth test and blending by the prefilter passes.
+ ***********************************************************/
+void ReflectionProbes::Update(FACE_CALLBACK renderFace)
+{
+	m_frame++;
+	if (m_probes.empty() || (NULL == m_pPrefilterShader))
+	{
+		return;
+	}
+
+	GLint previousFramebuffer = 0;
+	GLint previousProgram = 0;
+	GLint previousViewport[4];
+	GLfloat previousClearColor[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, previousClearColor);
+	bool bBound = false;
+
+	for (int i = 0; i < m_settings.stepsPerFrame; i++)
+	{
+		if (m_current < 0)
+		{
+			m_current = ChooseProbe();
+			if (m_current < 0)
+			{
+				break;
+			}
+			// changes from here on need another capture
+			m_probes[m_current].bDirty = false;
+			m_probes[m_current].step = 0;
+		}
+
+		if (!bBound)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+			bBound = true;
+		}
+
+		PROBE& probe = m_probes[m_current];
+		if (probe.step < FACE_COUNT)
+		{
+			RenderFace(probe, probe.step, renderFace);
+			if (probe.step == FACE_COUNT - 1)
+			{
+				glBindTexture(GL_TEXTURE_CUBE_MAP, probe.captureCubemap);
+				glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+				glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+			}
+		}
+		else
+		{
+			PrefilterMip(probe, probe.step - FACE_COUNT);
+		}
+
+		probe.step++;
+		if (probe.step == FACE_COUNT + m_mipCount)
+		{
+			probe.step = -1;
+			probe.bReady = true;
+			probe.lastRefreshFrame = m_frame;
+			m_refreshCount++;
+			m_current = -1;
+		}
+	}
+
+	if (bBound)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+		glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+		glClearColor(previousClearColor[0], previousClearColor[1], previousClearColor[2], previousClearColor[3]);
+		glUseProgram(previousProgram);
+	}
+}
+
+/***********************************************************
+ *  RenderFace()
+ *
+ *  This method is used for rendering the scene down one axis
+ *  from the probe into a face of its capture cubemap, with a
+ *  square 90 degree view.
+ ***********************************************************/
+void ReflectionProbes::RenderFace(PROBE& probe, int face, FACE_CALLBACK& renderFace)
+{
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, probe.captureCubemap, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "[ReflectionProbes] ERROR: Capture framebuffer incomplete" << std::endl;
+		return;
+	}
+
+	glViewport(0, 0, m_settings.resolution, m_settings.resolution);
+	glClearColor(m_settings.clearColor.r, m_settings.clearColor.g, m_settings.clearColor.b, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	VIEW_INFO faceView;
+	faceView.position = probe.position;
+	faceView.view = glm::lookAt(probe.position, probe.position + FACE_DIRECTIONS[face], FACE_UPS[face]);
+	faceView.projection = glm::perspective(glm::radians(90.0f), 1.0f, m_settings.nearPlane, m_settings.farPlane);
+	faceView.fovY = glm::radians(90.0f);
+	faceView.viewportWidth = (float)m_settings.resolution;
+	faceView.viewportHeight = (float)m_settings.resolution;
+	renderFace(faceView);
+}
+
+/***********************************************************
+ *  MipRoughness()
+ *
+ *  This method is used for the roughness a prefiltered mip
+ *  stands for: mirror at the top, fully rough at the bottom.
+ ***********************************************************/
+float ReflectionProbes::MipRoughness(int mip) const
+{
+	return (m_mipCount > 1) ? (float)mip / (float)(m_mipCount - 1) : 0.0f;
+}
+
+/***********************************************************
+ *  PrefilterMip()
+ *
+ *  This method is used for filling the six faces of one mip
+ *  of the displayed cubemap from the capture, with a full
+ *  screen triangle per face that convolves it with the GGX
+ *  lobe of the mip's roughness.
+ ***********************************************************/
+void ReflectionProbes::PrefilterMip(PROBE& probe, int mip)
+{
+	int size = m_settings.resolution >> mip;
+	GLboolean bDepthTest = glIsEnabled(GL_DEPTH_TEST);
+	GLboolean bBlend = glIsEnabled(GL_BLEND);
+
+	// no depth test, so the depth buffer is left off
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, 0);
+	glViewport(0, 0, size, size);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	m_pPrefilterShader->use();
+	m_pPrefilterShader->setSampler2DValue("captureCubemap", PROBE_TEXTURE_UNIT);
+	m_pPrefilterShader->setFloatValue("roughness", MipRoughness(mip));
+	m_pPrefilterShader->setFloatValue("captureResolution", (float)m_settings.resolution);
+	m_pPrefilterShader->setIntValue("sampleCount", m_settings.prefilterSamples);
+	glActiveTexture(GL_TEXTURE0 + PROBE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, probe.captureCubemap);
+	glBindVertexArray(m_emptyVAO);
+
+	for (int face = 0; face < FACE_COUNT; face++)
+	{
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, probe.prefilteredCubemap, mip);
+		m_pPrefilterShader->setIntValue("face", face);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	glActiveTexture(GL_TEXTURE0);
+	if (bDepthTest)
+	{
+		glEnable(GL_DEPTH_TEST);
+	}
+	if (bBlend)
+	{
+		glEnable(GL_BLEND);
+	}
+}
+
+/***********************************************************
+ *  FindProbe()
+ *
+ *  This method is used for finding the nearest probe whose
+ *  radius covers a point.
+ ***********************************************************/
+int ReflectionProbes::FindProbe(glm::vec3 position) const
+{
+	int found = -1;
+	float nearest = 0.0f;
+	for (int i = 0; i < (int)m_probes.size(); i++)
+	{
+		float distance = glm::length(m_probes[i].position - position);
+		if ((distance <= m_probes[i].radius) && ((found < 0) || (distance < nearest)))
+		{
+			found = i;
+			nearest = distance;
+		}
+	}
+	return found;
+}
+
+bool ReflectionProbes::IsReady(int probe) const
+{
+	return (probe >= 0) && (probe < (int)m_probes.size()) && m_probes[probe].bReady;
+}
+
+/***********************************************************
+ *  DrawReflection()
+ *
+ *  This method is used for drawing an object a second time,
+ *  over itself, with the probe's reflection. The shininess
+ *  picks the mip, and the alpha is the Fresnel weight, so
+ *  the scene's blending lays it over the lit object.
+ ***********************************************************/
+void ReflectionProbes::DrawReflection(
+	int probe,
+	const glm::mat4& model,
+	const VIEW_INFO& viewInfo,
+	glm::vec3 specularColor,
+	float shininess,
+	DRAW_CALLBACK drawObject)
+{
+	if (!IsReady(probe) || (NULL == m_pReflectionShader))
+	{
+		return;
+	}
+
+	// the Blinn-Phong exponent as a GGX roughness, which sets the mip
+	float alpha = std::sqrt(2.0f / (std::max(shininess, 0.0f) + 2.0f));
+	float lod = std::sqrt(alpha) * (float)(m_mipCount - 1);
+
+	GLint previousProgram = 0;
+	GLint previousDepthFunc = GL_LESS;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_DEPTH_FUNC, &previousDepthFunc);
+
+	m_pReflectionShader->use();
+	m_pReflectionShader->setMat4Value("model", model);
+	m_pReflectionShader->setMat4Value("view", viewInfo.view);
+	m_pReflectionShader->setMat4Value("projection", viewInfo.projection);
+	m_pReflectionShader->setVec3Value("cameraPosition", viewInfo.position);
+	m_pReflectionShader->setVec3Value("specularColor", specularColor);
+	m_pReflectionShader->setFloatValue("reflectionLod", lod);
+	m_pReflectionShader->setFloatValue("reflectionStrength", m_settings.reflectionStrength);
+	m_pReflectionShader->setSampler2DValue("reflectionCubemap", PROBE_TEXTURE_UNIT);
+	glActiveTexture(GL_TEXTURE0 + PROBE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, m_probes[probe].prefilteredCubemap);
+
+	// the same surface again: pulled forward a little and not written
+	glDepthFunc(GL_LEQUAL);
+	glDepthMask(GL_FALSE);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(-1.0f, -1.0f);
+
+	drawObject();
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(previousDepthFunc);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glUseProgram(previousProgram);
+}
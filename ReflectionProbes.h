@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////////
+// reflectionprobes.h
+// ============
+// cubemap reflections, re-rendered a face or a mip at a time
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "ViewManager.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/***********************************************************
+ *  REFLECTION_PROBE_SETTINGS
+ *
+ *  How large the probes are and how much of them is
+ *  refreshed each frame.
+ ***********************************************************/
+struct REFLECTION_PROBE_SETTINGS
+{
+	// width of each cube face, in texels
+	int resolution = 128;
+	// steps - a face rendered or a mip prefiltered - per frame
+	int stepsPerFrame = 1;
+	// frames before a probe nothing has changed near is refreshed anyway
+	int idleRefreshFrames = 600;
+	// importance samples for each prefiltered texel
+	int prefilterSamples = 32;
+	float nearPlane = 0.05f;
+	float farPlane = 2000.0f;
+	// what the faces are cleared to, as the main view is
+	glm::vec3 clearColor = glm::vec3(1.0f);
+	// how much of the Fresnel weighted reflection covers the object
+	float reflectionStrength = 0.6f;
+};
+
+/***********************************************************
+ *  ReflectionProbes
+ *
+ *  This class keeps cubemap captures of the scene around
+ *  reflective objects. Refreshing a probe takes 6 + mips
+ *  steps: each face is rendered into the capture cubemap,
+ *  then each mip of the displayed cubemap is prefiltered
+ *  from it, rougher mip by mip, so a reflection can be
+ *  sharp or blurred by choosing the level. Update() does a
+ *  fixed number of steps a frame, finishing the probe it is
+ *  on before starting another: one whose surroundings were
+ *  invalidated first, then the one refreshed longest ago
+ *  once it is due. The displayed cubemap only changes a mip
+ *  at a time, from a complete capture.
+ ***********************************************************/
+class ReflectionProbes
+{
+public:
+	// draws the scene for one cube face, into the bound framebuffer
+	typedef std::function<void(const VIEW_INFO& faceView)> FACE_CALLBACK;
+	// draws the reflective object with the reflection shader bound
+	typedef std::function<void()> DRAW_CALLBACK;
+
+	// constructor
+	ReflectionProbes();
+	// destructor
+	~ReflectionProbes();
+
+	// load the shaders and create the capture framebuffer
+	bool Initialize(const REFLECTION_PROBE_SETTINGS& settings);
+	// add a probe capturing the scene from a point, for objects within
+	// the radius; the index, or -1
+	int AddProbe(glm::vec3 position, float radius);
+
+	// refresh the probes whose radius reaches into the sphere, soon
+	void Invalidate(glm::vec3 center, float radius);
+	void InvalidateAll();
+
+	// do this frame's refresh steps
+	void Update(FACE_CALLBACK renderFace);
+
+	// the probe reflected by an object at the point, or -1
+	int FindProbe(glm::vec3 position) const;
+	// true once the probe has been captured and prefiltered
+	bool IsReady(int probe) const;
+	// draw an object's reflection over it, blended by the Fresnel term
+	void DrawReflection(
+		int probe,
+		const glm::mat4& model,
+		const VIEW_INFO& viewInfo,
+		glm::vec3 specularColor,
+		float shininess,
+		DRAW_CALLBACK drawObject);
+
+	int GetProbeCount() const { return (int)m_probes.size(); }
+	// refreshes finished since the start
+	int GetRefreshCount() const { return m_refreshCount; }
+
+private:
+	struct PROBE
+	{
+		glm::vec3 position;
+		float radius;
+		// rendered into a face at a time, mipmapped once complete
+		GLuint captureCubemap;
+		// prefiltered from the capture a mip at a time and sampled
+		GLuint prefilteredCubemap;
+		// the next step of the refresh in progress, or -1
+		int step;
+		bool bDirty;
+		bool bReady;
+		uint64_t lastRefreshFrame;
+	};
+
+	REFLECTION_PROBE_SETTINGS m_settings;
+	std::vector<PROBE> m_probes;
+	ShaderManager* m_pPrefilterShader;
+	ShaderManager* m_pReflectionShader;
+	GLuint m_framebuffer;
+	GLuint m_depthBuffer;
+	// bound for the full screen triangle, which has no vertices
+	GLuint m_emptyVAO;
+	int m_mipCount;
+	// the probe being refreshed, or -1
+	int m_current;
+	uint64_t m_frame;
+	int m_refreshCount;
+
+	GLuint CreateCubemap(bool bMipmapped) const;
+	int ChooseProbe() const;
+	void RenderFace(PROBE& probe, int face, FACE_CALLBACK& renderFace);
+	void PrefilterMip(PROBE& probe, int mip);
+	float MipRoughness(int mip) const;
+};
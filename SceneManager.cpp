@@ -16,22 +16,87 @@
 #endif
 
 #include <glm/gtx/transform.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
 #include <iostream> // for debug printing
 
 // declaration of global variables
 namespace
 {
     const char* g_ModelName = "model";
+    const char* g_ViewName = "view";
+    const char* g_ProjectionName = "projection";
     const char* g_ColorValueName = "objectColor";
     const char* g_TextureValueName = "objectTexture";
     const char* g_UseTextureName = "bUseTexture";
     const char* g_UseLightingName = "bUseLighting";
+
+    const char* g_VegetationDensityFile = "textures/grass_density.png";
+
+    // bump whenever PrepareScene() changes what it builds, so older
+    // snapshots are rebuilt instead of restored
+    const uint32_t SCENE_SNAPSHOT_VERSION = 4;
+
+    // the campground's grid of sites, centred on the main camp, and the
+    // ground plane under it, reaching a site's width past the outer rows
+    const int g_CampgroundColumns = 101;
+    const int g_CampgroundRows = 50;
+    const float g_CampgroundSpacing = 28.0f;
+    const float g_GroundHalfWidth = (g_CampgroundColumns - 1) * g_CampgroundSpacing * 0.5f + 20.0f;
+    const float g_GroundHalfDepth = (g_CampgroundRows - 1) * g_CampgroundSpacing * 0.5f + 20.0f;
+
+    // a scene texture in a snapshot, its levels in the level table;
+    // format is 0 for block compressed levels
+    struct SNAPSHOT_TEXTURE
+    {
+        char tag[32];
+        char filename[96];
+        uint32_t internalFormat;
+        uint32_t format;
+        uint32_t firstLevel;
+        uint32_t levelCount;
+    };
+    // one level of a snapshot texture, in the texture data section
+    struct SNAPSHOT_TEXTURE_LEVEL
+    {
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset;
+        uint64_t size;
+    };
+    struct SNAPSHOT_MATERIAL
+    {
+        char tag[32];
+        glm::vec3 diffuseColor;
+        glm::vec3 specularColor;
+        float shininess;
+    };
+
+    void CopyName(char* destination, size_t size, const std::string& name)
+    {
+        memset(destination, 0, size);
+        strncpy(destination, name.c_str(), size - 1);
+    }
+
+    std::string ReadName(const char* name, size_t size)
+    {
+        return std::string(name, strnlen(name, size));
+    }
+
+    // a load that has already finished with the given result
+    AssetTask<bool> CompletedLoad(bool bResult)
+    {
+        co_return bResult;
+    }
 }
 
 /***********************************************************
  *  SceneManager()
  *
- *  The constructor for the class
+ *  The constructor for the class. Nothing here needs OpenGL,
+ *  so the scene can be created, and BeginPrepareScene()
+ *  called, before the window and context exist.
  ***********************************************************/
 SceneManager::SceneManager(ShaderManager* pShaderManager)
 {
@@ -40,6 +105,31 @@ SceneManager::SceneManager(ShaderManager* pShaderManager)
 
     // Initialize texture count to zero
     m_loadedTextures = 0;
+    m_currentModel = glm::mat4(1.0f);
+    m_bShuttingDown = false;
+    m_snapshotFile = "scene.snapshot";
+    m_lightmapFile = "scene.lightmap";
+    m_pSnapshot = new SceneSnapshot();
+    m_bSnapshotPending = false;
+    m_bPrepareStarted = false;
+    m_pStartupProfiler = NULL;
+    // created by PrepareScene(), once there is a context
+    m_placeholderTexture = 0;
+
+    m_pImpostors = new ImpostorSystem();
+    for (int shape = 0; shape < PREFAB_SHAPE_COUNT; shape++)
+    {
+        m_pShapeLODs[shape] = new LODMesh();
+    }
+    m_pGPUCuller = new GPUCuller();
+    m_pRayQuery = new RayQuery();
+    m_pLightmaps = new LightmapSystem();
+    m_pProbes = new ReflectionProbes();
+    m_pAnimation = new AnimationSystem();
+    m_sceneTime = -1.0;
+    m_pVegetation = new VegetationSystem();
+    m_pPrefabs = new PrefabSystem();
+    m_pAssetLoader = new AssetLoader(ThreadPool::DefaultThreadCount());
 }
 
 /***********************************************************
@@ -49,13 +139,67 @@ SceneManager::SceneManager(ShaderManager* pShaderManager)
  ***********************************************************/
 SceneManager::~SceneManager()
 {
-    // Free any GPU texture objects before shutting down
-    DestroyGLTextures();
+    // Let the preparation on the workers finish registering its
+    // textures, then release the loads that were never requested, so
+    // they finish without loading, and finish any loads still in
+    // flight before freeing what they fill in
+    if (m_bPrepareStarted)
+    {
+        m_pAssetLoader->Wait(m_sceneData);
+        m_pAssetLoader->Wait(m_vegetationData);
+    }
+    m_bShuttingDown = true;
+    for (int i = 0; i < m_loadedTextures; i++)
+    {
+        m_lazyTextures[i].request.Set();
+    }
+    delete m_pAssetLoader;
+    m_pAssetLoader = NULL;
+
+    // Free any GPU texture objects before shutting down; there are
+    // none if the scene was never prepared on a context
+    if (0 != m_placeholderTexture)
+    {
+        DestroyGLTextures();
+    }
 
     m_pShaderManager = NULL;
 
+    delete m_pImpostors;
+    m_pImpostors = NULL;
+
+    for (int shape = 0; shape < PREFAB_SHAPE_COUNT; shape++)
+    {
+        delete m_pShapeLODs[shape];
+        m_pShapeLODs[shape] = NULL;
+    }
+
+    delete m_pGPUCuller;
+    m_pGPUCuller = NULL;
+
+    delete m_pRayQuery;
+    m_pRayQuery = NULL;
+
+    delete m_pLightmaps;
+    m_pLightmaps = NULL;
+
+    delete m_pProbes;
+    m_pProbes = NULL;
+
+    delete m_pAnimation;
+    m_pAnimation = NULL;
+
+    delete m_pVegetation;
+    m_pVegetation = NULL;
+
+    delete m_pPrefabs;
+    m_pPrefabs = NULL;
+
     delete m_basicMeshes;
     m_basicMeshes = NULL;
+
+    delete m_pSnapshot;
+    m_pSnapshot = NULL;
 }
 
 /***********************************************************
@@ -68,21 +212,16 @@ SceneManager::~SceneManager()
  ***********************************************************/
 bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 {
-    int width = 0;
-    int height = 0;
-    int colorChannels = 0;
     GLuint textureID = 0;
 
-    // indicate to always flip images vertically when loaded
-    stbi_set_flip_vertically_on_load(true);
-
-    // try to parse the image data from the specified image file
-    unsigned char* image = stbi_load(
-        filename,
-        &width,
-        &height,
-        &colorChannels,
-        0);
+    // try to parse the image data from the specified image file, with
+    // the loader's decoders - flipped vertically, as OpenGL expects
+    IMAGE_DATA decoded;
+    m_pAssetLoader->DecodeImageBytes(AssetIO::ReadWholeFile(filename), 1, decoded);
+    unsigned char* image = decoded.pixels.get();
+    int width = decoded.width;
+    int height = decoded.height;
+    int colorChannels = decoded.channels;
 
     // if the image was successfully read from the image file
     if (image)
@@ -140,16 +279,16 @@ bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
                 << colorChannels
                 << " channels"
                 << std::endl;
-            stbi_image_free(image);
             glBindTexture(GL_TEXTURE_2D, 0);
             return false;
         }
 
-        // generate the texture mipmaps for efficient minification
-        glGenerateMipmap(GL_TEXTURE_2D);
+        // build the texture mipmaps on the CPU for efficient minification
+        AssetLoader::UploadMipLevels(
+            MipGenerator::Generate(image, width, height, colorChannels, NULL),
+            (colorChannels == 4) ? GL_RGBA8 : GL_RGB8,
+            (colorChannels == 4) ? GL_RGBA : GL_RGB);
 
-        // free the image data from CPU memory
-        stbi_image_free(image);
         glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
 
         // register the loaded texture and associate it with the given tag
@@ -173,252 +312,999 @@ bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 }
 
 /***********************************************************
- *  BindGLTextures()
+ *  LoadSceneTexture()
  *
- *  This method is used for binding the loaded textures to
- *  OpenGL texture memory slots. There can be up to 16 slots.
+ *  This method is used for loading a texture in the background.
+ *  The slot is reserved straight away, so slots keep the order
+ *  the textures are registered in, and holds the placeholder
+ *  until the first visible draw using it calls RequestTexture().
+ *  Only then is the file read, once. A 1/8 size preview,
+ *  which the JPEG decoder produces from the DC coefficients
+ *  alone, and the full texture are decoded from those bytes
+ *  side by side; the preview is swapped in when it is ready,
+ *  then replaced once the full texture has completed its
+ *  upload.
  ***********************************************************/
-void SceneManager::BindGLTextures()
+AssetTask<bool> SceneManager::LoadSceneTexture(std::string filename, std::string tag)
 {
-    for (int i = 0; i < m_loadedTextures; i++)
+    if (m_loadedTextures >= MAX_TEXTURES)
     {
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+        std::cout << "[TextureLoader] WARNING: Exceeded MAX_TEXTURES; texture not stored."
+            << std::endl;
+        co_return false;
+    }
+
+    int slot = m_loadedTextures++;
+    m_textureIDs[slot].ID = m_placeholderTexture;
+    m_textureIDs[slot].tag = tag;
+    m_lazyTextures[slot].filename = filename;
+
+    co_await m_lazyTextures[slot].request;
+    if (m_bShuttingDown)
+    {
+        co_return false;
+    }
+
+    std::vector<unsigned char> bytes = co_await m_pAssetLoader->ReadFile(filename);
+    if (bytes.empty())
+    {
+        co_await m_pAssetLoader->ResumeOnGLThread();
+        std::cerr << "[PrepareScene] ERROR: Could not read " << filename << "\n";
+        co_return false;
+    }
+
+    // neither decode waits on the other; both finish on the GL thread
+    std::shared_ptr<const std::vector<unsigned char>> shared =
+        std::make_shared<const std::vector<unsigned char>>(std::move(bytes));
+    AssetTask<GLuint> preview = m_pAssetLoader->LoadTextureBytes(shared, filename, 8);
+    AssetTask<GLuint> full = m_pAssetLoader->LoadTextureBytes(shared, filename);
+
+    GLuint previewID = co_await preview;
+    if (previewID != 0)
+    {
+        m_textureIDs[slot].ID = previewID;
+    }
+
+    GLuint textureID = co_await full;
+    if (textureID == 0)
+    {
+        // the preview, if there is one, is better than nothing
+        std::cerr << "[PrepareScene] ERROR: Failed to load " << filename << "\n";
+        co_return false;
+    }
+
+    m_textureIDs[slot].ID = textureID;
+    if (previewID != 0)
+    {
+        glDeleteTextures(1, &previewID);
     }
+    if (NULL != m_pStartupProfiler)
+    {
+        m_pStartupProfiler->Mark("texture_" + tag);
+    }
+    co_return true;
 }
 
 /***********************************************************
- *  DestroyGLTextures()
+ *  BakeImpostors()
  *
- *  This method is used for freeing the memory in all the
- *  used texture memory slots.
+ *  This method is used for baking the impostor of the far
+ *  campground sites. It waits on the textures of the parts,
+ *  then continues on the GL thread; without all of them the
+ *  sites are simply drawn in full at every distance.
  ***********************************************************/
-void SceneManager::DestroyGLTextures()
+AssetTask<bool> SceneManager::BakeImpostors(std::vector<AssetTask<bool>> textureLoads)
 {
-    for (int i = 0; i < m_loadedTextures; i++)
+    bool bLoaded = true;
+    for (AssetTask<bool>& load : textureLoads)
     {
-        glDeleteTextures(1, &m_textureIDs[i].ID);
+        bool bResult = co_await load;
+        bLoaded = bLoaded && bResult;
     }
-    m_loadedTextures = 0;
+    co_await m_pAssetLoader->ResumeOnGLThread();
+
+    if (bLoaded)
+    {
+        BakeCampsiteImpostor();
+    }
+    co_return bLoaded;
 }
 
 /***********************************************************
- *  FindTextureID()
+ *  BakeCampsiteImpostor()
  *
- *  This method is used for getting an ID for the previously
- *  loaded texture bitmap associated with the passed-in tag.
+ *  This method is used for baking the campsite prefab - the
+ *  static objects that name a prefab, as every site places
+ *  them - into one impostor, on the GL thread. The parts are
+ *  drawn at their finest level with their own textures.
  ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
+void SceneManager::BakeCampsiteImpostor()
 {
-    int textureID = -1;
-    int index = 0;
-    bool bFound = false;
-
-    while ((index < m_loadedTextures) && (bFound == false))
+    // a sphere around the parts' spheres, centred on their box
+    std::vector<glm::vec4> spheres;
+    glm::vec3 minimum(FLT_MAX);
+    glm::vec3 maximum(-FLT_MAX);
+    for (const STATIC_OBJECT& object : m_staticObjects)
     {
-        if (m_textureIDs[index].tag.compare(tag) == 0)
-        {
-            textureID = m_textureIDs[index].ID;
-            bFound = true;
-        }
-        else
+        const LODMesh* pMesh = m_pShapeLODs[object.shape];
+        if (object.prefab.empty() || (pMesh->GetLevelCount() == 0))
         {
-            index++;
+            continue;
         }
+        glm::mat4 model = PrefabSystem::MakeTransform(object.scale, object.XrotationDegrees,
+            object.YrotationDegrees, object.ZrotationDegrees, object.position);
+        float scale = std::max(
+            glm::length(glm::vec3(model[0])),
+            std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        glm::vec3 center = glm::vec3(model * glm::vec4(pMesh->GetBoundsCenter(), 1.0f));
+        float radius = pMesh->GetBoundsRadius() * scale;
+        spheres.push_back(glm::vec4(center, radius));
+        minimum = glm::min(minimum, center - glm::vec3(radius));
+        maximum = glm::max(maximum, center + glm::vec3(radius));
+    }
+    if (spheres.empty())
+    {
+        return;
     }
 
-    return textureID;
+    glm::vec3 boundsCenter = (minimum + maximum) * 0.5f;
+    float boundsRadius = 0.0f;
+    for (const glm::vec4& sphere : spheres)
+    {
+        boundsRadius = std::max(boundsRadius, glm::length(glm::vec3(sphere) - boundsCenter) + sphere.w);
+    }
+
+    m_pImpostors->BakeImpostor(
+        "campsite",
+        [this](ShaderManager* pBakeShader)
+        {
+            pBakeShader->setIntValue("bUseTexture", 1);
+            for (const STATIC_OBJECT& object : m_staticObjects)
+            {
+                const LODMesh* pMesh = m_pShapeLODs[object.shape];
+                if (object.prefab.empty() || (pMesh->GetLevelCount() == 0))
+                {
+                    continue;
+                }
+                pBakeShader->setMat4Value("model", PrefabSystem::MakeTransform(object.scale,
+                    object.XrotationDegrees, object.YrotationDegrees, object.ZrotationDegrees, object.position));
+                glBindTexture(GL_TEXTURE_2D, (GLuint)std::max(FindTextureID(object.texture), 0));
+                pMesh->DrawLevel(0);
+            }
+        },
+        boundsCenter, boundsRadius, 0);
 }
 
 /***********************************************************
- *  FindTextureSlot()
+ *  RequestTexture()
  *
- *  This method is used for getting a slot index for the previously
- *  loaded texture bitmap associated with the passed-in tag.
+ *  This method is used for starting the load of the texture
+ *  in a slot the first time it is needed.
  ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
+void SceneManager::RequestTexture(int slot)
 {
-    int textureSlot = -1;
-    int index = 0;
-    bool bFound = false;
+    if ((slot >= 0) && (slot < m_loadedTextures) && (!m_lazyTextures[slot].request.IsSet()))
+    {
+        std::cout << "[TextureLoader] Requested " << m_lazyTextures[slot].filename << std::endl;
+        m_lazyTextures[slot].request.Set();
+    }
+}
 
-    while ((index < m_loadedTextures) && (bFound == false))
+/***********************************************************
+ *  RestoreSnapshot()
+ *
+ *  This method is used for mapping the snapshot file and, if
+ *  it is current, taking the materials, lights and GPU culler
+ *  contents from it. It runs on a loader worker, so it only
+ *  checks the textures and reads the whole file in; the
+ *  snapshot stays open for PrepareScene() to create the
+ *  textures and culler programs from. Nothing is kept from a
+ *  snapshot that is incomplete.
+ ***********************************************************/
+bool SceneManager::RestoreSnapshot()
+{
+    if (m_snapshotFile.empty() || !m_pSnapshot->Open(m_snapshotFile, SCENE_SNAPSHOT_VERSION))
     {
-        if (m_textureIDs[index].tag.compare(tag) == 0)
-        {
-            textureSlot = index;  // slot = index into m_textureIDs
-            bFound = true;
-        }
-        else
-        {
-            index++;
-        }
+        return false;
     }
 
-    return textureSlot;
+    size_t materialCount = 0;
+    size_t lightCount = 0;
+    const SNAPSHOT_MATERIAL* materials = m_pSnapshot->GetArray<SNAPSHOT_MATERIAL>(SNAPSHOT_MATERIALS, materialCount);
+    const POINT_LIGHT* lights = m_pSnapshot->GetArray<POINT_LIGHT>(SNAPSHOT_LIGHTS, lightCount);
+    if ((NULL == materials) || (NULL == lights) || !CheckSnapshotTextures(*m_pSnapshot) ||
+        !m_pGPUCuller->RestoreSnapshot(*m_pSnapshot))
+    {
+        std::cout << "[SceneManager] " << m_snapshotFile << " is incomplete; rebuilding the scene" << std::endl;
+        m_pSnapshot->Close();
+        return false;
+    }
+
+    // fault the texture levels and program binaries in here, rather
+    // than on the GL thread as they are uploaded
+    m_pSnapshot->Prefetch();
+
+    for (size_t i = 0; i < materialCount; i++)
+    {
+        OBJECT_MATERIAL material;
+        material.tag = ReadName(materials[i].tag, sizeof(materials[i].tag));
+        material.diffuseColor = materials[i].diffuseColor;
+        material.specularColor = materials[i].specularColor;
+        material.shininess = materials[i].shininess;
+        m_objectMaterials.push_back(material);
+    }
+    m_pointLights.assign(lights, lights + lightCount);
+    return true;
 }
 
 /***********************************************************
- *  FindMaterial()
+ *  CheckSnapshotTextures()
  *
- *  This method is used for getting a material from the previously
- *  defined materials list that is associated with the passed in tag.
+ *  This method is used for checking the texture tables of the
+ *  snapshot - that every level lies inside the data and is
+ *  large enough - before any texture is created from them.
  ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+bool SceneManager::CheckSnapshotTextures(const SceneSnapshot& snapshot) const
 {
-    if (m_objectMaterials.size() == 0)
+    size_t textureCount = 0;
+    size_t levelCount = 0;
+    size_t dataSize = 0;
+    const SNAPSHOT_TEXTURE* textures = snapshot.GetArray<SNAPSHOT_TEXTURE>(SNAPSHOT_TEXTURES, textureCount);
+    const SNAPSHOT_TEXTURE_LEVEL* levels = snapshot.GetArray<SNAPSHOT_TEXTURE_LEVEL>(SNAPSHOT_TEXTURE_LEVELS, levelCount);
+    const unsigned char* data = snapshot.GetSection(SNAPSHOT_TEXTURE_DATA, dataSize);
+    if ((NULL == textures) || (NULL == levels) || (NULL == data) ||
+        (textureCount > (size_t)(MAX_TEXTURES - m_loadedTextures)))
     {
         return false;
     }
 
-    int index = 0;
-    bool bFound = false;
-    while ((index < m_objectMaterials.size()) && (bFound == false))
+    for (size_t i = 0; i < textureCount; i++)
     {
-        if (m_objectMaterials[index].tag.compare(tag) == 0)
+        const SNAPSHOT_TEXTURE& texture = textures[i];
+        if ((texture.levelCount == 0) || ((uint64_t)texture.firstLevel + texture.levelCount > levelCount))
         {
-            bFound = true;
-            material.diffuseColor = m_objectMaterials[index].diffuseColor;
-            material.specularColor = m_objectMaterials[index].specularColor;
-            material.shininess = m_objectMaterials[index].shininess;
+            return false;
         }
-        else
+        for (uint32_t level = texture.firstLevel; level < texture.firstLevel + texture.levelCount; level++)
         {
-            index++;
+            uint64_t pixelBytes = (uint64_t)levels[level].width * levels[level].height * ((texture.format == GL_RGBA) ? 4 : 3);
+            if ((levels[level].size > dataSize) || (levels[level].offset > dataSize - levels[level].size) ||
+                ((texture.format != 0) && (levels[level].size < pixelBytes)))
+            {
+                return false;
+            }
         }
     }
-
     return true;
 }
 
 /***********************************************************
- *  SetTransformations()
+ *  CreateSnapshotTextures()
  *
- *  This method is used for setting the transform buffer
- *  using the passed in transformation values.
+ *  This method is used for creating the scene textures
+ *  straight from the mapped snapshot - every level, already
+ *  block compressed where the loader compressed it, so there
+ *  is no decoding or mip building at all. The tables were
+ *  checked by CheckSnapshotTextures() when it was opened.
  ***********************************************************/
-void SceneManager::SetTransformations(
-    glm::vec3 scaleXYZ,
-    float      XrotationDegrees,
-    float      YrotationDegrees,
-    float      ZrotationDegrees,
-    glm::vec3 positionXYZ)
+void SceneManager::CreateSnapshotTextures(const SceneSnapshot& snapshot)
 {
-    //variables for this method
-    glm::mat4 scale = glm::scale(scaleXYZ);
-    glm::mat4 rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
-    glm::mat4 rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
-    glm::mat4 rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
-    glm::mat4 translation = glm::translate(positionXYZ);
-
-    glm::mat4 modelView = translation * rotationZ * rotationY * rotationX * scale;
-
-    if (NULL != m_pShaderManager)
+    size_t textureCount = 0;
+    size_t levelCount = 0;
+    size_t dataSize = 0;
+    const SNAPSHOT_TEXTURE* textures = snapshot.GetArray<SNAPSHOT_TEXTURE>(SNAPSHOT_TEXTURES, textureCount);
+    const SNAPSHOT_TEXTURE_LEVEL* levels = snapshot.GetArray<SNAPSHOT_TEXTURE_LEVEL>(SNAPSHOT_TEXTURE_LEVELS, levelCount);
+    const unsigned char* data = snapshot.GetSection(SNAPSHOT_TEXTURE_DATA, dataSize);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t i = 0; i < textureCount; i++)
     {
-        m_pShaderManager->setMat4Value(g_ModelName, modelView);
+        const SNAPSHOT_TEXTURE& texture = textures[i];
+        GLuint textureID = 0;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        for (uint32_t level = 0; level < texture.levelCount; level++)
+        {
+            const SNAPSHOT_TEXTURE_LEVEL& entry = levels[texture.firstLevel + level];
+            if (texture.format == 0)
+            {
+                glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, texture.internalFormat, entry.width, entry.height, 0,
+                    (GLsizei)entry.size, data + entry.offset);
+            }
+            else
+            {
+                glTexImage2D(GL_TEXTURE_2D, (GLint)level, texture.internalFormat, entry.width, entry.height, 0,
+                    texture.format, GL_UNSIGNED_BYTE, data + entry.offset);
+            }
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levelCount - 1);
+
+        // the slot is loaded already, so it never waits for a request
+        int slot = m_loadedTextures++;
+        m_textureIDs[slot].ID = textureID;
+        m_textureIDs[slot].tag = ReadName(texture.tag, sizeof(texture.tag));
+        m_lazyTextures[slot].filename = ReadName(texture.filename, sizeof(texture.filename));
+        m_lazyTextures[slot].request.Set();
     }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 /***********************************************************
- *  SetShaderColor()
+ *  WriteSnapshot()
  *
- *  This method is used for setting the passed-in color
- *  into the shader for the next draw command (disables texture).
+ *  This method is used for saving the prepared scene once
+ *  every texture load has finished. It is called each frame
+ *  until then. A scene with a missing texture is not saved,
+ *  so the next launch tries to load it again.
  ***********************************************************/
-void SceneManager::SetShaderColor(
-    float redColorValue,
-    float greenColorValue,
-    float blueColorValue,
-    float alphaValue)
+void SceneManager::WriteSnapshot()
 {
-    glm::vec4 currentColor;
-    currentColor.r = redColorValue;
-    currentColor.g = greenColorValue;
-    currentColor.b = blueColorValue;
-    currentColor.a = alphaValue;
+    for (const AssetTask<bool>& load : m_textureLoads)
+    {
+        if (!load.IsReady())
+        {
+            return;
+        }
+    }
+    m_bSnapshotPending = false;
 
-    if (NULL != m_pShaderManager)
+    bool bComplete = true;
+    for (const AssetTask<bool>& load : m_textureLoads)
     {
-        // Turn off texturing in the shader
-        m_pShaderManager->setIntValue(g_UseTextureName, 0);
-        m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
+        bComplete = bComplete && load.Get();
+    }
+    m_textureLoads.clear();
+    if (!bComplete)
+    {
+        std::cout << "[SceneManager] Not writing " << m_snapshotFile << " - a texture failed to load" << std::endl;
+        return;
+    }
+
+    SceneSnapshot snapshot;
+    CaptureTextures(snapshot);
+
+    std::vector<SNAPSHOT_MATERIAL> materials;
+    for (const OBJECT_MATERIAL& material : m_objectMaterials)
+    {
+        SNAPSHOT_MATERIAL entry;
+        CopyName(entry.tag, sizeof(entry.tag), material.tag);
+        entry.diffuseColor = material.diffuseColor;
+        entry.specularColor = material.specularColor;
+        entry.shininess = material.shininess;
+        materials.push_back(entry);
+    }
+    snapshot.AddArray(SNAPSHOT_MATERIALS, materials);
+    snapshot.AddArray(SNAPSHOT_LIGHTS, m_pointLights);
+    m_pGPUCuller->SaveSnapshot(snapshot);
+    if (snapshot.Write(m_snapshotFile, SCENE_SNAPSHOT_VERSION) && (NULL != m_pStartupProfiler))
+    {
+        m_pStartupProfiler->Mark("snapshot_written");
     }
 }
 
 /***********************************************************
- *  SetShaderTexture()
+ *  IsLoading()
  *
- *  This method is used for setting the texture data
- *  associated with the passed-in tag into the shader.
+ *  This method is used for checking whether the scene is
+ *  still loading. Textures nothing has needed yet do not
+ *  count; with lazy loading they may never be requested.
  ***********************************************************/
-void SceneManager::SetShaderTexture(
-    std::string textureTag)
+bool SceneManager::IsLoading() const
 {
-    if (NULL != m_pShaderManager)
+    if (m_bSnapshotPending)
     {
-        // Turn on texturing in the shader
-        m_pShaderManager->setIntValue(g_UseTextureName, 1);
-
-        int slot = FindTextureSlot(textureTag);
-        if (slot >= 0)
-        {
-            // Tell the shader which texture unit to sample from
-            m_pShaderManager->setSampler2DValue(g_TextureValueName, slot);
-        }
-        else
+        return true;
+    }
+    for (size_t i = 0; i < m_textureLoads.size(); i++)
+    {
+        if (m_lazyTextures[i].request.IsSet() && !m_textureLoads[i].IsReady())
         {
-            std::cerr << "[SceneManager] ERROR: Texture tag '"
-                << textureTag
-                << "' not found."
-                << std::endl;
+            return true;
         }
     }
+    return false;
 }
 
 /***********************************************************
- *  SetTextureUVScale()
+ *  PickObject()
  *
- *  This method is used for setting the texture UV scale
- *  values into the shader (for tiling).
+ *  This method is used for finding the campground object
+ *  under a point in the window. The ray query is built with
+ *  the scene data, so nothing is picked until that is ready.
  ***********************************************************/
-void SceneManager::SetTextureUVScale(float u, float v)
+bool SceneManager::PickObject(const VIEW_INFO& viewInfo, float x, float y, RAY_HIT& hit) const
 {
-    if (NULL != m_pShaderManager)
+    if (!m_bPrepareStarted || !m_sceneData.IsReady())
     {
-        m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
+        return false;
     }
+    return m_pRayQuery->ClosestHit(RayQuery::MakePickRay(viewInfo, x, y), hit);
 }
 
 /***********************************************************
- *  SetShaderMaterial()
+ *  IsVisible()
  *
- *  This method is used for passing the material values
- *  into the shader.
+ *  This method is used for checking line of sight between
+ *  two points across the campground.
  ***********************************************************/
-void SceneManager::SetShaderMaterial(std::string materialTag)
+bool SceneManager::IsVisible(glm::vec3 from, glm::vec3 to) const
 {
-    if (m_objectMaterials.size() > 0)
+    if (!m_bPrepareStarted || !m_sceneData.IsReady())
     {
-        OBJECT_MATERIAL material;
-        bool bReturn = false;
-
-        bReturn = FindMaterial(materialTag, material);
-        if (bReturn == true)
-        {
-            m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-            m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-            m_pShaderManager->setFloatValue("material.shininess", material.shininess);
-        }
+        return true;
     }
+    return m_pRayQuery->IsVisible(from, to);
 }
 
-/***********************************************************/
-/*** STUDENTS CAN MODIFY the code in the methods BELOW for***/
+/***********************************************************
+ *  InvalidateReflections()
+ *
+ *  This method is used for telling the reflection probes
+ *  that something moved or changed its look, so the probes
+ *  that can see it are captured again ahead of the rest.
+ ***********************************************************/
+void SceneManager::InvalidateReflections(glm::vec3 center, float radius)
+{
+    m_pProbes->Invalidate(center, radius);
+}
+
+/***********************************************************
+ *  BeginPhase()
+ *
+ *  This method is used for starting a timed phase of
+ *  PrepareScene(), when startup is being profiled.
+ ***********************************************************/
+void SceneManager::BeginPhase(const char* name)
+{
+    if (NULL != m_pStartupProfiler)
+    {
+        m_pStartupProfiler->BeginPhase(name);
+    }
+}
+
+/***********************************************************
+ *  EndPhase()
+ *
+ *  This method is used for ending the current timed phase.
+ ***********************************************************/
+void SceneManager::EndPhase()
+{
+    if (NULL != m_pStartupProfiler)
+    {
+        m_pStartupProfiler->EndPhase();
+    }
+}
+
+/***********************************************************
+ *  CaptureTextures()
+ *
+ *  This method is used for reading every level of the scene
+ *  textures back from OpenGL into the snapshot, exactly as
+ *  they were uploaded - compressed levels stay compressed.
+ *  The image files are recorded as the snapshot's sources.
+ ***********************************************************/
+void SceneManager::CaptureTextures(SceneSnapshot& snapshot)
+{
+    std::vector<SNAPSHOT_TEXTURE> textures;
+    std::vector<SNAPSHOT_TEXTURE_LEVEL> levels;
+    std::vector<unsigned char> data;
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    for (int slot = 0; slot < m_loadedTextures; slot++)
+    {
+        SNAPSHOT_TEXTURE texture;
+        CopyName(texture.tag, sizeof(texture.tag), m_textureIDs[slot].tag);
+        CopyName(texture.filename, sizeof(texture.filename), m_lazyTextures[slot].filename);
+        snapshot.AddSource(m_lazyTextures[slot].filename);
+
+        GLint internalFormat = 0;
+        GLint compressed = GL_FALSE;
+        glBindTexture(GL_TEXTURE_2D, m_textureIDs[slot].ID);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+        texture.internalFormat = (uint32_t)internalFormat;
+        texture.format = (compressed == GL_TRUE) ? 0 : ((internalFormat == GL_RGBA8) ? GL_RGBA : GL_RGB);
+        texture.firstLevel = (uint32_t)levels.size();
+
+        // levels run until one has no size
+        for (GLint level = 0; level < 32; level++)
+        {
+            GLint width = 0;
+            GLint height = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+            if ((width == 0) || (height == 0))
+            {
+                break;
+            }
+
+            SNAPSHOT_TEXTURE_LEVEL entry;
+            entry.width = (uint32_t)width;
+            entry.height = (uint32_t)height;
+            entry.offset = data.size();
+            if (texture.format == 0)
+            {
+                GLint size = 0;
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+                entry.size = (uint64_t)size;
+                data.resize(data.size() + entry.size);
+                glGetCompressedTexImage(GL_TEXTURE_2D, level, data.data() + entry.offset);
+            }
+            else
+            {
+                entry.size = (uint64_t)width * height * ((texture.format == GL_RGBA) ? 4 : 3);
+                data.resize(data.size() + entry.size);
+                glGetTexImage(GL_TEXTURE_2D, level, texture.format, GL_UNSIGNED_BYTE, data.data() + entry.offset);
+            }
+            levels.push_back(entry);
+        }
+        texture.levelCount = (uint32_t)levels.size() - texture.firstLevel;
+        textures.push_back(texture);
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    snapshot.AddArray(SNAPSHOT_TEXTURES, textures);
+    snapshot.AddArray(SNAPSHOT_TEXTURE_LEVELS, levels);
+    snapshot.AddArray(SNAPSHOT_TEXTURE_DATA, data);
+}
+
+/***********************************************************
+ *  IsInView()
+ *
+ *  This method is used for testing whether a basic mesh drawn
+ *  with the given model matrix can be on screen. The basic
+ *  meshes all fit in a sphere of radius 1.5 around their origin.
+ ***********************************************************/
+bool SceneManager::IsInView(const glm::mat4& model) const
+{
+    float scale = std::max(
+        glm::length(glm::vec3(model[0])),
+        std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    return IsSphereInView(glm::vec3(model[3]), 1.5f * scale);
+}
+
+/***********************************************************
+ *  IsSphereInView()
+ *
+ *  This method is used for testing whether a world space
+ *  bounding sphere can be on screen from the current camera.
+ ***********************************************************/
+bool SceneManager::IsSphereInView(glm::vec3 center, float radius) const
+{
+    // frustum planes from the rows of the view-projection matrix
+    glm::mat4 viewProjection = m_viewInfo.projection * m_viewInfo.view;
+    glm::vec4 w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+    for (int i = 0; i < 3; i++)
+    {
+        glm::vec4 row(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        glm::vec4 planes[2] = { w + row, w - row };
+        for (const glm::vec4& plane : planes)
+        {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius * glm::length(glm::vec3(plane)))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/***********************************************************
+ *  BindGLTextures()
+ *
+ *  This method is used for binding the loaded textures to
+ *  OpenGL texture memory slots. There can be up to 16 slots.
+ ***********************************************************/
+void SceneManager::BindGLTextures()
+{
+    for (int i = 0; i < m_loadedTextures; i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+    }
+}
+
+/***********************************************************
+ *  DestroyGLTextures()
+ *
+ *  This method is used for freeing the memory in all the
+ *  used texture memory slots.
+ ***********************************************************/
+void SceneManager::DestroyGLTextures()
+{
+    for (int i = 0; i < m_loadedTextures; i++)
+    {
+        // slots that never loaded still hold the shared placeholder
+        if (m_textureIDs[i].ID != m_placeholderTexture)
+        {
+            glDeleteTextures(1, &m_textureIDs[i].ID);
+        }
+    }
+    m_loadedTextures = 0;
+
+    glDeleteTextures(1, &m_placeholderTexture);
+    m_placeholderTexture = 0;
+}
+
+/***********************************************************
+ *  FindTextureID()
+ *
+ *  This method is used for getting an ID for the previously
+ *  loaded texture bitmap associated with the passed-in tag.
+ ***********************************************************/
+int SceneManager::FindTextureID(std::string tag)
+{
+    int textureID = -1;
+    int index = 0;
+    bool bFound = false;
+
+    while ((index < m_loadedTextures) && (bFound == false))
+    {
+        if (m_textureIDs[index].tag.compare(tag) == 0)
+        {
+            textureID = m_textureIDs[index].ID;
+            bFound = true;
+        }
+        else
+        {
+            index++;
+        }
+    }
+
+    return textureID;
+}
+
+/***********************************************************
+ *  FindTextureSlot()
+ *
+ *  This method is used for getting a slot index for the previously
+ *  loaded texture bitmap associated with the passed-in tag.
+ ***********************************************************/
+int SceneManager::FindTextureSlot(std::string tag)
+{
+    int textureSlot = -1;
+    int index = 0;
+    bool bFound = false;
+
+    while ((index < m_loadedTextures) && (bFound == false))
+    {
+        if (m_textureIDs[index].tag.compare(tag) == 0)
+        {
+            textureSlot = index;  // slot = index into m_textureIDs
+            bFound = true;
+        }
+        else
+        {
+            index++;
+        }
+    }
+
+    return textureSlot;
+}
+
+/***********************************************************
+ *  FindMaterial()
+ *
+ *  This method is used for getting a material from the previously
+ *  defined materials list that is associated with the passed in tag.
+ ***********************************************************/
+bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+{
+    if (m_objectMaterials.size() == 0)
+    {
+        return false;
+    }
+
+    int index = 0;
+    bool bFound = false;
+    while ((index < m_objectMaterials.size()) && (bFound == false))
+    {
+        if (m_objectMaterials[index].tag.compare(tag) == 0)
+        {
+            bFound = true;
+            material.diffuseColor = m_objectMaterials[index].diffuseColor;
+            material.specularColor = m_objectMaterials[index].specularColor;
+            material.shininess = m_objectMaterials[index].shininess;
+        }
+        else
+        {
+            index++;
+        }
+    }
+
+    return true;
+}
+
+/***********************************************************
+ *  SetTransformations()
+ *
+ *  This method is used for setting the transform buffer
+ *  using the passed in transformation values.
+ ***********************************************************/
+void SceneManager::SetTransformations(
+    glm::vec3 scaleXYZ,
+    float      XrotationDegrees,
+    float      YrotationDegrees,
+    float      ZrotationDegrees,
+    glm::vec3 positionXYZ)
+{
+    //variables for this method
+    glm::mat4 scale = glm::scale(scaleXYZ);
+    glm::mat4 rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
+    glm::mat4 rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 translation = glm::translate(positionXYZ);
+
+    glm::mat4 modelView = translation * rotationZ * rotationY * rotationX * scale;
+    m_currentModel = modelView;
+
+    if (NULL != m_pShaderManager)
+    {
+        m_pShaderManager->setMat4Value(g_ModelName, modelView);
+    }
+}
+
+/***********************************************************
+ *  SetShaderColor()
+ *
+ *  This method is used for setting the passed-in color
+ *  into the shader for the next draw command (disables texture).
+ ***********************************************************/
+void SceneManager::SetShaderColor(
+    float redColorValue,
+    float greenColorValue,
+    float blueColorValue,
+    float alphaValue)
+{
+    glm::vec4 currentColor;
+    currentColor.r = redColorValue;
+    currentColor.g = greenColorValue;
+    currentColor.b = blueColorValue;
+    currentColor.a = alphaValue;
+
+    if (NULL != m_pShaderManager)
+    {
+        // Turn off texturing in the shader
+        m_pShaderManager->setIntValue(g_UseTextureName, 0);
+        m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
+    }
+}
+
+/***********************************************************
+ *  SetShaderTexture()
+ *
+ *  This method is used for setting the texture data
+ *  associated with the passed-in tag into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderTexture(
+    std::string textureTag)
+{
+    if (NULL != m_pShaderManager)
+    {
+        // Turn on texturing in the shader
+        m_pShaderManager->setIntValue(g_UseTextureName, 1);
+
+        int slot = FindTextureSlot(textureTag);
+        if (slot >= 0)
+        {
+            // the first visible draw with this texture starts its load
+            if ((!m_lazyTextures[slot].request.IsSet()) && IsInView(m_currentModel))
+            {
+                RequestTexture(slot);
+            }
+
+            // Tell the shader which texture unit to sample from
+            m_pShaderManager->setSampler2DValue(g_TextureValueName, slot);
+        }
+        else
+        {
+            std::cerr << "[SceneManager] ERROR: Texture tag '"
+                << textureTag
+                << "' not found."
+                << std::endl;
+        }
+    }
+}
+
+/***********************************************************
+ *  SetTextureUVScale()
+ *
+ *  This method is used for setting the texture UV scale
+ *  values into the shader (for tiling).
+ ***********************************************************/
+void SceneManager::SetTextureUVScale(float u, float v)
+{
+    if (NULL != m_pShaderManager)
+    {
+        m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
+    }
+}
+
+/***********************************************************
+ *  SetShaderMaterial()
+ *
+ *  This method is used for passing the material values
+ *  into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderMaterial(std::string materialTag)
+{
+    if (m_objectMaterials.size() > 0)
+    {
+        OBJECT_MATERIAL material;
+        bool bReturn = false;
+
+        bReturn = FindMaterial(materialTag, material);
+        if (bReturn == true)
+        {
+            m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
+            m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
+            m_pShaderManager->setFloatValue("material.shininess", material.shininess);
+        }
+    }
+}
+
+/***********************************************************
+ *  AddDistantProp()
+ *
+ *  This method is used for queuing a prop for the current
+ *  view. Once the prop is small on screen it is drawn from
+ *  its baked impostor as a single quad; until then the
+ *  caller keeps drawing the full meshes.
+ ***********************************************************/
+bool SceneManager::AddDistantProp(std::string tag, glm::vec3 position, float scale, float yaw)
+{
+    float distance = glm::length(position - m_viewInfo.position);
+    if (!m_pImpostors->ShouldUseImpostor(tag, distance, scale, m_viewInfo))
+    {
+        return false;
+    }
+    return m_pImpostors->AddInstance(tag, position, scale, yaw);
+}
+
+/***********************************************************
+ *  QueueDistantSites()
+ *
+ *  This method is used for handing the far campground sites
+ *  to the campsite impostor. A site qualifies once every one
+ *  of its parts is at its coarsest level from this camera,
+ *  and it is small enough on screen for the impostor; the
+ *  GPU culler then skips its parts for this view.
+ ***********************************************************/
+void SceneManager::QueueDistantSites()
+{
+    const std::vector<GPUCuller::INSTANCE_GROUP>& sites = m_pGPUCuller->GetGroups();
+    m_hiddenSites.assign((sites.size() + 31) / 32, 0);
+
+    float pixelsPerUnit = m_viewInfo.viewportHeight / (2.0f * std::tan(m_viewInfo.fovY * 0.5f));
+    for (size_t i = 0; i < sites.size(); i++)
+    {
+        const GPUCuller::INSTANCE_GROUP& site = sites[i];
+        glm::vec3 center = glm::vec3(site.boundingSphere);
+        float distance = std::max(glm::length(center - m_viewInfo.position) - site.boundingSphere.w, 1e-3f);
+        if (site.coarsestError * pixelsPerUnit / distance > m_pGPUCuller->m_pixelThreshold)
+        {
+            continue;
+        }
+
+        glm::vec3 origin = glm::vec3(site.transform[3]);
+        float scale = glm::length(glm::vec3(site.transform[0]));
+        float yaw = std::atan2(site.transform[2][0], site.transform[0][0]);
+        if (IsSphereInView(center, site.boundingSphere.w) && AddDistantProp("campsite", origin, scale, yaw))
+        {
+            m_hiddenSites[i >> 5] |= 1u << (i & 31);
+        }
+    }
+    m_pGPUCuller->SetHiddenGroups(m_hiddenSites);
+}
+
+/***********************************************************/
+/*** STUDENTS CAN MODIFY the code in the methods BELOW for***/
 /*** preparing and rendering their own 3D replicated scenes***/
 /*** Please refer to the code in the OpenGL sample project ***/
 /*** for assistance.                                      ***/
 /***********************************************************/
 
+/***********************************************************
+ *  BeginPrepareScene()
+ *
+ *  This method is used for starting the part of preparing
+ *  the scene that needs no OpenGL on the loader workers -
+ *  mapping and reading in the snapshot, or else registering
+ *  the textures and building the materials, lights and the
+ *  campground, and reading the vegetation density map. Called
+ *  before the window is created, all of it overlaps creating
+ *  the window and context and compiling the shaders.
+ ***********************************************************/
+void SceneManager::BeginPrepareScene()
+{
+    if (m_bPrepareStarted)
+    {
+        return;
+    }
+    m_bPrepareStarted = true;
+    m_sceneData = PrepareSceneData();
+    m_vegetationData = LoadVegetationDensity();
+}
+
+/***********************************************************
+ *  PrepareSceneData()
+ *
+ *  This method is used for restoring the snapshot, or for
+ *  building what it would hold, on a loader worker. Texture
+ *  slots registered here hold no texture until PrepareScene()
+ *  gives them the placeholder; their images still only load
+ *  once they are first seen. Returns true if the snapshot
+ *  was restored.
+ ***********************************************************/
+AssetTask<bool> SceneManager::PrepareSceneData()
+{
+    co_await m_pAssetLoader->ResumeOnWorker();
+
+    // Campsite prefabs, instanced across the whole campground
+    m_pPrefabs->Initialize(m_pGPUCuller);
+
+    // the shapes' LOD chains, shared by the campground and the camp
+    for (int shape = 0; shape < PREFAB_SHAPE_COUNT; shape++)
+    {
+        m_pPrefabs->GetShapeChain((PREFAB_SHAPE)shape);
+    }
+
+    // the hand placed camp is not in the snapshot; it is only a table
+    DefineStaticObjects();
+
+    // a current snapshot holds the materials, lights, campground and
+    // textures this would otherwise build
+    bool bRestored = RestoreSnapshot();
+    if (!bRestored)
+    {
+        // Register all textures - read and decoded in parallel on the
+        // asset workers once requested, uploaded on the GL thread as
+        // RenderScene() pumps them; missing textures are reported as
+        // they fail
+        m_textureLoads.push_back(LoadSceneTexture("textures/tent.jpg", "tent"));
+        m_textureLoads.push_back(LoadSceneTexture("textures/ground.jpg", "ground"));
+        m_textureLoads.push_back(LoadSceneTexture("textures/campfire.jpg", "campfire"));
+        m_textureLoads.push_back(LoadSceneTexture("textures/sky.jpg", "sky"));
+        m_textureLoads.push_back(LoadSceneTexture("textures/bark.jpg", "bark"));
+        m_textureLoads.push_back(LoadSceneTexture("textures/metal.jpg", "metal"));
+        m_textureLoads.push_back(LoadSceneTexture("textures/rock.jpg", "rock"));
+
+        DefineMaterials();
+        DefineLights();
+        DefinePrefabs();
+    }
+
+    // picking and line of sight test the campground on the CPU
+    m_pGPUCuller->BuildRayQuery(*m_pRayQuery);
+
+    if (NULL != m_pStartupProfiler)
+    {
+        m_pStartupProfiler->Mark("scene_data_ready");
+    }
+    co_return bRestored;
+}
+
+/***********************************************************
+ *  LoadVegetationDensity()
+ *
+ *  This method is used for reading the vegetation density
+ *  map on a loader worker.
+ ***********************************************************/
+AssetTask<bool> SceneManager::LoadVegetationDensity()
+{
+    co_await m_pAssetLoader->ResumeOnWorker();
+
+    VEGETATION_SETTINGS vegetation;
+    m_pVegetation->LoadDensityMap(vegetation, g_VegetationDensityFile);
+    co_return true;
+}
+
 /***********************************************************
  *  PrepareScene()
  *
@@ -430,40 +1316,160 @@ void SceneManager::SetShaderMaterial(std::string materialTag)
   *
   *  This method is used for preparing the 3D scene by loading
   *  the meshes and textures into memory so we can render.
+  *  The work that needs no OpenGL was started on the loader
+  *  workers by BeginPrepareScene(); the GL work runs here,
+  *  joining the workers only once it needs their results.
   ***********************************************************/
 void SceneManager::PrepareScene()
 {
+    BeginPrepareScene();
+    double prepareStart = glfwGetTime();
+
+    // the loader was created before the context: uploads and mipmaps go
+    // to a context shared with the current window, and compression needs
+    // the extensions GLEW has found since
+    BeginPhase("gl_setup");
+    m_pAssetLoader->StartUploadThread(glfwGetCurrentContext());
+    m_pAssetLoader->SetTextureCompression(TextureCompressor::IsSupported(), COMPRESS_FAST);
+
+    // mid grey stands in for every texture until its image has loaded
+    IMAGE_DATA placeholder;
+    placeholder.width = 1;
+    placeholder.height = 1;
+    placeholder.channels = 4;
+    placeholder.pixels = std::shared_ptr<unsigned char>(new unsigned char[4]{ 128, 128, 128, 255 }, std::default_delete<unsigned char[]>());
+    m_placeholderTexture = AssetLoader::CreateTexture(placeholder);
+    EndPhase();
+
     // Load basic meshes (plane, box, cylinder, torus)
+    BeginPhase("load_meshes");
     m_basicMeshes->LoadPlaneMesh();
     m_basicMeshes->LoadBoxMesh();
     m_basicMeshes->LoadCylinderMesh();
     m_basicMeshes->LoadTorusMesh();
     m_basicMeshes->LoadSphereMesh();
+    EndPhase();
+
+    BeginPhase("impostors");
+    m_pImpostors->Initialize();
+    EndPhase();
+
+    // everything after this uses the textures, lights or campground
+    BeginPhase("join_scene_data");
+    bool bRestored = m_pAssetLoader->Wait(m_sceneData);
+    m_pAssetLoader->Wait(m_vegetationData);
+    EndPhase();
+
+    // the camp's own objects pick their level from the chains as they draw
+    BeginPhase("shape_lods");
+    for (int shape = 0; shape < PREFAB_SHAPE_COUNT; shape++)
+    {
+        m_pShapeLODs[shape]->Create(m_pPrefabs->GetShapeChain((PREFAB_SHAPE)shape));
+    }
+    EndPhase();
+
+    // slots registered before there was a context hold no texture yet
+    for (int i = 0; i < m_loadedTextures; i++)
+    {
+        if (m_textureIDs[i].ID == 0)
+        {
+            m_textureIDs[i].ID = m_placeholderTexture;
+        }
+    }
+
+    // Bake the impostor the far campground sites are drawn with, as soon
+    // as the textures of the campsite's parts are in
+    BeginPhase("bake_impostors");
+    if (bRestored)
+    {
+        CreateSnapshotTextures(*m_pSnapshot);
+        BakeCampsiteImpostor();
+    }
+    else
+    {
+        // the impostor needs every part's texture, seen yet or not; a
+        // texture refused a slot has no load to wait for
+        std::vector<int> slots;
+        std::vector<AssetTask<bool>> loads;
+        for (const STATIC_OBJECT& object : m_staticObjects)
+        {
+            int slot = FindTextureSlot(object.texture);
+            if (object.prefab.empty() || (std::find(slots.begin(), slots.end(), slot) != slots.end()))
+            {
+                continue;
+            }
+            slots.push_back(slot);
+            RequestTexture(slot);
+            loads.push_back(((slot >= 0) && (slot < (int)m_textureLoads.size())) ? m_textureLoads[slot] : CompletedLoad(false));
+        }
+        BakeImpostors(loads);
+    }
+    EndPhase();
+
+    // Compute shaders for culling large instance counts on the GPU
+    BeginPhase("gpu_culler");
+    m_pGPUCuller->Initialize(m_pSnapshot->IsOpen() ? m_pSnapshot : NULL);
+    m_pSnapshot->Close();
+    EndPhase();
+
+    // Grass and undergrowth over the ground, bare around the campsite
+    BeginPhase("vegetation");
+    VEGETATION_SETTINGS vegetation;
+    m_pVegetation->Initialize(vegetation, g_VegetationDensityFile);
+    EndPhase();
+
+    // Light baked for the static objects, if it was baked for this scene
+    BeginPhase("lightmaps");
+    if (!m_lightmapFile.empty())
+    {
+        LightmapBaker baker;
+        DescribeLightmapScene(baker);
+        m_pLightmaps->Load(m_lightmapFile, baker.GetSceneHash());
+    }
+    EndPhase();
+
+    // A probe for each reflective object, captured over the first frames
+    BeginPhase("reflection_probes");
+    REFLECTION_PROBE_SETTINGS probes;
+    m_pProbes->Initialize(probes);
+    for (const STATIC_OBJECT& object : m_staticObjects)
+    {
+        // the mug's body and handle share the probe at its middle
+        if (object.bReflective && (m_pProbes->FindProbe(object.position) < 0))
+        {
+            m_pProbes->AddProbe(object.position + glm::vec3(0.0f, 0.5f * object.scale.y, 0.0f), 1.5f);
+        }
+    }
+    EndPhase();
 
-    // Load all textures
-    bool loadedTent = CreateGLTexture("textures/tent.jpg", "tent");
-    bool loadedGround = CreateGLTexture("textures/ground.jpg", "ground");
-    bool loadedCampfire = CreateGLTexture("textures/campfire.jpg", "campfire");
-    bool loadedSky = CreateGLTexture("textures/sky.jpg", "sky");
-    bool loadedBark = CreateGLTexture("textures/bark.jpg", "bark");
-    bool loadedMetal = CreateGLTexture("textures/metal.jpg", "metal");
-    bool loadedRock = CreateGLTexture("textures/rock.jpg", "rock");
-
-   
-    // Report any missing textures
-    if (!loadedTent)
-        std::cerr << "[PrepareScene] ERROR: Failed to load textures/tent.jpg\n";
-    if (!loadedGround)
-        std::cerr << "[PrepareScene] ERROR: Failed to load textures/ground.jpg\n";
-    if (!loadedCampfire)
-        std::cerr << "[PrepareScene] ERROR: Failed to load textures/campfire.jpg\n";
-    if (!loadedSky)
-        std::cerr << "[PrepareScene] ERROR: Failed to load textures/sky.jpg\n";
-    if (!loadedBark)
-        std::cerr << "[PrepareScene] ERROR: Failed to load textures/bark.jpg\n";
-    if (!loadedMetal)
-        std::cerr << "[PrepareScene] ERROR: Failed to load textures/metal.jpg\n";
+    BeginPhase("animation");
+    DefineAnimations();
+    EndPhase();
+
+    if (bRestored)
+    {
+        std::cout << "[SceneManager] Restored " << m_snapshotFile << " in "
+            << (glfwGetTime() - prepareStart) * 1000.0 << " ms" << std::endl;
+    }
+    else if (!m_snapshotFile.empty())
+    {
+        // the snapshot needs every texture, not just the ones seen so far
+        for (int i = 0; i < m_loadedTextures; i++)
+        {
+            RequestTexture(i);
+        }
+        m_bSnapshotPending = true;
+    }
+}
 
+/***********************************************************
+ *  DefineMaterials()
+ *
+ *  This method is used for defining the materials the scene
+ *  objects are drawn with.
+ ***********************************************************/
+void SceneManager::DefineMaterials()
+{
     // MATERIAL: Floor
     OBJECT_MATERIAL floorMat;
     floorMat.tag = "floor";
@@ -511,24 +1517,511 @@ void SceneManager::PrepareScene()
     skyMat.specularColor = glm::vec3(0.0f);
     skyMat.shininess = 1.0f;
     m_objectMaterials.push_back(skyMat);
+
+    // MATERIAL: Rocks
+    OBJECT_MATERIAL rockMat;
+    rockMat.tag = "rock";
+    rockMat.diffuseColor = glm::vec3(0.5f, 0.48f, 0.45f);
+    rockMat.specularColor = glm::vec3(0.1f);
+    rockMat.shininess = 8.0f;
+    m_objectMaterials.push_back(rockMat);
 }
 
-void SceneManager::RenderScene()
+/***********************************************************
+ *  DefineLights()
+ *
+ *  This method is used for defining the point lights, which
+ *  SetupLighting() passes to the shader every frame.
+ ***********************************************************/
+void SceneManager::DefineLights()
+{
+    // Point light (white overhead)
+    POINT_LIGHT overhead;
+    overhead.position = glm::vec3(14.0f, 6.0f, -14.0f);
+    overhead.ambient = glm::vec3(0.4f, 0.4f, 0.4f);
+    overhead.diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+    overhead.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+    overhead.constant = 1.0f;
+    overhead.linear = 0.09f;
+    overhead.quadratic = 0.032f;
+    m_pointLights.push_back(overhead);
+
+    // Point light (warm campfire glow)
+    POINT_LIGHT campfire;
+    campfire.position = glm::vec3(1.5f, 1.0f, -2.0f);
+    campfire.ambient = glm::vec3(0.6f, 0.3f, 0.1f);
+    campfire.diffuse = glm::vec3(0.9f, 0.4f, 0.1f);
+    campfire.specular = glm::vec3(0.8f, 0.3f, 0.2f);
+    campfire.constant = 1.0f;
+    campfire.linear = 0.14f;
+    campfire.quadratic = 0.07f;
+    m_pointLights.push_back(campfire);
+}
+
+/***********************************************************
+ *  DefineStaticObjects()
+ *
+ *  This method is used for defining the hand placed objects
+ *  of the main camp, with the values they have always been
+ *  drawn with. This is the only place the camp is written
+ *  out: DefinePrefabs() builds the campsite prefab from the
+ *  objects that name a prefab, so every site matches it. The
+ *  big boulder and the flame are the main camp's alone. The
+ *  rocks are drawn unlit unless they have a lightmap; the mug
+ *  keeps its per pixel specular and reflects its surroundings.
+ *  The flame is unlit and animated.
+ ***********************************************************/
+void SceneManager::DefineStaticObjects()
+{
+    m_staticObjects.clear();
+
+    STATIC_OBJECT object;
+    object.XrotationDegrees = 0.0f;
+    object.YrotationDegrees = 0.0f;
+    object.ZrotationDegrees = 0.0f;
+    object.bLighting = true;
+    object.bLightmapped = true;
+    object.bReflective = false;
+    object.bAnimated = false;
+
+    /***** TENT BASE AND ROOF *****/
+    object.prefab = "tent";
+    object.shape = PREFAB_BOX;
+    object.material = "tent";
+    object.texture = "tent";
+    object.scale = glm::vec3(9.0f, 0.1f, -5.0f);
+    object.XrotationDegrees = -1.0f;
+    object.position = glm::vec3(-7.45f, 0.1f, -4.5f);
+    m_staticObjects.push_back(object);
+    object.scale = glm::vec3(8.0f, 0.1f, -5.0f);
+    object.XrotationDegrees = 0.0f;
+    object.ZrotationDegrees = 45.0f;
+    object.position = glm::vec3(-10.5f, 2.0f, -5.0f);
+    m_staticObjects.push_back(object);
+    object.ZrotationDegrees = -45.0f;
+    object.position = glm::vec3(-5.0f, 2.0f, -5.0f);
+    m_staticObjects.push_back(object);
+    object.ZrotationDegrees = 0.0f;
+
+    /***** CAMPFIRE RING *****/
+    object.prefab = "campfire";
+    object.shape = PREFAB_CYLINDER;
+    object.material = "campfire";
+    object.texture = "campfire";
+    object.scale = glm::vec3(2.0f, 0.1f, 2.5f);
+    object.position = glm::vec3(1.5f, 0.5f, -2.0f);
+    m_staticObjects.push_back(object);
+
+    /***** FIRE LOGS *****/
+    object.material = "bark";
+    object.texture = "bark";
+    object.scale = glm::vec3(0.4f, 3.0f, 0.5f);
+    object.XrotationDegrees = glm::radians(360.0f);
+    object.position = glm::vec3(-0.25f, 0.5f, -1.25f);
+    m_staticObjects.push_back(object);
+    // logs 2 to 8; log 3 leans the other way and log 8 is the big one
+    const glm::vec3 logPositions[] = {
+        glm::vec3(1.0f, 0.5f, 0.5f), glm::vec3(1.5f, 0.5f, -4.0f), glm::vec3(3.0f, 0.5f, -1.0f),
+        glm::vec3(0.1f, 0.5f, -0.1f), glm::vec3(2.0f, 0.5f, 0.5f), glm::vec3(0.25f, 0.5f, -3.75f),
+        glm::vec3(2.5f, 0.5f, -3.75f) };
+    for (int i = 0; i < 7; i++)
+    {
+        object.scale = (i == 6) ? glm::vec3(2.4f, 5.0f, 0.5f) : glm::vec3(0.4f, 3.0f, 0.5f);
+        object.XrotationDegrees = glm::radians(90.0f);
+        object.YrotationDegrees = glm::radians((i == 1) ? -60.0f : 60.0f);
+        object.ZrotationDegrees = glm::radians(30.0f);
+        object.position = logPositions[i];
+        m_staticObjects.push_back(object);
+    }
+    object.XrotationDegrees = 0.0f;
+    object.YrotationDegrees = 0.0f;
+    object.ZrotationDegrees = 0.0f;
+
+    /***** FLAME *****/
+    // its height is driven by DefineAnimations()
+    object.prefab = "";
+    object.shape = PREFAB_SPHERE;
+    object.material = "campfire";
+    object.texture = "campfire";
+    object.bLighting = false;
+    object.bLightmapped = false;
+    object.bAnimated = true;
+    object.scale = glm::vec3(0.5f, 0.8f, 0.5f);
+    object.position = glm::vec3(1.5f, 0.55f, -2.0f);
+    m_staticObjects.push_back(object);
+    object.shape = PREFAB_CYLINDER;
+    object.bLighting = true;
+    object.bAnimated = false;
+
+    /***** MUG *****/
+    object.prefab = "mug";
+    object.material = "metal";
+    object.texture = "metal";
+    object.bLightmapped = false;
+    object.bReflective = true;
+    object.scale = glm::vec3(0.4f, 0.6f, 0.4f);
+    object.position = glm::vec3(6.0f, 0.3f, -1.5f);
+    m_staticObjects.push_back(object);
+    object.shape = PREFAB_TORUS;
+    object.scale = glm::vec3(0.15f);
+    object.position = glm::vec3(5.5f, 0.6f, -1.5f);
+    m_staticObjects.push_back(object);
+
+    /***** ROCKS GROUP *****/
+    object.shape = PREFAB_SPHERE;
+    object.material = "rock";
+    object.texture = "rock";
+    object.bLighting = false;
+    object.bLightmapped = true;
+    object.bReflective = false;
+    const glm::vec3 rockScales[] = {
+        glm::vec3(10.3f, 5.2f, 8.7f), glm::vec3(1.2f, 0.6f, 1.0f), glm::vec3(1.8f, 1.2f, 1.4f) };
+    const glm::vec3 rockRotations[] = {
+        glm::vec3(15.0f, 20.0f, 5.0f), glm::vec3(12.0f, 8.0f, 3.0f), glm::vec3(25.0f, 18.0f, 12.0f) };
+    const glm::vec3 rockPositions[] = {
+        glm::vec3(15.0f, 0.5f, -15.0f), glm::vec3(12.0f, 0.3f, -4.5f), glm::vec3(7.0f, 0.4f, -7.0f) };
+    for (int i = 0; i < 3; i++)
+    {
+        object.prefab = (i == 0) ? "" : "rocks";
+        object.scale = rockScales[i];
+        object.XrotationDegrees = glm::radians(rockRotations[i].x);
+        object.YrotationDegrees = glm::radians(rockRotations[i].y);
+        object.ZrotationDegrees = glm::radians(rockRotations[i].z);
+        object.position = rockPositions[i];
+        m_staticObjects.push_back(object);
+    }
+}
+
+/***********************************************************
+ *  DefineAnimations()
+ *
+ *  This method is used for sizing the stores the animation
+ *  writes into and binding its channels. The campfire light
+ *  flickers between three quarters and a little over its
+ *  defined strength, on a four second loop of irregular
+ *  keys; the lightmap keeps the light it was baked with.
+ *  The flame's height follows the same keys, so it rises as
+ *  the light brightens, and each change recaptures the
+ *  reflections that can see it.
+ ***********************************************************/
+void SceneManager::DefineAnimations()
+{
+    // every light is uploaded the first frame
+    m_lightIntensities.assign(m_pointLights.size(), 1.0f);
+    m_lightDirty.assign(m_pointLights.size(), 1);
+    m_staticObjectDirty.assign(m_staticObjects.size(), 0);
+
+    const float duration = 4.0f;
+    std::vector<ANIMATION_KEY> flicker;
+    uint32_t state = 0x9E3779B9u;
+    float time = 0.0f;
+    while (time < duration)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        float random = (float)(state >> 8) / 16777216.0f;
+        flicker.push_back({ time, 0.75f + 0.3f * random });
+        time += 0.06f + 0.1f * random;
+    }
+    // the loop ends where it started
+    flicker.push_back({ duration, flicker.front().value });
+
+    int clip = m_pAnimation->AddClip(duration, 30.0f, true);
+    const size_t campfireLight = 1;
+    if (m_pointLights.size() > campfireLight)
+    {
+        m_pAnimation->AddChannel(clip, flicker, &m_lightIntensities[campfireLight], &m_lightDirty[campfireLight]);
+    }
+    for (size_t i = 0; i < m_staticObjects.size(); i++)
+    {
+        STATIC_OBJECT& object = m_staticObjects[i];
+        if (object.bAnimated)
+        {
+            std::vector<ANIMATION_KEY> height = flicker;
+            for (ANIMATION_KEY& key : height)
+            {
+                key.value *= object.scale.y;
+            }
+            m_pAnimation->AddChannel(clip, height, &object.scale.y, &m_staticObjectDirty[i]);
+        }
+    }
+    m_pAnimation->Play(clip, glfwGetTime());
+
+    std::cout << "[SceneManager] " << m_pAnimation->GetChannelCount() << " animated channels in "
+        << m_pAnimation->GetSampleBytes() << " bytes" << std::endl;
+}
+
+/***********************************************************
+ *  DrawStaticObject()
+ *
+ *  This method is used for drawing a static object with the
+ *  scene shader.
+ ***********************************************************/
+void SceneManager::DrawStaticObject(const STATIC_OBJECT& object)
+{
+    m_pShaderManager->setIntValue(g_UseLightingName, object.bLighting ? 1 : 0);
+    SetTransformations(object.scale, object.XrotationDegrees, object.YrotationDegrees,
+        object.ZrotationDegrees, object.position);
+    SetShaderMaterial(object.material);
+    SetShaderTexture(object.texture);
+    DrawShapeMesh(object.shape);
+}
+
+/***********************************************************
+ *  DrawShapeMesh()
+ *
+ *  This method is used for drawing a prefab shape with the
+ *  model matrix last set. The level of its LOD chain is
+ *  chosen from the error it projects from the current view;
+ *  until the chains are built the basic mesh is drawn.
+ ***********************************************************/
+void SceneManager::DrawShapeMesh(PREFAB_SHAPE shape)
+{
+    const LODMesh* pMesh = m_pShapeLODs[shape];
+    if (pMesh->GetLevelCount() > 0)
+    {
+        float scale = std::max(
+            glm::length(glm::vec3(m_currentModel[0])),
+            std::max(glm::length(glm::vec3(m_currentModel[1])), glm::length(glm::vec3(m_currentModel[2]))));
+        glm::vec3 center = glm::vec3(m_currentModel * glm::vec4(pMesh->GetBoundsCenter(), 1.0f));
+        float distance = glm::length(center - m_viewInfo.position);
+        pMesh->DrawLevel(pMesh->SelectLevel(distance, scale, m_viewInfo.fovY, m_viewInfo.viewportHeight));
+        return;
+    }
+
+    switch (shape)
+    {
+    case PREFAB_BOX:
+        m_basicMeshes->DrawBoxMesh();
+        break;
+    case PREFAB_CYLINDER:
+        m_basicMeshes->DrawCylinderMesh();
+        break;
+    case PREFAB_SPHERE:
+        m_basicMeshes->DrawSphereMesh();
+        break;
+    default:
+        m_basicMeshes->DrawTorusMesh();
+        break;
+    }
+}
+
+/***********************************************************
+ *  DescribeLightmapScene()
+ *
+ *  This method is used for handing the baker the lightmapped
+ *  static objects, with their material colours, and what
+ *  else shadows or bounces light onto them: the ground, as
+ *  a thin box the size of the plane, and the mug. The ground
+ *  keeps its per pixel lighting - it spans the campground -
+ *  and so does the mug. The lights are the directional light as
+ *  SetupLighting() sets it and the point lights.
+ ***********************************************************/
+void SceneManager::DescribeLightmapScene(LightmapBaker& baker)
+{
+    MESH_DATA meshes[PREFAB_SHAPE_COUNT];
+    for (int shape = 0; shape < PREFAB_SHAPE_COUNT; shape++)
+    {
+        PrefabSystem::CreateShapeMesh((PREFAB_SHAPE)shape, meshes[shape]);
+    }
+
+    OBJECT_MATERIAL material;
+    glm::vec3 groundColor = FindMaterial("floor", material) ? material.diffuseColor : glm::vec3(0.5f);
+    baker.AddOccluder(meshes[PREFAB_BOX],
+        PrefabSystem::MakeTransform(glm::vec3(2.0f * g_GroundHalfWidth, 0.02f, 2.0f * g_GroundHalfDepth), 0.0f, 0.0f, 0.0f, glm::vec3(0.0f, -0.01f, 0.0f)),
+        groundColor);
+
+    for (const STATIC_OBJECT& object : m_staticObjects)
+    {
+        // whatever the animation moves would not match the bake
+        if (object.bAnimated)
+        {
+            continue;
+        }
+        glm::mat4 model = PrefabSystem::MakeTransform(object.scale, object.XrotationDegrees,
+            object.YrotationDegrees, object.ZrotationDegrees, object.position);
+        glm::vec3 color = FindMaterial(object.material, material) ? material.diffuseColor : glm::vec3(0.5f);
+        if (object.bLightmapped)
+        {
+            baker.AddObject(meshes[object.shape], model, color, FindTextureSlot(object.texture), glm::vec2(1.0f));
+        }
+        else
+        {
+            baker.AddOccluder(meshes[object.shape], model, color);
+        }
+    }
+
+    BAKE_LIGHT sun;
+    sun.bDirectional = true;
+    sun.direction = glm::vec3(-0.5f, -0.5f, -1.0f);
+    sun.diffuse = glm::vec3(0.9f, 0.9f, 0.9f);
+    baker.AddLight(sun);
+    for (const POINT_LIGHT& light : m_pointLights)
+    {
+        BAKE_LIGHT point;
+        point.position = light.position;
+        point.ambient = light.ambient;
+        point.diffuse = light.diffuse;
+        point.constant = light.constant;
+        point.linear = light.linear;
+        point.quadratic = light.quadratic;
+        baker.AddLight(point);
+    }
+}
+
+/***********************************************************
+ *  BakeLightmaps()
+ *
+ *  This method is used for baking the static objects'
+ *  lightmap offline, once the materials, lights and texture
+ *  slots are prepared, across every core.
+ ***********************************************************/
+bool SceneManager::BakeLightmaps(const LIGHTMAP_SETTINGS& settings)
+{
+    if (m_lightmapFile.empty())
+    {
+        std::cout << "[SceneManager] No lightmap file to bake into" << std::endl;
+        return false;
+    }
+
+    BeginPrepareScene();
+    m_pAssetLoader->Wait(m_sceneData);
+
+    LightmapBaker baker;
+    DescribeLightmapScene(baker);
+    ThreadPool pool(ThreadPool::DefaultThreadCount());
+    return baker.Bake(settings, &pool) && baker.Write(m_lightmapFile);
+}
+
+/***********************************************************
+ *  DefinePrefabs()
+ *
+ *  This method is used for building the campsite prefab from
+ *  the static objects - a tent, campfire, mug and rocks
+ *  prefab from the objects naming each, nested in one site -
+ *  and then placing thousands of copies of it in a campground
+ *  around the main camp. Every log, rock and tent panel of
+ *  every site lands in a shared batch on the GPU culler.
+ ***********************************************************/
+void SceneManager::DefinePrefabs()
+{
+    const glm::mat4 identity(1.0f);
+
+    // the parts, in the prefab of their object
+    std::vector<int> parts;
+    for (const STATIC_OBJECT& object : m_staticObjects)
+    {
+        if (object.prefab.empty())
+        {
+            continue;
+        }
+        int prefab = m_pPrefabs->FindPrefab(object.prefab);
+        if (prefab < 0)
+        {
+            prefab = m_pPrefabs->CreatePrefab(object.prefab);
+            parts.push_back(prefab);
+        }
+        m_pPrefabs->AddPart(prefab, object.shape, FindTextureSlot(object.texture),
+            PrefabSystem::MakeTransform(object.scale, object.XrotationDegrees, object.YrotationDegrees,
+                object.ZrotationDegrees, object.position));
+    }
+
+    // the whole campsite
+    int campsite = m_pPrefabs->CreatePrefab("campsite");
+    for (int prefab : parts)
+    {
+        m_pPrefabs->AddChild(campsite, prefab, identity);
+    }
+
+    // campground - a grid of sites around the main camp, each turned
+    // by a fixed pseudo random angle so the rows do not look stamped
+    const int siteCount = 5000;
+    const float clearRadius = 40.0f;
+    int placed = 0;
+    for (int cell = 0; (placed < siteCount) && (cell < g_CampgroundColumns * g_CampgroundRows); cell++)
+    {
+        int column = cell % g_CampgroundColumns;
+        int row = cell / g_CampgroundColumns;
+        float x = (column - (g_CampgroundColumns - 1) * 0.5f) * g_CampgroundSpacing;
+        float z = -(row - (g_CampgroundRows - 1) * 0.5f) * g_CampgroundSpacing;
+        if (glm::length(glm::vec2(x, z)) < clearRadius)
+        {
+            continue;
+        }
+
+        uint32_t hash = (uint32_t)cell * 2654435761u;
+        float yaw = (float)((hash >> 8) % 360);
+        m_pPrefabs->Instantiate(campsite,
+            PrefabSystem::MakeTransform(glm::vec3(1.0f), 0.0f, yaw, 0.0f, glm::vec3(x, 0.0f, z)));
+        placed++;
+    }
+
+    std::cout << "[SceneManager] Campground: " << m_pPrefabs->GetInstanceCount()
+        << " sites, " << m_pGPUCuller->GetInstanceCount() << " parts in "
+        << m_pPrefabs->GetBatchCount() << " batches" << std::endl;
+}
+
+/***********************************************************
+ *  UpdateAssets()
+ *
+ *  This method is used for the per frame work that does not
+ *  depend on the camera - finishing asset loads, saving the
+ *  snapshot, advancing the animation, binding the textures,
+ *  uploading the lights and refreshing the reflections - so
+ *  it all runs before the input is latched and the latest
+ *  input reaches the screen sooner. Static objects the
+ *  animation moved have the reflections around them
+ *  recaptured.
+ ***********************************************************/
+void SceneManager::UpdateAssets()
 {
+    // finish any asset loads waiting for the GL thread, a little per frame
+    m_pAssetLoader->PumpGLThread(0.004);
+    if (m_bSnapshotPending)
+    {
+        WriteSnapshot();
+    }
+
+    if (m_pAnimation->Update((m_sceneTime >= 0.0) ? m_sceneTime : glfwGetTime()) > 0)
+    {
+        for (size_t i = 0; i < m_staticObjectDirty.size(); i++)
+        {
+            if (m_staticObjectDirty[i])
+            {
+                const STATIC_OBJECT& object = m_staticObjects[i];
+                InvalidateReflections(object.position,
+                    std::max(object.scale.x, std::max(object.scale.y, object.scale.z)));
+                m_staticObjectDirty[i] = 0;
+            }
+        }
+    }
+
     BindGLTextures();
     SetupLighting();
+    UpdateReflectionProbes();
+}
 
+/***********************************************************
+ *  DrawBackdrop()
+ *
+ *  This method is used for drawing the ground plane and the
+ *  sky behind the scene, for the camera and the probes.
+ ***********************************************************/
+void SceneManager::DrawBackdrop()
+{
     glm::vec3 scaleXYZ;
     glm::vec3 positionXYZ;
     float XrotationDegrees = -45.0f;
 
     /***** GROUND PLANE *****/
-    scaleXYZ = glm::vec3(300.0f, 1.0f, 200.0f);
+    // under the whole campground, tiled every 60 by 40 units
+    scaleXYZ = glm::vec3(g_GroundHalfWidth, 1.0f, g_GroundHalfDepth);
     positionXYZ = glm::vec3(0.0f, 0.0f, 0.0f);
     SetTransformations(scaleXYZ, 0, 0, 0, positionXYZ);
     SetShaderMaterial("floor");
     SetShaderTexture("ground");
-    SetTextureUVScale(10.0f, 10.0f);
+    SetTextureUVScale(g_GroundHalfWidth / 30.0f, g_GroundHalfDepth / 20.0f);
     m_basicMeshes->DrawPlaneMesh();
 
     // SKY BACKDROP FIX  ROTATE INTO VIEW
@@ -545,140 +2038,215 @@ void SceneManager::RenderScene()
     m_basicMeshes->DrawPlaneMesh();
 
     m_pShaderManager->setIntValue("bUseLighting", 1);
+}
 
+/***********************************************************
+ *  UpdateReflectionProbes()
+ *
+ *  This method is used for refreshing the reflections a
+ *  step or so a frame. Every probe sees the whole camp, so
+ *  a texture finishing loading recaptures all of them.
+ ***********************************************************/
+void SceneManager::UpdateReflectionProbes()
+{
+    bool bTexturesChanged = (m_probeTextureIDs.size() != (size_t)m_loadedTextures);
+    m_probeTextureIDs.resize(m_loadedTextures);
+    for (int i = 0; i < m_loadedTextures; i++)
+    {
+        if (m_probeTextureIDs[i] != m_textureIDs[i].ID)
+        {
+            m_probeTextureIDs[i] = m_textureIDs[i].ID;
+            bTexturesChanged = true;
+        }
+    }
+    if (bTexturesChanged)
+    {
+        m_pProbes->InvalidateAll();
+    }
 
+    m_pProbes->Update([this](const VIEW_INFO& faceView) { RenderProbeFace(faceView); });
+}
 
-    /***** TENT BASE *****/
-    scaleXYZ = glm::vec3(9.0f, 0.1f, -5.0f);
-    positionXYZ = glm::vec3(-7.45f, .1f, -4.5f);
-    SetTransformations(scaleXYZ, -1.0, 0, 0, positionXYZ);
-    SetShaderMaterial("tent");
-    SetShaderTexture("tent");
-    m_basicMeshes->DrawBoxMesh();
-
-    /***** TENT ROOF *****/
-    scaleXYZ = glm::vec3(8.0f, 0.1f, -5.0f);
-    positionXYZ = glm::vec3(-10.5f, 2.0f, -5.0f);
-    SetTransformations(scaleXYZ, 0.0f, 0.0f, 45.0f, positionXYZ);
-    SetShaderMaterial("tent");
-    SetShaderTexture("tent");
-    m_basicMeshes->DrawBoxMesh();
-    positionXYZ = glm::vec3(-5.f, 2.0f, -5.0f);
-    SetTransformations(scaleXYZ, 0.0f, 0.0f, -45.0f, positionXYZ);
-    m_basicMeshes->DrawBoxMesh();
-
-    /***** CAMPFIRE RING *****/
-    scaleXYZ = glm::vec3(2.0f, 0.1f, 2.5f);
-    positionXYZ = glm::vec3(1.5f, 0.5f, -2.0f);
-    SetTransformations(scaleXYZ, 0, 0, 0, positionXYZ);
-    SetShaderMaterial("campfire");
-    SetShaderTexture("campfire");
-    m_basicMeshes->DrawCylinderMesh();
-
-    /***** FIRE LOGS - Simple 3-Log Teepee *****/
+/***********************************************************
+ *  RenderProbeFace()
+ *
+ *  This method is used for drawing the scene from a probe:
+ *  the backdrop and the static objects other than the
+ *  reflective ones. The grass, impostors and GPU culled
+ *  campground are left out to keep a face cheap. The
+ *  camera's matrices are put back afterwards.
+ ***********************************************************/
+void SceneManager::RenderProbeFace(const VIEW_INFO& faceView)
+{
+    // the probe is the camera for the levels and texture requests
+    VIEW_INFO cameraView = m_viewInfo;
+    m_viewInfo = faceView;
 
-// Log 1 - leaning back
+    m_pShaderManager->use();
+    m_pShaderManager->setMat4Value(g_ViewName, faceView.view);
+    m_pShaderManager->setMat4Value(g_ProjectionName, faceView.projection);
 
-    scaleXYZ = glm::vec3(0.4f, 3.0f, 0.5f);
-    positionXYZ = glm::vec3(-0.25f, 0.5f, -1.25f);
-    SetTransformations(scaleXYZ, XrotationDegrees, 0.0f, 0.0f, positionXYZ);
-    SetShaderMaterial("bark");
-    SetShaderTexture("bark");
-    XrotationDegrees = 45.0; 
-    m_basicMeshes->DrawCylinderMesh();
-
-
-    // Log 2 - leaning left
-    scaleXYZ = glm::vec3(0.4f, 3.0f, 0.5f);
-    positionXYZ = glm::vec3(1.0f, 0.5f, .5f);
-    SetTransformations(scaleXYZ, glm::radians(90.0f), glm::radians(60.0f), glm::radians(30.0f), positionXYZ);
-    m_basicMeshes->DrawCylinderMesh();
-
-    // Log 3 - leaning right
-    scaleXYZ = glm::vec3(0.4f, 3.0f, 0.5f);
-    positionXYZ = glm::vec3(1.5f, 0.5f, -4.0f);
-    SetTransformations(scaleXYZ, glm::radians(90.0f), glm::radians(-60.0f), glm::radians(30.0f), positionXYZ);
-    m_basicMeshes->DrawCylinderMesh();
-
-    // Log 4 - leaning left
-    scaleXYZ = glm::vec3(0.4f, 3.0f, 0.5f);
-    positionXYZ = glm::vec3(3.0f, 0.5f, -1.0f);
-    SetTransformations(scaleXYZ, glm::radians(90.0f), glm::radians(60.0f), glm::radians(30.0f), positionXYZ);
-    m_basicMeshes->DrawCylinderMesh();
-
-    // Log 5 - leaning left
-    scaleXYZ = glm::vec3(0.4f, 3.0f, 0.5f);
-    positionXYZ = glm::vec3(.1f, 0.5f, -.1f);
-    SetTransformations(scaleXYZ, glm::radians(90.0f), glm::radians(60.0f), glm::radians(30.0f), positionXYZ);
-    m_basicMeshes->DrawCylinderMesh();
-
-
-    // Log 6 - leaning left
-    scaleXYZ = glm::vec3(0.4f, 3.0f, 0.5f);
-    positionXYZ = glm::vec3(2.00f, 0.5f, .5f);
-    SetTransformations(scaleXYZ, glm::radians(90.0f), glm::radians(60.0f), glm::radians(30.0f), positionXYZ);
-    m_basicMeshes->DrawCylinderMesh();
-
-
-    // Log 7 - leaning left
-    scaleXYZ = glm::vec3(0.4f, 3.0f, 0.5f);
-    positionXYZ = glm::vec3(0.25f, 0.5f, -3.75f);
-    SetTransformations(scaleXYZ, glm::radians(90.0f), glm::radians(60.0f), glm::radians(30.0f), positionXYZ);
-    m_basicMeshes->DrawCylinderMesh();
-
-
-    // Log 8 - leaning left
-    scaleXYZ = glm::vec3(02.4f, 5.0f, 0.5f);
-    positionXYZ = glm::vec3(2.5f, 0.5f, -3.75f);
-    SetTransformations(scaleXYZ, glm::radians(90.0f), glm::radians(60.0f), glm::radians(30.0f), positionXYZ);
-    m_basicMeshes->DrawCylinderMesh();
-
-    /***** MUG BODY *****/
-    scaleXYZ = glm::vec3(0.4f, 0.6f, 0.4f);
-    positionXYZ = glm::vec3(6.0f, 0.3f, -1.5f);
-    SetTransformations(scaleXYZ, 0, 0, 0, positionXYZ);
-    SetShaderMaterial("metal");
-    SetShaderTexture("metal");
-    m_basicMeshes->DrawCylinderMesh();
+    DrawBackdrop();
+    const bool bLightmapped = m_pLightmaps->IsLoaded();
+    for (const STATIC_OBJECT& object : m_staticObjects)
+    {
+        if (!object.bReflective && !(object.bLightmapped && bLightmapped))
+        {
+            DrawStaticObject(object);
+        }
+    }
+    m_pShaderManager->setIntValue(g_UseLightingName, 1);
+    m_pLightmaps->Render(faceView);
 
-    /***** MUG HANDLE *****/
-    scaleXYZ = glm::vec3(0.15f);
-    positionXYZ = glm::vec3(5.5f, 0.6f, -1.5f);
-    SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-    m_basicMeshes->DrawTorusMesh();
+    m_viewInfo = cameraView;
+    m_pShaderManager->setMat4Value(g_ViewName, m_viewInfo.view);
+    m_pShaderManager->setMat4Value(g_ProjectionName, m_viewInfo.projection);
+}
 
-    /***** ROCKS GROUP *****/
+/***********************************************************
+ *  RenderScene()
+ *
+ *  This method is used for drawing the scene from the camera
+ *  set with SetViewInfo(), into the current viewport, after
+ *  UpdateAssets() has prepared the frame.
+ ***********************************************************/
+void SceneManager::RenderScene()
+{
+    DrawView(true, false);
+}
 
-// Big main rock
-    m_pShaderManager->setIntValue("bUseLighting", 0);  // Turn off lighting for backdrop-style boulders
+/***********************************************************
+ *  RenderViews()
+ *
+ *  This method is used for drawing the scene into several
+ *  viewports. The work that does not depend on the camera -
+ *  texture binding, lighting, animation writes and the
+ *  probe refresh - was done once for the frame by
+ *  UpdateAssets(); each view only sets its matrices and
+ *  draws what it sees.
+ ***********************************************************/
+void SceneManager::RenderViews(const std::vector<SCENE_VIEW>& views)
+{
+    if (views.empty())
+    {
+        return;
+    }
 
-    scaleXYZ = glm::vec3(10.3f, 5.2f, 8.7f);
-    positionXYZ = glm::vec3(15.0f, 0.5f, -15.0f);
-    SetTransformations(scaleXYZ, glm::radians(15.0f), glm::radians(20.0f), glm::radians(5.0f), positionXYZ);
-    SetShaderMaterial("rock");
-    SetShaderTexture("rock");
-    m_basicMeshes->DrawSphereMesh();
+    for (size_t i = 0; i < views.size(); i++)
+    {
+        ViewManager::BeginView(views[i]);
+        m_viewInfo = views[i].viewInfo;
+        m_pShaderManager->use();
+        m_pShaderManager->setMat4Value(g_ViewName, m_viewInfo.view);
+        m_pShaderManager->setMat4Value(g_ProjectionName, m_viewInfo.projection);
+        m_pShaderManager->setVec3Value("viewPosition", m_viewInfo.position);
+
+        DrawView(i == 0, views[i].bOverlay);
+    }
 
-    m_pShaderManager->setIntValue("bUseLighting", 0);  // Re-enable lighting
+    // leave the first view's camera set, as a single view would
+    m_viewInfo = views[0].viewInfo;
+    m_pShaderManager->setMat4Value(g_ViewName, m_viewInfo.view);
+    m_pShaderManager->setMat4Value(g_ProjectionName, m_viewInfo.projection);
+    m_pShaderManager->setVec3Value("viewPosition", m_viewInfo.position);
+    ViewManager::EndViews();
+}
 
-    // Smaller rock
-    scaleXYZ = glm::vec3(1.2f, 0.6f, 1.0f);
-    positionXYZ = glm::vec3(12.0f, 0.3f, -4.5f);
-    SetTransformations(scaleXYZ, glm::radians(12.0f), glm::radians(8.0f), glm::radians(3.0f), positionXYZ);
-    SetShaderMaterial("rock");
-    SetShaderTexture("rock");
-    m_basicMeshes->DrawSphereMesh();
+/***********************************************************
+ *  DrawView()
+ *
+ *  This method is used for drawing everything visible from
+ *  the current camera. Only the primary view updates the
+ *  GPU culler's occluders, which are its depth; the other
+ *  views are culled against the frustum alone. Overlays
+ *  leave out the grass.
+ ***********************************************************/
+void SceneManager::DrawView(bool bPrimary, bool bOverlay)
+{
+    DrawBackdrop();
 
-    // Another boulder
-    scaleXYZ = glm::vec3(1.8f, 1.2f, 1.4f);
-    positionXYZ = glm::vec3(7.0f, 0.4f, -7.0f);
-    SetTransformations(scaleXYZ, glm::radians(25.0f), glm::radians(18.0f), glm::radians(12.0f), positionXYZ);
-    SetShaderMaterial("rock");
-    SetShaderTexture("rock");
-    m_basicMeshes->DrawSphereMesh();
+    /***** STATIC OBJECTS *****/
+    // the tent, campfire, logs, mug and rocks; once their baked light has
+    // loaded, the lightmapped ones are drawn together after the rest
+    const bool bLightmapped = m_pLightmaps->IsLoaded();
+    for (const STATIC_OBJECT& object : m_staticObjects)
+    {
+        if (object.bLightmapped && bLightmapped)
+        {
+            // their textures still only load once they are first seen
+            glm::mat4 model = PrefabSystem::MakeTransform(object.scale, object.XrotationDegrees,
+                object.YrotationDegrees, object.ZrotationDegrees, object.position);
+            if (IsInView(model))
+            {
+                RequestTexture(FindTextureSlot(object.texture));
+            }
+            continue;
+        }
+        DrawStaticObject(object);
+        if (object.bReflective)
+        {
+            OBJECT_MATERIAL material;
+            FindMaterial(object.material, material);
+            m_pProbes->DrawReflection(
+                m_pProbes->FindProbe(object.position),
+                m_currentModel,
+                m_viewInfo,
+                material.specularColor,
+                material.shininess,
+                [this, &object]() { DrawShapeMesh(object.shape); });
+        }
+    }
+    m_pShaderManager->setIntValue(g_UseLightingName, 1);
+    m_pLightmaps->Render(m_viewInfo);
 
+    /***** VEGETATION *****/
+    // only the tiles around the camera exist, generated from the seed on demand
+    if (!bOverlay)
+    {
+        m_pVegetation->Render(
+            m_viewInfo,
+            glm::vec3(-0.5f, -0.5f, -1.0f),
+            glm::vec3(0.9f, 0.9f, 0.9f),
+            glm::vec3(0.4f, 0.4f, 0.4f));
+    }
 
-  
+    /***** DISTANT PROP IMPOSTORS *****/
+    // the far campground sites, and any distant prop queued for this view,
+    // are drawn in one instanced call per prop
+    QueueDistantSites();
+    m_pImpostors->Render(
+        m_viewInfo,
+        glm::vec3(-0.5f, -0.5f, -1.0f),
+        glm::vec3(0.9f, 0.9f, 0.9f),
+        glm::vec3(0.4f, 0.4f, 0.4f));
+    m_pImpostors->ClearInstances();
+
+    /***** GPU CULLED INSTANCES *****/
+    // frustum, occlusion and LOD selection run on the GPU - one draw call,
+    // and one more for what the occlusion retest finds
+    if (m_pGPUCuller->GetInstanceCount() > 0)
+    {
+        // the occluders are captured from, and tested for, the primary
+        // camera alone
+        bool bOcclusionCulling = m_pGPUCuller->m_bOcclusionCulling;
+        m_pGPUCuller->m_bOcclusionCulling = bOcclusionCulling && bPrimary;
+        m_pGPUCuller->CullAndDraw(
+            m_viewInfo,
+            glm::vec3(-0.5f, -0.5f, -1.0f),
+            glm::vec3(0.9f, 0.9f, 0.9f),
+            glm::vec3(0.4f, 0.4f, 0.4f));
+        m_pGPUCuller->m_bOcclusionCulling = bOcclusionCulling;
+
+        // textures of the instances that survived culling, read back a frame late
+        uint32_t visibleTextures = m_pGPUCuller->GetVisibleTextureMask();
+        for (int i = 0; i < m_loadedTextures; i++)
+        {
+            if (visibleTextures & (1u << i))
+            {
+                RequestTexture(i);
+            }
+        }
+    }
 
 
 
@@ -698,23 +2266,30 @@ void SceneManager::SetupLighting()
     m_pShaderManager->setVec3Value("dirLight.specular", glm::vec3(1.0f, 1.0f, 1.0f));
     m_pShaderManager->setBoolValue("dirLight.bActive", true);
 
-    // Point light (white overhead)
-    m_pShaderManager->setVec3Value("pointLights[0].position", glm::vec3(14.0f, 6.0f, -14.0f));
-    m_pShaderManager->setVec3Value("pointLights[0].ambient", glm::vec3(0.4f, 0.4f, 0.4f));
-    m_pShaderManager->setVec3Value("pointLights[0].diffuse", glm::vec3(0.8f, 0.8f, 0.8f));
-    m_pShaderManager->setVec3Value("pointLights[0].specular", glm::vec3(1.0f, 1.0f, 1.0f));
-    m_pShaderManager->setFloatValue("pointLights[0].constant", 1.0f);
-    m_pShaderManager->setFloatValue("pointLights[0].linear", 0.09f);
-    m_pShaderManager->setFloatValue("pointLights[0].quadratic", 0.032f);
-    m_pShaderManager->setBoolValue("pointLights[0].bActive", true);
-
-    // Point light (warm campfire glow)
-    m_pShaderManager->setVec3Value("pointLights[1].position", glm::vec3(1.5f, 1.0f, -2.0f));
-    m_pShaderManager->setVec3Value("pointLights[1].ambient", glm::vec3(0.6f, 0.3f, 0.1f));
-    m_pShaderManager->setVec3Value("pointLights[1].diffuse", glm::vec3(0.9f, 0.4f, 0.1f));
-    m_pShaderManager->setVec3Value("pointLights[1].specular", glm::vec3(0.8f, 0.3f, 0.2f));
-    m_pShaderManager->setFloatValue("pointLights[1].constant", 1.0f);
-    m_pShaderManager->setFloatValue("pointLights[1].linear", 0.14f);
-    m_pShaderManager->setFloatValue("pointLights[1].quadratic", 0.07f);
-    m_pShaderManager->setBoolValue("pointLights[1].bActive", true);
+    // Point lights, from the table built by DefineLights(); the shader
+    // keeps them between frames, so only those the animation changed
+    // are sent again
+    const bool bAllLights = (m_lightDirty.size() != m_pointLights.size());
+    for (size_t i = 0; i < m_pointLights.size(); i++)
+    {
+        if (!bAllLights && !m_lightDirty[i])
+        {
+            continue;
+        }
+        const POINT_LIGHT& light = m_pointLights[i];
+        float intensity = bAllLights ? 1.0f : m_lightIntensities[i];
+        std::string name = "pointLights[" + std::to_string(i) + "].";
+        m_pShaderManager->setVec3Value(name + "position", light.position);
+        m_pShaderManager->setVec3Value(name + "ambient", light.ambient * intensity);
+        m_pShaderManager->setVec3Value(name + "diffuse", light.diffuse * intensity);
+        m_pShaderManager->setVec3Value(name + "specular", light.specular * intensity);
+        m_pShaderManager->setFloatValue(name + "constant", light.constant);
+        m_pShaderManager->setFloatValue(name + "linear", light.linear);
+        m_pShaderManager->setFloatValue(name + "quadratic", light.quadratic);
+        m_pShaderManager->setBoolValue(name + "bActive", true);
+        if (!bAllLights)
+        {
+            m_lightDirty[i] = 0;
+        }
+    }
 }
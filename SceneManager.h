@@ -11,6 +11,19 @@
 
 #include "ShaderManager.h"
 #include "ShapeMeshes.h"
+#include "ViewManager.h"
+#include "ImpostorSystem.h"
+#include "LODMesh.h"
+#include "GPUCuller.h"
+#include "LightmapSystem.h"
+#include "ReflectionProbes.h"
+#include "RayQuery.h"
+#include "VegetationSystem.h"
+#include "PrefabSystem.h"
+#include "AssetLoader.h"
+#include "AnimationSystem.h"
+#include "SceneSnapshot.h"
+#include "StartupProfiler.h"
 
 #include <string>
 #include <vector>
@@ -43,6 +56,41 @@ public:
 		std::string tag;
 	};
 
+	struct POINT_LIGHT
+	{
+		glm::vec3 position;
+		glm::vec3 ambient;
+		glm::vec3 diffuse;
+		glm::vec3 specular;
+		float constant;
+		float linear;
+		float quadratic;
+	};
+
+	// an object of the main camp, with the values passed to
+	// SetTransformations(); lightmapped objects are drawn by the lightmap
+	// system once a current lightmap has loaded, reflective ones get
+	// their probe's reflection over them and are left out of the probe
+	// captures. The campground's sites are built from the same objects,
+	// each a part of the prefab it names, or of none if it is empty
+	struct STATIC_OBJECT
+	{
+		std::string prefab;
+		PREFAB_SHAPE shape;
+		glm::vec3 scale;
+		float XrotationDegrees;
+		float YrotationDegrees;
+		float ZrotationDegrees;
+		glm::vec3 position;
+		std::string material;
+		std::string texture;
+		bool bLighting;
+		bool bLightmapped;
+		bool bReflective;
+		// moved by the animation, so left out of the baked light
+		bool bAnimated;
+	};
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
@@ -54,9 +102,88 @@ private:
 	TEXTURE_INFO m_textureIDs[16];
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// point lights, in shader array order
+	std::vector<POINT_LIGHT> m_pointLights;
+	// the hand placed objects of the main camp
+	std::vector<STATIC_OBJECT> m_staticObjects;
+	// baked light for the static objects, and the file it is read from
+	LightmapSystem* m_pLightmaps;
+	std::string m_lightmapFile;
+	// cubemap reflections for the reflective static objects, and the
+	// texture IDs they were last captured with
+	ReflectionProbes* m_pProbes;
+	std::vector<uint32_t> m_probeTextureIDs;
+	// keyframed channels driving the lights and static objects, what
+	// they write into, and which entries they changed since last used
+	AnimationSystem* m_pAnimation;
+	std::vector<float> m_lightIntensities;
+	std::vector<uint8_t> m_lightDirty;
+	std::vector<uint8_t> m_staticObjectDirty;
+	// the time the animation is played at, or negative for the clock
+	double m_sceneTime;
+	// baked impostors for drawing distant props
+	ImpostorSystem* m_pImpostors;
+	// campground sites drawn from the impostor in the current view, one
+	// bit per GPU culler group
+	std::vector<uint32_t> m_hiddenSites;
+	// the shapes' LOD chains, drawn at the level the camera needs
+	LODMesh* m_pShapeLODs[PREFAB_SHAPE_COUNT];
+	// GPU culled, indirectly drawn instances
+	GPUCuller* m_pGPUCuller;
+	// the culler's instances on the CPU, for picking and line of sight
+	RayQuery* m_pRayQuery;
+	// procedurally scattered grass and undergrowth
+	VegetationSystem* m_pVegetation;
+	// reusable object hierarchies, drawn through the GPU culler
+	PrefabSystem* m_pPrefabs;
+	// background loading of the scene assets
+	AssetLoader* m_pAssetLoader;
+	// camera matrices for the frame being rendered
+	VIEW_INFO m_viewInfo;
+	// model matrix of the object being drawn, for visibility checks
+	glm::mat4 m_currentModel;
+
+	// a texture slot whose image is only loaded once it is first seen
+	struct LAZY_TEXTURE
+	{
+		std::string filename;
+		AssetTrigger request;
+	};
+	// per-slot load requests, parallel to m_textureIDs
+	LAZY_TEXTURE m_lazyTextures[16];
+	// 1x1 texture bound to a slot until its image has loaded
+	GLuint m_placeholderTexture;
+	// set in the destructor so waiting loads give up instead of loading
+	bool m_bShuttingDown;
+
+	// prepared scene saved after the first run, restored on later ones;
+	// no snapshot is used when the file name is empty
+	std::string m_snapshotFile;
+	SceneSnapshot* m_pSnapshot;
+	// texture loads, parallel to the slots, which the snapshot waits for
+	std::vector<AssetTask<bool>> m_textureLoads;
+	bool m_bSnapshotPending;
+	// preparation started on the loader workers, before the context;
+	// PrepareScene() joins it
+	bool m_bPrepareStarted;
+	AssetTask<bool> m_sceneData;
+	AssetTask<bool> m_vegetationData;
+	// times the preparation phases when set
+	StartupProfiler* m_pStartupProfiler;
 
 	// load texture images and convert to OpenGL texture data
 	bool CreateGLTexture(const char* filename, std::string tag);
+	// reserve the next texture slot; the image loads in the background
+	// once the texture is first used by something on screen
+	AssetTask<bool> LoadSceneTexture(std::string filename, std::string tag);
+	// start loading the texture in a slot, if it has not been already
+	void RequestTexture(int slot);
+	// test the bounding sphere of a unit mesh against the view frustum
+	bool IsInView(const glm::mat4& model) const;
+	bool IsSphereInView(glm::vec3 center, float radius) const;
+	// bake the campsite impostor once the textures of its parts have loaded
+	AssetTask<bool> BakeImpostors(std::vector<AssetTask<bool>> textureLoads);
+	void BakeCampsiteImpostor();
 	// bind loaded OpenGL textures to slots in memory
 	void BindGLTextures();
 	// free the loaded OpenGL textures
@@ -95,6 +222,50 @@ private:
 	void SetShaderMaterial(
 		std::string materialTag);
 
+	// build the campsite prefab from the static objects and populate the
+	// campground with it
+	void DefinePrefabs();
+	// define the object materials and the point lights
+	void DefineMaterials();
+	void DefineLights();
+	// define the hand placed objects of the main camp
+	void DefineStaticObjects();
+	// bind the animated channels, such as the campfire's flicker
+	void DefineAnimations();
+	// give the baker the static objects, what they bounce light off, and
+	// the lights; the same description hashes the lightmap on loading
+	void DescribeLightmapScene(LightmapBaker& baker);
+	// draw a static object with the per pixel lit scene shader
+	void DrawStaticObject(const STATIC_OBJECT& object);
+	void DrawShapeMesh(PREFAB_SHAPE shape);
+	// draw the ground plane and the sky backdrop
+	void DrawBackdrop();
+	// queue the campground sites far enough away for the impostor, and
+	// hide them from the GPU culler, for the current view
+	void QueueDistantSites();
+	// refresh this frame's share of the reflection probes
+	void UpdateReflectionProbes();
+	// draw what a probe sees down one cube face
+	void RenderProbeFace(const VIEW_INFO& faceView);
+	// draw the scene from m_viewInfo, after the per frame setup; the
+	// primary view captures the occluders and overlays skip the grass
+	void DrawView(bool bPrimary, bool bOverlay);
+
+	// the preparation that needs no OpenGL, run on the loader workers
+	AssetTask<bool> PrepareSceneData();
+	AssetTask<bool> LoadVegetationDensity();
+	// take the materials, lights and campground from the snapshot file,
+	// checking its textures, which are created once there is a context
+	bool RestoreSnapshot();
+	bool CheckSnapshotTextures(const SceneSnapshot& snapshot) const;
+	void CreateSnapshotTextures(const SceneSnapshot& snapshot);
+	// once every texture has loaded, save the prepared scene
+	void WriteSnapshot();
+	void CaptureTextures(SceneSnapshot& snapshot);
+	// time a preparation phase, when profiling startup
+	void BeginPhase(const char* name);
+	void EndPhase();
+
 	// Maximum number of textures we will support
 	static const int MAX_TEXTURES = 16;
 
@@ -110,5 +281,46 @@ public:
 	// customize for their own 3D scene
 	void PrepareScene();
 	void RenderScene();
+	// draw the scene into each view's viewport, sharing the per frame
+	// work; the first view is the primary camera
+	void RenderViews(const std::vector<SCENE_VIEW>& views);
+	// finish loads, save the snapshot, advance the animation, bind the
+	// textures, upload the lights and refresh the probes, before the
+	// input is latched and the camera is set up
+	void UpdateAssets();
+	// start the preparation that needs no OpenGL on the loader workers;
+	// may be called before the window exists, PrepareScene() calls it
+	// otherwise
+	void BeginPrepareScene();
 	void SetupLighting();
+
+	// set the snapshot file, before BeginPrepareScene(); empty disables it
+	void SetSnapshotFile(std::string filename) { m_snapshotFile = filename; }
+	// set the baked lightmap file, before PrepareScene(); empty disables it
+	void SetLightmapFile(std::string filename) { m_lightmapFile = filename; }
+	// bake the static objects' lightmap into the lightmap file, after
+	// BeginPrepareScene(); needs no OpenGL
+	bool BakeLightmaps(const LIGHTMAP_SETTINGS& settings);
+	// time the preparation phases and texture loads, before
+	// BeginPrepareScene()
+	void SetStartupProfiler(StartupProfiler* pProfiler) { m_pStartupProfiler = pProfiler; }
+	// true while requested textures are loading or the snapshot is unwritten
+	bool IsLoading() const;
+	// the closest campground object through a window position, in pixels
+	// from the top left; false if there is none or the scene is not ready
+	bool PickObject(const VIEW_INFO& viewInfo, float x, float y, RAY_HIT& hit) const;
+	// true if no campground object lies between the two points
+	bool IsVisible(glm::vec3 from, glm::vec3 to) const;
+	// recapture the reflections that can see something changed in the
+	// sphere
+	void InvalidateReflections(glm::vec3 center, float radius);
+
+	// play the animation at a fixed time, as an export does, rather than
+	// by the clock; a negative time goes back to the clock
+	void SetSceneTime(double time) { m_sceneTime = time; }
+	// set the camera matrices used for the next RenderScene()
+	void SetViewInfo(const VIEW_INFO& viewInfo) { m_viewInfo = viewInfo; }
+	// queue a prop to be drawn from its impostor in the current view;
+	// false when it is too close or has none, and must be drawn in full
+	bool AddDistantProp(std::string tag, glm::vec3 position, float scale, float yaw = 0.0f);
 };
\ No newline at end of file
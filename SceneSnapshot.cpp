@@ -0,0 +1,459 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenesnapshot.cpp
+// ============
+// one relocatable file holding the prepared scene, mapped on later launches
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneSnapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// bump whenever the header or section table changes
+	const uint32_t SNAPSHOT_FORMAT_VERSION = 1;
+	const char SNAPSHOT_MAGIC[8] = { 'C', 'A', 'M', 'P', 'S', 'N', 'A', 'P' };
+	// every section starts on a boundary this size
+	const uint64_t SECTION_ALIGNMENT = 64;
+
+	struct FILE_HEADER
+	{
+		char magic[8];
+		uint32_t formatVersion;
+		uint32_t contentVersion;
+		uint64_t fileSize;
+		uint32_t sectionCount;
+		// catches files written by a build with another pointer size
+		uint32_t pointerSize;
+	};
+
+	struct SECTION_ENTRY
+	{
+		uint32_t id;
+		uint32_t pad;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	uint64_t AlignOffset(uint64_t offset)
+	{
+		return (offset + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+	}
+}
+
+/***********************************************************
+ *  SceneSnapshot()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneSnapshot::SceneSnapshot()
+{
+	m_pData = NULL;
+	m_size = 0;
+	m_hFile = NULL;
+	m_hMapping = NULL;
+}
+
+/***********************************************************
+ *  ~SceneSnapshot()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneSnapshot::~SceneSnapshot()
+{
+	Close();
+}
+
+/***********************************************************
+ *  StampFile()
+ *
+ *  This method is used for reading the size and modification
+ *  time of a file. A missing file has a zero stamp, so it
+ *  only matches while it stays missing.
+ ***********************************************************/
+SceneSnapshot::SOURCE_STAMP SceneSnapshot::StampFile(const std::string& filename)
+{
+	SOURCE_STAMP stamp;
+	memset(&stamp, 0, sizeof(stamp));
+	strncpy(stamp.filename, filename.c_str(), sizeof(stamp.filename) - 1);
+
+	std::error_code error;
+	uintmax_t size = std::filesystem::file_size(filename, error);
+	if (!error)
+	{
+		stamp.size = (uint64_t)size;
+		std::filesystem::file_time_type modified = std::filesystem::last_write_time(filename, error);
+		if (!error)
+		{
+			stamp.modified = (int64_t)modified.time_since_epoch().count();
+		}
+	}
+	return stamp;
+}
+
+/***********************************************************
+ *  AddSource()
+ *
+ *  This method is used for recording a file the snapshot was
+ *  built from, as it is now.
+ ***********************************************************/
+void SceneSnapshot::AddSource(const std::string& filename)
+{
+	m_sources.push_back(StampFile(filename));
+}
+
+/***********************************************************
+ *  AddSection()
+ *
+ *  This method is used for copying a block of data into the
+ *  snapshot being written.
+ ***********************************************************/
+void SceneSnapshot::AddSection(uint32_t id, const void* data, size_t size)
+{
+	SECTION section;
+	section.id = id;
+	if (size > 0)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		section.bytes.assign(bytes, bytes + size);
+	}
+	m_sections.push_back(std::move(section));
+}
+
+/***********************************************************
+ *  Write()
+ *
+ *  This method is used for writing the snapshot. It goes to
+ *  a temporary file that replaces the old snapshot once it
+ *  is complete, so a crash part way through never leaves a
+ *  half written snapshot behind.
+ ***********************************************************/
+bool SceneSnapshot::Write(const std::string& filename, uint32_t contentVersion) const
+{
+	// the source stamps go first, as a section like any other
+	std::vector<const SECTION*> sections;
+	SECTION sources;
+	sources.id = SNAPSHOT_SOURCES;
+	sources.bytes.resize(m_sources.size() * sizeof(SOURCE_STAMP));
+	if (!m_sources.empty())
+	{
+		memcpy(sources.bytes.data(), m_sources.data(), sources.bytes.size());
+	}
+	sections.push_back(&sources);
+	for (const SECTION& section : m_sections)
+	{
+		sections.push_back(&section);
+	}
+
+	FILE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.formatVersion = SNAPSHOT_FORMAT_VERSION;
+	header.contentVersion = contentVersion;
+	header.sectionCount = (uint32_t)sections.size();
+	header.pointerSize = (uint32_t)sizeof(void*);
+
+	std::vector<SECTION_ENTRY> table(sections.size());
+	uint64_t offset = AlignOffset(sizeof(FILE_HEADER) + table.size() * sizeof(SECTION_ENTRY));
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		table[i].id = sections[i]->id;
+		table[i].pad = 0;
+		table[i].offset = offset;
+		table[i].size = sections[i]->bytes.size();
+		offset = AlignOffset(offset + table[i].size);
+	}
+	header.fileSize = offset;
+
+	std::string temporary = filename + ".tmp";
+	std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "[SceneSnapshot] Could not create " << temporary << std::endl;
+		return false;
+	}
+
+	const char padding[SECTION_ALIGNMENT] = {};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(SECTION_ENTRY));
+	uint64_t written = sizeof(header) + table.size() * sizeof(SECTION_ENTRY);
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		file.write(padding, (std::streamsize)(table[i].offset - written));
+		file.write(reinterpret_cast<const char*>(sections[i]->bytes.data()), (std::streamsize)table[i].size);
+		written = table[i].offset + table[i].size;
+	}
+	file.write(padding, (std::streamsize)(header.fileSize - written));
+	file.close();
+	if (file.fail())
+	{
+		std::cout << "[SceneSnapshot] Could not write " << temporary << std::endl;
+		std::filesystem::remove(temporary);
+		return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporary, filename, error);
+	if (error)
+	{
+		std::cout << "[SceneSnapshot] Could not replace " << filename << ": " << error.message() << std::endl;
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+
+	std::cout << "[SceneSnapshot] Wrote " << filename << ", " << sections.size()
+		<< " sections, " << (header.fileSize >> 10) << " KB" << std::endl;
+	return true;
+}
+
+/***********************************************************
+ *  MapFile()
+ *
+ *  This method is used for mapping the whole file read only.
+ *  Pages are only read from disk as the sections are used.
+ ***********************************************************/
+bool SceneSnapshot::MapFile(const std::string& filename)
+{
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (INVALID_HANDLE_VALUE == file)
+	{
+		return false;
+	}
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	if (GetFileSizeEx(file, &size) && (size.QuadPart > 0))
+	{
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	}
+	void* view = (NULL != mapping) ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (NULL == view)
+	{
+		if (NULL != mapping)
+		{
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+		return false;
+	}
+	m_hFile = file;
+	m_hMapping = mapping;
+	m_pData = static_cast<const unsigned char*>(view);
+	m_size = (size_t)size.QuadPart;
+	return true;
+#elif defined(__unix__) || defined(__APPLE__)
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat status;
+	void* view = MAP_FAILED;
+	if ((fstat(fd, &status) == 0) && (status.st_size > 0))
+	{
+		view = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	// the mapping keeps the file open on its own
+	close(fd);
+	if (MAP_FAILED == view)
+	{
+		return false;
+	}
+	m_pData = static_cast<const unsigned char*>(view);
+	m_size = (size_t)status.st_size;
+	return true;
+#else
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	m_fileBytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	if (m_fileBytes.empty())
+	{
+		return false;
+	}
+	m_pData = m_fileBytes.data();
+	m_size = m_fileBytes.size();
+	return true;
+#endif
+}
+
+/***********************************************************
+ *  UnmapFile()
+ *
+ *  This method is used for releasing the mapping.
+ ***********************************************************/
+void SceneSnapshot::UnmapFile()
+{
+	if (NULL == m_pData)
+	{
+		return;
+	}
+#if defined(_WIN32)
+	UnmapViewOfFile(m_pData);
+	CloseHandle((HANDLE)m_hMapping);
+	CloseHandle((HANDLE)m_hFile);
+#elif defined(__unix__) || defined(__APPLE__)
+	munmap(const_cast<unsigned char*>(m_pData), m_size);
+#else
+	m_fileBytes.clear();
+	m_fileBytes.shrink_to_fit();
+#endif
+	m_pData = NULL;
+	m_size = 0;
+	m_hFile = NULL;
+	m_hMapping = NULL;
+}
+
+/***********************************************************
+ *  IsValid()
+ *
+ *  This method is used for checking the mapped file is a
+ *  complete snapshot in this build's layout, of the expected
+ *  content, with every section inside the file, and built
+ *  from source files that have not changed since.
+ ***********************************************************/
+bool SceneSnapshot::IsValid(uint32_t contentVersion) const
+{
+	if (m_size < sizeof(FILE_HEADER))
+	{
+		return false;
+	}
+	const FILE_HEADER* pHeader = reinterpret_cast<const FILE_HEADER*>(m_pData);
+	if ((memcmp(pHeader->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) ||
+		(pHeader->formatVersion != SNAPSHOT_FORMAT_VERSION) ||
+		(pHeader->contentVersion != contentVersion) ||
+		(pHeader->pointerSize != (uint32_t)sizeof(void*)) ||
+		(pHeader->fileSize != (uint64_t)m_size))
+	{
+		std::cout << "[SceneSnapshot] Snapshot is from another version or incomplete" << std::endl;
+		return false;
+	}
+
+	uint64_t tableEnd = sizeof(FILE_HEADER) + (uint64_t)pHeader->sectionCount * sizeof(SECTION_ENTRY);
+	if (tableEnd > m_size)
+	{
+		return false;
+	}
+	const SECTION_ENTRY* table = reinterpret_cast<const SECTION_ENTRY*>(m_pData + sizeof(FILE_HEADER));
+	for (uint32_t i = 0; i < pHeader->sectionCount; i++)
+	{
+		if ((table[i].offset < tableEnd) || (table[i].offset % SECTION_ALIGNMENT != 0) ||
+			(table[i].size > m_size - table[i].offset))
+		{
+			return false;
+		}
+	}
+
+	size_t count = 0;
+	const SOURCE_STAMP* sources = GetArray<SOURCE_STAMP>(SNAPSHOT_SOURCES, count);
+	if (NULL == sources)
+	{
+		return false;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		std::string filename(sources[i].filename, strnlen(sources[i].filename, sizeof(sources[i].filename)));
+		SOURCE_STAMP current = StampFile(filename);
+		if ((current.size != sources[i].size) || (current.modified != sources[i].modified))
+		{
+			std::cout << "[SceneSnapshot] " << filename << " has changed since the snapshot" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for mapping a snapshot to read. It is
+ *  closed again unless it is current.
+ ***********************************************************/
+bool SceneSnapshot::Open(const std::string& filename, uint32_t contentVersion)
+{
+	Close();
+	if (!MapFile(filename))
+	{
+		return false;
+	}
+	if (!IsValid(contentVersion))
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for unmapping the snapshot.
+ ***********************************************************/
+void SceneSnapshot::Close()
+{
+	UnmapFile();
+}
+
+/***********************************************************
+ *  Prefetch()
+ *
+ *  This method is used for touching every page of the open
+ *  snapshot, so the reads from the drive happen on the
+ *  calling thread - a loader worker - rather than as page
+ *  faults on the GL thread wherever a section is first used.
+ ***********************************************************/
+void SceneSnapshot::Prefetch() const
+{
+	const size_t pageSize = 4096;
+	unsigned char sum = 0;
+	for (size_t offset = 0; offset < m_size; offset += pageSize)
+	{
+		sum = (unsigned char)(sum + ((const volatile unsigned char*)m_pData)[offset]);
+	}
+	(void)sum;
+}
+
+/***********************************************************
+ *  GetSection()
+ *
+ *  This method is used for finding a section of the open
+ *  snapshot. The table is short, so it is simply searched.
+ ***********************************************************/
+const unsigned char* SceneSnapshot::GetSection(uint32_t id, size_t& size) const
+{
+	size = 0;
+	if (NULL == m_pData)
+	{
+		return NULL;
+	}
+	const FILE_HEADER* pHeader = reinterpret_cast<const FILE_HEADER*>(m_pData);
+	const SECTION_ENTRY* table = reinterpret_cast<const SECTION_ENTRY*>(m_pData + sizeof(FILE_HEADER));
+	for (uint32_t i = 0; i < pHeader->sectionCount; i++)
+	{
+		if (table[i].id == id)
+		{
+			size = (size_t)table[i].size;
+			return m_pData + table[i].offset;
+		}
+	}
+	return NULL;
+}
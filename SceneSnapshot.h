@@ -0,0 +1,154 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenesnapshot.h
+// ============
+// one relocatable file holding the prepared scene, mapped on later launches
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  SNAPSHOT_SECTION
+ *
+ *  The blocks of data a snapshot holds. Each system writes
+ *  and reads back its own sections; the snapshot only keeps
+ *  them aligned and finds them again.
+ ***********************************************************/
+enum SNAPSHOT_SECTION
+{
+	// stamps of the files the snapshot was built from
+	SNAPSHOT_SOURCES = 1,
+	// scene textures, their levels, and the level data
+	SNAPSHOT_TEXTURES,
+	SNAPSHOT_TEXTURE_LEVELS,
+	SNAPSHOT_TEXTURE_DATA,
+	// material and point light tables
+	SNAPSHOT_MATERIALS,
+	SNAPSHOT_LIGHTS,
+	// GPU culler geometry, draw buckets, instances and the transforms
+	// of the instance groups
+	SNAPSHOT_CULLER_VERTICES,
+	SNAPSHOT_CULLER_INDICES,
+	SNAPSHOT_CULLER_MESHES,
+	SNAPSHOT_CULLER_BOUNDS,
+	SNAPSHOT_CULLER_BUCKETS,
+	SNAPSHOT_CULLER_INSTANCES,
+	SNAPSHOT_CULLER_GROUPS,
+	// linked program binaries and their data
+	SNAPSHOT_PROGRAMS,
+	SNAPSHOT_PROGRAM_DATA,
+	// baked lightmap: its size, the lightmapped geometry and objects,
+	// and the compressed texels
+	SNAPSHOT_LIGHTMAP_INFO,
+	SNAPSHOT_LIGHTMAP_VERTICES,
+	SNAPSHOT_LIGHTMAP_INDICES,
+	SNAPSHOT_LIGHTMAP_OBJECTS,
+	SNAPSHOT_LIGHTMAP_BLOCKS
+};
+
+/***********************************************************
+ *  SceneSnapshot
+ *
+ *  This class writes and reads a scene snapshot: a header, a
+ *  table of sections, then each section's bytes on a 64 byte
+ *  boundary. Every offset is from the start of the file and
+ *  nothing holds a pointer, so the file is used exactly where
+ *  it is mapped, with no parsing or fix ups. The data is in
+ *  the native layout of the build that wrote it; the format
+ *  version, the caller's content version and the stamps of
+ *  the source files all have to match for Open() to accept
+ *  the file, otherwise it is simply rebuilt.
+ ***********************************************************/
+class SceneSnapshot
+{
+public:
+	// constructor
+	SceneSnapshot();
+	// destructor - unmaps the file
+	~SceneSnapshot();
+
+	// record a file the snapshot depends on; changing it invalidates
+	// the snapshot
+	void AddSource(const std::string& filename);
+	// copy a block of data into the snapshot being written
+	void AddSection(uint32_t id, const void* data, size_t size);
+	template<typename T>
+	void AddArray(uint32_t id, const std::vector<T>& items)
+	{
+		AddSection(id, items.data(), items.size() * sizeof(T));
+	}
+	// write the header, section table and sections, replacing the file
+	// only once it is complete
+	bool Write(const std::string& filename, uint32_t contentVersion) const;
+
+	// map a snapshot and check it is current; false leaves it closed
+	bool Open(const std::string& filename, uint32_t contentVersion);
+	// unmap the file; sections read from it are no longer valid
+	void Close();
+	bool IsOpen() const { return NULL != m_pData; }
+	// read every page of the open snapshot now, on the calling thread
+	void Prefetch() const;
+
+	// a section of the open snapshot, NULL when it is missing
+	const unsigned char* GetSection(uint32_t id, size_t& size) const;
+	// a section as an array of T, pointing into the mapping; NULL when
+	// it is missing or is not a whole number of T
+	template<typename T>
+	const T* GetArray(uint32_t id, size_t& count) const
+	{
+		size_t size = 0;
+		const unsigned char* data = GetSection(id, size);
+		count = 0;
+		if ((NULL == data) || (size % sizeof(T) != 0))
+		{
+			return NULL;
+		}
+		count = size / sizeof(T);
+		return reinterpret_cast<const T*>(data);
+	}
+	// a section copied into a vector; false when it is missing
+	template<typename T>
+	bool CopyArray(uint32_t id, std::vector<T>& items) const
+	{
+		size_t count = 0;
+		const T* data = GetArray<T>(id, count);
+		items.assign(data, data + count);
+		return NULL != data;
+	}
+
+private:
+	struct SECTION
+	{
+		uint32_t id;
+		std::vector<unsigned char> bytes;
+	};
+	// size and modification time of a source file, when it was added
+	struct SOURCE_STAMP
+	{
+		char filename[112];
+		uint64_t size;
+		int64_t modified;
+	};
+
+	// sections and sources waiting to be written
+	std::vector<SECTION> m_sections;
+	std::vector<SOURCE_STAMP> m_sources;
+	// the mapped file being read
+	const unsigned char* m_pData;
+	size_t m_size;
+	// platform handles of the mapping
+	void* m_hFile;
+	void* m_hMapping;
+	// file contents, where files cannot be mapped
+	std::vector<unsigned char> m_fileBytes;
+
+	static SOURCE_STAMP StampFile(const std::string& filename);
+	bool MapFile(const std::string& filename);
+	void UnmapFile();
+	bool IsValid(uint32_t contentVersion) const;
+};
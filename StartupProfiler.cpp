@@ -0,0 +1,425 @@
+///////////////////////////////////////////////////////////////////////////////
+// startupprofiler.cpp
+// ============
+// timestamps the startup phases and writes them out as JSON
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StartupProfiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// timings of each phase or event name across the runs of a benchmark
+	typedef std::map<std::string, std::vector<double>> SAMPLES;
+
+	std::string EscapeJSON(const std::string& text)
+	{
+		std::string escaped;
+		for (char c : text)
+		{
+			if ((c == '"') || (c == '\\'))
+			{
+				escaped += '\\';
+			}
+			escaped += ((unsigned char)c < 0x20) ? ' ' : c;
+		}
+		return escaped;
+	}
+
+	// the string after "key": on a line written by WriteJSON()
+	bool ReadString(const std::string& line, const char* key, std::string& value)
+	{
+		std::string pattern = std::string("\"") + key + "\": \"";
+		size_t start = line.find(pattern);
+		if (start == std::string::npos)
+		{
+			return false;
+		}
+		value.clear();
+		for (size_t i = start + pattern.size(); i < line.size(); i++)
+		{
+			if (line[i] == '"')
+			{
+				return true;
+			}
+			if ((line[i] == '\\') && (i + 1 < line.size()))
+			{
+				i++;
+			}
+			value += line[i];
+		}
+		return false;
+	}
+
+	// the number after "key": on a line written by WriteJSON()
+	bool ReadNumber(const std::string& line, const char* key, double& value)
+	{
+		std::string pattern = std::string("\"") + key + "\": ";
+		size_t start = line.find(pattern);
+		if (start == std::string::npos)
+		{
+			return false;
+		}
+		value = atof(line.c_str() + start + pattern.size());
+		return true;
+	}
+
+	/***********************************************************
+	 *  ReadProfile()
+	 *
+	 *  Read back a profile written by WriteJSON(), which puts
+	 *  each phase and event on a line of its own, adding its
+	 *  timings to the samples. The text is kept to copy into
+	 *  the benchmark output as it is.
+	 ***********************************************************/
+	bool ReadProfile(
+		const std::string& filename,
+		SAMPLES& phases,
+		SAMPLES& events,
+		std::string& text)
+	{
+		std::ifstream file(filename);
+		if (!file.is_open())
+		{
+			return false;
+		}
+		std::stringstream stream;
+		stream << file.rdbuf();
+		text = stream.str();
+
+		std::istringstream lines(text);
+		std::string line;
+		while (std::getline(lines, line))
+		{
+			std::string name;
+			double value = 0.0;
+			if (!ReadString(line, "name", name))
+			{
+				continue;
+			}
+			if (ReadNumber(line, "duration_ms", value))
+			{
+				phases[name].push_back(value);
+			}
+			else if (ReadNumber(line, "time_ms", value))
+			{
+				events[name].push_back(value);
+			}
+		}
+		return true;
+	}
+
+	void WriteSummary(std::ostream& output, const char* key, const SAMPLES& samples)
+	{
+		output << "    \"" << key << "\": [";
+		bool bFirst = true;
+		for (const auto& entry : samples)
+		{
+			const std::vector<double>& values = entry.second;
+			double total = 0.0;
+			for (double value : values)
+			{
+				total += value;
+			}
+			output << (bFirst ? "\n" : ",\n")
+				<< "      {\"name\": \"" << EscapeJSON(entry.first) << "\""
+				<< ", \"runs\": " << values.size()
+				<< ", \"mean_ms\": " << total / values.size()
+				<< ", \"min_ms\": " << *std::min_element(values.begin(), values.end())
+				<< ", \"max_ms\": " << *std::max_element(values.begin(), values.end()) << "}";
+			bFirst = false;
+		}
+		output << "\n    ]";
+	}
+}
+
+/***********************************************************
+ *  StartupProfiler()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+StartupProfiler::StartupProfiler()
+{
+	m_launchTime = std::chrono::steady_clock::now();
+}
+
+/***********************************************************
+ *  GetElapsedMs()
+ *
+ *  This method is used for reading the time since launch.
+ ***********************************************************/
+double StartupProfiler::GetElapsedMs() const
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_launchTime).count();
+}
+
+/***********************************************************
+ *  BeginPhase()
+ *
+ *  This method is used for starting a phase, nested in the
+ *  phase that is open.
+ ***********************************************************/
+void StartupProfiler::BeginPhase(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	STARTUP_PHASE phase;
+	phase.name = name;
+	phase.depth = (int)m_openPhases.size();
+	phase.startMs = GetElapsedMs();
+	m_openPhases.push_back(m_phases.size());
+	m_phases.push_back(phase);
+}
+
+/***********************************************************
+ *  EndPhase()
+ *
+ *  This method is used for ending the innermost open phase.
+ ***********************************************************/
+void StartupProfiler::EndPhase()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_openPhases.empty())
+	{
+		return;
+	}
+	STARTUP_PHASE& phase = m_phases[m_openPhases.back()];
+	phase.durationMs = GetElapsedMs() - phase.startMs;
+	m_openPhases.pop_back();
+}
+
+/***********************************************************
+ *  Mark()
+ *
+ *  This method is used for recording the first time an event
+ *  happens.
+ ***********************************************************/
+void StartupProfiler::Mark(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (const STARTUP_EVENT& event : m_events)
+	{
+		if (event.name == name)
+		{
+			return;
+		}
+	}
+	STARTUP_EVENT event;
+	event.name = name;
+	event.timeMs = GetElapsedMs();
+	m_events.push_back(event);
+}
+
+/***********************************************************
+ *  HasEvent()
+ *
+ *  This method is used for checking whether an event has
+ *  been marked.
+ ***********************************************************/
+bool StartupProfiler::HasEvent(const std::string& name) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (const STARTUP_EVENT& event : m_events)
+	{
+		if (event.name == name)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/***********************************************************
+ *  WriteJSON()
+ *
+ *  This method is used for writing the phases, in the order
+ *  they began, and the events, in the order they happened.
+ *  Phases still open are written with the time so far.
+ ***********************************************************/
+bool StartupProfiler::WriteJSON(const char* filename) const
+{
+	std::ofstream output(filename);
+	if (!output)
+	{
+		std::cerr << "ERROR: Could not write " << filename << std::endl;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	double nowMs = GetElapsedMs();
+	output << "{\n  \"phases\": [";
+	for (size_t i = 0; i < m_phases.size(); i++)
+	{
+		const STARTUP_PHASE& phase = m_phases[i];
+		bool bOpen = std::find(m_openPhases.begin(), m_openPhases.end(), i) != m_openPhases.end();
+		output << ((i == 0) ? "\n" : ",\n")
+			<< "    {\"name\": \"" << EscapeJSON(phase.name) << "\""
+			<< ", \"depth\": " << phase.depth
+			<< ", \"start_ms\": " << phase.startMs
+			<< ", \"duration_ms\": " << (bOpen ? nowMs - phase.startMs : phase.durationMs) << "}";
+	}
+	output << "\n  ],\n  \"events\": [";
+	for (size_t i = 0; i < m_events.size(); i++)
+	{
+		output << ((i == 0) ? "\n" : ",\n")
+			<< "    {\"name\": \"" << EscapeJSON(m_events[i].name) << "\""
+			<< ", \"time_ms\": " << m_events[i].timeMs << "}";
+	}
+	output << "\n  ]\n}\n";
+	return true;
+}
+
+/***********************************************************
+ *  EvictFromPageCache()
+ *
+ *  This method is used for making the next read of the files
+ *  come from the drive. Linux is asked to drop their cached
+ *  pages; on Windows, opening a file without buffering
+ *  flushes it from the cache. Elsewhere nothing is dropped,
+ *  and cold runs are no colder than warm ones.
+ ***********************************************************/
+void StartupProfiler::EvictFromPageCache(const std::vector<std::string>& paths)
+{
+	std::vector<std::string> files;
+	for (const std::string& path : paths)
+	{
+		std::error_code error;
+		if (std::filesystem::is_directory(path, error))
+		{
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(path, error))
+			{
+				if (entry.is_regular_file(error))
+				{
+					files.push_back(entry.path().string());
+				}
+			}
+		}
+		else if (std::filesystem::is_regular_file(path, error))
+		{
+			files.push_back(path);
+		}
+	}
+
+	for (const std::string& filename : files)
+	{
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+			OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, NULL);
+		if (INVALID_HANDLE_VALUE != file)
+		{
+			CloseHandle(file);
+		}
+#elif defined(__linux__)
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd >= 0)
+		{
+			fdatasync(fd);
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			close(fd);
+		}
+#endif
+	}
+
+#if !defined(_WIN32) && !defined(__linux__)
+	std::cout << "[StartupProfiler] WARNING: Cannot evict files here; cold runs use the page cache" << std::endl;
+#endif
+}
+
+/***********************************************************
+ *  RunBenchmark()
+ *
+ *  This method is used for timing startup over many runs.
+ *  Cold runs evict the assets first. Warm runs follow one
+ *  untimed run that fills the cache - and writes the scene
+ *  snapshot, when that is enabled, so warm runs restore it.
+ ***********************************************************/
+bool StartupProfiler::RunBenchmark(
+	const std::string& command,
+	const std::string& profileFile,
+	int runs,
+	const std::vector<std::string>& evictPaths,
+	const char* outputFile)
+{
+	std::ofstream output(outputFile);
+	if (!output)
+	{
+		std::cerr << "ERROR: Could not write " << outputFile << std::endl;
+		return false;
+	}
+	output << "{\n  \"runs\": " << runs;
+
+	const char* modes[2] = { "cold", "warm" };
+	for (int mode = 0; mode < 2; mode++)
+	{
+		bool bCold = (mode == 0);
+		if (!bCold)
+		{
+			std::remove(profileFile.c_str());
+			std::system(command.c_str());
+		}
+
+		SAMPLES phases;
+		SAMPLES events;
+		std::vector<std::string> profiles;
+		for (int run = 0; run < runs; run++)
+		{
+			if (bCold)
+			{
+				EvictFromPageCache(evictPaths);
+			}
+			std::remove(profileFile.c_str());
+			int result = std::system(command.c_str());
+
+			std::string text;
+			if ((result != 0) || !ReadProfile(profileFile, phases, events, text))
+			{
+				std::cerr << "ERROR: " << modes[mode] << " run " << run << " failed" << std::endl;
+				continue;
+			}
+			profiles.push_back(text);
+			std::cout << "INFO: " << modes[mode] << " run " << run << " done" << std::endl;
+		}
+		std::remove(profileFile.c_str());
+
+		output << ",\n  \"" << modes[mode] << "\": {\n    \"profiles\": [";
+		for (size_t i = 0; i < profiles.size(); i++)
+		{
+			// indent the profile to sit inside the array
+			std::string indented = "      ";
+			for (char c : profiles[i].substr(0, profiles[i].find_last_not_of("\r\n") + 1))
+			{
+				indented += c;
+				if (c == '\n')
+				{
+					indented += "      ";
+				}
+			}
+			output << ((i == 0) ? "\n" : ",\n") << indented;
+		}
+		output << "\n    ],\n";
+		WriteSummary(output, "phases", phases);
+		output << ",\n";
+		WriteSummary(output, "events", events);
+		output << "\n  }";
+	}
+	output << "\n}\n";
+
+	return true;
+}
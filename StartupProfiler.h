@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////
+// startupprofiler.h
+// ============
+// timestamps the startup phases and writes them out as JSON
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  STARTUP_PHASE
+ *
+ *  One timed phase of startup, in milliseconds from launch.
+ *  Phases nest; depth is 0 for the outermost ones.
+ ***********************************************************/
+struct STARTUP_PHASE
+{
+	std::string name;
+	int depth = 0;
+	double startMs = 0.0;
+	double durationMs = 0.0;
+};
+
+/***********************************************************
+ *  STARTUP_EVENT
+ *
+ *  A moment during startup, such as the first frame being
+ *  presented, in milliseconds from launch.
+ ***********************************************************/
+struct STARTUP_EVENT
+{
+	std::string name;
+	double timeMs = 0.0;
+};
+
+/***********************************************************
+ *  StartupProfiler
+ *
+ *  This class records nested phases and single events from
+ *  the moment it is created, which main() does first thing.
+ *  Events may be marked from any thread; phases are begun
+ *  and ended on the main thread. RunBenchmark() launches the
+ *  program repeatedly in profiling mode, with the assets
+ *  evicted from the page cache before each cold run, and
+ *  summarises the runs.
+ ***********************************************************/
+class StartupProfiler
+{
+public:
+	// constructor - launch time is now
+	StartupProfiler();
+
+	// milliseconds since launch
+	double GetElapsedMs() const;
+
+	// start a phase inside the current one
+	void BeginPhase(const std::string& name);
+	// end the most recently begun phase
+	void EndPhase();
+	// record an event, once; later marks of the same name are ignored
+	void Mark(const std::string& name);
+	// true once the named event has been marked
+	bool HasEvent(const std::string& name) const;
+
+	// write the phases and events as one JSON object
+	bool WriteJSON(const char* filename) const;
+
+	// run command (which must write its profile to profileFile) runs
+	// times cold and runs times warm, and write every profile with a
+	// summary of each phase and event to outputFile
+	static bool RunBenchmark(
+		const std::string& command,
+		const std::string& profileFile,
+		int runs,
+		const std::vector<std::string>& evictPaths,
+		const char* outputFile);
+
+	// drop the files, and every file below the directories, from the
+	// page cache so the next read comes from the drive
+	static void EvictFromPageCache(const std::vector<std::string>& paths);
+
+private:
+	std::chrono::steady_clock::time_point m_launchTime;
+	mutable std::mutex m_mutex;
+	std::vector<STARTUP_PHASE> m_phases;
+	std::vector<size_t> m_openPhases;
+	std::vector<STARTUP_EVENT> m_events;
+};
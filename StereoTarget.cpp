@@ -0,0 +1,306 @@
+///////////////////////////////////////////////////////////////////////////////
+// stereotarget.cpp
+// ============
+// two layer render target and eye matrices for single pass stereo
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StereoTarget.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+	// after the 16 scene texture units
+	const GLint STEREO_TEXTURE_UNIT = 16;
+	const int EYE_COUNT = 2;
+}
+
+/***********************************************************
+ *  StereoTarget()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+StereoTarget::StereoTarget()
+{
+	m_mode = STEREO_NONE;
+	m_eyeWidth = 0;
+	m_eyeHeight = 0;
+	m_colorTexture = 0;
+	m_depthTexture = 0;
+	m_framebuffer = 0;
+	m_eyeBuffer = 0;
+	m_pPresentShader = NULL;
+	m_emptyVAO = 0;
+	m_previousFramebuffer = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		m_previousViewport[i] = 0;
+	}
+}
+
+/***********************************************************
+ *  ~StereoTarget()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+StereoTarget::~StereoTarget()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for releasing the layers, buffers and
+ *  shader.
+ ***********************************************************/
+void StereoTarget::Destroy()
+{
+	if (m_emptyVAO != 0)
+	{
+		glDeleteVertexArrays(1, &m_emptyVAO);
+		m_emptyVAO = 0;
+	}
+	if (m_eyeBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_eyeBuffer);
+		m_eyeBuffer = 0;
+	}
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	if (m_depthTexture != 0)
+	{
+		glDeleteTextures(1, &m_depthTexture);
+		m_depthTexture = 0;
+	}
+	if (m_colorTexture != 0)
+	{
+		glDeleteTextures(1, &m_colorTexture);
+		m_colorTexture = 0;
+	}
+	delete m_pPresentShader;
+	m_pPresentShader = NULL;
+	m_mode = STEREO_NONE;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for choosing how draws reach both
+ *  eyes - multiview where the driver has it, otherwise
+ *  doubled instances writing gl_Layer from the vertex
+ *  shader - and creating the layered target for it.
+ ***********************************************************/
+bool StereoTarget::Initialize(int eyeWidth, int eyeHeight)
+{
+	Destroy();
+	if (GLEW_OVR_multiview)
+	{
+		m_mode = STEREO_MULTIVIEW;
+	}
+	else if (GLEW_ARB_shader_viewport_layer_array || GLEW_AMD_vertex_shader_layer)
+	{
+		m_mode = STEREO_INSTANCED;
+	}
+	else
+	{
+		std::cout << "[StereoTarget] Neither multiview nor vertex shader layer output is supported; "
+			<< "drawing in mono" << std::endl;
+		return false;
+	}
+	m_eyeWidth = std::max(eyeWidth, 1);
+	m_eyeHeight = std::max(eyeHeight, 1);
+
+	glGenTextures(1, &m_colorTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_colorTexture);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, m_eyeWidth, m_eyeHeight, EYE_COUNT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glGenTextures(1, &m_depthTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_depthTexture);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT24, m_eyeWidth, m_eyeHeight, EYE_COUNT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+	if (m_mode == STEREO_MULTIVIEW)
+	{
+		glFramebufferTextureMultiviewOVR(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_colorTexture, 0, 0, EYE_COUNT);
+		glFramebufferTextureMultiviewOVR(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTexture, 0, 0, EYE_COUNT);
+	}
+	else
+	{
+		// layered attachments, so gl_Layer picks the eye
+		glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_colorTexture, 0);
+		glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTexture, 0);
+	}
+	GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebuffer);
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "[StereoTarget] ERROR: Layered framebuffer incomplete" << std::endl;
+		Destroy();
+		return false;
+	}
+
+	glGenBuffers(1, &m_eyeBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_eyeBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(EYE_BLOCK), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glGenVertexArrays(1, &m_emptyVAO);
+	m_pPresentShader = new ShaderManager();
+	m_pPresentShader->LoadShaders(
+		"shaders/stereoPresentVertexShader.glsl",
+		"shaders/stereoPresentFragmentShader.glsl");
+
+	std::cout << "[StereoTarget] " << m_eyeWidth << "x" << m_eyeHeight << " per eye, "
+		<< ((m_mode == STEREO_MULTIVIEW) ? "multiview" : "instanced") << std::endl;
+	return true;
+}
+
+/***********************************************************
+ *  MakeEyes()
+ *
+ *  This method is used for placing the eyes half the
+ *  separation either side of the camera, looking the same
+ *  way. Their frustums are enclosed by one with the same
+ *  field of view from a point behind the camera, far enough
+ *  back that its sides pass outside both eyes, so culling
+ *  against it once keeps everything either eye can see.
+ ***********************************************************/
+void StereoTarget::MakeEyes(
+	const VIEW_INFO& center,
+	float eyeSeparation,
+	VIEW_INFO eyes[2],
+	VIEW_INFO& cullView) const
+{
+	// near and far planes of the camera's perspective projection
+	const glm::mat4& projection = center.projection;
+	float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+	float farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+	float aspect = (float)std::max(m_eyeWidth, 1) / (float)std::max(m_eyeHeight, 1);
+	glm::mat4 eyeProjection = glm::perspective(center.fovY, aspect, nearPlane, farPlane);
+
+	const float halfSeparation = 0.5f * eyeSeparation;
+	glm::vec3 right(center.view[0][0], center.view[1][0], center.view[2][0]);
+	glm::vec3 back(center.view[0][2], center.view[1][2], center.view[2][2]);
+	for (int eye = 0; eye < EYE_COUNT; eye++)
+	{
+		// the left eye first, the order of the layers
+		float offset = (eye == 0) ? -halfSeparation : halfSeparation;
+		eyes[eye] = center;
+		eyes[eye].view = glm::translate(glm::vec3(-offset, 0.0f, 0.0f)) * center.view;
+		eyes[eye].projection = eyeProjection;
+		eyes[eye].position = center.position + right * offset;
+		eyes[eye].viewportWidth = (float)m_eyeWidth;
+		eyes[eye].viewportHeight = (float)m_eyeHeight;
+	}
+
+	float setback = halfSeparation / (std::tan(0.5f * center.fovY) * aspect);
+	cullView = eyes[0];
+	cullView.view = glm::translate(glm::vec3(0.0f, 0.0f, -setback)) * center.view;
+	cullView.projection = glm::perspective(center.fovY, aspect, nearPlane, farPlane + setback);
+	cullView.position = center.position + back * setback;
+}
+
+/***********************************************************
+ *  Begin()
+ *
+ *  This method is used for pointing the drawing at both
+ *  layers and binding the eyes' matrices for the stereo
+ *  shaders.
+ ***********************************************************/
+void StereoTarget::Begin(const VIEW_INFO eyes[2])
+{
+	if (m_mode == STEREO_NONE)
+	{
+		return;
+	}
+
+	EYE_BLOCK block;
+	for (int eye = 0; eye < EYE_COUNT; eye++)
+	{
+		block.view[eye] = eyes[eye].view;
+		block.projection[eye] = eyes[eye].projection;
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, m_eyeBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(EYE_BLOCK), &block);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, EYE_BLOCK_BINDING, m_eyeBuffer);
+
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_previousViewport);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_eyeWidth, m_eyeHeight);
+	// cleared as the window is
+	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void StereoTarget::End()
+{
+	if (m_mode == STEREO_NONE)
+	{
+		return;
+	}
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_previousFramebuffer);
+	glViewport(m_previousViewport[0], m_previousViewport[1], m_previousViewport[2], m_previousViewport[3]);
+}
+
+/***********************************************************
+ *  Present()
+ *
+ *  This method is used for drawing each eye's layer over its
+ *  half of the rectangle, the left eye on the left.
+ ***********************************************************/
+void StereoTarget::Present(int x, int y, int width, int height)
+{
+	if (m_mode == STEREO_NONE)
+	{
+		return;
+	}
+
+	GLint previousProgram = 0;
+	GLint previousViewport[4];
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+	GLboolean bDepthTest = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
+
+	m_pPresentShader->use();
+	m_pPresentShader->setIntValue("eyeLayers", STEREO_TEXTURE_UNIT);
+	glActiveTexture(GL_TEXTURE0 + STEREO_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_colorTexture);
+	glBindVertexArray(m_emptyVAO);
+
+	int halfWidth = width / 2;
+	for (int eye = 0; eye < EYE_COUNT; eye++)
+	{
+		glViewport(x + eye * halfWidth, y, (eye == 0) ? halfWidth : width - halfWidth, height);
+		m_pPresentShader->setIntValue("eye", eye);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	glActiveTexture(GL_TEXTURE0);
+	if (bDepthTest)
+	{
+		glEnable(GL_DEPTH_TEST);
+	}
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+	glUseProgram(previousProgram);
+}
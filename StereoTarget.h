@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////////////////////////////
+// stereotarget.h
+// ============
+// two layer render target and eye matrices for single pass stereo
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "ViewManager.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  STEREO_MODE
+ *
+ *  How a single draw reaches both eyes.
+ ***********************************************************/
+enum STEREO_MODE
+{
+	// neither way is supported; nothing is drawn in stereo
+	STEREO_NONE,
+	// GL_OVR_multiview: the driver runs the vertex shader once per
+	// layer of the target, with gl_ViewID_OVR naming the eye
+	STEREO_MULTIVIEW,
+	// every instance is drawn twice, the eye being the low bit of
+	// gl_InstanceID, and the vertex shader writes gl_Layer
+	STEREO_INSTANCED
+};
+
+/***********************************************************
+ *  StereoTarget
+ *
+ *  This class holds what single pass stereo needs outside the
+ *  drawing code: a colour and depth texture array with a
+ *  layer per eye, a uniform block holding both eyes' view
+ *  and projection matrices, and the choice of how the
+ *  shaders fan a draw out to both layers. The scene is culled
+ *  once against a frustum enclosing both eyes and submitted
+ *  once, so stereo costs the CPU what mono does; Present()
+ *  then copies the layers side by side into the window.
+ ***********************************************************/
+class StereoTarget
+{
+public:
+	// uniform block binding of the eye matrices, see StereoEyes in the
+	// stereo vertex shaders
+	static const GLuint EYE_BLOCK_BINDING = 1;
+
+	// constructor
+	StereoTarget();
+	// destructor
+	~StereoTarget();
+
+	// choose the mode and create the layers at the size of one eye;
+	// false if stereo is not supported or the target is incomplete
+	bool Initialize(int eyeWidth, int eyeHeight);
+
+	// the two eyes either side of a camera, separated along its right
+	// axis, with a projection fitting a layer, and a view whose frustum
+	// encloses both, for culling
+	void MakeEyes(
+		const VIEW_INFO& center,
+		float eyeSeparation,
+		VIEW_INFO eyes[2],
+		VIEW_INFO& cullView) const;
+
+	// bind and clear the layers and upload the eyes' matrices
+	void Begin(const VIEW_INFO eyes[2]);
+	// bind the framebuffer and viewport that were bound before Begin()
+	void End();
+	// draw the left and right layers into the halves of a rectangle of
+	// the bound framebuffer
+	void Present(int x, int y, int width, int height);
+
+	STEREO_MODE GetMode() const { return m_mode; }
+	int GetEyeWidth() const { return m_eyeWidth; }
+	int GetEyeHeight() const { return m_eyeHeight; }
+
+private:
+	// std140 layout of the StereoEyes uniform block
+	struct EYE_BLOCK
+	{
+		glm::mat4 view[2];
+		glm::mat4 projection[2];
+	};
+
+	STEREO_MODE m_mode;
+	int m_eyeWidth;
+	int m_eyeHeight;
+	GLuint m_colorTexture;
+	GLuint m_depthTexture;
+	GLuint m_framebuffer;
+	GLuint m_eyeBuffer;
+	// draws a layer over the viewport with a triangle of no vertices;
+	// the window is multisampled, so the layers cannot be blitted to it
+	ShaderManager* m_pPresentShader;
+	GLuint m_emptyVAO;
+	// state put back by End()
+	GLint m_previousFramebuffer;
+	GLint m_previousViewport[4];
+
+	void Destroy();
+};
@@ -0,0 +1,831 @@
+///////////////////////////////////////////////////////////////////////////////
+// stressscene.cpp
+// ============
+// seeded procedural scene of N objects, lights and textures for benchmarks
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StressScene.h"
+#include "MeshData.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <random>
+
+namespace
+{
+	// keeps clear of the scene textures bound to units 0-15
+	const GLuint STRESS_TEXTURE_UNIT = 16;
+	// edge length of the generated textures
+	const int STRESS_TEXTURE_SIZE = 128;
+	// cells animated and culled per thread pool task
+	const size_t UPDATE_GRAIN = 32;
+	// edge length of the squares the objects are grouped into for culling
+	const float CELL_SIZE = 64.0f;
+	// visible instances gathered locally before claiming output space
+	const int FLUSH_SIZE = 64;
+
+	const float PI = 3.14159265f;
+
+	/***********************************************************
+	 *  ClassifyBox()
+	 *
+	 *  Test a box against the frustum planes. Returns -1 when it
+	 *  is outside, 1 when it is wholly inside, and 0 when it
+	 *  straddles a plane and its contents need testing.
+	 ***********************************************************/
+	int ClassifyBox(const glm::vec4 planes[6], glm::vec3 boxMin, glm::vec3 boxMax)
+	{
+		int result = 1;
+		for (int i = 0; i < 6; i++)
+		{
+			glm::vec3 normal = glm::vec3(planes[i]);
+			glm::vec3 nearest(
+				(normal.x >= 0.0f) ? boxMin.x : boxMax.x,
+				(normal.y >= 0.0f) ? boxMin.y : boxMax.y,
+				(normal.z >= 0.0f) ? boxMin.z : boxMax.z);
+			glm::vec3 farthest(
+				(normal.x >= 0.0f) ? boxMax.x : boxMin.x,
+				(normal.y >= 0.0f) ? boxMax.y : boxMin.y,
+				(normal.z >= 0.0f) ? boxMax.z : boxMin.z);
+			if (glm::dot(normal, farthest) + planes[i].w < 0.0f)
+			{
+				return -1;
+			}
+			if (glm::dot(normal, nearest) + planes[i].w < 0.0f)
+			{
+				result = 0;
+			}
+		}
+		return result;
+	}
+}
+
+/***********************************************************
+ *  StressScene()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+StressScene::StressScene()
+{
+	m_pThreadPool = NULL;
+	m_pShader = NULL;
+	m_pStereoShader = NULL;
+	m_stereoMode = STEREO_NONE;
+	m_worldRadius = 0.0f;
+	m_vao = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+	m_instanceBuffer = 0;
+	m_lightBuffer = 0;
+	m_textureArray = 0;
+	m_viewCount = 0;
+	for (int v = 0; v < MAX_VIEWS; v++)
+	{
+		for (int i = 0; i < SHAPE_COUNT; i++)
+		{
+			m_visible[v][i] = 0;
+		}
+		m_viewSource[v] = v;
+	}
+	m_bInstancesUploaded = false;
+}
+
+/***********************************************************
+ *  ~StressScene()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+StressScene::~StressScene()
+{
+	Destroy();
+
+	if (m_indexBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_indexBuffer);
+	}
+	if (m_vertexBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_vertexBuffer);
+	}
+	if (m_vao != 0)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+	}
+
+	delete m_pStereoShader;
+	m_pStereoShader = NULL;
+	delete m_pShader;
+	m_pShader = NULL;
+	delete m_pThreadPool;
+	m_pThreadPool = NULL;
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing everything that depends
+ *  on the scene size, before a new scene is generated.
+ ***********************************************************/
+void StressScene::Destroy()
+{
+	if (m_instanceBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_instanceBuffer);
+		m_instanceBuffer = 0;
+	}
+	if (m_lightBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_lightBuffer);
+		m_lightBuffer = 0;
+	}
+	if (m_textureArray != 0)
+	{
+		glDeleteTextures(1, &m_textureArray);
+		m_textureArray = 0;
+	}
+	m_objects.clear();
+	m_instances.clear();
+	m_cells.clear();
+	m_viewCount = 0;
+}
+
+/***********************************************************
+ *  CreateGeometry()
+ *
+ *  This method is used for packing the four basic shapes into
+ *  one vertex and index buffer, drawn by base vertex.
+ ***********************************************************/
+void StressScene::CreateGeometry()
+{
+	MESH_DATA meshes[SHAPE_COUNT];
+	MeshData::CreateBoxMesh(meshes[0]);
+	MeshData::CreateCylinderMesh(24, meshes[1]);
+	MeshData::CreateSphereMesh(12, 24, meshes[2]);
+	MeshData::CreateTorusMesh(24, 12, 0.3f, meshes[3]);
+
+	std::vector<MESH_VERTEX> vertices;
+	std::vector<uint32_t> indices;
+	for (int i = 0; i < SHAPE_COUNT; i++)
+	{
+		m_shapes[i].indexCount = (GLsizei)meshes[i].indices.size();
+		m_shapes[i].firstIndex = (GLuint)indices.size();
+		m_shapes[i].baseVertex = (GLint)vertices.size();
+		m_shapes[i].boundsCenter = meshes[i].boundsCenter;
+		m_shapes[i].boundsRadius = meshes[i].boundsRadius;
+		m_shapes[i].firstObject = 0;
+		m_shapes[i].objectCount = 0;
+		vertices.insert(vertices.end(), meshes[i].vertices.begin(), meshes[i].vertices.end());
+		indices.insert(indices.end(), meshes[i].indices.begin(), meshes[i].indices.end());
+	}
+
+	glGenVertexArrays(1, &m_vao);
+	glBindVertexArray(m_vao);
+
+	glGenBuffers(1, &m_vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MESH_VERTEX), vertices.data(), GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MESH_VERTEX), (void*)offsetof(MESH_VERTEX, position));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MESH_VERTEX), (void*)offsetof(MESH_VERTEX, normal));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(MESH_VERTEX), (void*)offsetof(MESH_VERTEX, texCoord));
+
+	glGenBuffers(1, &m_indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/***********************************************************
+ *  CreateTextures()
+ *
+ *  This method is used for generating the texture layers -
+ *  each a seeded colour pair in a seeded stripe or checker
+ *  pattern - in parallel, then uploading them as one array.
+ ***********************************************************/
+void StressScene::CreateTextures()
+{
+	const int size = STRESS_TEXTURE_SIZE;
+	const int layers = std::max(m_settings.textureCount, 1);
+	const size_t layerBytes = (size_t)size * size * 4;
+	std::vector<unsigned char> pixels(layerBytes * layers);
+
+	m_pThreadPool->ParallelFor((size_t)layers, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t layer = begin; layer < end; layer++)
+		{
+			std::mt19937 random(m_settings.seed * 7919u + (uint32_t)layer);
+			std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+			glm::vec3 colorA(unit(random), unit(random), unit(random));
+			glm::vec3 colorB = colorA * 0.35f;
+			int period = 4 << (random() % 4);
+			bool bChecker = (random() % 2) == 0;
+
+			unsigned char* output = pixels.data() + layer * layerBytes;
+			for (int y = 0; y < size; y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					int cell = bChecker ? ((x / period) + (y / period)) : (x / period);
+					glm::vec3 color = (cell % 2) ? colorA : colorB;
+					unsigned char* texel = output + ((size_t)y * size + x) * 4;
+					texel[0] = (unsigned char)(color.r * 255.0f);
+					texel[1] = (unsigned char)(color.g * 255.0f);
+					texel[2] = (unsigned char)(color.b * 255.0f);
+					texel[3] = 255;
+				}
+			}
+		}
+	});
+
+	glGenTextures(1, &m_textureArray);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureArray);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, size, size, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+/***********************************************************
+ *  Generate()
+ *
+ *  This method is used for building the scene. Objects are
+ *  scattered over a disc that grows with the object count,
+ *  so the density, and with it the fraction on screen, stays
+ *  about the same at every scene size. The same seed always
+ *  gives the same scene. Within each shape the objects are
+ *  sorted into square cells, which Update() culls whole.
+ ***********************************************************/
+bool StressScene::Generate(const STRESS_SETTINGS& settings)
+{
+	Destroy();
+	m_settings = settings;
+	m_settings.objectCount = std::max(m_settings.objectCount, 0);
+	m_settings.lightCount = std::max(m_settings.lightCount, 0);
+	m_settings.textureCount = std::max(m_settings.textureCount, 1);
+
+	int threads = (m_settings.threadCount > 0) ? m_settings.threadCount : ThreadPool::DefaultThreadCount();
+	if ((NULL == m_pThreadPool) || (m_pThreadPool->GetThreadCount() != threads))
+	{
+		delete m_pThreadPool;
+		m_pThreadPool = new ThreadPool(threads);
+	}
+
+	if (NULL == m_pShader)
+	{
+		m_pShader = new ShaderManager();
+		m_pShader->LoadShaders(
+			"shaders/stressVertexShader.glsl",
+			"shaders/stressFragmentShader.glsl");
+	}
+	if (m_vao == 0)
+	{
+		CreateGeometry();
+	}
+
+	std::mt19937 random(m_settings.seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	m_worldRadius = 4.0f * std::sqrt((float)std::max(m_settings.objectCount, 100));
+
+	// objects, grouped by shape so each shape draws from one range
+	int shapeCounts[SHAPE_COUNT] = { 0, 0, 0, 0 };
+	std::vector<int> shapeOfObject(m_settings.objectCount);
+	for (int& shape : shapeOfObject)
+	{
+		shape = (int)(random() % SHAPE_COUNT);
+		shapeCounts[shape]++;
+	}
+	int first = 0;
+	for (int i = 0; i < SHAPE_COUNT; i++)
+	{
+		m_shapes[i].firstObject = first;
+		m_shapes[i].objectCount = shapeCounts[i];
+		first += shapeCounts[i];
+		shapeCounts[i] = 0;
+	}
+
+	m_objects.resize(m_settings.objectCount);
+	for (int i = 0; i < m_settings.objectCount; i++)
+	{
+		float angle = unit(random) * 2.0f * PI;
+		float distance = std::sqrt(unit(random)) * m_worldRadius;
+
+		STRESS_OBJECT object;
+		object.scale = 0.3f + 1.2f * unit(random);
+		object.position = glm::vec3(std::cos(angle) * distance, object.scale + 6.0f * unit(random), std::sin(angle) * distance);
+		object.axis = glm::normalize(glm::vec3(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f) + glm::vec3(0.0f, 0.001f, 0.0f));
+		object.spinRate = 2.0f * unit(random) - 1.0f;
+		object.phase = unit(random) * 2.0f * PI;
+		object.textureLayer = (float)(random() % m_settings.textureCount);
+
+		int shape = shapeOfObject[i];
+		m_objects[m_shapes[shape].firstObject + shapeCounts[shape]++] = object;
+	}
+	m_instances.resize(m_objects.size());
+
+	// cells of each shape's objects, with boxes around where they can spin to
+	const int columns = (int)std::ceil(2.0f * m_worldRadius / CELL_SIZE) + 1;
+	auto cellOf = [&](const STRESS_OBJECT& object)
+	{
+		int column = std::clamp((int)((object.position.x + m_worldRadius) / CELL_SIZE), 0, columns - 1);
+		int row = std::clamp((int)((object.position.z + m_worldRadius) / CELL_SIZE), 0, columns - 1);
+		return row * columns + column;
+	};
+	for (int shape = 0; shape < SHAPE_COUNT; shape++)
+	{
+		std::vector<STRESS_OBJECT>::iterator begin = m_objects.begin() + m_shapes[shape].firstObject;
+		std::vector<STRESS_OBJECT>::iterator end = begin + m_shapes[shape].objectCount;
+		std::stable_sort(begin, end, [&](const STRESS_OBJECT& a, const STRESS_OBJECT& b)
+		{
+			return cellOf(a) < cellOf(b);
+		});
+
+		float reach = glm::length(m_shapes[shape].boundsCenter) + m_shapes[shape].boundsRadius;
+		for (int i = m_shapes[shape].firstObject; i < m_shapes[shape].firstObject + m_shapes[shape].objectCount; i++)
+		{
+			const STRESS_OBJECT& object = m_objects[i];
+			glm::vec3 extent = glm::vec3(reach * object.scale);
+			if (m_cells.empty() || (m_cells.back().shape != shape) ||
+				(cellOf(m_objects[m_cells.back().firstObject]) != cellOf(object)))
+			{
+				STRESS_CELL cell;
+				cell.shape = shape;
+				cell.firstObject = i;
+				cell.objectCount = 0;
+				cell.boundsMin = object.position - extent;
+				cell.boundsMax = object.position + extent;
+				m_cells.push_back(cell);
+			}
+			STRESS_CELL& cell = m_cells.back();
+			cell.objectCount++;
+			cell.boundsMin = glm::min(cell.boundsMin, object.position - extent);
+			cell.boundsMax = glm::max(cell.boundsMax, object.position + extent);
+		}
+	}
+
+	// point lights scattered over the same disc
+	std::vector<POINT_LIGHT> lights(std::max(m_settings.lightCount, 1));
+	for (POINT_LIGHT& light : lights)
+	{
+		float angle = unit(random) * 2.0f * PI;
+		float distance = std::sqrt(unit(random)) * m_worldRadius;
+		light.positionRadius = glm::vec4(std::cos(angle) * distance, 2.0f + 4.0f * unit(random), std::sin(angle) * distance, 10.0f + 15.0f * unit(random));
+		light.color = glm::vec4(unit(random), unit(random), unit(random), 1.0f) * 0.8f;
+	}
+
+	glGenBuffers(1, &m_lightBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lightBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, lights.size() * sizeof(POINT_LIGHT), lights.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	// per-instance attributes, refilled every frame
+	glBindVertexArray(m_vao);
+	glGenBuffers(1, &m_instanceBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, std::max<size_t>(m_instances.size(), 1) * sizeof(STRESS_INSTANCE), NULL, GL_STREAM_DRAW);
+	for (int column = 0; column < 4; column++)
+	{
+		glEnableVertexAttribArray(3 + column);
+		glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(STRESS_INSTANCE), (void*)(offsetof(STRESS_INSTANCE, model) + column * sizeof(glm::vec4)));
+		glVertexAttribDivisor(3 + column, 1);
+	}
+	glEnableVertexAttribArray(7);
+	glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, sizeof(STRESS_INSTANCE), (void*)offsetof(STRESS_INSTANCE, textureLayer));
+	glVertexAttribDivisor(7, 1);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	CreateTextures();
+
+	std::cout << "[StressScene] Generated " << m_settings.objectCount << " objects in " << m_cells.size() << " cells, "
+		<< m_settings.lightCount << " lights, " << m_settings.textureCount << " textures, seed "
+		<< m_settings.seed << ", " << m_pThreadPool->GetThreadCount() << " threads" << std::endl;
+
+	return true;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for spinning the objects and testing
+ *  them against each view frustum, a few cells per thread
+ *  pool task. Each cell's box is classified against every
+ *  view once: a cell outside them all is skipped without
+ *  animating its objects, and the objects of a cell wholly
+ *  inside a view are taken for it without any plane tests,
+ *  so overlapping views share most of their culling. Only
+ *  cells straddling a view's planes test their objects.
+ *  Survivors are gathered in small local batches per view
+ *  and then copied into their shape's range of that view's
+ *  instance list through an atomic cursor, so threads
+ *  rarely contend. The animation and bounds are worked out
+ *  once, however many views there are; a view with the same
+ *  camera as an earlier one is not culled again at all.
+ ***********************************************************/
+void StressScene::Update(double time, const VIEW_INFO& viewInfo)
+{
+	Update(time, std::vector<VIEW_INFO>(1, viewInfo));
+}
+
+void StressScene::Update(double time, const std::vector<VIEW_INFO>& views)
+{
+	m_viewCount = std::min((int)views.size(), MAX_VIEWS);
+	m_bInstancesUploaded = false;
+	for (int v = 0; v < MAX_VIEWS; v++)
+	{
+		for (int i = 0; i < SHAPE_COUNT; i++)
+		{
+			m_visible[v][i] = 0;
+		}
+	}
+	if (m_objects.empty() || (m_viewCount == 0))
+	{
+		return;
+	}
+	const size_t objectCount = m_objects.size();
+	if (m_instances.size() < objectCount * m_viewCount)
+	{
+		m_instances.resize(objectCount * m_viewCount);
+	}
+
+	// frustum planes of each view with a camera of its own
+	glm::vec4 planes[MAX_VIEWS][6];
+	int culledViews[MAX_VIEWS];
+	int culledCount = 0;
+	for (int v = 0; v < m_viewCount; v++)
+	{
+		glm::mat4 viewProjection = views[v].projection * views[v].view;
+		m_viewSource[v] = v;
+		for (int u = 0; u < v; u++)
+		{
+			if (views[u].projection * views[u].view == viewProjection)
+			{
+				m_viewSource[v] = m_viewSource[u];
+				break;
+			}
+		}
+		if (m_viewSource[v] != v)
+		{
+			continue;
+		}
+
+		for (int i = 0; i < 3; i++)
+		{
+			glm::vec4 row(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+			glm::vec4 w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+			planes[v][i * 2] = w + row;
+			planes[v][i * 2 + 1] = w - row;
+		}
+		for (glm::vec4& plane : planes[v])
+		{
+			plane /= glm::length(glm::vec3(plane));
+		}
+		culledViews[culledCount++] = v;
+	}
+
+	const float seconds = (float)time;
+	m_pThreadPool->ParallelFor(m_cells.size(), UPDATE_GRAIN, [&](size_t begin, size_t end)
+	{
+		STRESS_INSTANCE local[MAX_VIEWS][FLUSH_SIZE];
+		int localCount[MAX_VIEWS] = {};
+		int localShape = -1;
+
+		auto flush = [&](int v)
+		{
+			if (localCount[v] > 0)
+			{
+				int offset = m_visible[v][localShape].fetch_add(localCount[v]);
+				std::copy(local[v], local[v] + localCount[v],
+					m_instances.begin() + v * objectCount + m_shapes[localShape].firstObject + offset);
+				localCount[v] = 0;
+			}
+		};
+
+		for (size_t c = begin; c < end; c++)
+		{
+			const STRESS_CELL& cell = m_cells[c];
+
+			// the views that can see the cell, and whether it straddles them
+			int cellViews[MAX_VIEWS];
+			bool bStraddles[MAX_VIEWS];
+			int cellViewCount = 0;
+			for (int k = 0; k < culledCount; k++)
+			{
+				int result = ClassifyBox(planes[culledViews[k]], cell.boundsMin, cell.boundsMax);
+				if (result >= 0)
+				{
+					cellViews[cellViewCount] = culledViews[k];
+					bStraddles[cellViewCount] = (result == 0);
+					cellViewCount++;
+				}
+			}
+			if (cellViewCount == 0)
+			{
+				continue;
+			}
+
+			if (cell.shape != localShape)
+			{
+				for (int k = 0; k < culledCount; k++)
+				{
+					flush(culledViews[k]);
+				}
+				localShape = cell.shape;
+			}
+
+			const SHAPE_RANGE& shape = m_shapes[cell.shape];
+			for (int i = cell.firstObject; i < cell.firstObject + cell.objectCount; i++)
+			{
+				const STRESS_OBJECT& object = m_objects[i];
+				glm::mat4 model =
+					glm::translate(object.position) *
+					glm::rotate(object.phase + object.spinRate * seconds, object.axis) *
+					glm::scale(glm::vec3(object.scale));
+
+				glm::vec3 center = glm::vec3(model * glm::vec4(shape.boundsCenter, 1.0f));
+				float radius = shape.boundsRadius * object.scale;
+				for (int k = 0; k < cellViewCount; k++)
+				{
+					int v = cellViews[k];
+					bool bVisible = true;
+					if (bStraddles[k])
+					{
+						for (const glm::vec4& plane : planes[v])
+						{
+							if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+							{
+								bVisible = false;
+								break;
+							}
+						}
+					}
+					if (bVisible)
+					{
+						if (localCount[v] == FLUSH_SIZE)
+						{
+							flush(v);
+						}
+						local[v][localCount[v]].model = model;
+						local[v][localCount[v]].textureLayer = object.textureLayer;
+						localCount[v]++;
+					}
+				}
+			}
+		}
+		for (int k = 0; k < culledCount; k++)
+		{
+			flush(culledViews[k]);
+		}
+	});
+}
+
+/***********************************************************
+ *  Render()
+ *
+ *  This method is used for drawing the visible objects of a
+ *  view with one instanced draw per shape. The first view
+ *  drawn after Update() uploads every view's lists.
+ ***********************************************************/
+void StressScene::Render(
+	const VIEW_INFO& viewInfo,
+	glm::vec3 lightDirection,
+	glm::vec3 lightColor,
+	glm::vec3 ambientColor)
+{
+	Render(0, viewInfo, lightDirection, lightColor, ambientColor);
+}
+
+void StressScene::Render(
+	int view,
+	const VIEW_INFO& viewInfo,
+	glm::vec3 lightDirection,
+	glm::vec3 lightColor,
+	glm::vec3 ambientColor)
+{
+	if ((NULL == m_pShader) || (m_instanceBuffer == 0) || (view < 0) || (view >= m_viewCount))
+	{
+		return;
+	}
+	UploadInstances();
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+	m_pShader->use();
+	m_pShader->setMat4Value("view", viewInfo.view);
+	m_pShader->setMat4Value("projection", viewInfo.projection);
+	SetShading(m_pShader, lightDirection, lightColor, ambientColor);
+	DrawInstances(m_viewSource[view], 1);
+
+	glUseProgram(previousProgram);
+}
+
+/***********************************************************
+ *  RenderStereo()
+ *
+ *  This method is used for drawing the first view's objects
+ *  to both eyes of a stereo target, between its Begin() and
+ *  End(), with the same draws as Render(). Multiview runs
+ *  the vertex shader per eye by itself; otherwise each draw
+ *  has twice the instances, the per instance data stepping
+ *  every other one, so each object is drawn once per eye.
+ ***********************************************************/
+void StressScene::RenderStereo(
+	STEREO_MODE mode,
+	glm::vec3 lightDirection,
+	glm::vec3 lightColor,
+	glm::vec3 ambientColor)
+{
+	if ((mode == STEREO_NONE) || (m_instanceBuffer == 0) || (m_viewCount == 0))
+	{
+		return;
+	}
+	if ((NULL == m_pStereoShader) || (m_stereoMode != mode))
+	{
+		delete m_pStereoShader;
+		m_pStereoShader = new ShaderManager();
+		m_pStereoShader->LoadShaders(
+			(mode == STEREO_MULTIVIEW) ? "shaders/stressMultiviewVertexShader.glsl" : "shaders/stressStereoVertexShader.glsl",
+			"shaders/stressFragmentShader.glsl");
+		m_stereoMode = mode;
+	}
+	UploadInstances();
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+	// the eyes' matrices are in the block StereoTarget::Begin() bound
+	m_pStereoShader->use();
+	SetShading(m_pStereoShader, lightDirection, lightColor, ambientColor);
+	if (mode == STEREO_INSTANCED)
+	{
+		SetInstanceDivisor(2);
+		DrawInstances(m_viewSource[0], 2);
+		SetInstanceDivisor(1);
+	}
+	else
+	{
+		DrawInstances(m_viewSource[0], 1);
+	}
+
+	glUseProgram(previousProgram);
+}
+
+/***********************************************************
+ *  UploadInstances()
+ *
+ *  This method is used for orphaning last frame's instance
+ *  data and uploading each view's visible range of each
+ *  shape, once after each Update().
+ ***********************************************************/
+void StressScene::UploadInstances()
+{
+	const size_t objectCount = m_objects.size();
+	if (!m_bInstancesUploaded)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, std::max<size_t>(m_instances.size(), 1) * sizeof(STRESS_INSTANCE), NULL, GL_STREAM_DRAW);
+		for (int v = 0; v < m_viewCount; v++)
+		{
+			for (int i = 0; (m_viewSource[v] == v) && (i < SHAPE_COUNT); i++)
+			{
+				int visible = m_visible[v][i].load();
+				if (visible > 0)
+				{
+					size_t first = v * objectCount + m_shapes[i].firstObject;
+					glBufferSubData(
+						GL_ARRAY_BUFFER,
+						(GLintptr)first * sizeof(STRESS_INSTANCE),
+						visible * sizeof(STRESS_INSTANCE),
+						&m_instances[first]);
+				}
+			}
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		m_bInstancesUploaded = true;
+	}
+}
+
+/***********************************************************
+ *  SetShading()
+ *
+ *  This method is used for setting the textures and lights
+ *  of a shader drawing the objects.
+ ***********************************************************/
+void StressScene::SetShading(
+	ShaderManager* pShader,
+	glm::vec3 lightDirection,
+	glm::vec3 lightColor,
+	glm::vec3 ambientColor)
+{
+	pShader->setIntValue("objectTextures", (int)STRESS_TEXTURE_UNIT);
+	pShader->setIntValue("lightCount", m_settings.lightCount);
+	pShader->setVec3Value("lightDirection", lightDirection);
+	pShader->setVec3Value("lightColor", lightColor);
+	pShader->setVec3Value("ambientColor", ambientColor);
+}
+
+/***********************************************************
+ *  SetInstanceDivisor()
+ *
+ *  This method is used for setting how many instances each
+ *  object's per instance data is used for.
+ ***********************************************************/
+void StressScene::SetInstanceDivisor(GLuint divisor)
+{
+	glBindVertexArray(m_vao);
+	for (GLuint attribute = 3; attribute <= 7; attribute++)
+	{
+		glVertexAttribDivisor(attribute, divisor);
+	}
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  DrawInstances()
+ *
+ *  This method is used for drawing a view's visible objects
+ *  with one instanced draw per shape, each object drawn as
+ *  the given number of instances, with the shader in use.
+ ***********************************************************/
+void StressScene::DrawInstances(int source, GLsizei instancesPerObject)
+{
+	const size_t objectCount = m_objects.size();
+
+	glActiveTexture(GL_TEXTURE0 + STRESS_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureArray);
+	glActiveTexture(GL_TEXTURE0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_lightBuffer);
+
+	glBindVertexArray(m_vao);
+	for (int i = 0; i < SHAPE_COUNT; i++)
+	{
+		int visible = m_visible[source][i].load();
+		if (visible > 0)
+		{
+			glDrawElementsInstancedBaseVertexBaseInstance(
+				GL_TRIANGLES,
+				m_shapes[i].indexCount,
+				GL_UNSIGNED_INT,
+				(void*)(m_shapes[i].firstIndex * sizeof(uint32_t)),
+				visible * instancesPerObject,
+				m_shapes[i].baseVertex,
+				(GLuint)(source * objectCount + m_shapes[i].firstObject));
+		}
+	}
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  GetBenchmarkView()
+ *
+ *  This method is used for getting the camera of a benchmark
+ *  frame - a slow orbit inside the disc of objects, looking
+ *  across it, that depends only on the frame number.
+ ***********************************************************/
+VIEW_INFO StressScene::GetBenchmarkView(int frame, float width, float height) const
+{
+	float angle = (float)frame * (2.0f * PI / 600.0f);
+	float orbit = m_worldRadius * 0.6f;
+
+	VIEW_INFO viewInfo;
+	viewInfo.position = glm::vec3(std::cos(angle) * orbit, 12.0f, std::sin(angle) * orbit);
+	glm::vec3 target(-std::sin(angle) * orbit * 0.5f, 2.0f, std::cos(angle) * orbit * 0.5f);
+	viewInfo.fovY = glm::radians(45.0f);
+	viewInfo.viewportWidth = width;
+	viewInfo.viewportHeight = height;
+	viewInfo.view = glm::lookAt(viewInfo.position, target, glm::vec3(0.0f, 1.0f, 0.0f));
+	viewInfo.projection = glm::perspective(viewInfo.fovY, width / height, 0.1f, m_worldRadius * 2.5f);
+	return viewInfo;
+}
+
+/***********************************************************
+ *  GetVisibleCount()
+ *
+ *  This method is used for getting the number of objects
+ *  that passed culling for a view in the last update.
+ ***********************************************************/
+int StressScene::GetVisibleCount(int view) const
+{
+	if ((view < 0) || (view >= m_viewCount))
+	{
+		return 0;
+	}
+	int total = 0;
+	for (int i = 0; i < SHAPE_COUNT; i++)
+	{
+		total += m_visible[m_viewSource[view]][i].load();
+	}
+	return total;
+}
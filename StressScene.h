@@ -0,0 +1,180 @@
+///////////////////////////////////////////////////////////////////////////////
+// stressscene.h
+// ============
+// seeded procedural scene of N objects, lights and textures for benchmarks
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "StereoTarget.h"
+#include "ViewManager.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  STRESS_SETTINGS
+ *
+ *  Size of the generated scene and the threads updating it.
+ ***********************************************************/
+struct STRESS_SETTINGS
+{
+	int objectCount = 10000;
+	int lightCount = 32;
+	int textureCount = 16;
+	uint32_t seed = 1;
+	// threads for the per-frame update, 0 for every hardware thread
+	int threadCount = 0;
+};
+
+/***********************************************************
+ *  StressScene
+ *
+ *  This class generates a scene of spinning objects, point
+ *  lights and procedural textures from a seed, so any size
+ *  of scene can be rebuilt exactly. Each frame the objects
+ *  are animated and frustum culled in parallel on a thread
+ *  pool, then drawn with one instanced call per shape, which
+ *  makes frame time scale with both object and thread count.
+ *  Several views are culled in the same pass: each object is
+ *  animated and bounded once, then tested against every
+ *  view, filling each view's shape sorted instance lists at
+ *  once, and views with the same camera share one list.
+ ***********************************************************/
+class StressScene
+{
+public:
+	// constructor
+	StressScene();
+	// destructor
+	~StressScene();
+
+	// build, or rebuild, the scene for the given settings
+	bool Generate(const STRESS_SETTINGS& settings);
+	// most views culled by one Update()
+	static const int MAX_VIEWS = 4;
+
+	// animate every object for the frame and cull it for each view
+	void Update(double time, const VIEW_INFO& viewInfo);
+	void Update(double time, const std::vector<VIEW_INFO>& views);
+	// draw the objects of a view that survived the last Update(), into
+	// the current viewport
+	void Render(
+		const VIEW_INFO& viewInfo,
+		glm::vec3 lightDirection,
+		glm::vec3 lightColor,
+		glm::vec3 ambientColor);
+	void Render(
+		int view,
+		const VIEW_INFO& viewInfo,
+		glm::vec3 lightDirection,
+		glm::vec3 lightColor,
+		glm::vec3 ambientColor);
+	// draw the objects of the first view to both eyes of the bound stereo
+	// target in one pass; cull with the target's enclosing view
+	void RenderStereo(
+		STEREO_MODE mode,
+		glm::vec3 lightDirection,
+		glm::vec3 lightColor,
+		glm::vec3 ambientColor);
+
+	// fixed camera path, so benchmark runs see the same frames
+	VIEW_INFO GetBenchmarkView(int frame, float width, float height) const;
+
+	const STRESS_SETTINGS& GetSettings() const { return m_settings; }
+	int GetThreadCount() const { return (NULL != m_pThreadPool) ? m_pThreadPool->GetThreadCount() : 1; }
+	int GetVisibleCount(int view = 0) const;
+	// radius of the disc the objects are scattered over
+	float GetWorldRadius() const { return m_worldRadius; }
+
+private:
+	static const int SHAPE_COUNT = 4;
+
+	struct STRESS_OBJECT
+	{
+		glm::vec3 position;
+		float scale;
+		glm::vec3 axis;
+		float spinRate;
+		float phase;
+		float textureLayer;
+	};
+	// per-instance vertex data, see stressVertexShader.glsl
+	struct STRESS_INSTANCE
+	{
+		glm::mat4 model;
+		float textureLayer;
+		float pad[3];
+	};
+	struct POINT_LIGHT
+	{
+		glm::vec4 positionRadius;
+		glm::vec4 color;
+	};
+	struct SHAPE_RANGE
+	{
+		GLsizei indexCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		glm::vec3 boundsCenter;
+		float boundsRadius;
+		// objects of this shape are stored contiguously from here
+		int firstObject;
+		int objectCount;
+	};
+	// the objects of one shape in one square of the disc, stored
+	// contiguously, and a box around all they reach while spinning
+	struct STRESS_CELL
+	{
+		int shape;
+		int firstObject;
+		int objectCount;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	STRESS_SETTINGS m_settings;
+	ThreadPool* m_pThreadPool;
+	ShaderManager* m_pShader;
+	// loaded for the stereo mode first drawn with
+	ShaderManager* m_pStereoShader;
+	STEREO_MODE m_stereoMode;
+	float m_worldRadius;
+
+	std::vector<STRESS_OBJECT> m_objects;
+	// a list of every object's slot per view, each grouped by shape
+	std::vector<STRESS_INSTANCE> m_instances;
+	SHAPE_RANGE m_shapes[SHAPE_COUNT];
+	// every object is in one cell; cells are in shape order
+	std::vector<STRESS_CELL> m_cells;
+	// views culled by the last Update(), visible instances it wrote per
+	// view and shape, and the view whose list each view draws
+	int m_viewCount;
+	std::atomic<int> m_visible[MAX_VIEWS][SHAPE_COUNT];
+	int m_viewSource[MAX_VIEWS];
+	// the lists have been copied to the instance buffer since Update()
+	bool m_bInstancesUploaded;
+
+	GLuint m_vao;
+	GLuint m_vertexBuffer;
+	GLuint m_indexBuffer;
+	GLuint m_instanceBuffer;
+	GLuint m_lightBuffer;
+	GLuint m_textureArray;
+
+	void Destroy();
+	void CreateGeometry();
+	void CreateTextures();
+	void UploadInstances();
+	void SetShading(
+		ShaderManager* pShader,
+		glm::vec3 lightDirection,
+		glm::vec3 lightColor,
+		glm::vec3 ambientColor);
+	void SetInstanceDivisor(GLuint divisor);
+	void DrawInstances(int source, GLsizei instancesPerObject);
+};
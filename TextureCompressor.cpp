@@ -0,0 +1,641 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecompressor.cpp
+// ============
+// BC1 and BC7 block compression of decoded textures at load time
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCompressor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define BC_USE_SSE2 1
+#endif
+
+namespace
+{
+	// block rows compressed per task
+	const size_t BLOCK_ROW_GRAIN = 4;
+
+	// BC7 4 bit index interpolation weights, out of 64
+	const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	/***********************************************************
+	 *  BLOCK
+	 *
+	 *  The 16 pixels of a block, one array per channel so four
+	 *  pixels fill an SSE register.
+	 ***********************************************************/
+	struct BLOCK
+	{
+		alignas(16) float channel[4][16];
+	};
+
+	/***********************************************************
+	 *  LoadBlock()
+	 *
+	 *  Gather a block as RGBA, repeating the edge pixels where
+	 *  the block hangs over the image.
+	 ***********************************************************/
+	void LoadBlock(const unsigned char* pixels, int width, int height, int channels, int blockX, int blockY, BLOCK& block)
+	{
+		for (int y = 0; y < 4; y++)
+		{
+			int sy = std::min(blockY * 4 + y, height - 1);
+			for (int x = 0; x < 4; x++)
+			{
+				int sx = std::min(blockX * 4 + x, width - 1);
+				const unsigned char* p = pixels + ((size_t)sy * width + sx) * channels;
+				int i = y * 4 + x;
+				if (channels >= 3)
+				{
+					block.channel[0][i] = p[0];
+					block.channel[1][i] = p[1];
+					block.channel[2][i] = p[2];
+				}
+				else
+				{
+					block.channel[0][i] = block.channel[1][i] = block.channel[2][i] = p[0];
+				}
+				block.channel[3][i] = (channels == 4) ? p[3] : ((channels == 2) ? p[1] : 255.0f);
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  FitEndpoints()
+	 *
+	 *  Put the endpoints at the extremes of the block along its
+	 *  principal axis, found by power iteration on the colour
+	 *  covariance.
+	 ***********************************************************/
+	void FitEndpoints(const BLOCK& block, int channelCount, float e0[4], float e1[4])
+	{
+		float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float lo[4], hi[4];
+		for (int c = 0; c < channelCount; c++)
+		{
+			lo[c] = hi[c] = block.channel[c][0];
+			for (int i = 0; i < 16; i++)
+			{
+				mean[c] += block.channel[c][i];
+				lo[c] = std::min(lo[c], block.channel[c][i]);
+				hi[c] = std::max(hi[c], block.channel[c][i]);
+			}
+			mean[c] /= 16.0f;
+		}
+
+		float covariance[4][4] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			float d[4];
+			for (int c = 0; c < channelCount; c++)
+			{
+				d[c] = block.channel[c][i] - mean[c];
+			}
+			for (int a = 0; a < channelCount; a++)
+			{
+				for (int b = a; b < channelCount; b++)
+				{
+					covariance[a][b] += d[a] * d[b];
+				}
+			}
+		}
+
+		// start from the diagonal of the bounding box, which is already
+		// close to the axis for most blocks
+		float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int c = 0; c < channelCount; c++)
+		{
+			axis[c] = hi[c] - lo[c];
+		}
+		for (int iteration = 0; iteration < 4; iteration++)
+		{
+			float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int a = 0; a < channelCount; a++)
+			{
+				for (int b = 0; b < channelCount; b++)
+				{
+					next[a] += ((a <= b) ? covariance[a][b] : covariance[b][a]) * axis[b];
+				}
+			}
+			float length = 0.0f;
+			for (int c = 0; c < channelCount; c++)
+			{
+				length = std::max(length, std::fabs(next[c]));
+			}
+			if (length < 1e-6f)
+			{
+				break;
+			}
+			for (int c = 0; c < channelCount; c++)
+			{
+				axis[c] = next[c] / length;
+			}
+		}
+
+		float axisLength2 = 0.0f;
+		for (int c = 0; c < channelCount; c++)
+		{
+			axisLength2 += axis[c] * axis[c];
+		}
+		if (axisLength2 < 1e-12f)
+		{
+			// a flat block
+			for (int c = 0; c < 4; c++)
+			{
+				e0[c] = e1[c] = (c < channelCount) ? mean[c] : 255.0f;
+			}
+			return;
+		}
+
+		float minT = 0.0f;
+		float maxT = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < channelCount; c++)
+			{
+				t += (block.channel[c][i] - mean[c]) * axis[c];
+			}
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+		for (int c = 0; c < 4; c++)
+		{
+			if (c < channelCount)
+			{
+				e0[c] = std::min(std::max(mean[c] + axis[c] * minT / axisLength2, 0.0f), 255.0f);
+				e1[c] = std::min(std::max(mean[c] + axis[c] * maxT / axisLength2, 0.0f), 255.0f);
+			}
+			else
+			{
+				e0[c] = e1[c] = 255.0f;
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  ProjectIndices()
+	 *
+	 *  Pick, for every pixel, the nearest of `steps` evenly spaced
+	 *  points on the line between the endpoints, as 0..steps-1.
+	 ***********************************************************/
+	void ProjectIndices(const BLOCK& block, int channelCount, const float e0[4], const float e1[4], int steps, int indices[16])
+	{
+		float direction[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float length2 = 0.0f;
+		for (int c = 0; c < channelCount; c++)
+		{
+			direction[c] = e1[c] - e0[c];
+			length2 += direction[c] * direction[c];
+		}
+		if (length2 < 1e-6f)
+		{
+			std::fill(indices, indices + 16, 0);
+			return;
+		}
+		const float scale = (steps - 1) / length2;
+
+#if defined(BC_USE_SSE2)
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 top = _mm_set1_ps((float)(steps - 1));
+		for (int i = 0; i < 16; i += 4)
+		{
+			__m128 t = _mm_setzero_ps();
+			for (int c = 0; c < channelCount; c++)
+			{
+				__m128 offset = _mm_sub_ps(_mm_load_ps(&block.channel[c][i]), _mm_set1_ps(e0[c]));
+				t = _mm_add_ps(t, _mm_mul_ps(offset, _mm_set1_ps(direction[c] * scale)));
+			}
+			t = _mm_min_ps(_mm_max_ps(t, zero), top);
+			__m128i rounded = _mm_cvttps_epi32(_mm_add_ps(t, _mm_set1_ps(0.5f)));
+			_mm_storeu_si128((__m128i*)&indices[i], rounded);
+		}
+#else
+		for (int i = 0; i < 16; i++)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < channelCount; c++)
+			{
+				t += (block.channel[c][i] - e0[c]) * direction[c] * scale;
+			}
+			t = std::min(std::max(t, 0.0f), (float)(steps - 1));
+			indices[i] = (int)(t + 0.5f);
+		}
+#endif
+	}
+
+	/***********************************************************
+	 *  RefineEndpoints()
+	 *
+	 *  Least squares fit of the endpoints to the pixels, given
+	 *  the weight of the second endpoint at each pixel.
+	 ***********************************************************/
+	void RefineEndpoints(const BLOCK& block, int channelCount, const float weights[16], float e0[4], float e1[4])
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ap[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float bp[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; i++)
+		{
+			float b = weights[i];
+			float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < channelCount; c++)
+			{
+				ap[c] += a * block.channel[c][i];
+				bp[c] += b * block.channel[c][i];
+			}
+		}
+		float determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < 1e-6f)
+		{
+			return;
+		}
+		for (int c = 0; c < channelCount; c++)
+		{
+			e0[c] = std::min(std::max((ap[c] * bb - bp[c] * ab) / determinant, 0.0f), 255.0f);
+			e1[c] = std::min(std::max((bp[c] * aa - ap[c] * ab) / determinant, 0.0f), 255.0f);
+		}
+	}
+
+	// squared error of a block against the palette the indices select
+	float BlockError(const BLOCK& block, int channelCount, const float palette[16][4], const int indices[16])
+	{
+		float error = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < channelCount; c++)
+			{
+				float d = block.channel[c][i] - palette[indices[i]][c];
+				error += d * d;
+			}
+		}
+		return error;
+	}
+
+	/***********************************************************
+	 *  BC1 helpers
+	 ***********************************************************/
+	unsigned short PackRGB565(const float color[4])
+	{
+		int r = (int)std::lround(color[0] * 31.0f / 255.0f);
+		int g = (int)std::lround(color[1] * 63.0f / 255.0f);
+		int b = (int)std::lround(color[2] * 31.0f / 255.0f);
+		return (unsigned short)((r << 11) | (g << 5) | b);
+	}
+
+	void UnpackRGB565(unsigned short packed, float color[4])
+	{
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (float)((r << 3) | (r >> 2));
+		color[1] = (float)((g << 2) | (g >> 4));
+		color[2] = (float)((b << 3) | (b >> 2));
+		color[3] = 255.0f;
+	}
+
+	// the four colour palette of the 4 colour mode, in index order
+	void BuildBC1Palette(unsigned short c0, unsigned short c1, float palette[16][4])
+	{
+		UnpackRGB565(c0, palette[0]);
+		UnpackRGB565(c1, palette[1]);
+		for (int c = 0; c < 4; c++)
+		{
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+	}
+
+	// BC1 index for each step along the line from colour 0 to colour 1
+	const int BC1_STEP_TO_INDEX[4] = { 0, 2, 3, 1 };
+	const float BC1_STEP_WEIGHT[4] = { 0.0f, 1.0f / 3.0f, 2.0f / 3.0f, 1.0f };
+
+	/***********************************************************
+	 *  EncodeBC1()
+	 *
+	 *  Encode one block in the 4 colour mode. Colour 0 has to
+	 *  be the larger value, so the endpoints swap when needed.
+	 ***********************************************************/
+	float EncodeBC1(const BLOCK& block, const float e0In[4], const float e1In[4], unsigned char* pOut)
+	{
+		unsigned short c0 = PackRGB565(e0In);
+		unsigned short c1 = PackRGB565(e1In);
+		if (c0 < c1)
+		{
+			std::swap(c0, c1);
+		}
+
+		float palette[16][4];
+		BuildBC1Palette(c0, c1, palette);
+		int steps[16];
+		int indices[16];
+		unsigned int bits = 0;
+		if (c0 != c1)
+		{
+			ProjectIndices(block, 3, palette[0], palette[1], 4, steps);
+			for (int i = 0; i < 16; i++)
+			{
+				indices[i] = BC1_STEP_TO_INDEX[steps[i]];
+				bits |= (unsigned int)indices[i] << (i * 2);
+			}
+		}
+		else
+		{
+			// a single colour - every pixel takes colour 0
+			std::fill(indices, indices + 16, 0);
+		}
+
+		pOut[0] = (unsigned char)(c0 & 0xFF);
+		pOut[1] = (unsigned char)(c0 >> 8);
+		pOut[2] = (unsigned char)(c1 & 0xFF);
+		pOut[3] = (unsigned char)(c1 >> 8);
+		std::memcpy(pOut + 4, &bits, 4);
+		return BlockError(block, 3, palette, indices);
+	}
+
+	/***********************************************************
+	 *  CompressBC1Block()
+	 ***********************************************************/
+	void CompressBC1Block(const BLOCK& block, COMPRESS_QUALITY quality, unsigned char* pOut)
+	{
+		float e0[4], e1[4];
+		FitEndpoints(block, 3, e0, e1);
+		float error = EncodeBC1(block, e0, e1, pOut);
+		if ((quality != COMPRESS_REFINED) || (error == 0.0f))
+		{
+			return;
+		}
+
+		int steps[16];
+		float weights[16];
+		ProjectIndices(block, 3, e0, e1, 4, steps);
+		for (int i = 0; i < 16; i++)
+		{
+			weights[i] = BC1_STEP_WEIGHT[steps[i]];
+		}
+		RefineEndpoints(block, 3, weights, e0, e1);
+
+		unsigned char refined[8];
+		if (EncodeBC1(block, e0, e1, refined) < error)
+		{
+			std::memcpy(pOut, refined, 8);
+		}
+	}
+
+	/***********************************************************
+	 *  BC7 helpers
+	 ***********************************************************/
+
+	// quantize an endpoint to 7 bits a channel plus a shared low bit,
+	// trying both values of the low bit
+	void QuantizeBC7Endpoint(const float color[4], int quantized[4], int& pBit)
+	{
+		float bestError = 0.0f;
+		for (int p = 0; p < 2; p++)
+		{
+			int candidate[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; c++)
+			{
+				candidate[c] = std::min(std::max((int)std::lround((color[c] - p) / 2.0f), 0), 127);
+				float d = color[c] - (float)((candidate[c] << 1) | p);
+				error += d * d;
+			}
+			if ((p == 0) || (error < bestError))
+			{
+				bestError = error;
+				pBit = p;
+				std::copy(candidate, candidate + 4, quantized);
+			}
+		}
+	}
+
+	// append `count` bits of value to a 128 bit little endian block
+	void PutBits(unsigned char* pBlock, int& position, unsigned int value, int count)
+	{
+		for (int i = 0; i < count; i++, position++)
+		{
+			if (value & (1u << i))
+			{
+				pBlock[position >> 3] |= (unsigned char)(1u << (position & 7));
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  EncodeBC7()
+	 *
+	 *  Encode one block in mode 6: a single subset with RGBA
+	 *  endpoints of 7 bits plus a p-bit, and 4 bit indices. The
+	 *  first pixel's index must have a clear top bit, so the
+	 *  endpoints swap and the indices flip when it does not.
+	 ***********************************************************/
+	float EncodeBC7(const BLOCK& block, const float e0In[4], const float e1In[4], unsigned char* pOut)
+	{
+		int q[2][4];
+		int pBits[2];
+		QuantizeBC7Endpoint(e0In, q[0], pBits[0]);
+		QuantizeBC7Endpoint(e1In, q[1], pBits[1]);
+
+		float palette[16][4];
+		float endpoints[2][4];
+		for (int e = 0; e < 2; e++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				endpoints[e][c] = (float)((q[e][c] << 1) | pBits[e]);
+			}
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				int v0 = (int)endpoints[0][c];
+				int v1 = (int)endpoints[1][c];
+				palette[i][c] = (float)(((64 - BC7_WEIGHTS[i]) * v0 + BC7_WEIGHTS[i] * v1 + 32) >> 6);
+			}
+		}
+
+		int indices[16];
+		ProjectIndices(block, 4, endpoints[0], endpoints[1], 16, indices);
+		float error = BlockError(block, 4, palette, indices);
+
+		if (indices[0] & 8)
+		{
+			std::swap(q[0], q[1]);
+			std::swap(pBits[0], pBits[1]);
+			for (int i = 0; i < 16; i++)
+			{
+				indices[i] = 15 - indices[i];
+			}
+		}
+
+		std::memset(pOut, 0, 16);
+		int position = 0;
+		PutBits(pOut, position, 1u << 6, 7);
+		for (int c = 0; c < 4; c++)
+		{
+			PutBits(pOut, position, (unsigned int)q[0][c], 7);
+			PutBits(pOut, position, (unsigned int)q[1][c], 7);
+		}
+		PutBits(pOut, position, (unsigned int)pBits[0], 1);
+		PutBits(pOut, position, (unsigned int)pBits[1], 1);
+		PutBits(pOut, position, (unsigned int)indices[0], 3);
+		for (int i = 1; i < 16; i++)
+		{
+			PutBits(pOut, position, (unsigned int)indices[i], 4);
+		}
+		return error;
+	}
+
+	/***********************************************************
+	 *  CompressBC7Block()
+	 ***********************************************************/
+	void CompressBC7Block(const BLOCK& block, COMPRESS_QUALITY quality, unsigned char* pOut)
+	{
+		float e0[4], e1[4];
+		FitEndpoints(block, 4, e0, e1);
+		float error = EncodeBC7(block, e0, e1, pOut);
+		if ((quality != COMPRESS_REFINED) || (error == 0.0f))
+		{
+			return;
+		}
+
+		int steps[16];
+		float weights[16];
+		ProjectIndices(block, 4, e0, e1, 16, steps);
+		for (int i = 0; i < 16; i++)
+		{
+			weights[i] = BC7_WEIGHTS[steps[i]] / 64.0f;
+		}
+		RefineEndpoints(block, 4, weights, e0, e1);
+
+		unsigned char refined[16];
+		if (EncodeBC7(block, e0, e1, refined) < error)
+		{
+			std::memcpy(pOut, refined, 16);
+		}
+	}
+}
+
+/***********************************************************
+ *  CompressLevel()
+ *
+ *  This method is used for compressing one image level. The
+ *  blocks are written row by row, the layout GL expects.
+ ***********************************************************/
+std::vector<unsigned char> TextureCompressor::CompressLevel(
+	const unsigned char* pixels,
+	int width,
+	int height,
+	int channels,
+	bool bAlpha,
+	COMPRESS_QUALITY quality,
+	ThreadPool* pPool)
+{
+	const int blocksX = (width + 3) / 4;
+	const int blocksY = (height + 3) / 4;
+	const size_t blockBytes = bAlpha ? 16 : 8;
+	std::vector<unsigned char> blocks((size_t)blocksX * blocksY * blockBytes);
+
+	auto compressRows = [&](size_t begin, size_t end)
+	{
+		BLOCK block;
+		for (size_t by = begin; by < end; by++)
+		{
+			for (int bx = 0; bx < blocksX; bx++)
+			{
+				LoadBlock(pixels, width, height, channels, bx, (int)by, block);
+				unsigned char* pOut = blocks.data() + (by * blocksX + bx) * blockBytes;
+				if (bAlpha)
+				{
+					CompressBC7Block(block, quality, pOut);
+				}
+				else
+				{
+					CompressBC1Block(block, quality, pOut);
+				}
+			}
+		}
+	};
+
+	if (NULL != pPool)
+	{
+		pPool->ParallelFor((size_t)blocksY, BLOCK_ROW_GRAIN, compressRows);
+	}
+	else
+	{
+		compressRows(0, (size_t)blocksY);
+	}
+	return blocks;
+}
+
+/***********************************************************
+ *  Compress()
+ *
+ *  This method is used for compressing a texture and all of
+ *  its mip levels in one format.
+ ***********************************************************/
+COMPRESSED_TEXTURE TextureCompressor::Compress(
+	const unsigned char* pixels,
+	int width,
+	int height,
+	int channels,
+	const std::vector<MIP_LEVEL>& mipLevels,
+	COMPRESS_QUALITY quality,
+	ThreadPool* pPool)
+{
+	COMPRESSED_TEXTURE texture;
+	if ((NULL == pixels) || (width <= 0) || (height <= 0) || (channels < 1) || (channels > 4))
+	{
+		return texture;
+	}
+
+	// only pay for BC7 when some pixel is actually transparent
+	bool bAlpha = false;
+	if ((channels == 2) || (channels == 4))
+	{
+		const size_t count = (size_t)width * height;
+		for (size_t i = 0; (i < count) && !bAlpha; i++)
+		{
+			bAlpha = (pixels[i * channels + channels - 1] != 255);
+		}
+	}
+	texture.format = bAlpha ? GL_COMPRESSED_RGBA_BPTC_UNORM : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+	COMPRESSED_TEXTURE::LEVEL base;
+	base.width = width;
+	base.height = height;
+	base.blocks = CompressLevel(pixels, width, height, channels, bAlpha, quality, pPool);
+	texture.levels.push_back(std::move(base));
+
+	for (const MIP_LEVEL& mip : mipLevels)
+	{
+		COMPRESSED_TEXTURE::LEVEL level;
+		level.width = mip.width;
+		level.height = mip.height;
+		level.blocks = CompressLevel(mip.pixels.data(), mip.width, mip.height, channels, bAlpha, quality, pPool);
+		texture.levels.push_back(std::move(level));
+	}
+	return texture;
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking the driver exposes S3TC
+ *  for BC1 and BPTC for BC7 (core since OpenGL 4.2).
+ ***********************************************************/
+bool TextureCompressor::IsSupported()
+{
+	return GLEW_EXT_texture_compression_s3tc && GLEW_ARB_texture_compression_bptc;
+}
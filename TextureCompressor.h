@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecompressor.h
+// ============
+// BC1 and BC7 block compression of decoded textures at load time
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ThreadPool.h"
+#include "MipGenerator.h"
+
+#include <GL/glew.h>
+
+#include <vector>
+
+/***********************************************************
+ *  COMPRESS_QUALITY
+ *
+ *  How much work goes into each 4x4 block.
+ ***********************************************************/
+enum COMPRESS_QUALITY
+{
+	// endpoints from the extent of the block along its principal axis
+	COMPRESS_FAST = 0,
+	// plus a least squares refit of the endpoints to the chosen indices
+	COMPRESS_REFINED
+};
+
+/***********************************************************
+ *  COMPRESSED_TEXTURE
+ *
+ *  Every level of a block compressed texture, base first,
+ *  ready for glCompressedTexImage2D().
+ ***********************************************************/
+struct COMPRESSED_TEXTURE
+{
+	struct LEVEL
+	{
+		int width = 0;
+		int height = 0;
+		std::vector<unsigned char> blocks;
+	};
+
+	GLenum format = 0;
+	std::vector<LEVEL> levels;
+};
+
+/***********************************************************
+ *  TextureCompressor
+ *
+ *  This class compresses 8 bit images into 4x4 blocks: BC1
+ *  (8 bytes a block, 1/6 of RGB8) for opaque images, and BC7
+ *  mode 6 (16 bytes a block, 1/4 of RGBA8) for images with
+ *  any transparency. Endpoints come from the principal axis
+ *  of each block's colours and the indices from projecting
+ *  onto the quantized endpoints, four pixels at a time with
+ *  SSE2. Rows of blocks are spread across the pool.
+ ***********************************************************/
+class TextureCompressor
+{
+public:
+	// compress the base image and its mip chain; the format is BC7 when
+	// the image has an alpha channel that is not fully opaque, else BC1
+	static COMPRESSED_TEXTURE Compress(
+		const unsigned char* pixels,
+		int width,
+		int height,
+		int channels,
+		const std::vector<MIP_LEVEL>& mipLevels,
+		COMPRESS_QUALITY quality,
+		ThreadPool* pPool);
+
+	// compress one level into BC1 or BC7 blocks, row by row
+	static std::vector<unsigned char> CompressLevel(
+		const unsigned char* pixels,
+		int width,
+		int height,
+		int channels,
+		bool bAlpha,
+		COMPRESS_QUALITY quality,
+		ThreadPool* pPool);
+
+	// true when the driver can sample both formats
+	static bool IsSupported();
+};
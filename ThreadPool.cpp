@@ -0,0 +1,196 @@
+///////////////////////////////////////////////////////////////////////////////
+// threadpool.cpp
+// ============
+// fixed set of worker threads for parallel loops and background tasks
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+/***********************************************************
+ *  ThreadPool()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ThreadPool::ThreadPool(int threadCount)
+{
+	m_running = 0;
+	m_bStopping = false;
+
+	for (int i = 1; i < std::max(threadCount, 1); i++)
+	{
+		m_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+/***********************************************************
+ *  ~ThreadPool()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_taskReady.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+/***********************************************************
+ *  DefaultThreadCount()
+ *
+ *  This method is used for getting the number of hardware
+ *  threads, which is the default size of a pool.
+ ***********************************************************/
+int ThreadPool::DefaultThreadCount()
+{
+	return std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+/***********************************************************
+ *  WorkerLoop()
+ *
+ *  This method is used for running queued tasks on a worker
+ *  thread until the pool is destroyed. The queue is drained
+ *  before the workers exit.
+ ***********************************************************/
+void ThreadPool::WorkerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_taskReady.wait(lock, [this]() { return m_bStopping || !m_tasks.empty(); });
+			if (m_tasks.empty())
+			{
+				return;
+			}
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+			m_running++;
+		}
+
+		task();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_running--;
+			if ((m_running == 0) && m_tasks.empty())
+			{
+				m_idle.notify_all();
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method is used for queueing a task for the workers.
+ *  With no workers the task runs immediately on the caller.
+ ***********************************************************/
+void ThreadPool::Submit(std::function<void()> task)
+{
+	if (m_workers.empty())
+	{
+		task();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+	m_taskReady.notify_one();
+}
+
+/***********************************************************
+ *  WaitIdle()
+ *
+ *  This method is used for blocking until every queued task
+ *  has finished.
+ ***********************************************************/
+void ThreadPool::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this]() { return (m_running == 0) && m_tasks.empty(); });
+}
+
+/***********************************************************
+ *  ParallelFor()
+ *
+ *  This method is used for running a task over a range of
+ *  items. Chunks are handed out through an atomic counter to
+ *  the workers and the calling thread, which balances uneven
+ *  chunks without any per-item locking. Returns when the
+ *  whole range is done. It only waits for the chunks, not for
+ *  the helper tasks, so it is safe to call from a worker: if
+ *  every worker is busy the caller simply runs every chunk.
+ ***********************************************************/
+void ThreadPool::ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& task)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	grain = std::max<size_t>(grain, 1);
+	const size_t chunks = (count + grain - 1) / grain;
+	const size_t helpers = std::min(m_workers.size(), chunks - 1);
+
+	if (helpers == 0)
+	{
+		task(0, count);
+		return;
+	}
+
+	// shared between the helpers, which may start after this call has
+	// returned, finding no chunks left
+	struct LOOP_STATE
+	{
+		std::atomic<size_t> nextChunk{ 0 };
+		std::atomic<size_t> finishedChunks{ 0 };
+		std::mutex mutex;
+		std::condition_variable done;
+	};
+	std::shared_ptr<LOOP_STATE> state = std::make_shared<LOOP_STATE>();
+
+	auto runChunks = [state, count, grain, chunks, &task]()
+	{
+		for (;;)
+		{
+			size_t chunk = state->nextChunk.fetch_add(1);
+			if (chunk >= chunks)
+			{
+				return;
+			}
+			size_t begin = chunk * grain;
+			task(begin, std::min(begin + grain, count));
+			if (state->finishedChunks.fetch_add(1) + 1 == chunks)
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->done.notify_all();
+			}
+		}
+	};
+
+	for (size_t i = 0; i < helpers; i++)
+	{
+		Submit(runChunks);
+	}
+
+	runChunks();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->done.wait(lock, [&]() { return state->finishedChunks.load() == chunks; });
+}
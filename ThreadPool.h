@@ -0,0 +1,59 @@
+///////////////////////////////////////////////////////////////////////////////
+// threadpool.h
+// ============
+// fixed set of worker threads for parallel loops and background tasks
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  ThreadPool
+ *
+ *  This class owns a fixed number of worker threads that
+ *  take tasks from a shared queue. ParallelFor() splits a
+ *  range into chunks that the workers and the calling thread
+ *  pull from until the range is done, so a pool of N threads
+ *  keeps N cores busy including the caller.
+ ***********************************************************/
+class ThreadPool
+{
+public:
+	// threadCount includes the calling thread, so 1 means no workers
+	explicit ThreadPool(int threadCount);
+	// destructor - finishes the queued tasks and joins the workers
+	~ThreadPool();
+
+	// threads taking part in ParallelFor(), including the caller
+	int GetThreadCount() const { return (int)m_workers.size() + 1; }
+
+	// run task(begin, end) over [0, count) in chunks of up to grain items
+	void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& task);
+
+	// queue a task to run on a worker thread
+	void Submit(std::function<void()> task);
+	// wait until the queue is empty and no task is running
+	void WaitIdle();
+
+	// hardware threads available, at least 1
+	static int DefaultThreadCount();
+
+private:
+	std::vector<std::thread> m_workers;
+	std::deque<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_taskReady;
+	std::condition_variable m_idle;
+	int m_running;
+	bool m_bStopping;
+
+	void WorkerLoop();
+};
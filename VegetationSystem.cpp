@@ -0,0 +1,482 @@
+///////////////////////////////////////////////////////////////////////////////
+// vegetationsystem.cpp
+// ============
+// procedural, tiled, instanced grass and undergrowth over the ground
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "VegetationSystem.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
+namespace
+{
+	// attribute locations of the per-instance data
+	const GLuint PLACEMENT_ATTRIBUTE = 3;
+	const GLuint VARIATION_ATTRIBUTE = 4;
+
+	// radius of the bare clearing left around the campsite when
+	// no density map is supplied
+	const float CAMP_CLEARING_RADIUS = 14.0f;
+
+	/***********************************************************
+	 *  HashTile()
+	 *
+	 *  Mix the seed and tile coordinates into the starting
+	 *  state of the tile's random sequence, so every tile is
+	 *  regenerated identically whenever it comes back in view.
+	 ***********************************************************/
+	uint32_t HashTile(uint32_t seed, int tileX, int tileZ)
+	{
+		uint32_t h = seed ^ 0x9E3779B9u;
+		h ^= (uint32_t)tileX * 0x85EBCA6Bu;
+		h = (h << 13) | (h >> 19);
+		h ^= (uint32_t)tileZ * 0xC2B2AE35u;
+		h ^= h >> 16;
+		h *= 0x7FEB352Du;
+		h ^= h >> 15;
+		h *= 0x846CA68Bu;
+		h ^= h >> 16;
+		return h;
+	}
+
+	// xorshift random number in [0, 1)
+	float NextRandom(uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+}
+
+/***********************************************************
+ *  VegetationSystem()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+VegetationSystem::VegetationSystem()
+{
+	m_pShader = NULL;
+	m_densityWidth = 0;
+	m_densityHeight = 0;
+	m_vao = 0;
+	m_bladeVBO = 0;
+	m_instanceVBO = 0;
+	m_indirectBuffer = 0;
+	m_bladeVertexCount = 0;
+	m_frame = 0;
+	m_drawnInstances = 0;
+}
+
+/***********************************************************
+ *  ~VegetationSystem()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+VegetationSystem::~VegetationSystem()
+{
+	if (m_indirectBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_indirectBuffer);
+	}
+	if (m_instanceVBO != 0)
+	{
+		glDeleteBuffers(1, &m_instanceVBO);
+	}
+	if (m_bladeVBO != 0)
+	{
+		glDeleteBuffers(1, &m_bladeVBO);
+	}
+	if (m_vao != 0)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+	}
+	delete m_pShader;
+	m_pShader = NULL;
+}
+
+/***********************************************************
+ *  LoadDensityMap()
+ *
+ *  This method is used for reading the density map, or
+ *  building the default meadow when there is none. The flip
+ *  setting is per thread, so image decodes running on the
+ *  other loader workers are not affected.
+ ***********************************************************/
+void VegetationSystem::LoadDensityMap(const VEGETATION_SETTINGS& settings, const char* densityMapFile)
+{
+	m_settings = settings;
+
+	int channels = 0;
+	stbi_set_flip_vertically_on_load_thread(0);
+	unsigned char* image = (NULL != densityMapFile) ?
+		stbi_load(densityMapFile, &m_densityWidth, &m_densityHeight, &channels, 1) : NULL;
+	if (image)
+	{
+		m_density.assign(image, image + (size_t)m_densityWidth * m_densityHeight);
+		stbi_image_free(image);
+	}
+	else
+	{
+		// no map - full density except for a clearing around the camp
+		std::cout << "[VegetationSystem] No density map, using the default meadow" << std::endl;
+		m_densityWidth = 256;
+		m_densityHeight = 256;
+		m_density.resize((size_t)m_densityWidth * m_densityHeight);
+		for (int y = 0; y < m_densityHeight; y++)
+		{
+			for (int x = 0; x < m_densityWidth; x++)
+			{
+				float wx = m_settings.worldMin.x + (x + 0.5f) / m_densityWidth * (m_settings.worldMax.x - m_settings.worldMin.x);
+				float wz = m_settings.worldMin.y + (y + 0.5f) / m_densityHeight * (m_settings.worldMax.y - m_settings.worldMin.y);
+				float distance = std::sqrt(wx * wx + wz * wz);
+				float density = glm::clamp((distance - CAMP_CLEARING_RADIUS) / 6.0f, 0.0f, 1.0f);
+				m_density[(size_t)y * m_densityWidth + x] = (unsigned char)(density * 255.0f);
+			}
+		}
+	}
+	stbi_set_flip_vertically_on_load_thread(1);
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for loading the density map, if it
+ *  was not loaded ahead, and the shaders, building the blade
+ *  shape, and allocating the instance buffer for a fixed
+ *  number of tile slots - just enough to cover the fade
+ *  distance around the camera.
+ ***********************************************************/
+bool VegetationSystem::Initialize(const VEGETATION_SETTINGS& settings, const char* densityMapFile)
+{
+	if (m_density.empty())
+	{
+		LoadDensityMap(settings, densityMapFile);
+	}
+	m_settings = settings;
+
+	m_pShader = new ShaderManager();
+	m_pShader->LoadShaders(
+		"shaders/vegetationVertexShader.glsl",
+		"shaders/vegetationFragmentShader.glsl");
+
+	// two crossed quads: position xyz, uv
+	const float blade[] = {
+		-0.5f, 0.0f, 0.0f, 0.0f, 0.0f,   0.5f, 0.0f, 0.0f, 1.0f, 0.0f,   0.5f, 1.0f, 0.0f, 1.0f, 1.0f,
+		-0.5f, 0.0f, 0.0f, 0.0f, 0.0f,   0.5f, 1.0f, 0.0f, 1.0f, 1.0f,  -0.5f, 1.0f, 0.0f, 0.0f, 1.0f,
+		 0.0f, 0.0f,-0.5f, 0.0f, 0.0f,   0.0f, 0.0f, 0.5f, 1.0f, 0.0f,   0.0f, 1.0f, 0.5f, 1.0f, 1.0f,
+		 0.0f, 0.0f,-0.5f, 0.0f, 0.0f,   0.0f, 1.0f, 0.5f, 1.0f, 1.0f,   0.0f, 1.0f,-0.5f, 0.0f, 1.0f };
+	m_bladeVertexCount = 12;
+
+	// slots for every tile that can be within the fade distance
+	int tilesAcross = (int)std::ceil(2.0f * m_settings.fadeEnd / m_settings.tileSize) + 1;
+	m_slots.resize((size_t)tilesAcross * tilesAcross);
+	for (TILE_SLOT& slot : m_slots)
+	{
+		slot.bValid = false;
+		slot.instanceCount = 0;
+		slot.lastUsedFrame = 0;
+		slot.tileX = 0;
+		slot.tileZ = 0;
+	}
+	m_scratch.reserve(m_settings.instancesPerTile);
+
+	glGenVertexArrays(1, &m_vao);
+	glBindVertexArray(m_vao);
+
+	glGenBuffers(1, &m_bladeVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_bladeVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(blade), blade, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+
+	glGenBuffers(1, &m_instanceVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+	glBufferData(
+		GL_ARRAY_BUFFER,
+		m_slots.size() * m_settings.instancesPerTile * sizeof(VEGETATION_INSTANCE),
+		NULL,
+		GL_DYNAMIC_DRAW);
+	glEnableVertexAttribArray(PLACEMENT_ATTRIBUTE);
+	glVertexAttribPointer(PLACEMENT_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(VEGETATION_INSTANCE), (void*)offsetof(VEGETATION_INSTANCE, placement));
+	glVertexAttribDivisor(PLACEMENT_ATTRIBUTE, 1);
+	glEnableVertexAttribArray(VARIATION_ATTRIBUTE);
+	glVertexAttribPointer(VARIATION_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(VEGETATION_INSTANCE), (void*)offsetof(VEGETATION_INSTANCE, variation));
+	glVertexAttribDivisor(VARIATION_ATTRIBUTE, 1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glGenBuffers(1, &m_indirectBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, m_slots.size() * sizeof(DRAW_ARRAYS_COMMAND), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	std::cout << "[VegetationSystem] Tile pool: " << m_slots.size()
+		<< " tiles, " << m_slots.size() * m_settings.instancesPerTile << " instances max"
+		<< std::endl;
+
+	return true;
+}
+
+/***********************************************************
+ *  SampleDensity()
+ *
+ *  This method is used for reading the density map with
+ *  bilinear filtering at a world position.
+ ***********************************************************/
+float VegetationSystem::SampleDensity(float x, float z) const
+{
+	float u = (x - m_settings.worldMin.x) / (m_settings.worldMax.x - m_settings.worldMin.x);
+	float v = (z - m_settings.worldMin.y) / (m_settings.worldMax.y - m_settings.worldMin.y);
+	if ((u < 0.0f) || (u > 1.0f) || (v < 0.0f) || (v > 1.0f) || m_density.empty())
+	{
+		return 0.0f;
+	}
+
+	float fx = u * (m_densityWidth - 1);
+	float fy = v * (m_densityHeight - 1);
+	int x0 = (int)fx;
+	int y0 = (int)fy;
+	int x1 = std::min(x0 + 1, m_densityWidth - 1);
+	int y1 = std::min(y0 + 1, m_densityHeight - 1);
+	float tx = fx - x0;
+	float ty = fy - y0;
+
+	float a = m_density[(size_t)y0 * m_densityWidth + x0];
+	float b = m_density[(size_t)y0 * m_densityWidth + x1];
+	float c = m_density[(size_t)y1 * m_densityWidth + x0];
+	float d = m_density[(size_t)y1 * m_densityWidth + x1];
+	return glm::mix(glm::mix(a, b, tx), glm::mix(c, d, tx), ty) / 255.0f;
+}
+
+/***********************************************************
+ *  AcquireSlot()
+ *
+ *  This method is used for finding the slot holding a tile,
+ *  or recycling the least recently used slot for it.
+ ***********************************************************/
+int VegetationSystem::AcquireSlot(int tileX, int tileZ)
+{
+	int oldest = 0;
+	for (size_t i = 0; i < m_slots.size(); i++)
+	{
+		TILE_SLOT& slot = m_slots[i];
+		if (slot.bValid && (slot.tileX == tileX) && (slot.tileZ == tileZ))
+		{
+			slot.lastUsedFrame = m_frame;
+			return (int)i;
+		}
+		// empty slots first, then the one unused for longest
+		const TILE_SLOT& best = m_slots[oldest];
+		if (best.bValid && (!slot.bValid || (slot.lastUsedFrame < best.lastUsedFrame)))
+		{
+			oldest = (int)i;
+		}
+	}
+
+	GenerateTile(oldest, tileX, tileZ);
+	return oldest;
+}
+
+/***********************************************************
+ *  GenerateTile()
+ *
+ *  This method is used for scattering the instances of one
+ *  tile. Candidate points come from the tile's seeded random
+ *  sequence and survive with the probability given by the
+ *  density map, so the result never has to be stored.
+ ***********************************************************/
+void VegetationSystem::GenerateTile(int slotIndex, int tileX, int tileZ)
+{
+	uint32_t state = HashTile(m_settings.seed, tileX, tileZ) | 1u;
+	float originX = tileX * m_settings.tileSize;
+	float originZ = tileZ * m_settings.tileSize;
+
+	m_scratch.clear();
+	for (int i = 0; i < m_settings.instancesPerTile; i++)
+	{
+		float x = originX + NextRandom(state) * m_settings.tileSize;
+		float z = originZ + NextRandom(state) * m_settings.tileSize;
+		float keep = NextRandom(state);
+		float rotation = NextRandom(state) * 6.2831853f;
+		float size = NextRandom(state);
+		float kind = (NextRandom(state) < m_settings.undergrowthRatio) ? 1.0f : 0.0f;
+		float tint = NextRandom(state);
+
+		if (keep >= SampleDensity(x, z))
+		{
+			continue;
+		}
+
+		VEGETATION_INSTANCE instance;
+		if (kind < 0.5f)
+		{
+			instance.placement = glm::vec4(x, 0.0f, z, 0.35f + 0.45f * size);
+			instance.variation = glm::vec4(rotation, 0.08f + 0.05f * size, kind, tint);
+		}
+		else
+		{
+			instance.placement = glm::vec4(x, 0.0f, z, 0.4f + 0.3f * size);
+			instance.variation = glm::vec4(rotation, 0.5f + 0.4f * size, kind, tint);
+		}
+		m_scratch.push_back(instance);
+	}
+
+	TILE_SLOT& slot = m_slots[slotIndex];
+	slot.tileX = tileX;
+	slot.tileZ = tileZ;
+	slot.bValid = true;
+	slot.instanceCount = (uint32_t)m_scratch.size();
+	slot.lastUsedFrame = m_frame;
+
+	if (!m_scratch.empty())
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+		glBufferSubData(
+			GL_ARRAY_BUFFER,
+			(GLintptr)slotIndex * m_settings.instancesPerTile * sizeof(VEGETATION_INSTANCE),
+			m_scratch.size() * sizeof(VEGETATION_INSTANCE),
+			m_scratch.data());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+}
+
+/***********************************************************
+ *  Render()
+ *
+ *  This method is used for drawing the vegetation around the
+ *  camera. Tiles outside the fade radius or the view frustum
+ *  are skipped; the rest go out in one multi-draw, blended by
+ *  alpha-to-coverage so no sorting is required.
+ ***********************************************************/
+void VegetationSystem::Render(
+	const VIEW_INFO& viewInfo,
+	glm::vec3 lightDirection,
+	glm::vec3 lightColor,
+	glm::vec3 ambientColor)
+{
+	if (NULL == m_pShader)
+	{
+		return;
+	}
+	m_frame++;
+
+	// frustum planes from the rows of the view-projection matrix
+	glm::mat4 viewProjection = viewInfo.projection * viewInfo.view;
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; r++)
+	{
+		rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+	}
+	glm::vec4 planes[6] = {
+		rows[3] + rows[0], rows[3] - rows[0],
+		rows[3] + rows[1], rows[3] - rows[1],
+		rows[3] + rows[2], rows[3] - rows[2] };
+
+	const float tileSize = m_settings.tileSize;
+	const float radius = m_settings.fadeEnd;
+	int minX = (int)std::floor((viewInfo.position.x - radius) / tileSize);
+	int maxX = (int)std::floor((viewInfo.position.x + radius) / tileSize);
+	int minZ = (int)std::floor((viewInfo.position.z - radius) / tileSize);
+	int maxZ = (int)std::floor((viewInfo.position.z + radius) / tileSize);
+
+	m_commands.clear();
+	m_drawnInstances = 0;
+	for (int tz = minZ; tz <= maxZ; tz++)
+	{
+		for (int tx = minX; tx <= maxX; tx++)
+		{
+			glm::vec3 tileMin(tx * tileSize, 0.0f, tz * tileSize);
+			glm::vec3 tileMax(tileMin.x + tileSize, 1.0f, tileMin.z + tileSize);
+
+			// distance from the camera to the nearest point of the tile
+			glm::vec3 nearest;
+			nearest.x = glm::clamp(viewInfo.position.x, tileMin.x, tileMax.x);
+			nearest.y = glm::clamp(viewInfo.position.y, tileMin.y, tileMax.y);
+			nearest.z = glm::clamp(viewInfo.position.z, tileMin.z, tileMax.z);
+			if (glm::length(nearest - viewInfo.position) > radius)
+			{
+				continue;
+			}
+
+			bool bVisible = true;
+			for (const glm::vec4& plane : planes)
+			{
+				glm::vec3 positive(
+					(plane.x >= 0.0f) ? tileMax.x : tileMin.x,
+					(plane.y >= 0.0f) ? tileMax.y : tileMin.y,
+					(plane.z >= 0.0f) ? tileMax.z : tileMin.z);
+				if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f)
+				{
+					bVisible = false;
+					break;
+				}
+			}
+			if (!bVisible)
+			{
+				continue;
+			}
+
+			int slot = AcquireSlot(tx, tz);
+			if (m_slots[slot].instanceCount == 0)
+			{
+				continue;
+			}
+
+			DRAW_ARRAYS_COMMAND command;
+			command.count = (GLuint)m_bladeVertexCount;
+			command.instanceCount = m_slots[slot].instanceCount;
+			command.first = 0;
+			command.baseInstance = (GLuint)(slot * m_settings.instancesPerTile);
+			m_commands.push_back(command);
+			m_drawnInstances += command.instanceCount;
+		}
+	}
+
+	if (m_commands.empty())
+	{
+		return;
+	}
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+	m_pShader->use();
+	m_pShader->setMat4Value("view", viewInfo.view);
+	m_pShader->setMat4Value("projection", viewInfo.projection);
+	m_pShader->setVec3Value("viewPosition", viewInfo.position);
+	m_pShader->setFloatValue("fadeStart", m_settings.fadeStart);
+	m_pShader->setFloatValue("fadeEnd", m_settings.fadeEnd);
+	m_pShader->setFloatValue("time", (float)glfwGetTime());
+	m_pShader->setVec3Value("lightDirection", lightDirection);
+	m_pShader->setVec3Value("lightColor", lightColor);
+	m_pShader->setVec3Value("ambientColor", ambientColor);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, m_slots.size() * sizeof(DRAW_ARRAYS_COMMAND), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, m_commands.size() * sizeof(DRAW_ARRAYS_COMMAND), m_commands.data());
+
+	// blades are thin and double sided - no culling, coverage instead of blending
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_BLEND);
+	glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+
+	glBindVertexArray(m_vao);
+	glMultiDrawArraysIndirect(GL_TRIANGLES, (void*)0, (GLsizei)m_commands.size(), 0);
+	glBindVertexArray(0);
+
+	glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+	glEnable(GL_BLEND);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	glUseProgram(previousProgram);
+}
@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////////////////////////////
+// vegetationsystem.h
+// ============
+// procedural, tiled, instanced grass and undergrowth over the ground
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "ViewManager.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  VEGETATION_SETTINGS
+ *
+ *  Where and how densely vegetation is scattered.
+ ***********************************************************/
+struct VEGETATION_SETTINGS
+{
+	// world rectangle covered by the density map (x, z) - the ground plane
+	glm::vec2 worldMin = glm::vec2(-300.0f, -200.0f);
+	glm::vec2 worldMax = glm::vec2(300.0f, 200.0f);
+	// edge length of one generated tile
+	float tileSize = 16.0f;
+	// instances per tile where the density map is fully white
+	int instancesPerTile = 1536;
+	// distance at which blades start and finish fading out
+	float fadeStart = 45.0f;
+	float fadeEnd = 60.0f;
+	// fraction of instances that are undergrowth rather than grass
+	float undergrowthRatio = 0.08f;
+	// seed for the placement hash - same seed, same meadow
+	uint32_t seed = 1337;
+};
+
+/***********************************************************
+ *  VegetationSystem
+ *
+ *  This class scatters vegetation from a density map and a
+ *  seed without storing any per-blade data for the world.
+ *  Only the tiles around the camera are generated, into a
+ *  fixed pool of tile slots that is recycled as the camera
+ *  moves, so memory does not grow with the world size.
+ ***********************************************************/
+class VegetationSystem
+{
+public:
+	// constructor
+	VegetationSystem();
+	// destructor
+	~VegetationSystem();
+
+	// read the density map; no OpenGL, so it can run on a worker before
+	// the context exists
+	void LoadDensityMap(const VEGETATION_SETTINGS& settings, const char* densityMapFile);
+	// load the shaders, the density map unless it is loaded already, and
+	// allocate the tile pool
+	bool Initialize(const VEGETATION_SETTINGS& settings, const char* densityMapFile);
+
+	// generate missing tiles, cull, and draw the visible ones
+	void Render(
+		const VIEW_INFO& viewInfo,
+		glm::vec3 lightDirection,
+		glm::vec3 lightColor,
+		glm::vec3 ambientColor);
+
+	// instances generated for the tiles drawn last frame
+	size_t GetDrawnInstanceCount() const { return m_drawnInstances; }
+
+private:
+	// per-instance vertex data, see vegetationVertexShader.glsl
+	struct VEGETATION_INSTANCE
+	{
+		glm::vec4 placement;
+		glm::vec4 variation;
+	};
+
+	// one slot of the tile pool
+	struct TILE_SLOT
+	{
+		int tileX;
+		int tileZ;
+		bool bValid;
+		uint32_t instanceCount;
+		uint64_t lastUsedFrame;
+	};
+
+	// indirect draw command for glMultiDrawArraysIndirect
+	struct DRAW_ARRAYS_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint first;
+		GLuint baseInstance;
+	};
+
+	VEGETATION_SETTINGS m_settings;
+	ShaderManager* m_pShader;
+
+	// density map, one byte per texel
+	std::vector<unsigned char> m_density;
+	int m_densityWidth;
+	int m_densityHeight;
+
+	GLuint m_vao;
+	GLuint m_bladeVBO;
+	GLuint m_instanceVBO;
+	GLuint m_indirectBuffer;
+	GLsizei m_bladeVertexCount;
+
+	std::vector<TILE_SLOT> m_slots;
+	std::vector<VEGETATION_INSTANCE> m_scratch;
+	std::vector<DRAW_ARRAYS_COMMAND> m_commands;
+	uint64_t m_frame;
+	size_t m_drawnInstances;
+
+	float SampleDensity(float x, float z) const;
+	int AcquireSlot(int tileX, int tileZ);
+	void GenerateTile(int slot, int tileX, int tileZ);
+};
@@ -0,0 +1,517 @@
+///////////////////////////////////////////////////////////////////////////////
+// videoexporter.cpp
+// ============
+// streams rendered frames to a Y4M or raw RGB file or pipe
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "VideoExporter.h"
+
+#include "GLFW/glfw3.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32)
+#define EXPORT_POPEN _popen
+#define EXPORT_PCLOSE _pclose
+#else
+#define EXPORT_POPEN popen
+#define EXPORT_PCLOSE pclose
+#endif
+
+namespace
+{
+	// as the window, see InitializeGLFW()
+	const int RENDER_SAMPLES = 4;
+	// longest single wait for a read to finish, in nanoseconds
+	const GLuint64 READBACK_TIMEOUT = 1000000000;
+
+	// full range BT.601, as Y4M's C420jpeg expects, in 8 bit fixed point;
+	// the chroma offset of 128 keeps the sums positive before the shift
+	inline unsigned char LumaOf(int r, int g, int b)
+	{
+		return (unsigned char)((77 * r + 150 * g + 29 * b + 128) >> 8);
+	}
+	inline unsigned char BlueDifferenceOf(int r, int g, int b)
+	{
+		return (unsigned char)((-43 * r - 85 * g + 128 * b + 32895) >> 8);
+	}
+	inline unsigned char RedDifferenceOf(int r, int g, int b)
+	{
+		return (unsigned char)((128 * r - 107 * g - 21 * b + 32895) >> 8);
+	}
+}
+
+/***********************************************************
+ *  VideoExporter()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+VideoExporter::VideoExporter()
+{
+	m_format = VIDEO_Y4M;
+	m_width = 0;
+	m_height = 0;
+	m_bOpen = false;
+	m_pOutput = NULL;
+	m_bPipe = false;
+	m_renderFramebuffer = 0;
+	m_renderColor = 0;
+	m_renderDepth = 0;
+	m_resolveFramebuffer = 0;
+	m_resolveColor = 0;
+	m_nextReadback = 0;
+	m_oldestReadback = 0;
+	m_capturedFrames = 0;
+	m_stalls = 0;
+	m_startTime = 0.0;
+	m_bClosing = false;
+	m_bWriteFailed = false;
+}
+
+/***********************************************************
+ *  ~VideoExporter()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+VideoExporter::~VideoExporter()
+{
+	if (m_bOpen)
+	{
+		Finish();
+	}
+	Destroy();
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for releasing the framebuffers and
+ *  pixel buffers.
+ ***********************************************************/
+void VideoExporter::Destroy()
+{
+	for (READBACK& readback : m_readbacks)
+	{
+		if (NULL != readback.fence)
+		{
+			glDeleteSync(readback.fence);
+		}
+		glDeleteBuffers(1, &readback.buffer);
+	}
+	m_readbacks.clear();
+	if (m_resolveFramebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_resolveFramebuffer);
+		glDeleteRenderbuffers(1, &m_resolveColor);
+		m_resolveFramebuffer = 0;
+		m_resolveColor = 0;
+	}
+	if (m_renderFramebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_renderFramebuffer);
+		glDeleteRenderbuffers(1, &m_renderColor);
+		glDeleteRenderbuffers(1, &m_renderDepth);
+		m_renderFramebuffer = 0;
+		m_renderColor = 0;
+		m_renderDepth = 0;
+	}
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for opening the file or starting the
+ *  command, writing the Y4M header, creating the resolve and
+ *  headless framebuffers and the ring of pixel buffers, and
+ *  starting the writer.
+ ***********************************************************/
+bool VideoExporter::Open(const VIDEO_EXPORT_SETTINGS& settings, int width, int height)
+{
+	m_settings = settings;
+	m_settings.framesPerSecond = std::max(m_settings.framesPerSecond, 1);
+	m_settings.readbackDepth = std::max(m_settings.readbackDepth, 1);
+	m_settings.queueDepth = std::max(m_settings.queueDepth, 1);
+	m_width = std::max(width, 1);
+	m_height = std::max(height, 1);
+
+	const std::string& output = m_settings.output;
+	m_bPipe = !output.empty() && (output[0] == '|');
+	m_format = ((output.size() >= 4) && (output.compare(output.size() - 4, 4, ".rgb") == 0)) ? VIDEO_RAW_RGB : VIDEO_Y4M;
+	m_pOutput = m_bPipe ? EXPORT_POPEN(output.c_str() + 1, "wb") : fopen(output.c_str(), "wb");
+	if (NULL == m_pOutput)
+	{
+		std::cout << "[VideoExporter] Could not open " << output << std::endl;
+		return false;
+	}
+	if (m_format == VIDEO_Y4M)
+	{
+		fprintf(m_pOutput, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", m_width, m_height, m_settings.framesPerSecond);
+	}
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGenRenderbuffers(1, &m_resolveColor);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_resolveColor);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_width, m_height);
+	glGenFramebuffers(1, &m_resolveFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_resolveFramebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_resolveColor);
+	bool bComplete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+	if (m_settings.bHeadless)
+	{
+		// the depth format matches the window's, for GPUCuller::CaptureDepth()
+		glGenRenderbuffers(1, &m_renderColor);
+		glBindRenderbuffer(GL_RENDERBUFFER, m_renderColor);
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, RENDER_SAMPLES, GL_RGBA8, m_width, m_height);
+		glGenRenderbuffers(1, &m_renderDepth);
+		glBindRenderbuffer(GL_RENDERBUFFER, m_renderDepth);
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, RENDER_SAMPLES, GL_DEPTH24_STENCIL8, m_width, m_height);
+		glGenFramebuffers(1, &m_renderFramebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_renderFramebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_renderColor);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_renderDepth);
+		bComplete = bComplete && (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	}
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+	if (!bComplete)
+	{
+		std::cout << "[VideoExporter] ERROR: Export framebuffer incomplete" << std::endl;
+		Destroy();
+		if (m_bPipe)
+		{
+			EXPORT_PCLOSE(m_pOutput);
+		}
+		else
+		{
+			fclose(m_pOutput);
+		}
+		m_pOutput = NULL;
+		return false;
+	}
+
+	const GLsizeiptr frameBytes = (GLsizeiptr)m_width * m_height * 4;
+	m_readbacks.resize(m_settings.readbackDepth);
+	for (READBACK& readback : m_readbacks)
+	{
+		glGenBuffers(1, &readback.buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, NULL, GL_STREAM_READ);
+		readback.fence = NULL;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	m_nextReadback = 0;
+	m_oldestReadback = 0;
+	m_capturedFrames = 0;
+	m_stalls = 0;
+
+	m_bClosing = false;
+	m_bWriteFailed = false;
+	m_writer = std::thread(&VideoExporter::WriterLoop, this);
+	m_startTime = glfwGetTime();
+	m_bOpen = true;
+
+	std::cout << "[VideoExporter] Exporting " << GetTotalFrames() << " frames of " << m_width << "x" << m_height
+		<< " at " << m_settings.framesPerSecond << " fps to " << output
+		<< (m_settings.bHeadless ? ", headless" : "") << std::endl;
+	return true;
+}
+
+int VideoExporter::GetTotalFrames() const
+{
+	return std::max(1, (int)std::lround(m_settings.duration * m_settings.framesPerSecond));
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for pointing the frame's drawing at
+ *  the offscreen framebuffer when headless. It must come
+ *  before the frame is cleared.
+ ***********************************************************/
+void VideoExporter::BeginFrame()
+{
+	if (m_bOpen && (m_renderFramebuffer != 0))
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, m_renderFramebuffer);
+	}
+}
+
+/***********************************************************
+ *  CaptureFrame()
+ *
+ *  This method is used for queueing the read of the frame
+ *  just drawn: resolving the samples, then reading into the
+ *  next pixel buffer of the ring, which the GPU does in the
+ *  background. Earlier frames whose reads have finished are
+ *  then handed to the writer. Only if the ring has come
+ *  round to a read still in flight is it waited for.
+ ***********************************************************/
+void VideoExporter::CaptureFrame()
+{
+	if (!m_bOpen)
+	{
+		return;
+	}
+
+	READBACK& readback = m_readbacks[m_nextReadback];
+	if (NULL != readback.fence)
+	{
+		m_stalls++;
+		Collect(readback, true);
+	}
+
+	GLint drawFramebuffer = 0;
+	GLint readFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, drawFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_resolveFramebuffer);
+	glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_resolveFramebuffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+	glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+
+	m_nextReadback = (m_nextReadback + 1) % m_readbacks.size();
+	m_capturedFrames++;
+	CollectReady();
+}
+
+/***********************************************************
+ *  CollectReady()
+ *
+ *  This method is used for handing over the reads that have
+ *  finished, oldest first, stopping at the first that has
+ *  not, so the frames reach the writer in order.
+ ***********************************************************/
+void VideoExporter::CollectReady()
+{
+	while (NULL != m_readbacks[m_oldestReadback].fence)
+	{
+		GLenum status = glClientWaitSync(m_readbacks[m_oldestReadback].fence, 0, 0);
+		if ((status != GL_ALREADY_SIGNALED) && (status != GL_CONDITION_SATISFIED))
+		{
+			break;
+		}
+		Collect(m_readbacks[m_oldestReadback], false);
+	}
+}
+
+/***********************************************************
+ *  Collect()
+ *
+ *  This method is used for copying the oldest finished read
+ *  out of its pixel buffer into a frame for the writer,
+ *  waiting for the read first if asked to. If the writer is
+ *  a whole queue behind, this waits for it instead of
+ *  letting the frames pile up.
+ ***********************************************************/
+void VideoExporter::Collect(READBACK& readback, bool bWait)
+{
+	if (bWait)
+	{
+		GLenum status = GL_TIMEOUT_EXPIRED;
+		while (status == GL_TIMEOUT_EXPIRED)
+		{
+			status = glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, READBACK_TIMEOUT);
+		}
+	}
+	glDeleteSync(readback.fence);
+	readback.fence = NULL;
+	m_oldestReadback = (m_oldestReadback + 1) % m_readbacks.size();
+
+	const size_t frameBytes = (size_t)m_width * m_height * 4;
+	std::vector<unsigned char> frame;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_frameWritten.wait(lock, [this]() { return (int)m_frames.size() < m_settings.queueDepth; });
+		if (!m_freeFrames.empty())
+		{
+			frame.swap(m_freeFrames.back());
+			m_freeFrames.pop_back();
+		}
+	}
+	frame.resize(frameBytes);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+	const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)frameBytes, GL_MAP_READ_BIT);
+	if (NULL != pixels)
+	{
+		memcpy(frame.data(), pixels, frameBytes);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	else
+	{
+		std::cout << "[VideoExporter] ERROR: Could not map a read back frame" << std::endl;
+		std::fill(frame.begin(), frame.end(), (unsigned char)0);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_frames.push_back(std::move(frame));
+	}
+	m_frameReady.notify_one();
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for collecting the reads still in
+ *  flight, letting the writer drain its queue and closing
+ *  the output, then reporting how fast the export ran.
+ ***********************************************************/
+bool VideoExporter::Finish()
+{
+	if (!m_bOpen)
+	{
+		return false;
+	}
+	while (NULL != m_readbacks[m_oldestReadback].fence)
+	{
+		Collect(m_readbacks[m_oldestReadback], true);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bClosing = true;
+	}
+	m_frameReady.notify_one();
+	m_writer.join();
+
+	int closeResult = m_bPipe ? EXPORT_PCLOSE(m_pOutput) : fclose(m_pOutput);
+	m_pOutput = NULL;
+	m_bOpen = false;
+	bool bSucceeded = !m_bWriteFailed && (closeResult == 0);
+
+	double seconds = glfwGetTime() - m_startTime;
+	double videoSeconds = (double)m_capturedFrames / m_settings.framesPerSecond;
+	std::cout << "[VideoExporter] " << (bSucceeded ? "Wrote " : "ERROR: Failed writing ") << m_capturedFrames
+		<< " frames in " << seconds << " s, " << (seconds > 0.0 ? videoSeconds / seconds : 0.0)
+		<< "x real time, " << m_stalls << " waits on a read back" << std::endl;
+	return bSucceeded;
+}
+
+/***********************************************************
+ *  WriterLoop()
+ *
+ *  This method is used for converting and writing frames on
+ *  the writer thread until the export is finished and the
+ *  queue is empty. After a failed write the frames are
+ *  still taken, so the renderer never waits on a dead pipe.
+ ***********************************************************/
+void VideoExporter::WriterLoop()
+{
+	std::vector<unsigned char> output;
+	for (;;)
+	{
+		std::vector<unsigned char> frame;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_frameReady.wait(lock, [this]() { return m_bClosing || !m_frames.empty(); });
+			if (m_frames.empty())
+			{
+				break;
+			}
+			frame.swap(m_frames.front());
+			m_frames.pop_front();
+		}
+
+		if (!m_bWriteFailed)
+		{
+			ConvertFrame(frame, output);
+			if (fwrite(output.data(), 1, output.size(), m_pOutput) != output.size())
+			{
+				std::cout << "[VideoExporter] ERROR: Writing to " << m_settings.output << " failed" << std::endl;
+				m_bWriteFailed = true;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_freeFrames.push_back(std::move(frame));
+		}
+		m_frameWritten.notify_one();
+	}
+	fflush(m_pOutput);
+}
+
+/***********************************************************
+ *  ConvertFrame()
+ *
+ *  This method is used for turning a read back frame, bottom
+ *  row first, into the bytes written for it: top row first,
+ *  as RGB, or for Y4M a FRAME marker then the full size luma
+ *  plane and the two chroma planes, each chroma sample from
+ *  the average colour of a 2x2 block.
+ ***********************************************************/
+void VideoExporter::ConvertFrame(const std::vector<unsigned char>& rgba, std::vector<unsigned char>& output) const
+{
+	const int width = m_width;
+	const int height = m_height;
+	auto pixel = [&](int x, int y) { return &rgba[((size_t)(height - 1 - y) * width + x) * 4]; };
+
+	if (m_format == VIDEO_RAW_RGB)
+	{
+		output.resize((size_t)width * height * 3);
+		unsigned char* out = output.data();
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				const unsigned char* p = pixel(x, y);
+				*out++ = p[0];
+				*out++ = p[1];
+				*out++ = p[2];
+			}
+		}
+		return;
+	}
+
+	static const char FRAME_MARKER[] = "FRAME\n";
+	const size_t markerBytes = sizeof(FRAME_MARKER) - 1;
+	const int chromaWidth = (width + 1) / 2;
+	const int chromaHeight = (height + 1) / 2;
+	output.resize(markerBytes + (size_t)width * height + 2 * (size_t)chromaWidth * chromaHeight);
+	memcpy(output.data(), FRAME_MARKER, markerBytes);
+
+	unsigned char* luma = output.data() + markerBytes;
+	unsigned char* blue = luma + (size_t)width * height;
+	unsigned char* red = blue + (size_t)chromaWidth * chromaHeight;
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			const unsigned char* p = pixel(x, y);
+			*luma++ = LumaOf(p[0], p[1], p[2]);
+		}
+	}
+	for (int cy = 0; cy < chromaHeight; cy++)
+	{
+		int y0 = cy * 2;
+		int y1 = std::min(y0 + 1, height - 1);
+		for (int cx = 0; cx < chromaWidth; cx++)
+		{
+			int x0 = cx * 2;
+			int x1 = std::min(x0 + 1, width - 1);
+			const unsigned char* p[4] = { pixel(x0, y0), pixel(x1, y0), pixel(x0, y1), pixel(x1, y1) };
+			int r = (p[0][0] + p[1][0] + p[2][0] + p[3][0] + 2) >> 2;
+			int g = (p[0][1] + p[1][1] + p[2][1] + p[3][1] + 2) >> 2;
+			int b = (p[0][2] + p[1][2] + p[2][2] + p[3][2] + 2) >> 2;
+			*blue++ = BlueDifferenceOf(r, g, b);
+			*red++ = RedDifferenceOf(r, g, b);
+		}
+	}
+}
@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////////
+// videoexporter.h
+// ============
+// streams rendered frames to a Y4M or raw RGB file or pipe
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  VIDEO_EXPORT_SETTINGS
+ *
+ *  Where the frames go and how they are produced.
+ ***********************************************************/
+struct VIDEO_EXPORT_SETTINGS
+{
+	// a file, or after a '|' a command the frames are piped into, such
+	// as "|ffmpeg -i - flythrough.mp4"; raw RGB if it ends in .rgb, Y4M
+	// otherwise
+	std::string output = "flythrough.y4m";
+	int framesPerSecond = 30;
+	// length of the video, in seconds
+	float duration = 10.0f;
+	// frames being read back at once, each with a pixel buffer
+	int readbackDepth = 3;
+	// frames read back but not yet written before the renderer waits
+	int queueDepth = 8;
+	// draw into an offscreen framebuffer, the window being hidden
+	bool bHeadless = false;
+};
+
+/***********************************************************
+ *  VideoExporter
+ *
+ *  This class captures rendered frames without stalling the
+ *  GPU. Each frame is resolved and read into the next pixel
+ *  buffer of a ring, with a fence after it; only buffers
+ *  whose fence has already passed are mapped, so the copy
+ *  out waits on nothing unless the whole ring is still in
+ *  flight. The frames are handed to a writer thread, which
+ *  converts them - to 4:2:0 YUV for Y4M - and writes them to
+ *  the file or pipe while the next frames render. In
+ *  headless mode the frames are drawn into an offscreen
+ *  framebuffer and never shown, so an export runs as fast
+ *  as they can be drawn.
+ ***********************************************************/
+class VideoExporter
+{
+public:
+	// constructor
+	VideoExporter();
+	// destructor - finishes the export if it was not finished
+	~VideoExporter();
+
+	// open the output and create the buffers for frames of the given
+	// size, with the context current; false if the output did not open
+	bool Open(const VIDEO_EXPORT_SETTINGS& settings, int width, int height);
+	// bind the framebuffer to draw the next frame into; the window's,
+	// unless headless
+	void BeginFrame();
+	// read back the frame drawn into the bound framebuffer
+	void CaptureFrame();
+	// write every frame still in flight and close the output; false if
+	// anything failed to write
+	bool Finish();
+
+	// frames in the whole video, and the time each is drawn at
+	int GetTotalFrames() const;
+	double GetFrameTime(int frame) const { return (double)frame / m_settings.framesPerSecond; }
+	int GetCapturedFrames() const { return m_capturedFrames; }
+
+private:
+	enum VIDEO_FORMAT
+	{
+		VIDEO_Y4M,
+		VIDEO_RAW_RGB
+	};
+	struct READBACK
+	{
+		GLuint buffer;
+		// set once the frame's read is queued, cleared once it is copied
+		GLsync fence;
+	};
+
+	VIDEO_EXPORT_SETTINGS m_settings;
+	VIDEO_FORMAT m_format;
+	int m_width;
+	int m_height;
+	bool m_bOpen;
+	FILE* m_pOutput;
+	bool m_bPipe;
+
+	// multisampled like the window, drawn into when headless
+	GLuint m_renderFramebuffer;
+	GLuint m_renderColor;
+	GLuint m_renderDepth;
+	// single sampled copy of the frame, read into the pixel buffers
+	GLuint m_resolveFramebuffer;
+	GLuint m_resolveColor;
+	std::vector<READBACK> m_readbacks;
+	// the next buffer to read into, and the oldest still in flight
+	size_t m_nextReadback;
+	size_t m_oldestReadback;
+	int m_capturedFrames;
+	// reads that had to be waited for, as the ring was full
+	int m_stalls;
+	double m_startTime;
+
+	// RGBA frames, bottom row first, waiting for the writer, and
+	// buffers it has finished with
+	std::thread m_writer;
+	std::mutex m_mutex;
+	std::condition_variable m_frameReady;
+	std::condition_variable m_frameWritten;
+	std::deque<std::vector<unsigned char>> m_frames;
+	std::vector<std::vector<unsigned char>> m_freeFrames;
+	bool m_bClosing;
+	std::atomic<bool> m_bWriteFailed;
+
+	void Destroy();
+	void CollectReady();
+	void Collect(READBACK& readback, bool bWait);
+	void WriterLoop();
+	void ConvertFrame(const std::vector<unsigned char>& rgba, std::vector<unsigned char>& output) const;
+};
@@ -14,6 +14,10 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>    
 
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
 // declaration of the global variables and defines
 namespace
 {
@@ -26,19 +30,76 @@ namespace
 	// camera object used for viewing and interacting with
 	// the 3D scene
 	Camera* g_pCamera = nullptr;
+	// the camera of the right hand view, when the screen is split
+	Camera* g_pSecondCamera = nullptr;
 
 	// these variables are used for mouse movement processing
 	float gLastX = WINDOW_WIDTH / 2.0f;
 	float gLastY = WINDOW_HEIGHT / 2.0f;
 	bool gFirstMouse = true;
 
-	// time between current frame and last frame
-	float gDeltaTime = 0.0f; 
-	float gLastFrame = 0.0f;
+	// size of the window's framebuffer in pixels, which the views are
+	// laid out in; larger than the window on high density displays
+	int gFramebufferWidth = WINDOW_WIDTH;
+	int gFramebufferHeight = WINDOW_HEIGHT;
 
 	// the following variable is false when orthographic projection
 	// is off and true when it is on
 	bool bOrthographicProjection = false;
+	// the views drawn besides the first camera's
+	bool bSplitScreen = false;
+	bool bMinimap = false;
+
+	// keys that move the cameras while they are held, in the order
+	// LatchInput() applies them: W, S, A, D, Q, E for the first, and
+	// the arrow keys for the second
+	const int MOVEMENT_KEY_COUNT = 10;
+	const int MOVEMENT_KEYS[MOVEMENT_KEY_COUNT] = {
+		GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_Q, GLFW_KEY_E,
+		GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_LEFT, GLFW_KEY_RIGHT };
+
+	// the minimap: a square in the top right corner, sized in window
+	// coordinates, looking straight down on the first camera from
+	// above, this far to each side
+	const int MINIMAP_SIZE = 200;
+	const int MINIMAP_MARGIN = 10;
+	const float MINIMAP_EXTENT = 30.0f;
+	const float MINIMAP_HEIGHT = 100.0f;
+
+	/***********************************************************
+	 *  INPUT_STATE
+	 *
+	 *  Input gathered by the callbacks, on the thread taking
+	 *  window events, since the camera last latched it. Each
+	 *  movement key's held time is measured from the event
+	 *  timestamps, so the camera moves by exactly as long as
+	 *  the key was down, however long the frames take.
+	 ***********************************************************/
+	struct INPUT_STATE
+	{
+		std::mutex mutex;
+		bool bKeyDown[MOVEMENT_KEY_COUNT] = {};
+		// when a held key went down, or the last latch if later
+		double keyDownTime[MOVEMENT_KEY_COUNT] = {};
+		// time held by presses released since the last latch
+		double keyHeldTime[MOVEMENT_KEY_COUNT] = {};
+		float mouseX = 0.0f;
+		float mouseY = 0.0f;
+		float scroll = 0.0f;
+		bool bOrthographic = false;
+		bool bSplitScreen = false;
+		bool bMinimap = false;
+		bool bPick = false;
+		// arrival times of the events not yet latched
+		std::vector<double> eventTimes;
+	};
+	INPUT_STATE g_Input;
+
+	// note an event arriving; called with the input mutex held
+	void NoteInputEvent(double time)
+	{
+		g_Input.eventTimes.push_back(time);
+	}
 }
 
 /***********************************************************
@@ -52,6 +113,14 @@ ViewManager::ViewManager(
 	// initialize the member variables
 	m_pShaderManager = pShaderManager;
 	m_pWindow = NULL;
+	m_viewInfo.view = glm::mat4(1.0f);
+	m_viewInfo.projection = glm::mat4(1.0f);
+	m_viewInfo.position = glm::vec3(0.0f);
+	m_viewInfo.fovY = 0.0f;
+	m_viewInfo.viewportWidth = (float)WINDOW_WIDTH;
+	m_viewInfo.viewportHeight = (float)WINDOW_HEIGHT;
+	m_latchTime = 0.0;
+	m_bPickRequested = false;
 	g_pCamera = new Camera();
 	// default camera view parameters
 	g_pCamera->Position = glm::vec3(0.0f, 5.0f, 12.0f);
@@ -59,6 +128,13 @@ ViewManager::ViewManager(
 	g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
 	g_pCamera->Zoom = 80;
 	g_pCamera->MovementSpeed = 20;
+	// the second camera looks at the camp from across the fire
+	g_pSecondCamera = new Camera();
+	g_pSecondCamera->Position = glm::vec3(14.0f, 4.0f, 8.0f);
+	g_pSecondCamera->Front = glm::normalize(glm::vec3(-1.2f, -0.3f, -1.0f));
+	g_pSecondCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
+	g_pSecondCamera->Zoom = 80;
+	g_pSecondCamera->MovementSpeed = 20;
 }
 
 /***********************************************************
@@ -76,6 +152,11 @@ ViewManager::~ViewManager()
 		delete g_pCamera;
 		g_pCamera = NULL;
 	}
+	if (NULL != g_pSecondCamera)
+	{
+		delete g_pSecondCamera;
+		g_pSecondCamera = NULL;
+	}
 }
 
 /***********************************************************
@@ -109,6 +190,12 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 
 	glfwSetScrollCallback(window, &ViewManager::Mouse_Scroll_Callback); // capture mouse scroll
 
+	// this callback is used to receive key presses and releases
+	glfwSetKeyCallback(window, &ViewManager::Key_Callback);
+
+	// this callback is used to receive clicks for picking
+	glfwSetMouseButtonCallback(window, &ViewManager::Mouse_Button_Callback);
+
 
 	// enable blending for supporting tranparent rendering
 	glEnable(GL_BLEND);
@@ -124,9 +211,13 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
  *
  *  This method is automatically called from GLFW whenever
  *  the mouse is moved within the active GLFW display window.
+ *  The movement is added up until the camera latches it.
  ***********************************************************/
 void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos, double yMousePos)
 {
+	std::lock_guard<std::mutex> lock(g_Input.mutex);
+	NoteInputEvent(glfwGetTime());
+
 	// when the first mouse move event is received, this needs to be recorded so that
 	// all subsequent mouse moves can correctly calculate the X position offset and Y
 	// position offset for proper operation
@@ -145,74 +236,278 @@ void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos,
 	gLastX = xMousePos;
 	gLastY = yMousePos;
 
-	// move the 3D camera according to the calculated offsets
-	g_pCamera->ProcessMouseMovement(xOffset, yOffset);
+	// add the calculated offsets to the movement for the 3D camera
+	g_Input.mouseX += xOffset;
+	g_Input.mouseY += yOffset;
 }
 /***********************************************************
  *  Mouse_Scroll_Callback()
  ***********************************************************/
 void ViewManager::Mouse_Scroll_Callback(GLFWwindow* window, double xOffset, double yOffset)
 {
-	// Zoom or adjust camera speed based on scroll
-	g_pCamera->ProcessMouseScroll(yOffset);
+	// Zoom or adjust camera speed based on scroll, once latched
+	std::lock_guard<std::mutex> lock(g_Input.mutex);
+	NoteInputEvent(glfwGetTime());
+	g_Input.scroll += (float)yOffset;
 }
 
 /***********************************************************
- *  ProcessKeyboardEvents()
+ *  Key_Callback()
  *
- *  This method is called to process any keyboard events
- *  that may be waiting in the event queue.
+ *  This method is automatically called from GLFW whenever a
+ *  key is pressed or released, as soon as the event arrives.
+ *  Movement keys are timed for LatchInput(); the others take
+ *  effect straight away.
  ***********************************************************/
-void ViewManager::ProcessKeyboardEvents()
+void ViewManager::Key_Callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
+	if (action == GLFW_REPEAT)
+	{
+		return;
+	}
+	double time = glfwGetTime();
+	bool bPress = (action == GLFW_PRESS);
+
 	// close the window if the escape key has been pressed
-	if (glfwGetKey(m_pWindow, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+	if ((key == GLFW_KEY_ESCAPE) && bPress)
+	{
+		glfwSetWindowShouldClose(window, true);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(g_Input.mutex);
+	for (int i = 0; i < MOVEMENT_KEY_COUNT; i++)
+	{
+		if (key != MOVEMENT_KEYS[i])
+		{
+			continue;
+		}
+		NoteInputEvent(time);
+		if (bPress && !g_Input.bKeyDown[i])
+		{
+			g_Input.keyDownTime[i] = time;
+		}
+		else if (!bPress && g_Input.bKeyDown[i])
+		{
+			g_Input.keyHeldTime[i] += time - g_Input.keyDownTime[i];
+		}
+		g_Input.bKeyDown[i] = bPress;
+	}
+
+	// Switch to perspective projection (P key), or to orthographic
+	// projection (O key)
+	if (bPress && ((key == GLFW_KEY_P) || (key == GLFW_KEY_O)))
+	{
+		NoteInputEvent(time);
+		g_Input.bOrthographic = (key == GLFW_KEY_O);
+	}
+
+	// Split the screen between the two cameras (F2), and show or hide
+	// the minimap (M)
+	if (bPress && (key == GLFW_KEY_F2))
+	{
+		NoteInputEvent(time);
+		g_Input.bSplitScreen = !g_Input.bSplitScreen;
+	}
+	if (bPress && (key == GLFW_KEY_M))
 	{
-		glfwSetWindowShouldClose(m_pWindow, true);
+		NoteInputEvent(time);
+		g_Input.bMinimap = !g_Input.bMinimap;
+	}
+}
+
+/***********************************************************
+ *  Mouse_Button_Callback()
+ *
+ *  This method is automatically called from GLFW whenever a
+ *  mouse button is pressed or released. A left click asks
+ *  for the object under the crosshair once latched.
+ ***********************************************************/
+void ViewManager::Mouse_Button_Callback(GLFWwindow* window, int button, int action, int mods)
+{
+	if ((button == GLFW_MOUSE_BUTTON_LEFT) && (action == GLFW_PRESS))
+	{
+		std::lock_guard<std::mutex> lock(g_Input.mutex);
+		NoteInputEvent(glfwGetTime());
+		g_Input.bPick = true;
+	}
+}
+
+/***********************************************************
+ *  AddProbeEvent()
+ *
+ *  This method is used for timing an input event that
+ *  changes nothing, so input latency can be measured when
+ *  no one is using the controls, as in a benchmark.
+ ***********************************************************/
+void ViewManager::AddProbeEvent()
+{
+	std::lock_guard<std::mutex> lock(g_Input.mutex);
+	NoteInputEvent(glfwGetTime());
+}
+
+/***********************************************************
+ *  SetSplitScreen()
+ *
+ *  This method is used for choosing the views from the
+ *  command line; they are latched with the next frame's
+ *  input, as the keys toggling them are.
+ ***********************************************************/
+void ViewManager::SetSplitScreen(bool bSplitScreen)
+{
+	std::lock_guard<std::mutex> lock(g_Input.mutex);
+	g_Input.bSplitScreen = bSplitScreen;
+}
+
+void ViewManager::SetMinimap(bool bMinimap)
+{
+	std::lock_guard<std::mutex> lock(g_Input.mutex);
+	g_Input.bMinimap = bMinimap;
+}
+
+/***********************************************************
+ *  BeginView()
+ *
+ *  This method is used for pointing the drawing at a view's
+ *  rectangle of the window. A view drawn over others has
+ *  just its rectangle cleared first.
+ ***********************************************************/
+void ViewManager::BeginView(const SCENE_VIEW& view)
+{
+	glViewport(view.x, view.y, view.width, view.height);
+	if (view.bOverlay)
+	{
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(view.x, view.y, view.width, view.height);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glDisable(GL_SCISSOR_TEST);
+	}
+}
+
+void ViewManager::EndViews()
+{
+	glViewport(0, 0, gFramebufferWidth, gFramebufferHeight);
+}
+
+/***********************************************************
+ *  LatchInput()
+ *
+ *  This method is used for applying everything the callbacks
+ *  gathered since the last frame to the camera - the mouse
+ *  movement, scrolling, and each movement key for as long as
+ *  it was held - and starting to gather again.
+ ***********************************************************/
+void ViewManager::LatchInput()
+{
+	double heldTime[MOVEMENT_KEY_COUNT] = {};
+	float mouseX = 0.0f;
+	float mouseY = 0.0f;
+	float scroll = 0.0f;
+	{
+		std::lock_guard<std::mutex> lock(g_Input.mutex);
+		m_latchTime = glfwGetTime();
+		for (int i = 0; i < MOVEMENT_KEY_COUNT; i++)
+		{
+			heldTime[i] = g_Input.keyHeldTime[i];
+			if (g_Input.bKeyDown[i])
+			{
+				heldTime[i] += m_latchTime - g_Input.keyDownTime[i];
+				g_Input.keyDownTime[i] = m_latchTime;
+			}
+			g_Input.keyHeldTime[i] = 0.0;
+		}
+		mouseX = g_Input.mouseX;
+		mouseY = g_Input.mouseY;
+		scroll = g_Input.scroll;
+		bOrthographicProjection = g_Input.bOrthographic;
+		bSplitScreen = g_Input.bSplitScreen;
+		bMinimap = g_Input.bMinimap;
+		m_bPickRequested = g_Input.bPick;
+		g_Input.bPick = false;
+		m_latchedInputTimes.swap(g_Input.eventTimes);
+		g_Input.eventTimes.clear();
+
+		g_Input.mouseX = 0.0f;
+		g_Input.mouseY = 0.0f;
+		g_Input.scroll = 0.0f;
+	}
+
+	// move the 3D camera according to the mouse offsets
+	if ((mouseX != 0.0f) || (mouseY != 0.0f))
+	{
+		g_pCamera->ProcessMouseMovement(mouseX, mouseY);
+	}
+	if (scroll != 0.0f)
+	{
+		g_pCamera->ProcessMouseScroll(scroll);
 	}
 
 	// process camera zooming in and out
-	if (glfwGetKey(m_pWindow, GLFW_KEY_W) == GLFW_PRESS)
+	if (heldTime[0] > 0.0)
 	{
-		g_pCamera->ProcessKeyboard(FORWARD, gDeltaTime);
+		g_pCamera->ProcessKeyboard(FORWARD, (float)heldTime[0]);
 	}
-	if (glfwGetKey(m_pWindow, GLFW_KEY_S) == GLFW_PRESS)
+	if (heldTime[1] > 0.0)
 	{
-		g_pCamera->ProcessKeyboard(BACKWARD, gDeltaTime);
+		g_pCamera->ProcessKeyboard(BACKWARD, (float)heldTime[1]);
 	}
 
 	// process camera panning left and right
-	if (glfwGetKey(m_pWindow, GLFW_KEY_A) == GLFW_PRESS)
+	if (heldTime[2] > 0.0)
 	{
-		g_pCamera->ProcessKeyboard(LEFT, gDeltaTime);
+		g_pCamera->ProcessKeyboard(LEFT, (float)heldTime[2]);
 	}
-	if (glfwGetKey(m_pWindow, GLFW_KEY_D) == GLFW_PRESS)
+	if (heldTime[3] > 0.0)
 	{
-		g_pCamera->ProcessKeyboard(RIGHT, gDeltaTime);
+		g_pCamera->ProcessKeyboard(RIGHT, (float)heldTime[3]);
 	}
 	// Move camera up (Q)
-	if (glfwGetKey(m_pWindow, GLFW_KEY_Q) == GLFW_PRESS)
+	if (heldTime[4] > 0.0)
 	{
-		g_pCamera->ProcessKeyboard(UP, gDeltaTime);
+		g_pCamera->ProcessKeyboard(UP, (float)heldTime[4]);
 	}
 
 	// Move camera down (E)
-	if (glfwGetKey(m_pWindow, GLFW_KEY_E) == GLFW_PRESS)
+	if (heldTime[5] > 0.0)
 	{
-		g_pCamera->ProcessKeyboard(DOWN, gDeltaTime);
+		g_pCamera->ProcessKeyboard(DOWN, (float)heldTime[5]);
 	}
 
-	// Switch to perspective projection (P key)
-	if (glfwGetKey(m_pWindow, GLFW_KEY_P) == GLFW_PRESS)
+	// the arrow keys move the second camera, whether or not it is shown
+	const Camera_Movement secondMovements[4] = { FORWARD, BACKWARD, LEFT, RIGHT };
+	for (int i = 0; i < 4; i++)
 	{
-		bOrthographicProjection = false;
+		if (heldTime[6 + i] > 0.0)
+		{
+			g_pSecondCamera->ProcessKeyboard(secondMovements[i], (float)heldTime[6 + i]);
+		}
 	}
+}
 
-	// Switch to orthographic projection (O key)
-	if (glfwGetKey(m_pWindow, GLFW_KEY_O) == GLFW_PRESS)
+/***********************************************************
+ *  MakeCameraView()
+ *
+ *  This method is used for the view and projection of one of
+ *  the cameras, for a viewport of the given size.
+ ***********************************************************/
+VIEW_INFO ViewManager::MakeCameraView(Camera* pCamera, int width, int height) const
+{
+	VIEW_INFO viewInfo;
+	viewInfo.view = pCamera->GetViewMatrix();
+	if (bOrthographicProjection)
+	{
+		float orthoScale = 10.0f;
+		viewInfo.projection = glm::ortho(-orthoScale, orthoScale, -orthoScale, orthoScale, 0.1f, 100.0f);
+	}
+	else
 	{
-		bOrthographicProjection = true;
+		viewInfo.projection = glm::perspective(glm::radians(pCamera->Zoom), (float)width / (float)height, 5.0f, 100000.0f);
 	}
+	viewInfo.position = pCamera->Position;
+	viewInfo.fovY = glm::radians(pCamera->Zoom);
+	viewInfo.viewportWidth = (float)width;
+	viewInfo.viewportHeight = (float)height;
+	return viewInfo;
 }
 
 /***********************************************************
@@ -220,36 +515,74 @@ void ViewManager::ProcessKeyboardEvents()
  *
  *  This method is used for preparing the 3D scene by loading
  *  the shapes, textures in memory to support the 3D scene 
- *  rendering
+ *  rendering. Every view of the frame is laid out here: the
+ *  first camera's, the second camera's beside it when the
+ *  screen is split, and the minimap over them. They are laid
+ *  out in framebuffer pixels, read each frame, so they fill
+ *  the window on high density displays and after a resize.
  ***********************************************************/
 void ViewManager::PrepareSceneView()
 {
-	glm::mat4 view;
-	glm::mat4 projection;
+	// apply the input that has arrived since the last frame
+	LatchInput();
 
-	// per-frame timing
-	float currentFrame = glfwGetTime();
-	gDeltaTime = currentFrame - gLastFrame;
-	gLastFrame = currentFrame;
-
-	// process any keyboard events that may be waiting in the 
-	// event queue
-	ProcessKeyboardEvents();
-
-	// get the current view matrix from the camera
-	view = g_pCamera->GetViewMatrix();
-
-	// define the current projection matrix
-	// Projection matrix
-	if (bOrthographicProjection)
+	// a minimized window has an empty framebuffer
+	int windowWidth = WINDOW_WIDTH;
+	int windowHeight = WINDOW_HEIGHT;
+	if (NULL != m_pWindow)
 	{
-		float orthoScale = 10.0f;
-		projection = glm::ortho(-orthoScale, orthoScale, -orthoScale, orthoScale, 0.1f, 100.0f);
+		glfwGetFramebufferSize(m_pWindow, &gFramebufferWidth, &gFramebufferHeight);
+		glfwGetWindowSize(m_pWindow, &windowWidth, &windowHeight);
 	}
-	else
+	gFramebufferWidth = std::max(gFramebufferWidth, 1);
+	gFramebufferHeight = std::max(gFramebufferHeight, 1);
+	float pixelScale = (float)gFramebufferWidth / (float)std::max(windowWidth, 1);
+
+	m_views.clear();
+	SCENE_VIEW sceneView;
+	sceneView.x = 0;
+	sceneView.y = 0;
+	sceneView.width = bSplitScreen ? gFramebufferWidth / 2 : gFramebufferWidth;
+	sceneView.height = gFramebufferHeight;
+	sceneView.bOverlay = false;
+	sceneView.viewInfo = MakeCameraView(g_pCamera, sceneView.width, sceneView.height);
+	m_views.push_back(sceneView);
+
+	if (bSplitScreen)
 	{
-		projection = glm::perspective(glm::radians(g_pCamera->Zoom), (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 5.0f, 100000.0f);
+		sceneView.x = gFramebufferWidth / 2;
+		sceneView.width = gFramebufferWidth - sceneView.x;
+		sceneView.viewInfo = MakeCameraView(g_pSecondCamera, sceneView.width, sceneView.height);
+		m_views.push_back(sceneView);
 	}
+
+	if (bMinimap)
+	{
+		glm::vec3 center(g_pCamera->Position.x, 0.0f, g_pCamera->Position.z);
+		int size = std::max((int)(MINIMAP_SIZE * pixelScale), 1);
+		int margin = (int)(MINIMAP_MARGIN * pixelScale);
+		sceneView.x = gFramebufferWidth - size - margin;
+		sceneView.y = gFramebufferHeight - size - margin;
+		sceneView.width = size;
+		sceneView.height = size;
+		sceneView.bOverlay = true;
+		sceneView.viewInfo.position = center + glm::vec3(0.0f, MINIMAP_HEIGHT, 0.0f);
+		sceneView.viewInfo.view = glm::lookAt(sceneView.viewInfo.position, center, glm::vec3(0.0f, 0.0f, -1.0f));
+		sceneView.viewInfo.projection = glm::ortho(
+			-MINIMAP_EXTENT, MINIMAP_EXTENT, -MINIMAP_EXTENT, MINIMAP_EXTENT, 1.0f, 2.0f * MINIMAP_HEIGHT);
+		// the field of view that covers the same ground from that height,
+		// for the systems choosing detail by projected size
+		sceneView.viewInfo.fovY = 2.0f * std::atan(MINIMAP_EXTENT / MINIMAP_HEIGHT);
+		sceneView.viewInfo.viewportWidth = (float)size;
+		sceneView.viewInfo.viewportHeight = (float)size;
+		m_views.push_back(sceneView);
+	}
+
+	// remember the matrices for systems using their own shaders
+	m_viewInfo = m_views[0].viewInfo;
+	glm::mat4 view = m_viewInfo.view;
+	glm::mat4 projection = m_viewInfo.projection;
+
 	// if the shader manager object is valid
 	if (NULL != m_pShaderManager)
 	{
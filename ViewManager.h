@@ -15,6 +15,43 @@
 // GLFW library
 #include "GLFW/glfw3.h" 
 
+#include <vector>
+
+/***********************************************************
+ *  VIEW_INFO
+ *
+ *  The camera matrices and viewport used for the current
+ *  frame, for systems that render outside the main shader.
+ ***********************************************************/
+struct VIEW_INFO
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 position;
+	float fovY;
+	float viewportWidth;
+	float viewportHeight;
+};
+
+/***********************************************************
+ *  SCENE_VIEW
+ *
+ *  One of the views drawn into the window each frame: its
+ *  camera, and where in the window it goes.
+ ***********************************************************/
+struct SCENE_VIEW
+{
+	VIEW_INFO viewInfo;
+	// the viewport, in pixels from the bottom left of the window
+	int x;
+	int y;
+	int width;
+	int height;
+	// drawn over the views before it, as the minimap is, so its
+	// rectangle is cleared first and the fine detail is left out
+	bool bOverlay;
+};
+
 class ViewManager
 {
 public:
@@ -28,19 +65,60 @@ public:
 	static void Mouse_Position_Callback(GLFWwindow* window, double xMousePos, double yMousePos);
 
 	static void Mouse_Scroll_Callback(GLFWwindow* window, double xOffset, double yOffset);
+
+	// key callback for moving the camera and switching the projection
+	static void Key_Callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+	// mouse button callback for picking what is under the crosshair
+	static void Mouse_Button_Callback(GLFWwindow* window, int button, int action, int mods);
+	// time an input event that changes nothing, for measuring latency
+	static void AddProbeEvent();
+	// show a second camera beside the first (F2), and a top down map
+	// of the area around the first (M)
+	static void SetSplitScreen(bool bSplitScreen);
+	static void SetMinimap(bool bMinimap);
+	// set the viewport to a view's rectangle, clearing it first if it
+	// is drawn over another view
+	static void BeginView(const SCENE_VIEW& view);
+	// set the viewport back to the whole window's framebuffer
+	static void EndViews();
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
+	// matrices prepared for the current frame, of the first view, and
+	// every view drawn this frame
+	VIEW_INFO m_viewInfo;
+	std::vector<SCENE_VIEW> m_views;
+	// when the camera last took the input, and when each input event
+	// it took arrived
+	double m_latchTime;
+	std::vector<double> m_latchedInputTimes;
+	// the left mouse button was clicked since the previous latch
+	bool m_bPickRequested;
 
-	// process keyboard events for interaction with the 3D scene
-	void ProcessKeyboardEvents();
+	// apply the input gathered since the last frame to the cameras
+	void LatchInput();
+	// the matrices of a camera, for a viewport of the given size
+	VIEW_INFO MakeCameraView(Camera* pCamera, int width, int height) const;
 
 public:
 	// create the initial OpenGL display window
 	GLFWwindow* CreateDisplayWindow(const char* windowTitle);
 	
-	// prepare the conversion from 3D object display to 2D scene display
+	// prepare the conversion from 3D object display to 2D scene display;
+	// call as late in the frame as possible, as it latches the input
 	void PrepareSceneView();
+
+	// get the camera matrices prepared for the current frame
+	const VIEW_INFO& GetViewInfo() const { return m_viewInfo; }
+	// every view of the current frame, the first camera's first
+	const std::vector<SCENE_VIEW>& GetViews() const { return m_views; }
+	// glfwGetTime() of the latest latch, and of each input event the
+	// latest latch applied
+	double GetLatchTime() const { return m_latchTime; }
+	const std::vector<double>& GetLatchedInputTimes() const { return m_latchedInputTimes; }
+	// true if the latest latch took a click to pick the object under
+	// the crosshair, at the centre of the window
+	bool IsPickRequested() const { return m_bPickRequested; }
 };
\ No newline at end of file
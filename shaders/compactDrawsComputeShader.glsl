@@ -0,0 +1,28 @@
+#version 460 core
+// packs the non-empty bucket commands together and counts them
+layout (local_size_x = 64) in;
+
+struct DRAW_COMMAND
+{
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+layout (std430, binding = 2) readonly buffer Commands { DRAW_COMMAND commands[]; };
+layout (std430, binding = 4) writeonly buffer Compacted { DRAW_COMMAND compacted[]; };
+layout (std430, binding = 5) buffer DrawCount { uint drawCount; };
+
+uniform uint bucketCount;
+
+void main()
+{
+	uint bucket = gl_GlobalInvocationID.x;
+	if ((bucket >= bucketCount) || (commands[bucket].instanceCount == 0))
+	{
+		return;
+	}
+	compacted[atomicAdd(drawCount, 1)] = commands[bucket];
+}
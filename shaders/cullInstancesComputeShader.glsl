@@ -0,0 +1,151 @@
+#version 460 core
+// frustum, occlusion and LOD selection for every instance - visible
+// instances are appended to the instance list of their mesh/LOD bucket
+layout (local_size_x = 64) in;
+
+struct INSTANCE_RECORD
+{
+	mat4 model;
+	vec4 boundingSphere;
+	uint meshIndex;
+	float scale;
+	uint group;
+	uint pad;
+};
+
+struct MESH_RECORD
+{
+	uint firstBucket;
+	uint lodCount;
+	uint textureSlot;
+	uint pad;
+	vec4 lodErrors[2];
+};
+
+struct DRAW_COMMAND
+{
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Instances { INSTANCE_RECORD instances[]; };
+layout (std430, binding = 1) readonly buffer Meshes { MESH_RECORD meshes[]; };
+layout (std430, binding = 2) buffer Commands { DRAW_COMMAND commands[]; };
+layout (std430, binding = 3) writeonly buffer Visible { uint visibleInstances[]; };
+// one bit per instance group drawn some other way from this view
+layout (std430, binding = 6) readonly buffer HiddenGroups { uint hiddenGroups[]; };
+// instances the depth hid in the first pass, for the retest pass
+layout (std430, binding = 7) buffer Retest { uint retestCount; uint retestInstances[]; };
+
+uniform mat4 viewProjection;
+// the camera the depth pyramid was captured from
+uniform mat4 depthViewProjection;
+uniform vec4 frustumPlanes[6];
+uniform vec3 cameraPosition;
+uniform float pixelsPerUnit;
+uniform float pixelThreshold;
+uniform uint instanceCount;
+uniform uint hiddenGroupCount;
+uniform bool bOcclusion;
+// test only the instances the first pass recorded
+uniform bool bRetest;
+uniform sampler2D depthPyramid;
+uniform vec2 pyramidSize;
+
+bool IsOccluded(vec3 center, float radius)
+{
+	// screen rectangle and nearest depth of the bounding sphere
+	vec2 minUV = vec2(1.0f);
+	vec2 maxUV = vec2(0.0f);
+	float nearestDepth = 1.0f;
+	for (int i = 0; i < 8; i++)
+	{
+		vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0f : -1.0f, (i & 2) != 0 ? 1.0f : -1.0f, (i & 4) != 0 ? 1.0f : -1.0f);
+		vec4 clip = depthViewProjection * vec4(corner, 1.0f);
+		if (clip.w <= 0.0f)
+		{
+			return false;
+		}
+		vec3 ndc = clip.xyz / clip.w;
+		vec2 uv = ndc.xy * 0.5f + 0.5f;
+		minUV = min(minUV, uv);
+		maxUV = max(maxUV, uv);
+		nearestDepth = min(nearestDepth, ndc.z * 0.5f + 0.5f);
+	}
+	minUV = clamp(minUV, vec2(0.0f), vec2(1.0f));
+	maxUV = clamp(maxUV, vec2(0.0f), vec2(1.0f));
+
+	// pick the mip where the rectangle covers about two texels
+	vec2 extent = (maxUV - minUV) * pyramidSize;
+	float level = ceil(log2(max(max(extent.x, extent.y), 1.0f)));
+
+	float farthest = textureLod(depthPyramid, minUV, level).r;
+	farthest = max(farthest, textureLod(depthPyramid, vec2(maxUV.x, minUV.y), level).r);
+	farthest = max(farthest, textureLod(depthPyramid, vec2(minUV.x, maxUV.y), level).r);
+	farthest = max(farthest, textureLod(depthPyramid, maxUV, level).r);
+	return nearestDepth > farthest;
+}
+
+void main()
+{
+	uint index = gl_GlobalInvocationID.x;
+	if (bRetest)
+	{
+		if (index >= retestCount)
+		{
+			return;
+		}
+		index = retestInstances[index];
+	}
+	else if (index >= instanceCount)
+	{
+		return;
+	}
+
+	INSTANCE_RECORD instance = instances[index];
+	if ((instance.group < hiddenGroupCount) &&
+		((hiddenGroups[instance.group >> 5] & (1u << (instance.group & 31u))) != 0u))
+	{
+		return;
+	}
+
+	vec3 center = instance.boundingSphere.xyz;
+	float radius = instance.boundingSphere.w;
+
+	for (int i = 0; i < 6; i++)
+	{
+		if (dot(frustumPlanes[i].xyz, center) + frustumPlanes[i].w < -radius)
+		{
+			return;
+		}
+	}
+	if (bOcclusion && IsOccluded(center, radius))
+	{
+		if (!bRetest)
+		{
+			retestInstances[atomicAdd(retestCount, 1)] = index;
+		}
+		return;
+	}
+
+	// coarsest LOD whose error projects under the pixel threshold
+	MESH_RECORD mesh = meshes[instance.meshIndex];
+	float distance = max(length(center - cameraPosition) - radius, 1e-3f);
+	uint lod = 0;
+	for (uint level = 1; level < mesh.lodCount; level++)
+	{
+		float error = mesh.lodErrors[level >> 2][level & 3] * instance.scale;
+		if (error * pixelsPerUnit / distance > pixelThreshold)
+		{
+			break;
+		}
+		lod = level;
+	}
+
+	uint bucket = mesh.firstBucket + lod;
+	uint slot = atomicAdd(commands[bucket].instanceCount, 1);
+	visibleInstances[commands[bucket].baseInstance + slot] = index;
+}
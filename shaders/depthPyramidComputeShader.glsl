@@ -0,0 +1,44 @@
+#version 460 core
+// builds one level of the farthest-depth pyramid used for occlusion
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (r32f, binding = 0) writeonly uniform image2D destinationLevel;
+uniform sampler2D sourceDepth;
+uniform int sourceLevel;
+uniform ivec2 destinationSize;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	if (any(greaterThanEqual(texel, destinationSize)))
+	{
+		return;
+	}
+
+	// level 0 copies the depth buffer, later levels keep the farthest of
+	// 2x2; a level is half the one above rounded down, so when that one
+	// is odd the last texel also takes in its last column or row
+	float depth;
+	if (sourceLevel < 0)
+	{
+		depth = texelFetch(sourceDepth, texel, 0).r;
+	}
+	else
+	{
+		ivec2 base = texel * 2;
+		ivec2 sourceSize = textureSize(sourceDepth, sourceLevel);
+		ivec2 last = sourceSize - 1;
+		bvec2 bOdd = notEqual(sourceSize & 1, ivec2(0));
+		bvec2 bEdge = equal(texel, destinationSize - 1);
+		ivec2 footprint = ivec2(2) + ivec2(bOdd.x && bEdge.x, bOdd.y && bEdge.y);
+		depth = 0.0f;
+		for (int y = 0; y < footprint.y; y++)
+		{
+			for (int x = 0; x < footprint.x; x++)
+			{
+				depth = max(depth, texelFetch(sourceDepth, min(base + ivec2(x, y), last), sourceLevel).r);
+			}
+		}
+	}
+	imageStore(destinationLevel, texel, vec4(depth));
+}
@@ -0,0 +1,22 @@
+#version 460 core
+// textured, directionally lit output for the GPU-driven draws
+in vec3 fragmentPosition;
+in vec3 fragmentVertexNormal;
+in vec2 fragmentTextureCoordinate;
+flat in uint fragmentTextureSlot;
+
+out vec4 fragmentColor;
+
+// the scene textures stay bound to units 0-15; the slot is the same
+// for every instance of a draw so the index is dynamically uniform
+uniform sampler2D objectTextures[16];
+uniform vec3 lightDirection;
+uniform vec3 lightColor;
+uniform vec3 ambientColor;
+
+void main()
+{
+	vec3 albedo = texture(objectTextures[fragmentTextureSlot], fragmentTextureCoordinate).rgb;
+	float diffuse = max(dot(normalize(fragmentVertexNormal), -normalize(lightDirection)), 0.0f);
+	fragmentColor = vec4(albedo * (ambientColor + lightColor * diffuse), 1.0f);
+}
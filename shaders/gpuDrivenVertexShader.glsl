@@ -0,0 +1,50 @@
+#version 460 core
+// vertex shader for the indirect draws - the instance comes from the
+// compacted visible list written by the culling pass
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec3 inVertexNormal;
+layout (location = 2) in vec2 inTextureCoordinate;
+
+struct INSTANCE_RECORD
+{
+	mat4 model;
+	vec4 boundingSphere;
+	uint meshIndex;
+	float scale;
+	uint group;
+	uint pad;
+};
+
+struct MESH_RECORD
+{
+	uint firstBucket;
+	uint lodCount;
+	uint textureSlot;
+	uint pad;
+	vec4 lodErrors[2];
+};
+
+layout (std430, binding = 0) readonly buffer Instances { INSTANCE_RECORD instances[]; };
+layout (std430, binding = 1) readonly buffer Meshes { MESH_RECORD meshes[]; };
+layout (std430, binding = 3) readonly buffer Visible { uint visibleInstances[]; };
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+flat out uint fragmentTextureSlot;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	INSTANCE_RECORD instance = instances[visibleInstances[gl_BaseInstance + gl_InstanceID]];
+
+	vec4 worldPosition = instance.model * vec4(inVertexPosition, 1.0f);
+	gl_Position = projection * view * worldPosition;
+
+	fragmentPosition = worldPosition.xyz;
+	fragmentVertexNormal = mat3(instance.model) * inVertexNormal;
+	fragmentTextureCoordinate = inTextureCoordinate;
+	fragmentTextureSlot = meshes[instance.meshIndex].textureSlot;
+}
@@ -0,0 +1,32 @@
+#version 440 core
+// writes albedo, object-space normal and depth for one impostor frame
+in vec3 fragmentVertexNormal;
+in vec2 fragmentTextureCoordinate;
+in float fragmentViewDepth;
+
+layout (location = 0) out vec4 outAlbedo;
+layout (location = 1) out vec4 outNormal;
+layout (location = 2) out float outDepth;
+
+uniform bool bUseTexture;
+uniform vec4 objectColor;
+uniform sampler2D objectTexture;
+uniform vec2 UVscale;
+// distance from the bake camera to the prop center, and the prop radius
+uniform float centerDepth;
+uniform float boundsRadius;
+
+void main()
+{
+	if (bUseTexture)
+	{
+		outAlbedo = vec4(texture(objectTexture, fragmentTextureCoordinate * UVscale).rgb, 1.0f);
+	}
+	else
+	{
+		outAlbedo = vec4(objectColor.rgb, 1.0f);
+	}
+	outNormal = vec4(normalize(fragmentVertexNormal) * 0.5f + 0.5f, 1.0f);
+	// signed offset from the center plane, in units of the radius
+	outDepth = (fragmentViewDepth - centerDepth) / boundsRadius;
+}
@@ -0,0 +1,23 @@
+#version 440 core
+// renders a prop from one octahedral view into the impostor atlas
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec3 inVertexNormal;
+layout (location = 2) in vec2 inTextureCoordinate;
+
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+out float fragmentViewDepth;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	vec4 viewPosition = view * model * vec4(inVertexPosition, 1.0f);
+	gl_Position = projection * viewPosition;
+
+	fragmentVertexNormal = mat3(transpose(inverse(model))) * inVertexNormal;
+	fragmentTextureCoordinate = inTextureCoordinate;
+	fragmentViewDepth = -viewPosition.z;
+}
@@ -0,0 +1,59 @@
+#version 440 core
+// blends the four nearest octahedral frames and relights the result
+in vec2 fragmentQuadCoordinate;
+in vec2 fragmentFrameCoordinate;
+in vec3 fragmentCenter;
+in vec3 fragmentRight;
+in vec3 fragmentUp;
+in vec3 fragmentForward;
+in float fragmentRadius;
+in vec3 fragmentLightDirection;
+
+out vec4 fragmentColor;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform sampler2D albedoAtlas;
+uniform sampler2D normalAtlas;
+uniform sampler2D depthAtlas;
+uniform int framesPerSide;
+uniform vec3 lightColor;
+uniform vec3 ambientColor;
+
+void main()
+{
+	vec2 frame = clamp(fragmentFrameCoordinate, vec2(0.0f), vec2(float(framesPerSide - 1)));
+	vec2 base = floor(frame);
+	vec2 blend = frame - base;
+
+	vec4 albedo = vec4(0.0f);
+	vec3 normal = vec3(0.0f);
+	float depth = 0.0f;
+	for (int i = 0; i < 4; i++)
+	{
+		vec2 offset = vec2(i & 1, i >> 1);
+		vec2 cell = min(base + offset, vec2(float(framesPerSide - 1)));
+		float weight = mix(1.0f - blend.x, blend.x, offset.x) * mix(1.0f - blend.y, blend.y, offset.y);
+		vec2 uv = (cell + fragmentQuadCoordinate) / float(framesPerSide);
+		albedo += texture(albedoAtlas, uv) * weight;
+		normal += (texture(normalAtlas, uv).xyz * 2.0f - 1.0f) * weight;
+		depth += texture(depthAtlas, uv).r * weight;
+	}
+
+	if (albedo.a < 0.5f)
+	{
+		discard;
+	}
+	albedo.rgb /= albedo.a;
+
+	// push the fragment depth back onto the baked surface
+	vec3 surface = fragmentCenter +
+		fragmentRight * (fragmentQuadCoordinate.x * 2.0f - 1.0f) * fragmentRadius +
+		fragmentUp * (fragmentQuadCoordinate.y * 2.0f - 1.0f) * fragmentRadius -
+		fragmentForward * depth * fragmentRadius;
+	vec4 clip = projection * view * vec4(surface, 1.0f);
+	gl_FragDepth = (clip.z / clip.w) * 0.5f + 0.5f;
+
+	float diffuse = max(dot(normalize(normal), -normalize(fragmentLightDirection)), 0.0f);
+	fragmentColor = vec4(albedo.rgb * (ambientColor + lightColor * diffuse), 1.0f);
+}
@@ -0,0 +1,68 @@
+#version 440 core
+// camera facing impostor quad - four vertices per distant instance
+layout (location = 0) in vec2 inCorner;
+// per instance: world position of the prop origin and uniform scale,
+// and the turn about the vertical it was placed with
+layout (location = 3) in vec4 inInstance;
+layout (location = 4) in float inYaw;
+
+out vec2 fragmentQuadCoordinate;
+out vec2 fragmentFrameCoordinate;
+out vec3 fragmentCenter;
+out vec3 fragmentRight;
+out vec3 fragmentUp;
+out vec3 fragmentForward;
+out float fragmentRadius;
+out vec3 fragmentLightDirection;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPosition;
+uniform vec3 boundsCenter;
+uniform float boundsRadius;
+uniform int framesPerSide;
+uniform vec3 lightDirection;
+
+vec2 OctEncode(vec3 n)
+{
+	n /= (abs(n.x) + abs(n.y) + abs(n.z));
+	vec2 p = n.xz;
+	if (n.y < 0.0f)
+	{
+		p = (1.0f - abs(n.zx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.z >= 0.0f ? 1.0f : -1.0f);
+	}
+	return p;
+}
+
+void main()
+{
+	// from the prop's own space, as it was baked, to the world
+	float c = cos(inYaw);
+	float s = sin(inYaw);
+	mat3 yaw = mat3(c, 0.0f, -s, 0.0f, 1.0f, 0.0f, s, 0.0f, c);
+
+	float radius = boundsRadius * inInstance.w;
+	vec3 center = inInstance.xyz + yaw * boundsCenter * inInstance.w;
+
+	// view direction from the prop towards the camera, in the prop's
+	// space, selects the frame; the quad is turned back into the world
+	vec3 localForward = transpose(yaw) * normalize(viewPosition - center);
+	vec3 localUp = (abs(localForward.y) > 0.99f) ? vec3(0.0f, 0.0f, 1.0f) : vec3(0.0f, 1.0f, 0.0f);
+	vec3 localRight = normalize(cross(localUp, localForward));
+	vec3 forward = yaw * localForward;
+	vec3 right = yaw * localRight;
+	vec3 up = yaw * cross(localForward, localRight);
+
+	vec3 worldPosition = center + (right * inCorner.x + up * inCorner.y) * radius;
+	gl_Position = projection * view * vec4(worldPosition, 1.0f);
+
+	fragmentQuadCoordinate = inCorner * 0.5f + 0.5f;
+	fragmentFrameCoordinate = (OctEncode(localForward) * 0.5f + 0.5f) * float(framesPerSide) - 0.5f;
+	fragmentCenter = center;
+	fragmentRight = right;
+	fragmentUp = up;
+	fragmentForward = forward;
+	fragmentRadius = radius;
+	// the baked normals are in the prop's space
+	fragmentLightDirection = transpose(yaw) * lightDirection;
+}
@@ -0,0 +1,19 @@
+#version 440 core
+// the object's texture times the light baked for it - one lightmap
+// fetch in place of every light
+in vec2 fragmentTextureCoordinate;
+in vec2 fragmentLightmapCoordinate;
+
+out vec4 fragmentColor;
+
+uniform sampler2D objectTexture;
+uniform sampler2D lightmapTexture;
+// the light a full lightmap texel stands for
+uniform float lightmapRange;
+
+void main()
+{
+	vec3 albedo = texture(objectTexture, fragmentTextureCoordinate).rgb;
+	vec3 light = texture(lightmapTexture, fragmentLightmapCoordinate).rgb * lightmapRange;
+	fragmentColor = vec4(albedo * light, 1.0f);
+}
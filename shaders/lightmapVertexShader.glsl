@@ -0,0 +1,20 @@
+#version 440 core
+// static objects with baked light - the positions are already in world
+// space, and each vertex has its own place in the lightmap
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 2) in vec2 inTextureCoordinate;
+layout (location = 3) in vec2 inLightmapCoordinate;
+
+out vec2 fragmentTextureCoordinate;
+out vec2 fragmentLightmapCoordinate;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec2 UVscale;
+
+void main()
+{
+	gl_Position = projection * view * vec4(inVertexPosition, 1.0f);
+	fragmentTextureCoordinate = inTextureCoordinate * UVscale;
+	fragmentLightmapCoordinate = inLightmapCoordinate;
+}
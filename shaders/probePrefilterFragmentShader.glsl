@@ -0,0 +1,83 @@
+#version 440 core
+// convolves a probe capture with the GGX lobe of one roughness, for one
+// face of one mip, taking each sample from the capture mip that matches
+// its footprint so few samples stay smooth
+in vec2 faceCoordinate;
+
+out vec4 fragmentColor;
+
+uniform samplerCube captureCubemap;
+uniform int face;
+uniform float roughness;
+uniform float captureResolution;
+uniform int sampleCount;
+
+const float PI = 3.14159265359f;
+
+// the direction through a point of a face, in cubemap face order
+vec3 FaceDirection(int faceIndex, vec2 uv)
+{
+	if (faceIndex == 0) return vec3(1.0f, -uv.y, -uv.x);
+	if (faceIndex == 1) return vec3(-1.0f, -uv.y, uv.x);
+	if (faceIndex == 2) return vec3(uv.x, 1.0f, uv.y);
+	if (faceIndex == 3) return vec3(uv.x, -1.0f, -uv.y);
+	if (faceIndex == 4) return vec3(uv.x, -uv.y, 1.0f);
+	return vec3(-uv.x, -uv.y, -1.0f);
+}
+
+vec2 Hammersley(uint i, uint count)
+{
+	uint bits = bitfieldReverse(i);
+	return vec2(float(i) / float(count), float(bits) * 2.3283064365386963e-10f);
+}
+
+// a half vector around N, distributed as the GGX lobe
+vec3 SampleGGX(vec2 xi, vec3 N, float alpha)
+{
+	float phi = 2.0f * PI * xi.x;
+	float cosTheta = sqrt((1.0f - xi.y) / (1.0f + (alpha * alpha - 1.0f) * xi.y));
+	float sinTheta = sqrt(1.0f - cosTheta * cosTheta);
+	vec3 H = vec3(cos(phi) * sinTheta, sin(phi) * sinTheta, cosTheta);
+
+	vec3 up = (abs(N.z) < 0.999f) ? vec3(0.0f, 0.0f, 1.0f) : vec3(1.0f, 0.0f, 0.0f);
+	vec3 tangent = normalize(cross(up, N));
+	vec3 bitangent = cross(N, tangent);
+	return normalize(tangent * H.x + bitangent * H.y + N * H.z);
+}
+
+void main()
+{
+	vec3 N = normalize(FaceDirection(face, faceCoordinate));
+
+	// the top mip is the capture itself
+	if (roughness <= 0.0f)
+	{
+		fragmentColor = vec4(textureLod(captureCubemap, N, 0.0f).rgb, 1.0f);
+		return;
+	}
+
+	// the view and reflection are taken to be along the normal
+	float alpha = roughness * roughness;
+	float texelSolidAngle = 4.0f * PI / (6.0f * captureResolution * captureResolution);
+	vec3 color = vec3(0.0f);
+	float totalWeight = 0.0f;
+	for (int i = 0; i < sampleCount; i++)
+	{
+		vec3 H = SampleGGX(Hammersley(uint(i), uint(sampleCount)), N, alpha);
+		vec3 L = reflect(-N, H);
+		float NdotL = dot(N, L);
+		if (NdotL > 0.0f)
+		{
+			float NdotH = max(dot(N, H), 0.0f);
+			float d = NdotH * NdotH * (alpha * alpha - 1.0f) + 1.0f;
+			float D = alpha * alpha / (PI * d * d);
+			float pdf = D * 0.25f + 0.0001f;
+			float sampleSolidAngle = 1.0f / (float(sampleCount) * pdf);
+			float lod = 0.5f * log2(sampleSolidAngle / texelSolidAngle) + 1.0f;
+
+			color += textureLod(captureCubemap, L, max(lod, 0.0f)).rgb * NdotL;
+			totalWeight += NdotL;
+		}
+	}
+	fragmentColor = vec4(color / max(totalWeight, 0.0001f), 1.0f);
+}
@@ -0,0 +1,10 @@
+#version 440 core
+// one triangle covering the face being prefiltered; there are no vertices
+out vec2 faceCoordinate;
+
+void main()
+{
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	faceCoordinate = corner * 2.0f - 1.0f;
+	gl_Position = vec4(faceCoordinate, 0.0f, 1.0f);
+}
@@ -0,0 +1,29 @@
+#version 440 core
+// the probe's view along the reflected ray, blurred to the material's
+// roughness, with a Fresnel weighted alpha for blending over the lit object
+in vec3 fragmentPosition;
+in vec3 fragmentVertexNormal;
+
+out vec4 fragmentColor;
+
+uniform samplerCube reflectionCubemap;
+uniform vec3 cameraPosition;
+uniform vec3 specularColor;
+// the prefiltered mip matching the material's shininess
+uniform float reflectionLod;
+uniform float reflectionStrength;
+
+void main()
+{
+	vec3 N = normalize(fragmentVertexNormal);
+	vec3 V = normalize(cameraPosition - fragmentPosition);
+	vec3 R = reflect(-V, N);
+	vec3 reflection = textureLod(reflectionCubemap, R, reflectionLod).rgb;
+
+	// Schlick's approximation, from the specular colour at normal incidence
+	float F0 = max(specularColor.r, max(specularColor.g, specularColor.b));
+	float cosTheta = clamp(dot(N, V), 0.0f, 1.0f);
+	float fresnel = F0 + (1.0f - F0) * pow(1.0f - cosTheta, 5.0f);
+
+	fragmentColor = vec4(reflection * specularColor / max(F0, 0.0001f), fresnel * reflectionStrength);
+}
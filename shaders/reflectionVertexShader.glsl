@@ -0,0 +1,20 @@
+#version 440 core
+// a reflective object drawn again over itself, for its probe reflection
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec3 inVertexNormal;
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	vec4 worldPosition = model * vec4(inVertexPosition, 1.0f);
+	gl_Position = projection * view * worldPosition;
+
+	fragmentPosition = worldPosition.xyz;
+	fragmentVertexNormal = mat3(transpose(inverse(model))) * inVertexNormal;
+}
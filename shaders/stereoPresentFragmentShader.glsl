@@ -0,0 +1,13 @@
+#version 440 core
+// copies an eye's layer of the stereo target to the window
+in vec2 layerCoordinate;
+
+out vec4 fragmentColor;
+
+uniform sampler2DArray eyeLayers;
+uniform int eye;
+
+void main()
+{
+	fragmentColor = vec4(texture(eyeLayers, vec3(layerCoordinate, float(eye))).rgb, 1.0f);
+}
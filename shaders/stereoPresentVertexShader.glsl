@@ -0,0 +1,10 @@
+#version 440 core
+// one triangle covering the eye's half of the window; there are no vertices
+out vec2 layerCoordinate;
+
+void main()
+{
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	layerCoordinate = corner;
+	gl_Position = vec4(corner * 2.0f - 1.0f, 0.0f, 1.0f);
+}
@@ -0,0 +1,40 @@
+#version 440 core
+// stress scene shading - every fragment loops over every point light,
+// so the cost grows with the generated light count
+in vec3 fragmentPosition;
+in vec3 fragmentVertexNormal;
+in vec2 fragmentTextureCoordinate;
+flat in float fragmentTextureLayer;
+
+out vec4 fragmentColor;
+
+struct POINT_LIGHT
+{
+	vec4 positionRadius;
+	vec4 color;
+};
+
+layout (std430, binding = 0) readonly buffer Lights { POINT_LIGHT lights[]; };
+
+uniform sampler2DArray objectTextures;
+uniform int lightCount;
+uniform vec3 lightDirection;
+uniform vec3 lightColor;
+uniform vec3 ambientColor;
+
+void main()
+{
+	vec3 albedo = texture(objectTextures, vec3(fragmentTextureCoordinate, fragmentTextureLayer)).rgb;
+	vec3 normal = normalize(fragmentVertexNormal);
+
+	vec3 lighting = ambientColor + lightColor * max(dot(normal, -normalize(lightDirection)), 0.0f);
+	for (int i = 0; i < lightCount; i++)
+	{
+		vec3 toLight = lights[i].positionRadius.xyz - fragmentPosition;
+		float distance = length(toLight);
+		float falloff = clamp(1.0f - distance / lights[i].positionRadius.w, 0.0f, 1.0f);
+		lighting += lights[i].color.rgb * falloff * falloff * max(dot(normal, toLight / max(distance, 0.0001f)), 0.0f);
+	}
+
+	fragmentColor = vec4(albedo * lighting, 1.0f);
+}
@@ -0,0 +1,39 @@
+#version 440 core
+// multiview stereo for the stress scene - the driver runs this once per
+// eye, drawing to the layer gl_ViewID_OVR names; only the position may
+// depend on the eye
+#extension GL_OVR_multiview : require
+layout (num_views = 2) in;
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec3 inVertexNormal;
+layout (location = 2) in vec2 inTextureCoordinate;
+// per instance: model matrix columns and the texture array layer
+layout (location = 3) in vec4 inModel0;
+layout (location = 4) in vec4 inModel1;
+layout (location = 5) in vec4 inModel2;
+layout (location = 6) in vec4 inModel3;
+layout (location = 7) in float inTextureLayer;
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+flat out float fragmentTextureLayer;
+
+// both eyes' matrices, see StereoTarget
+layout (std140, binding = 1) uniform StereoEyes
+{
+	mat4 eyeView[2];
+	mat4 eyeProjection[2];
+};
+
+void main()
+{
+	mat4 model = mat4(inModel0, inModel1, inModel2, inModel3);
+	vec4 worldPosition = model * vec4(inVertexPosition, 1.0f);
+	gl_Position = eyeProjection[gl_ViewID_OVR] * eyeView[gl_ViewID_OVR] * worldPosition;
+
+	fragmentPosition = worldPosition.xyz;
+	fragmentVertexNormal = mat3(model) * inVertexNormal;
+	fragmentTextureCoordinate = inTextureCoordinate;
+	fragmentTextureLayer = inTextureLayer;
+}
@@ -0,0 +1,41 @@
+#version 440 core
+// instanced stereo for the stress scene - each object is drawn as two
+// instances, the per instance data advancing every second one, and the
+// low bit of the instance picks the eye and the layer it is drawn to
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec3 inVertexNormal;
+layout (location = 2) in vec2 inTextureCoordinate;
+// per object: model matrix columns and the texture array layer
+layout (location = 3) in vec4 inModel0;
+layout (location = 4) in vec4 inModel1;
+layout (location = 5) in vec4 inModel2;
+layout (location = 6) in vec4 inModel3;
+layout (location = 7) in float inTextureLayer;
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+flat out float fragmentTextureLayer;
+
+// both eyes' matrices, see StereoTarget
+layout (std140, binding = 1) uniform StereoEyes
+{
+	mat4 eyeView[2];
+	mat4 eyeProjection[2];
+};
+
+void main()
+{
+	int eye = gl_InstanceID & 1;
+	mat4 model = mat4(inModel0, inModel1, inModel2, inModel3);
+	vec4 worldPosition = model * vec4(inVertexPosition, 1.0f);
+	gl_Position = eyeProjection[eye] * eyeView[eye] * worldPosition;
+	gl_Layer = eye;
+
+	fragmentPosition = worldPosition.xyz;
+	fragmentVertexNormal = mat3(model) * inVertexNormal;
+	fragmentTextureCoordinate = inTextureCoordinate;
+	fragmentTextureLayer = inTextureLayer;
+}
@@ -0,0 +1,32 @@
+#version 440 core
+// instanced objects of the procedural stress scene - transforms and
+// texture layers are written by the CPU update every frame
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec3 inVertexNormal;
+layout (location = 2) in vec2 inTextureCoordinate;
+// per instance: model matrix columns and the texture array layer
+layout (location = 3) in vec4 inModel0;
+layout (location = 4) in vec4 inModel1;
+layout (location = 5) in vec4 inModel2;
+layout (location = 6) in vec4 inModel3;
+layout (location = 7) in float inTextureLayer;
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+flat out float fragmentTextureLayer;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	mat4 model = mat4(inModel0, inModel1, inModel2, inModel3);
+	vec4 worldPosition = model * vec4(inVertexPosition, 1.0f);
+	gl_Position = projection * view * worldPosition;
+
+	fragmentPosition = worldPosition.xyz;
+	fragmentVertexNormal = mat3(model) * inVertexNormal;
+	fragmentTextureCoordinate = inTextureCoordinate;
+	fragmentTextureLayer = inTextureLayer;
+}
@@ -0,0 +1,35 @@
+#version 440 core
+// procedural blade/leaf coverage written to alpha for alpha-to-coverage
+in vec2 fragmentTextureCoordinate;
+in vec3 fragmentNormal;
+in float fragmentFade;
+flat in float fragmentKind;
+flat in float fragmentTint;
+
+out vec4 fragmentColor;
+
+uniform vec3 lightDirection;
+uniform vec3 lightColor;
+uniform vec3 ambientColor;
+
+void main()
+{
+	vec2 uv = fragmentTextureCoordinate;
+	float across = abs(uv.x - 0.5f) * 2.0f;
+
+	// grass tapers to a point, undergrowth leaves are rounded
+	float halfWidth = (fragmentKind < 0.5f) ? (1.0f - uv.y) : sin(uv.y * 3.14159f);
+	float edge = halfWidth - across;
+	float coverage = clamp(edge / max(fwidth(edge), 1e-4f) + 0.5f, 0.0f, 1.0f) * fragmentFade;
+	if (coverage <= 0.0f)
+	{
+		discard;
+	}
+
+	vec3 baseColor = (fragmentKind < 0.5f) ? vec3(0.16f, 0.30f, 0.07f) : vec3(0.12f, 0.22f, 0.08f);
+	vec3 tipColor = (fragmentKind < 0.5f) ? vec3(0.45f, 0.55f, 0.20f) : vec3(0.25f, 0.38f, 0.12f);
+	vec3 albedo = mix(baseColor, tipColor, uv.y) * (0.8f + 0.4f * fragmentTint);
+
+	float diffuse = abs(dot(normalize(fragmentNormal), -normalize(lightDirection)));
+	fragmentColor = vec4(albedo * (ambientColor + lightColor * diffuse), coverage);
+}
@@ -0,0 +1,47 @@
+#version 440 core
+// instanced grass blades and undergrowth - the per-instance data is
+// generated procedurally per tile, so only the blade shape is stored
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec2 inTextureCoordinate;
+// per instance: xyz ground position, w height
+layout (location = 3) in vec4 inPlacement;
+// per instance: x rotation, y width, z kind (0 grass, 1 undergrowth), w tint
+layout (location = 4) in vec4 inVariation;
+
+out vec2 fragmentTextureCoordinate;
+out vec3 fragmentNormal;
+out float fragmentFade;
+flat out float fragmentKind;
+flat out float fragmentTint;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPosition;
+uniform float fadeStart;
+uniform float fadeEnd;
+uniform float time;
+
+void main()
+{
+	float distance = length(inPlacement.xyz - viewPosition);
+	fragmentFade = 1.0f - smoothstep(fadeStart, fadeEnd, distance);
+
+	// shrink blades into the ground as they fade so far tiles cost nothing to shade
+	float height = inPlacement.w * max(fragmentFade, 0.0f);
+	float s = sin(inVariation.x);
+	float c = cos(inVariation.x);
+	vec3 local = vec3(inVertexPosition.x * inVariation.y, inVertexPosition.y * height, inVertexPosition.z * inVariation.y);
+	vec3 rotated = vec3(c * local.x + s * local.z, local.y, -s * local.x + c * local.z);
+
+	// gentle sway, stronger towards the tip
+	float sway = sin(time * 1.7f + inPlacement.x * 0.3f + inPlacement.z * 0.2f) * 0.08f * inTextureCoordinate.y * height;
+	rotated.x += sway;
+
+	vec3 worldPosition = inPlacement.xyz + rotated;
+	gl_Position = projection * view * vec4(worldPosition, 1.0f);
+
+	fragmentTextureCoordinate = inTextureCoordinate;
+	fragmentNormal = normalize(vec3(-s, 0.6f, -c));
+	fragmentKind = inVariation.z;
+	fragmentTint = inVariation.w;
+}